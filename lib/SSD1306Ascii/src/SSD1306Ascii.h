@@ -41,7 +41,8 @@
  */
 
 //DUBLER MOD 082920 TURN OFF SCROLLING OPTION
-//#define INCLUDE_SCROLLING 1
+//  Back on - the OLED's graph screens scroll the display with setStartLine()  (Newline scrolling stays off, see INITIAL_SCROLL_MODE)
+#define INCLUDE_SCROLLING 1
 
 /** Initial scroll mode, SCROLL_MODE_OFF,
     SCROLL_MODE_AUTO, or SCROLL_MODE_APP. */
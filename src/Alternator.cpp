@@ -26,11 +26,19 @@
 #include "Alternator.h"
 #include "OSEnergy_Serial.h"
 #include "Sensors.h"
+#include "FeedForward.h"
+#include "GainSchedule.h"
+#include "ThermalModel.h"
+#include "SOC.h"
+#include "Taper.h"
+#include "BMS_SERIAL.h"
+#include "Flash.h"
 #include <math.h>
 
 int inChargingStateCount; // seconds left in warmup
 uint32_t inChargingStateTime;  // count up milliseconds in current state
-const char *chargingStateString;
+char chargingStateName[12];                     // Name of the current charging state, copied from SMStates[] by manage_ALT()
+const char *chargingStateString = chargingStateName;
 
 #ifdef ENABLE_FEATURE_IN_SCUBA
 bool scubaMode = false;
@@ -87,6 +95,9 @@ bool tachMode = false;               // Has the user indicated (via the DIP Swit
 //---   Targets which are 'regulated' towards:
 int altCapAmps = 0;     // This will contain the capacity of the Alternator, either determined by auto-sizing or as declared to use by the user.
 int altCapRPMs = 0;     // If we did an auto-sizing cycle, this will be the high-water mark RPMs  (= 0 indicates we have not yet measured the capacity)
+                        //   (When auto-sizing, both are looked up from the Capability Curve for the current RPMs, see set_VAWL() )
+tACC altCapCurve;                // Auto-sizing Capability Curve, demonstrated Amps at each RPMs grid point.  Loaded from EEPROM at startup.
+bool altCapCurveChanged = false; // Has it been updated since last saved?
                         // Default deployment is assumed to be Battery Centric; hence these two limits are disabled.  Note that reduced power modes will
                         // directly adjust the PWM duty-cycle, to approx things like Half-Power mode, etc.
 int targetAltWatts = 0; // Where do we want to be.  Will me adjusted for charger mode and battery temp.
@@ -100,6 +111,7 @@ bool smallAltMode = false; // Has the user indicated (vita the DIP Switch) they
                            //   alternator has limited heat dispersion capability and will as such reduce its output to a max of ALT_AMP_DERATE_SMALL_MODE
                            //   of its capability (as auto-measured, or defined by the user).
 tCPS chargingParms;  // Charge Parameters we are currently working with, appropriate entry is copied from EEPROM or FLASH during startup();
+tCompiledCPS compiledCPS; // .. and its thresholds, scaled for this system by compile_CPS().
 uint8_t cpIndex = 0; // Which entry in the chargeParms structure should we be using for battery setpoints?  (Default = 1st one)
 
 float systemAmpMult = 1; // Multiplier used to adjust Amp targets for the charging setpoints?
@@ -119,12 +131,23 @@ float systemVoltMult = 1; // The actually system battery is this mutable of a "1
                           //
                           //  Using a Float allows better support for other voltages, ala 2.666 --> 32v batteries. 3.5 --> 42v ones.
 
-int8_t SDMCounter = SDM_SENSITIVITY; // Use this to moderate the number of times the Serial port is updated with debug info.
 bool sendDebugString = false;        // By default, lets assume we are NOT sending out the debug string.  Unless overridden by $EDB:, or
                                      // if #define DEBUG is present (look in startup() )
 
+//---  Working values of manage_ALT() that are also used by the Charging State Machine guards and actions.
+static float errorA;           // Measured - target:  + = over target, - = under target.
+static float errorW;
+static bool atTargVoltage;     // Have we reached the target voltage?  Used when checking to see if we are ready to transation to the next Mode.
+static uint32_t enteredMills;  // Time in millis() managed_alt() was entered.  Used throughout function and saves 300 bytes of code vs. repeated millis() calls
+static int PWMError;           // Holds final PWM modification value.
+static int32_t persistentBatmV; // persistentBatVolts / Amps, and measuredBatAmps converted once each pass for the state machine guards'
+static int16_t persistentBatdA; //   integer compares against compiledCPS.
+static int16_t measuredBatdA;
+
 // Internal function prototypes.
 void set_VAWL(float passedV);
+static void update_ALT_cap_curve(void);
+static bool ALT_cap_sample_needed(void);
 
 //------------------------------------------------------------------------------------------------------
 // Initialize Alternator
@@ -142,6 +165,9 @@ bool initialize_alternator(void)
 
     attachInterrupt(STATOR_IRQ_NUMBER, stator_IRQ, RISING); // Setup the Interrupt from the Stator.
 
+    if (read_ACC_EEPROM(&altCapCurve) != true)    // Pick up what we have learned about the alternators capability in prior runs.
+        memset(&altCapCurve, 0, sizeof(tACC));    //  (Or start fresh if nothing valid saved)
+
     set_ALT_PWM(0);             // When starting up, make sure to turn off the Field
     set_charging_mode(unknown); // We are just starting out...
 
@@ -236,6 +262,11 @@ void calculate_ALT_targets(void)
 
     int i;
     float f;
+    tSMState st;
+#ifdef USE_BMS_SERIAL_IN
+    static bool cellOver = false; // Highest cell went past CELL_MAX_MV + CELL_OVER_MV, Amps cut until it is back to CELL_MAX_MV
+#endif
+
     if (cpIndex >= MAX_CPES)
     { // As this is a rather critical function, do a range check on the current index
         chargingState = FAULTED;
@@ -247,11 +278,12 @@ void calculate_ALT_targets(void)
         ((measuredBatTemp >= chargingParms.BAT_MAX_CHARGE_TEMP) || (measuredBatTemp <= chargingParms.BAT_MIN_CHARGE_TEMP)))
         set_charging_mode(float_charge); // If we are too warm or too cold - force charger to Float Charge safety voltage.
 
-    switch (chargingState)  // to find correct BAT_V_SETPOINT and set targetAltAmps and targetAltWatts
+    if (get_SM_state(chargingState, &st) != true)
+        st.targets = SMT_OFF; // Some state manage_ALT() does not know how to run, make sure the alternator is turned off.
+
+    switch (st.targets)  // to find correct BAT_V_SETPOINT and set targetAltAmps and targetAltWatts
     {
-    case warm_up:
-    case ramping:
-    //case post_ramp:
+    case SMT_RAMP:
         f = chargingParms.ACPT_BAT_V_SETPOINT;  // When Ramping up, we want to target the lower of Acpt or Float set points
         if ((chargingParms.FLOAT_BAT_V_SETPOINT != 0) && (chargingParms.FLOAT_BAT_V_SETPOINT < f)) 
             f = chargingParms.FLOAT_BAT_V_SETPOINT;                                                
@@ -259,48 +291,78 @@ void calculate_ALT_targets(void)
         set_VAWL(f); // Set the Volts/Amps/Watts limits (See helper function just below)
         break;
 
-    case bulk_charge:
-    case determine_ALT_cap:
-    case acceptance_charge:
+    case SMT_ACPT:
         set_VAWL(chargingParms.ACPT_BAT_V_SETPOINT); // Set the Volts/Amps/Watts limits (See helper function just below)
         break;
 
-    case overcharge_charge:
+    case SMT_OC:
         set_VAWL(chargingParms.EXIT_OC_VOLTS);  // Set the Volts taking into account comp factors (system voltage, bat temp..)
-        targetAltAmps = min(targetAltAmps, (chargingParms.LIMIT_OC_AMPS * systemAmpMult)); // Need to override the default Amps / Watts calc, as we do things a bit different in OC mode.
-        targetAltWatts = min(targetAltWatts, (chargingParms.EXIT_OC_VOLTS * systemVoltMult * targetAltAmps));
+        targetAltAmps = min(targetAltAmps, compiledCPS.LIMIT_OC_AMPS); // Need to override the default Amps / Watts calc, as we do things a bit different in OC mode.
+        targetAltWatts = min(targetAltWatts, (compiledCPS.EXIT_OC_VOLTS * targetAltAmps));
         break;
 
-    case float_charge:
-    case forced_float_charge:
+    case SMT_FLOAT:
         set_VAWL(chargingParms.FLOAT_BAT_V_SETPOINT); // Set the Volts/Amps/Watts limits (See helper function just below)
 
         if ((chargingParms.LIMIT_FLOAT_AMPS != -1) && (shuntAltAmpsMeasured == true))
         {   // User wants active current regulation during FLOAT, AND it seems the shunt it working.
-            targetAltAmps = min(targetAltAmps, (chargingParms.LIMIT_FLOAT_AMPS * systemAmpMult)); // Need to override the commonly set target Amps / Watts calcs.
-            targetAltWatts = min(targetAltWatts, (chargingParms.FLOAT_BAT_V_SETPOINT * systemVoltMult * targetAltAmps));
+            targetAltAmps = min(targetAltAmps, compiledCPS.LIMIT_FLOAT_AMPS); // Need to override the commonly set target Amps / Watts calcs.
+            targetAltWatts = min(targetAltWatts, (compiledCPS.FLOAT_BAT_VOLTS * targetAltAmps));
         }
 
         break;
 
-    case equalize:
+    case SMT_EQUAL:
         set_VAWL(chargingParms.EQUAL_BAT_V_SETPOINT); // Set the Volts/Amps/Watts limits (See helper function just below)
 
         if (chargingParms.LIMIT_EQUAL_AMPS != 0)
         {
-            targetAltAmps = min(targetAltAmps, (chargingParms.LIMIT_EQUAL_AMPS * systemAmpMult));
-            targetAltWatts = min(targetAltWatts, (chargingParms.EQUAL_BAT_V_SETPOINT * systemVoltMult * targetAltAmps));
+            targetAltAmps = min(targetAltAmps, compiledCPS.LIMIT_EQUAL_AMPS);
+            targetAltWatts = min(targetAltWatts, (compiledCPS.EQUAL_BAT_VOLTS * targetAltAmps));
         }
         break; // In equalization mode need to re-calc the Watts limits, as one of the
 
-    case LIFEPO_FORCED_SHUTDOWN:
+    case SMT_OFF:
     default:
         targetBatVolts = 0.0; // We are shut down, faulted, or in an undefined state.
         targetAltWatts = 0;
         targetAltAmps = 0;
         fieldPWMLimit = 0;  // no need to call set_VAWL() and should not to avoid any overrides that might get set there
         break; //return;
-    } //switch (chargingState)
+    } //switch (st.targets)
+
+#ifdef USE_BMS_SERIAL_IN
+    if ((chargingParms.CELL_TAPER_MV != 0) && (chargingParms.CELL_MAX_MV > chargingParms.CELL_TAPER_MV) &&
+        (st.targets != SMT_OFF) && (st.targets != SMT_FLOAT) && (BMS_cells_valid() == true))
+    { // Charging, and we can see the cells.  As the highest cell nears its limit, taper the Amps back to BALANCE_AMPS so the BMS
+      //   can balance the others up to it - rather than driving it into the BMS disconnect.
+        i = BMS_cell_max();
+        if (i > (chargingParms.CELL_MAX_MV + CELL_OVER_MV))
+            cellOver = true;
+        else if (i <= chargingParms.CELL_MAX_MV)
+            cellOver = false;
+
+        if (cellOver)
+            f = 0.0; //  (Well over the limit, back off altogether until it comes down)
+        else if (i >= chargingParms.CELL_MAX_MV)
+            f = compiledCPS.BALANCE_AMPS; //  At the limit, hold it there while the BMS balances the others up
+        else if (i > chargingParms.CELL_TAPER_MV)
+            f = compiledCPS.BALANCE_AMPS + ((targetAltAmps - compiledCPS.BALANCE_AMPS) * (chargingParms.CELL_MAX_MV - i) / (float)(chargingParms.CELL_MAX_MV - chargingParms.CELL_TAPER_MV));
+        else
+            f = targetAltAmps;
+
+        targetAltAmps = min(targetAltAmps, max(f, 0.0));
+        targetAltWatts = min(targetAltWatts, (int)(targetAltAmps * targetBatVolts));
+    }
+#endif
+
+#ifdef USE_THERMAL_MODEL
+    if ((thermalAmpsCap >= 0) && (targetAltAmps != 0) && (chargingState != determine_ALT_cap))
+    { // Hold back the Amps (and so Watts) to what the Thermal Model says the alternator can keep up without going over temp.
+        targetAltAmps = min(targetAltAmps, thermalAmpsCap);
+        targetAltWatts = min(targetAltWatts, (int)(thermalAmpsCap * targetBatVolts));
+    }
+#endif
 
     if ((targetBatVolts != 0.0) && (measuredBatTemp != -99))
     {  // If we can read the Bat Temp probe, do the Battery Temp Comp Calcs.
@@ -310,6 +372,11 @@ void calculate_ALT_targets(void)
             i = measuredBatTemp;
 
         targetBatVolts += (BAT_TEMP_NOMINAL - i) * chargingParms.BAT_TEMP_1C_COMP * systemVoltMult;
+
+#ifdef USE_BMS_SERIAL_IN
+        if (BMS_limits_valid() == true)
+            targetBatVolts = min(targetBatVolts, (bmsData.CVL_mV / 1000.0)); // (Temp Comp does not get to go over the BMS limit either)
+#endif
     }
 } //calculate_ALT_targets
 
@@ -322,6 +389,12 @@ void set_VAWL(float passedV)
 
     targetBatVolts = passedV * systemVoltMult; // Set global regulate-to voltage.
 
+    if ((systemConfig.ALT_AMPS_LIMIT == -1) && (chargingState != determine_ALT_cap))
+    {                                               // If we are auto-sizing the alternator, use the capability it has shown at the RPMs we are
+        altCapAmps = ALT_cap_at_RPMs(measuredRPMs); //   turning NOW, not the high-RPM peak.  (Alternators make a lot less at idle)
+        altCapRPMs = measuredRPMs;
+    }
+
     // Set the 'high water limits' (Alt Amps, Watts, and max PWM to use) applying various de-rating values.
     //   Note that we ALWAYS apply the de-rating values, even if the user has told us the Alternator size.
     //   Note also that in addition to de-rating via measured Amps, we will also 'de-rate' based in the max
@@ -371,6 +444,16 @@ void set_VAWL(float passedV)
     if (chargingState == determine_ALT_cap)
         fieldPWMLimit = FIELD_PWM_MAX; // And if we are indeed determining the Alt Capacity, we need to be able to drive the Field PWM full bore!
 
+#ifdef USE_BMS_SERIAL_IN
+    if (BMS_limits_valid() == true)
+    { // Never ask for more than the BMS says the battery can take, whatever the state.
+        targetBatVolts = min(targetBatVolts, (bmsData.CVL_mV / 1000.0));
+        targetAltAmps = min(targetAltAmps, (bmsData.CCL_dA / 10.0));
+        if (bmsData.flags & BMS_FLAG_NO_CHARGE)
+            targetAltAmps = 0;
+    }
+#endif
+
     if (systemConfig.ALT_WATTS_LIMIT == -1)
         targetAltWatts = targetBatVolts * targetAltAmps; // User has selected Auto-calculation for Watts limit
     else
@@ -381,6 +464,151 @@ void set_VAWL(float passedV)
                                 // for the System Wattage), set Watts to a LARGE number  (Ahem, see 1000A comment above  :-)
 } //set_VAWL
 
+//------------------------------------------------------------------------------------------------------
+//
+//  Alternator Capability at RPMs
+//              Returns the Amps capability of the alternator at the passed engine RPMs, interpolated between the
+//              sampled grid points of the Capability Curve.   Below the lowest sampled point the capability is
+//              scaled down in proportion to RPMs, above the highest one it is held flat.  If RPMs are not known (= 0),
+//              the highest capability seen is returned.   Returns 0 if nothing has been sampled yet.
+//
+//------------------------------------------------------------------------------------------------------
+
+int ALT_cap_at_RPMs(int RPMs)
+{
+    int lo = -1;  // Sampled grid points just at/below, and just above the RPMs
+    int hi = -1;
+    float f;
+    float amps = 0.0;
+
+    f = (float)RPMs / ACC_RPM_STEP;
+
+    for (int r = 0; r < ACC_RPM_BINS; r++)
+    {
+        if ((altCapCurve.SAMPLED & (1U << r)) == 0)
+            continue;
+
+        amps = max(amps, altCapCurve.AMPS[r]);
+
+        if (r <= f)
+            lo = r;
+        else if (hi == -1)
+            hi = r;
+    }
+
+    if ((RPMs == 0) || ((lo == -1) && (hi == -1)))
+        return ((int)amps); // Can not see RPMs (or nothing sampled), use the high-water mark  (0 if none)
+
+    if (hi == -1)
+        return ((int)altCapCurve.AMPS[lo]);
+
+    if (lo == -1)
+        return ((int)(altCapCurve.AMPS[hi] * f / hi));
+
+    return ((int)(altCapCurve.AMPS[lo] + ((altCapCurve.AMPS[hi] - altCapCurve.AMPS[lo]) * (f - lo) / (hi - lo))));
+} //ALT_cap_at_RPMs
+
+//-------       'helper' functions used by manage_ALT() to maintain the Capability Curve.
+//
+//              update_ALT_cap_curve() is called each PID cycle.   Any Amps seen above what the curve holds for the current grid point raises
+//              it right away.   While the field is full on (or during a Capacity Sample cycle) the grid point is also marked as sampled, and it is
+//              allowed to fall slowly towards what is measured, so a hot alternator gets de-rated.
+//              ALT_cap_sample_needed() tells bulk_charge if we are running at RPMs that have never been sampled, and so a Capacity Sample is needed.
+
+static void update_ALT_cap_curve(void)
+{
+    uint8_t r;
+    bool fullField;
+
+    if ((systemConfig.ALT_AMPS_LIMIT != -1) || (measuredRPMs == 0) || (shuntAltAmpsMeasured == false) || (measuredAltAmps <= 0.0))
+        return; // Not auto-sizing, or can not see what we need to.
+
+    r = min((measuredRPMs + (ACC_RPM_STEP / 2)) / ACC_RPM_STEP, ACC_RPM_BINS - 1); // Closest grid point
+
+    fullField = (chargingState == determine_ALT_cap) ||
+                ((fieldPWMvalue >= FIELD_PWM_MAX) && ((measuredBatVolts - targetBatVolts) <= (LD1_THRESHOLD * systemVoltMult)));
+
+    if (measuredAltAmps > altCapCurve.AMPS[r])
+    {
+        altCapCurve.AMPS[r] = measuredAltAmps; // We want to track increases quickly,
+        altCapCurveChanged = true;
+    }
+    else if ((fieldPWMvalue >= FIELD_PWM_MAX) && ((altCapCurve.SAMPLED & (1U << r)) != 0))
+    { // but decreases slowly, and only when it is really being pushed.
+        altCapCurve.AMPS[r] = ((altCapCurve.AMPS[r] * (float)(ACC_PERSISTENCE_FACTOR - 1)) + measuredAltAmps) / ACC_PERSISTENCE_FACTOR;
+        altCapCurveChanged = true;
+    }
+
+    if ((fullField) && ((altCapCurve.SAMPLED & (1U << r)) == 0))
+    {
+        altCapCurve.SAMPLED |= (1U << r);
+        altCapCurveChanged = true;
+    }
+}
+
+static bool ALT_cap_sample_needed(void)
+{
+    uint8_t r;
+
+    if (measuredRPMs == 0)
+        return (false); // Can not do a Capacity Sample if we can not see RPMs anyway.
+
+    r = min((measuredRPMs + (ACC_RPM_STEP / 2)) / ACC_RPM_STEP, ACC_RPM_BINS - 1);
+
+    return ((altCapCurve.SAMPLED & (1U << r)) == 0);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Checkpoint Alternator Capability Curve
+//      Called from the Mainloop.  If the Capability Curve has been updated while regulating, save it to EEPROM - but no
+//      more often than ACC_CHECKPOINT_PERIOD.  (It is also saved at the end of each Capacity Sample cycle)
+//
+//------------------------------------------------------------------------------------------------------
+
+void checkpoint_ACC(void)
+{
+    uint32_t static lastCheckpoint = 0;
+
+    if ((altCapCurveChanged == true) && ((millis() - lastCheckpoint) >= ACC_CHECKPOINT_PERIOD))
+    {
+        write_ACC_EEPROM(&altCapCurve);
+        altCapCurveChanged = false;
+        lastCheckpoint = millis();
+    }
+} //checkpoint_ACC
+
+//------------------------------------------------------------------------------------------------------
+// Compile Charging Profile
+//      Called once during Startup, after the working Charge Profile (chargingParms) has been loaded and the system
+//      Volts / Amps multipliers are known.  Scales the thresholds checked every time around by the charging state
+//      machine and check_for_faults() into compiledCPS, as mV / 0.1A integers, so they need not be re-multiplied
+//      in floating point each pass.  Call it again if chargingParms or the multipliers are ever changed on the fly.
+//
+//------------------------------------------------------------------------------------------------------
+
+void compile_CPS(void)
+{
+    compiledCPS.EXIT_ACPT_dA = TO_dA(chargingParms.EXIT_ACPT_AMPS * systemAmpMult);
+    compiledCPS.FLOAT_TO_BULK_dA = TO_dA(chargingParms.FLOAT_TO_BULK_AMPS * systemAmpMult);
+    compiledCPS.EXIT_EQUAL_dA = TO_dA(chargingParms.EXIT_EQUAL_AMPS * systemAmpMult);
+    compiledCPS.FLOAT_TO_BULK_AHS = (int16_t)floor(chargingParms.FLOAT_TO_BULK_AHS * systemAmpMult); // Compared against whole Ahs, so
+    compiledCPS.PF_TO_BULK_AHS = (int16_t)floor(chargingParms.PF_TO_BULK_AHS * systemAmpMult);       //   rounding down gives the same result.
+
+    compiledCPS.FLOAT_TO_BULK_mV = TO_mV(chargingParms.FLOAT_TO_BULK_VOLTS * systemVoltMult);
+    compiledCPS.PF_TO_BULK_mV = TO_mV(chargingParms.PF_TO_BULK_VOLTS * systemVoltMult);
+    compiledCPS.FAULT_CHARGE_mV = TO_mV(FAULT_BAT_VOLTS_CHARGE * systemVoltMult);
+    compiledCPS.FAULT_EQUAL_mV = TO_mV(FAULT_BAT_VOLTS_EQUALIZE * systemVoltMult);
+    compiledCPS.FAULT_LOW_mV = TO_mV(FAULT_BAT_VOLTS_LOW * systemVoltMult);
+
+    compiledCPS.EXIT_OC_VOLTS = chargingParms.EXIT_OC_VOLTS * systemVoltMult;
+    compiledCPS.FLOAT_BAT_VOLTS = chargingParms.FLOAT_BAT_V_SETPOINT * systemVoltMult;
+    compiledCPS.EQUAL_BAT_VOLTS = chargingParms.EQUAL_BAT_V_SETPOINT * systemVoltMult;
+    compiledCPS.LIMIT_OC_AMPS = chargingParms.LIMIT_OC_AMPS * systemAmpMult;
+    compiledCPS.LIMIT_FLOAT_AMPS = chargingParms.LIMIT_FLOAT_AMPS * systemAmpMult;
+    compiledCPS.LIMIT_EQUAL_AMPS = chargingParms.LIMIT_EQUAL_AMPS * systemAmpMult;
+    compiledCPS.BALANCE_AMPS = chargingParms.BALANCE_AMPS * systemAmpMult;
+} //compile_CPS
+
 //------------------------------------------------------------------------------------------------------
 //
 //  Set Alternator Mode
@@ -439,6 +667,426 @@ void set_ALT_PWM(int PWM)
 
 } //set_ALT_PWM
 
+//------------------------------------------------------------------------------------------------------
+//
+//  Charging State Machine
+//              The guards and actions used by the SMTrans[] and SMStates[] tables just below, which in turn are run by
+//              run_charging_SM() each time manage_ALT() has worked out the PID corrections.
+//
+//              -- Ramp   --> Bulk:    Total time allocated for Ramping exceeded, or we are driving alternator full bore.
+//              -- Bulk   --> Accept:  VBatt reached max
+//              -- Accept --> Float:   Been in Accept phase for EXIT_ACPT_DURATION
+//              -- Float  --> ????
+//
+//------------------------------------------------------------------------------------------------------
+
+static bool SM_hold(void)
+{
+    return (true); // If we got called here while in FAULT condition, do not change anything.
+}
+
+static bool SM_field_off(void)
+{
+    fieldPWMvalue = FIELD_PWM_MIN; //  Turn off alternator
+    PWMError = 0;
+    return (false);
+}
+
+static bool SM_disabled_tick(void)
+{
+    PWMError = 0;
+    LEDRepeat = 0;     // And force a resetting of the LED blinking pattern
+    fieldPWMvalue = 0; //  Turn off alternator.
+    return (false);
+}
+
+static bool SM_LIFEPO_tick(void)
+{
+    fieldPWMvalue = 0; //  Turn off alternator.
+    return (false);
+}
+
+//---  WARM UP
+static bool SM_warmup_tick(void)
+{
+    if ((tachMode) && (systemConfig.FIELD_TACH_PWM > 0)) // If user has configured system to have a min PWM value for Tach mode
+        fieldPWMvalue = systemConfig.FIELD_TACH_PWM;     // send that out, even during engine warm-up period.
+    else
+        fieldPWMvalue = FIELD_PWM_MIN; //  All other cases, Alternator should still be turned off.
+
+    PWMError = 0; // we will not be making ANY adjustments to the PWM for now.
+
+    // countdown for warm-up
+    inChargingStateCount = (uint32_t)systemConfig.ENGINE_WARMUP_DURATION - int((enteredMills - altModeChanged) / 1000UL); // capture the number of second remaining in the warmup.
+    return (false);
+}
+
+static bool SM_warmup_done(void)
+{
+    return (((enteredMills - altModeChanged) > ((uint32_t)systemConfig.ENGINE_WARMUP_DURATION * 1000UL)) &&
+            !((tachMode) && (systemConfig.FIELD_TACH_PWM > 0) && (measuredRPMs == 0))); //  (But 1st - if we expect to be able to measure RPMs, don't leave pending until we do  (Engine might be stopped))
+}
+
+//---  RAMPING
+static bool SM_ramp_tick(void)
+{
+    persistentBatAmps = measuredBatAmps;   //  While ramping, just track the actually measured amps and Watts.
+    persistentBatVolts = measuredBatVolts; //  Overwriting the persistence calculation above.
+    reset_run_summary();                   // Starting a new Charge Cycle - reset the accumulators.
+
+    // countdown for ramping
+    inChargingStateCount = int(((PWM_RAMP_RATE * FIELD_PWM_MAX / PWM_CHANGE_CAP) - (enteredMills - altModeChanged)) / 1000UL); // capture the number of second remaining in the ramp.
+
+    if (systemConfig.ALT_AMPS_LIMIT != -1)        // Starting a new 'charge cycle' (1st time or restart from float).
+    {
+        altCapAmps = systemConfig.ALT_AMPS_LIMIT; // User is telling us the capacity of the alternator (Or disabled Amps by setting this = 0)
+        altCapRPMs = 0;
+    }                                             // If user has selected Auto-determine mode, the Capability Curve carries over from
+                                                  // prior cycles (and boots) - only RPMs never sampled before need a new Capacity Sample.
+    return (false);
+}
+
+static bool SM_ramp_done(void)
+{
+    return ((fieldPWMvalue >= fieldPWMLimit) ||  // Driving alternator full bore?
+            (atTargVoltage) ||                   // Reached terminal voltage?
+            (errorA >= 0) ||                     // Reached terminal Amps?
+            (errorW >= 0) ||                     // Reached terminal Watts?  (Reaching ANY of these limits should cause exit of RAMP mode)
+            ((enteredMills - altModeChanged) >= PWM_RAMP_RATE * FIELD_PWM_MAX / PWM_CHANGE_CAP) // Or, have we been ramping long enough?
+#ifdef ENABLE_FEATURE_IN_SCUBA
+            ||
+            ((scubaMode) && (fieldPWMvalue >= FIELD_PWM_SCUBA)) // or, if in scubaMode AND PWM is at Scuba level
+#endif
+    );
+}
+
+static bool SM_ramp_done_sample(void)
+{
+    return (SM_ramp_done() && (systemConfig.ALT_AMPS_LIMIT == -1) && (ALT_cap_sample_needed())); // But 1st see if we need to measure the Alternators Capacity..
+}
+
+static bool SM_ramp_stay(void)
+{
+    return ((enteredMills - lastPWMChanged) <= PWM_RAMP_RATE); // Still under limits, while ramping wait longer between changes..
+}
+
+//---  DETERMINE ALT CAPACITY
+static bool SM_det_cap_done(void)
+{
+    return ((systemConfig.ALT_AMPS_LIMIT != -1) || // If we are NOT configured to auto-determining the Alt Capacity,   --OR--
+            (fieldPWMvalue == FIELD_PWM_MAX) ||    // we have Maxed Out the Field (PWM capping should have been removed during alt_cap mode) --OR--
+            (atTargVoltage) ||                     // Reached terminal voltage?  --OR-- (meaning, we really can not finish determine the Alt cap as the battery is kind of full.....)
+            (measuredRPMs == 0) ||                 // If we are not able to see RPMs, can not reliably do alt-cap setting
+            (shuntAltAmpsMeasured == false) ||     //  And of course, if we are not even able to measure current - not a chance to size the alt!
+            ((enteredMills - altModeChanged) >= SAMPLE_ALT_CAP_DURATION)); // Finally -- have we been doing an Alt Cap Sampling Cycle long enough..
+}
+
+static bool SM_det_cap_save(void)
+{
+    if (altCapCurveChanged == true)
+    {                                   // The Capability Curve was updated by update_ALT_cap_curve() as we pushed the alternator,
+        write_ACC_EEPROM(&altCapCurve); //   save it now so we do not need to stress the alternator for these RPMs again.
+        altCapCurveChanged = false;
+    }
+    return (false);
+}
+
+//---  BULK CHARGE MODE
+//      The purpose of bulk mode is to drive as much energy into the battery as fast as it will take it.
+//      Bulk is easy, we simply drive the alternator hard until the battery voltage reaches the terminal voltage as defined by .ACPT_BAT_V_SETPOINT in the CPE.
+//      While in Bulk Mode, we will also see if there is reason for us to re-sample the alternator capacity (if configured to do so), ala the RPM have increased
+//      indicating the engine has sped up.
+static bool SM_bulk_tick(void)
+{
+    inChargingStateTime = (enteredMills - altModeChanged);
+    persistentBatAmps = measuredBatAmps; //  While in Bulk as well, just track the actually measured amps and Watts.
+                                         // (Prevents any initial low-amp numbers from clouding the issue once we get into Acceptance)
+    return (false);
+}
+
+static bool SM_at_target_volts(void)
+{
+    return (atTargVoltage);
+}
+
+static bool SM_bulk_to_accept(void)
+{
+    adptExitAcceptDuration = (enteredMills - altModeChanged) * ADPT_ACPT_TIME_FACTOR; // Calculate a time-only based acceptance duration based on how long we had been in Bulk mode,
+    return (false);                                                                   //    (In case we cannot see Amps.)
+}
+
+static bool SM_bulk_stay(void)
+{
+    return (((enteredMills - rampModeEntered) <= PWM_RAMP_RATE * FIELD_PWM_MAX / PWM_CHANGE_CAP) &&
+            ((enteredMills - lastPWMChanged) <= PWM_RAMP_RATE)); // If somehow Ramp-mode got short-changed, continue the nice soft ramping until we get to the target voltage.
+}
+
+static bool SM_bulk_sample(void)
+{
+    return ((systemConfig.ALT_AMPS_LIMIT == -1) &&                     // Are we configured to auto-capacity sample the alternator?
+            ((enteredMills - altModeChanged) > SAMPLE_ALT_CAP_REST) && // Did we just do a capacity sample cycle, and if so have we 'rested' the alternator long enough?
+            (SM_bulk_stay() != true) &&                                // (And not still finishing up a short-changed Ramp)
+            (ALT_cap_sample_needed()));                                // IF we are spinning the alternator at RPMs we have never sampled.  (Higher Amps than the curve holds simply raise it, see update_ALT_cap_curve() )
+                                                                       // This last step is kind of the key.  During a new cycle we will not artificially reduce the output
+                                                                       // of the alternator, but instead run it as hard as we can to see if we get a new High Water Mark.
+                                                                       // After a short period of time we will then re-enable the reduced current modes (ala smallAltMode)
+}
+
+//---  ACCEPTANCE CHARGE MODE
+//      In acceptance phase we are packing in extra energy into the battery until it is fully charged.  We cap the voltage to .ACPT_BAT_V_SETPOINT to keep from overheating
+//      the battery, and the battery itself controls how many Amps it will 'accept'.  The handling of accept phase is one of the key benefits of using this regulator, as
+//      by monitoring the accepted amps we can MEASURE the batteries state of charge.  Once the acceptance amps fall below about 1-2% of the batteries Ah capacity, we know
+//      the battery is fully charged.  The Amp trigger is defined by .EXIT_ACPT_AMPS, once we fall below this level we move on.  We can also move on by staying too long in
+//      acceptance phase.  CPE entry .EXIT_ACPT_DURATION allows for a time limit to be defined, and if we exceed this time limit we move on.  This can be used when the AMP
+//      shunt is not connected, but also provides a level of protection increase something goes wrong - protection from boiling the battery dry.
+//      Finally, the regulator can be configured to disable Amp-based determination of Exit-Acceptance and instead to a time-based exit criteria based on some factor
+//      of the amount of timer we spent in Bulk.  This will happen if the user has entered -1 in the  EXIT_ACPT_AMPS, OR we do not seem to be able to measure any Amps
+//      (ala, the user has not connected up the shunt).  Note that even with Adaptive Acceptance duration, we will never exceed the configured EXIT_ACPT_DURATION value.
+static bool SM_accept_tick(void)
+{
+    inChargingStateTime = uint32_t(enteredMills - altModeChanged);
+#ifdef USE_TAPER_EXIT
+    update_TPR(atTargVoltage); // Follow the taper of the battery Amps.
+#endif
+    return (false);
+}
+
+static bool SM_cells_balanced(void)
+{
+#ifdef USE_BMS_SERIAL_IN
+    return ((chargingParms.CELL_TAPER_MV == 0) || (chargingParms.BALANCE_SPREAD_MV == 0) || // Not waiting on balancing?
+            (BMS_cells_valid() != true) ||                                                 //   (or cannot see the cells)
+            (BMS_cell_spread() <= chargingParms.BALANCE_SPREAD_MV));                       // Else have they come together?
+#else
+    return (true);
+#endif
+}
+
+static bool SM_accept_done(void)
+{
+    if ((SM_cells_balanced() != true) &&                                                 // Hold the balancing plateau until the cells have come together,
+        !((chargingParms.EXIT_ACPT_DURATION > 0) &&                                     //   but never past the Acceptance time limit.
+          ((enteredMills - altModeChanged) >= chargingParms.EXIT_ACPT_DURATION)))
+        return (false);
+
+    return (((chargingParms.EXIT_ACPT_DURATION > 0) &&
+             ((enteredMills - altModeChanged) >= chargingParms.EXIT_ACPT_DURATION)) || // 4 ways to exit.  Have we have been in Acceptance Phase long enough?  --OR--
+
+            ((chargingParms.EXIT_ACPT_AMPS == -1) &&                         // Have we been configured to do Adaptive Acceptance?
+#ifdef USE_SOC_ESTIMATOR
+             ((chargingParms.EXIT_ACPT_SOC == 0) || (SOC_valid() != true)) && //  (Unless we know the State of Charge, then it is used instead - just below)
+#endif
+             ((enteredMills - altModeChanged) >= adptExitAcceptDuration)) || // ..  Yes, early exit Acceptance Phase if we have exceeded the amount of time in Bulk by x-factor.
+                                                                             //                                                                      --OR--
+#ifdef USE_SOC_ESTIMATOR
+            ((chargingParms.EXIT_ACPT_SOC != 0) &&                  // Is exiting by State of Charge enabled, and is the battery full enough?
+             (SOC_valid() == true) &&                               //  ... and can the estimate be trusted?
+             (atTargVoltage) &&                                     //  ... and we are holding the Acceptance voltage.
+             (batterySOC >= chargingParms.EXIT_ACPT_SOC)) ||        //                                                                      --OR--
+#endif
+
+            ((chargingParms.EXIT_ACPT_AMPS > 0) &&  // Is exiting by Amps enabled, and we have reached that threshold?
+             ((shuntAltAmpsMeasured == true)) &&    //  ... and does it look like we are even measuring Amps?
+             (atTargVoltage) &&    //  ... Also, make sure the low amps are not because the engine is idling, or perhaps a large external load
+             (persistentBatdA <= compiledCPS.EXIT_ACPT_dA)) ||                        //  has been applied.  We need to see low amps at the appropriate full voltage!
+                                                                                      //                                                                      --OR--
+#ifdef USE_TAPER_EXIT
+            ((chargingParms.EXIT_ACPT_AMPS != 0) &&          // Same again, but using the fitted taper - which does not lag as persistentBatAmps does.
+             ((shuntAltAmpsMeasured == true)) &&             //  It will also exit once the Amps have flattened out, even if above EXIT_ACPT_AMPS.
+             (atTargVoltage) &&                              //  (With EXIT_ACPT_AMPS = -1, only the flattening out is used)
+             (TPR_exit_reached(max(compiledCPS.EXIT_ACPT_dA, 0) / 10.0))) ||
+#endif
+
+            ((chargingParms.EXIT_ACPT_DURATION == 0) && (chargingParms.EXIT_ACPT_AMPS == 0))); //  if user has set BOTH time and amps = 0, they do not want to do any Acceptance...
+}
+
+static bool SM_accept_to_float(void)
+{
+    return (SM_accept_done() && (chargingParms.LIMIT_OC_AMPS == 0)); //      Yes -- time to float  -- OR --. . . .
+}                                                                    //      . . .into OC mode, if it is configured (Limit Amps != 0)
+
+//---  OVERCHARGE MODE
+//      Overcharge is used by some batteries to pack just-a-little-more in after completing the acceptance phase.  (ala, some AMG batteries like an Overcharge).
+//      Overcharge holds the charge current at a low level while allowing the voltage to rise.  Once the voltage reaches a defined point, the battery is considered
+//      fully charged.  Note that to make full use of this capability, the Amp Shunt should be installed on the BATTERY, not the ALTERNATOR.
+//      The regulator will allow for overcharge to be optionally configured, compete with its own target voltage .EXIT_OC_BAT_VOLTS, Amp limit via .LIMIT_OC_AMPS, and
+//      a time limit .EXIT_OC_DURATION.    To disable OC mode, set LIMIT_OC_AMPS = 0.  (for safety, Time or Volts = 0 will also disable OC mode)
+static bool SM_OC_done(void)
+{
+    return (((enteredMills - altModeChanged) >= chargingParms.EXIT_OC_DURATION) || // Have we have been in Overcharge Phase long enough?  --OR--
+            (chargingParms.LIMIT_OC_AMPS == 0) ||                                  // Are we even configured to do OC mode? --OR--
+            (chargingParms.EXIT_OC_VOLTS == 0) ||
+            (atTargVoltage));                                                      // Did we reach the terminal voltage for Overcharge mode?
+}
+
+//---  FLOAT MODE
+//      Float is not really a Charge mode, it is more intended to just hold station.  To keep the battery at a point where it will neither continue to charge,
+//      nor discharge.  You can think of it as putting in just enough energy to make up for any self-discharge of the battery.  Exiting Float will happen in several
+//      ways.  A normal exit will be by time; .EXIT_FLOAT_DURATION in the CPE will tell us how long to stay in float.  Setting this to '0' will cause
+//      us to never move out of float on to the next charge state (Post Float).  In normal operations, just hanging around in Float once a battery is fully charged is
+//      the right choice: supplying sufficient energy to keep the battery happy, and also providing any additional amps as needed to drive house loads - so those loads
+//      do not try and take energy from the battery.
+//
+//      But what happens if that house loads gets really large, too large for the Alternator to keep up?  Energy will start to be sapped out of the battery and as some time
+//      we will have to recognize the battery is no longer fully charged.  The 1st (and preferred) way is if we start to see negative Amps on the shunt.  Configuring the
+//      Exit Amps value for a neg number will let the regulator watch the battery and then go out of float when it starts to see too much of a discharge.
+//
+//      If the Amp Shunt is attached to the Alternator, one COULD also look to see if a large number of Amps is being asked for, perhaps near the full capacity
+//      of the Alternator.
+//
+//      An indirect way to recognize the battery is being drawn upon is if the battery voltage drops below .FLOAT_TO_BULK_VOLTS, the alternator will revert to Bulk mode.
+//      This is an indirect way of telling of the battery is losing energy.
+//
+//      Starting with revision 0.1.3, two new capabilities were added:
+//         1) Reevaluation of Amps while in Float (See set_alt_targets(), allowed 'managing' battery amps that flow into battery, even down to 0A
+//         2) Exit criteria based in number of Amp-Hours that have been withdrawn from the battery after first entering Float mode.
+//
+//      Going back to Bulk is always via ramping, so as to soften shock to fan belts.
+static bool SM_float_to_bulk(void)
+{
+    return (((compiledCPS.FLOAT_TO_BULK_mV != 0) && (persistentBatmV <= compiledCPS.FLOAT_TO_BULK_mV)) ||
+
+            (((shuntAltAmpsMeasured == true)) && // VBat too low, or we are able to measure Amps AND one of the current triggers tripped
+             (((compiledCPS.FLOAT_TO_BULK_dA != 0) && (persistentBatdA <= compiledCPS.FLOAT_TO_BULK_dA)) ||
+
+#ifdef USE_SOC_ESTIMATOR
+              ((chargingParms.FLOAT_TO_BULK_SOC != 0) && (SOC_valid() == true) && (batterySOC <= chargingParms.FLOAT_TO_BULK_SOC)) ||
+#endif
+              ((chargingParms.FLOAT_TO_BULK_AHS != 0) &&
+               ((int)(((accumulatedASecs - modeChangeASecs) / 3600UL) * (ACCUMULATE_SAMPLING_RATE / 1000UL)) <= compiledCPS.FLOAT_TO_BULK_AHS)))));
+}
+
+static bool SM_float_done(void)
+{
+    return ((((int32_t)chargingParms.EXIT_FLOAT_DURATION) != 0) && // Has max time for Float been configured?
+            ((enteredMills - altModeChanged) >= chargingParms.EXIT_FLOAT_DURATION)); // And have we been in Float long enough?
+}
+
+static bool SM_float_done_to_bulk(void)
+{
+    return (SM_float_done() && SM_float_to_bulk()); // Both on the same pass:  field is turned off as for Post-Float, but it is Bulk (via ramping) we go to.
+}
+
+//---  POST FLOAT MODE
+//      During Post-Float the alternator is turned off, but voltage is monitors to see if a large load is placed
+//      on the system and we need to restart charging.  In that case we go directly back into recharging, as opposed to float.
+//      This is because the battery has shown some sign of discharging, so no need to flip to float to only then flip to bulk.
+static bool SM_PF_done(void)
+{
+    return ((((int32_t)chargingParms.EXIT_PF_DURATION) != 0) && // Has max time for Post-Float been configured?
+            ((enteredMills - altModeChanged) >= chargingParms.EXIT_PF_DURATION)); // And have we been in Post-Float long enough?
+}
+
+static bool SM_PF_to_bulk(void)
+{
+    return (((compiledCPS.PF_TO_BULK_mV != 0) && (persistentBatmV < compiledCPS.PF_TO_BULK_mV)) ||
+            ((chargingParms.PF_TO_BULK_AHS != 0) && ((shuntAltAmpsMeasured == true)) && // Able to measure current - so do Ah check.
+             ((int)(((accumulatedASecs - modeChangeASecs) / 3600UL) * (ACCUMULATE_SAMPLING_RATE / 1000UL)) <= compiledCPS.PF_TO_BULK_AHS)));
+}
+
+//---  EQUALIZE MODE
+static bool SM_equal_done(void)
+{
+    return (((enteredMills - altModeChanged) >= chargingParms.EXIT_EQUAL_DURATION) || // Have we have been in Equalize mode long enough?  --OR--
+            ((chargingParms.EXIT_EQUAL_AMPS != 0) &&                                  //   Is exiting by Amps enabled, and we have reached that threshold while at target voltage?
+             ((shuntAltAmpsMeasured == true)) &&                                      //  ... and does it look like we are even measuring Amps?
+             (atTargVoltage) &&
+             (measuredBatdA <= compiledCPS.EXIT_EQUAL_dA)));
+}
+
+const tSMState SMStates[] PROGMEM = {
+    // state                 name            onTick            onStay         targets    faultChecks                           LED pattern   LED rate         LED mirror
+    {unknown,                "UNKNOWN    ", &SM_disabled_tick, NULL,          SMT_OFF,   0,                                    LED_IDLE,     LED_RATE_NORMAL, false},
+    {disabled,               "DISABLED   ", &SM_disabled_tick, NULL,          SMT_OFF,   0,                                    LED_IDLE,     LED_RATE_NORMAL, false},
+    {FAULTED,                "FAULTED    ", &SM_hold,          NULL,          SMT_OFF,   SMF_LOGIC_ERR,                        LED_IDLE,     LED_RATE_NORMAL, false},
+    {warm_up,                "WARMUP     ", &SM_warmup_tick,   NULL,          SMT_RAMP,  0,                                    LED_IDLE,     LED_RATE_NORMAL, false},
+    {ramping,                "RAMPING    ", &SM_ramp_tick,     &SM_ramp_stay, SMT_RAMP,  SMF_RAMP | SMF_SHUNT | SMF_VCHARGE,   LED_BULK,     LED_RATE_NORMAL, false},
+    {determine_ALT_cap,      "DET ALT CAP", NULL,              NULL,          SMT_ACPT,  SMF_SHUNT | SMF_VCHARGE,              LED_BULK,     LED_RATE_NORMAL, false},
+    {bulk_charge,            "BULK       ", &SM_bulk_tick,     &SM_bulk_stay, SMT_ACPT,  SMF_VCHARGE,                          LED_BULK,     LED_RATE_NORMAL, false},
+    {acceptance_charge,      "ACCEPTANCE ", &SM_accept_tick,   NULL,          SMT_ACPT,  SMF_SHUNT | SMF_VCHARGE,              LED_ACCEPT,   LED_RATE_NORMAL, false},
+    {overcharge_charge,      "OVER CHARGE", NULL,              NULL,          SMT_OC,    SMF_SHUNT | SMF_VCHARGE,              LED_OC,       LED_RATE_SLOW,   false},
+    {float_charge,           "FLOAT      ", NULL,              NULL,          SMT_FLOAT, SMF_VEQUAL,                           LED_FLOAT,    LED_RATE_NORMAL, false},
+    {forced_float_charge,    "FORCE FLOAT", NULL,              NULL,          SMT_FLOAT, SMF_VEQUAL,                           LED_FLOAT,    LED_RATE_NORMAL, false},  // (check_inbound() will note when the feature-in signal is removed and take us out of Float)
+    {LIFEPO_FORCED_SHUTDOWN, "LIFEPO STDN", &SM_LIFEPO_tick,   NULL,          SMT_OFF,   SMF_VEQUAL,                           LED_IDLE,     LED_RATE_NORMAL, false},
+    {post_float,             "POST FLOAT ", NULL,              &SM_field_off, SMT_OFF,   0,                                    LED_FLOAT,    LED_RATE_NORMAL, false},
+    {equalize,               "EQUALIZE   ", NULL,              NULL,          SMT_EQUAL, SMF_VEQUAL,                           LED_EQUALIZE, LED_RATE_FAST,   OUT_LAMP_MIRROR_EQUALIZE}};
+
+const tSMTrans SMTrans[] PROGMEM = {
+    // from                guard                  action              to
+    {warm_up,           &SM_warmup_done,       NULL,               ramping},            // It is time to start Ramping!
+    {ramping,           &SM_ramp_done_sample,  NULL,               determine_ALT_cap},
+    {ramping,           &SM_ramp_done,         NULL,               bulk_charge},
+    {determine_ALT_cap, &SM_det_cap_done,      &SM_det_cap_save,   bulk_charge},        // Stop this cycle - go back to Bulk Charge mode.
+    {bulk_charge,       &SM_at_target_volts,   &SM_bulk_to_accept, acceptance_charge},  // Bulk is easy - got the volts so go into Acceptance Phase!
+    {bulk_charge,       &SM_bulk_sample,       NULL,               determine_ALT_cap},  // Start a new 'capacity determining' cycle
+    {acceptance_charge, &SM_accept_to_float,   NULL,               float_charge},
+    {acceptance_charge, &SM_accept_done,       NULL,               overcharge_charge},
+    {overcharge_charge, &SM_OC_done,           NULL,               float_charge},
+    {float_charge,      &SM_float_done_to_bulk, &SM_field_off,     ramping},            // (Ahead of the two below - when both fire, Bulk wins but the field still goes off)
+    {float_charge,      &SM_float_to_bulk,     NULL,               ramping},
+    {float_charge,      &SM_float_done,        &SM_field_off,      post_float},
+    {post_float,        &SM_PF_done,           NULL,               float_charge},       // Switch back to Float for a while.
+    {post_float,        &SM_PF_to_bulk,        NULL,               ramping},
+    {equalize,          &SM_equal_done,        NULL,               float_charge}};      // Time to float  - let the main loop take care of adjusting the PWM.
+
+//------------------------------------------------------------------------------------------------------
+//
+//  Get State Machine state
+//              Copies the SMStates[] entry for the passed state out of PROGMEM.  Returns FALSE if there is no such entry
+//              (ala, manage_ALT() does not know how to run the passed state).
+//
+//------------------------------------------------------------------------------------------------------
+
+bool get_SM_state(tModes state, tSMState *statePtr)
+{
+    for (uint8_t i = 0; i < (sizeof(SMStates) / sizeof(tSMState)); i++)
+    {
+        memcpy_P(statePtr, &SMStates[i], sizeof(tSMState));
+        if (statePtr->state == state)
+            return (true);
+    }
+    return (false);
+} //get_SM_state
+
+//-------       'helper' function used by manage_ALT();
+//              Runs one pass of the Charging State Machine.  Returns TRUE if manage_ALT() should return right away
+//              and not adjust the Field PWM this time around.
+static bool run_charging_SM(void)
+{
+    tSMState st;
+    tSMTrans tr;
+
+    if (get_SM_state(chargingState, &st) != true)
+    {
+        strcpy_P(chargingStateName, PSTR("FAULTED    "));
+        chargingState = FAULTED; // We should never have gotten here.   Something is wrong. . .
+        faultCode = FC_LOG_ALT_STATE1;
+        return (true);
+    }
+
+    strcpy(chargingStateName, st.name);
+
+    if ((st.onTick != NULL) && (st.onTick() == true))
+        return (true);
+
+    for (uint8_t i = 0; i < (sizeof(SMTrans) / sizeof(tSMTrans)); i++)
+    {
+        memcpy_P(&tr, &SMTrans[i], sizeof(tSMTrans));
+        if ((tr.from != chargingState) || (tr.guard() != true))
+            continue;
+
+        if (tr.action != NULL)
+            tr.action();
+        set_charging_mode(tr.to);
+        return (false);
+    }
+
+    if (st.onStay != NULL)
+        return (st.onStay());
+
+    return (false);
+} //run_charging_SM
+
 //------------------------------------------------------------------------------------------------------
 //
 //  Manage the Alternator.
@@ -462,10 +1110,7 @@ void manage_ALT()
 
     //----   Working variable used each time through, to hold calcs for the PID engine.
     float errorV; // Calc the real-time delta error (P value of PID) Measured - target:  Note the order, over target will result in positive number!
-    float errorA;
-    float errorW;
     int errorAT;
-    bool atTargVoltage; // Have we reached the target voltage?  Used when checking to see if we are ready to transation to the next Mode.
 
     float VdErr; //  Calculate 1st order derivative of VBat error  (Rate of Change, D value of PID)
     float AdErr; //  Calculate 1st order derivative of Alt Amps error
@@ -479,7 +1124,7 @@ void manage_ALT()
     int PWMErrorA;             // Alt Amps delta (Alternator limited)
     int static PWMErrorAT = 0; // Alt Temp delta (Alternator limited)  -- we remember this value between PID calcs, as if we are over-temp we do not want anyone else to raise things.
 
-    int PWMError; // Holds final PWM modification value.
+    float gsMult; // Gain Schedule multiplier for the V, A, and W loops, at the current RPMs and Alt Temp.
 
     //-----  Working variables that must RETAIN their values between calls for mange_alt().  Some are for the PID, others for load-dumps management and temperature pull-backs.
     float static ViErr = 0; // Accumulated integral error of VBat errors - retained between calls to manage_alt();
@@ -496,9 +1141,8 @@ void manage_ALT()
     bool static LD3Triggered = false;
     bool static AOTTriggered = false; // Has the Alternator Overtemp been triggred?  If so, do not let PWM rise until it cools off some.
 
-    uint32_t enteredMills;                   // Time in millis() managed_alt() was entered.  Used throughout function and saves 300 bytes of code vs. repeated millis() calls
         
-    char charBuffer[OUTBOUND_BUFF_SIZE + 1]; // Used to assemble Debug ASCII String (if needed)
+    tTXWriter w; // Used to send the Debug ASCII String (if needed)
 
     //------ NOW we can start the code!!
     //
@@ -548,11 +1192,17 @@ void manage_ALT()
     ATdErr = constrain(ATdErr, 0, KdPWM_AT); // And we only want the D to pull-down as we are approching target temp.
                                              //    (Never prevent an OT from pulling down)
 
+#ifdef USE_GAIN_SCHEDULING
+    gsMult = gain_schedule_mult(measuredRPMs, measuredAltTemp); // How much more (or less) responsive should the PID be at this RPM and temperature?
+#else
+    gsMult = 1.0;
+#endif
+
     //--- Calculate the values for the Integral (I) values
     //
-    ViErr += (errorV * KiPWM_V / systemVoltMult); // Calc the I values.
-    AiErr += (errorA * KiPWM_A);                  // Note also that the scaling factors are figured in here, as opposed to during the PID formula below.
-    WiErr += (errorW * KiPWM_W / systemVoltMult); // Doing so helps avoid issues down the road if we ever implement an auto-tuning capability, and change the I
+    ViErr += (errorV * KiPWM_V * gsMult / systemVoltMult); // Calc the I values.
+    AiErr += (errorA * KiPWM_A * gsMult);                  // Note also that the scaling factors are figured in here, as opposed to during the PID formula below.
+    WiErr += (errorW * KiPWM_W * gsMult / systemVoltMult); // Doing so helps avoid issues down the road if we ever implement an auto-tuning capability, and change the I
 
     ViErr = constrain(ViErr, 0, PID_I_WINDUP_CAP); // Keep the accumulated errors from getting out of hand, their impact is meant to be a soft refinement, not a
     AiErr = constrain(AiErr, 0, PID_I_WINDUP_CAP); // sledge hammer!
@@ -560,9 +1210,9 @@ void manage_ALT()
 
     //--  And calc the final PID correction factors
     //
-    PWMErrorV = (int)((errorV * -KpPWM_V / systemVoltMult) - ViErr - (VdErr * KdPWM_V / systemVoltMult));
-    PWMErrorA = (int)((errorA * -KpPWM_A) - AiErr - (AdErr * KdPWM_A));
-    PWMErrorW = (int)((errorW * -KpPWM_W / systemVoltMult) - WiErr - (WdErr * KdPWM_W / systemVoltMult));
+    PWMErrorV = (int)((errorV * -KpPWM_V * gsMult / systemVoltMult) - ViErr - (VdErr * KdPWM_V * gsMult / systemVoltMult));
+    PWMErrorA = (int)((errorA * -KpPWM_A * gsMult) - AiErr - (AdErr * KdPWM_A * gsMult));
+    PWMErrorW = (int)((errorW * -KpPWM_W * gsMult / systemVoltMult) - WiErr - (WdErr * KdPWM_W * gsMult / systemVoltMult));
 
     //--  Temperature adjustments are handled a little different, in that the calcs are paced out and applied to better match the slow responcee time of temperature changes.
     //
@@ -602,7 +1252,13 @@ void manage_ALT()
     if (measuredAltTemp <= -99)      // Yet another Special Case for alt temp:  if we are not able to measure an alternator temp...
         PWMErrorAT = PWM_CHANGE_CAP; //  .. make no effort to do any adjustments up based on Alt Temp.
 
+#ifdef USE_THERMAL_MODEL
+    manage_THM(); // Update the Thermal Model, and the Amps ceiling it sets.
+#endif
+
     //-- Finaly, do a kind of 'load-dump' check on alternator temperature, to see if it is growing so fast we have a hard time catching up with it.
+    //     (If the Thermal Model is working its Amps cap should keep us from getting here.  If we do get here anyway, that cap did not
+    //      hold the temperature - so this stays as the last-resort backstop, model or not)
     //
     if (measuredAltTemp > (systemConfig.ALT_TEMP_SETPOINT * AOT_PULLBACK_THRESHOLD) && (AOTTriggered == false))
     {
@@ -640,327 +1296,24 @@ void manage_ALT()
     else                                        // but slowly decreases...  This will prevent us from changing state too soon.
         persistentBatVolts = (((persistentBatVolts * (float)(VOLTS_PERSISTENCE_FACTOR - 1)) + measuredBatVolts) / VOLTS_PERSISTENCE_FACTOR);
 
+    update_ALT_cap_curve(); // Take note of what the alternator is showing us it can do at these RPMs.
 
 
-    switch (chargingState)  // manage the transitions between charging states
-    {
-    case warm_up:
-        chargingStateString = "WARMUP     ";
-
-        if ((tachMode) && (systemConfig.FIELD_TACH_PWM > 0)) // If user has configured system to have a min PWM value for Tach mode
-            fieldPWMvalue = systemConfig.FIELD_TACH_PWM;     // send that out, even during engine warm-up period.
-        else
-            fieldPWMvalue = FIELD_PWM_MIN; //  All other cases, Alternator should still be turned off.
-
-        PWMError = 0; // we will not be making ANY adjustments to the PWM for now.
-
-        // countdown for warm-up
-        inChargingStateCount = (uint32_t)systemConfig.ENGINE_WARMUP_DURATION - int((enteredMills - altModeChanged) / 1000UL); // capture the number of second remaining in the warmup.
-      
-        if (((enteredMills - altModeChanged) > ((uint32_t)systemConfig.ENGINE_WARMUP_DURATION * 1000UL)) &&  
-            !((tachMode) && (systemConfig.FIELD_TACH_PWM > 0) && (measuredRPMs == 0))) //  (But 1st - if we expect to be able to measure RPMs, don't leave pending until we do  (Engine might be stopped))
-            set_charging_mode(ramping);                                                // It is time to start Ramping!
-
-        break; // WarmUp
-
-    case ramping:
-        chargingStateString = "RAMPING    ";
-
-        persistentBatAmps = measuredBatAmps;   //  While ramping, just track the actually measured amps and Watts.
-        persistentBatVolts = measuredBatVolts; //  Overwriting the persistence calculation above.
-        reset_run_summary();                   // Starting a new Charge Cycle - reset the accumulators.
-
-        // countdown for ramping
-        inChargingStateCount = int(((PWM_RAMP_RATE * FIELD_PWM_MAX / PWM_CHANGE_CAP) - (enteredMills - altModeChanged)) / 1000UL); // capture the number of second remaining in the ramp.
-
-        if (systemConfig.ALT_AMPS_LIMIT != -1)        // Starting a new 'charge cycle' (1st time or restart from float).  Re-sample Alt limits
-            altCapAmps = systemConfig.ALT_AMPS_LIMIT; // User is telling us the capacity of the alternator (Or disabled Amps by setting this = 0)
-        else
-            altCapAmps = 0; // User has selected Auto-determine mode for Alternator size, so reset the high water
-                            // mark for the next auto-sizing cycle.
-        altCapRPMs = 0;
-
-        if ((fieldPWMvalue >= fieldPWMLimit) ||  // Driving alternator full bore?
-            (atTargVoltage) ||                   // Reached terminal voltage?
-            (errorA >= 0) ||                     // Reached terminal Amps?
-            (errorW >= 0) ||                     // Reached terminal Watts?  (Reaching ANY of these limits should cause exit of RAMP mode)
-            ((enteredMills - altModeChanged) >= PWM_RAMP_RATE * FIELD_PWM_MAX / PWM_CHANGE_CAP) // Or, have we been ramping long enough?
-#ifdef ENABLE_FEATURE_IN_SCUBA
-            ||
-            ((scubaMode) && (fieldPWMvalue >= FIELD_PWM_SCUBA)) // or, if in scubaMode AND PWM is at Scuba level
-#endif
-        )
-        {
-          if (systemConfig.ALT_AMPS_LIMIT == -1)
-              set_charging_mode(determine_ALT_cap); //  Yes or Yes!  Time to go into Bulk Phase
-          else
-              set_charging_mode(bulk_charge); // (was post_ramp)  But 1st see if we need to measure the Alternators Capacity..
-        }
-        else
-        {
-          if ((enteredMills - lastPWMChanged) <= PWM_RAMP_RATE) // Still under limits, while ramping wait longer between changes..
-            return;
-        }
-
-        break;  // ramping
-
-    case determine_ALT_cap:
-        chargingStateString = "DET ALT CAP";
-
-        if ((systemConfig.ALT_AMPS_LIMIT != -1) || // If we are NOT configured to auto-determining the Alt Capacity,   --OR--
-            (fieldPWMvalue == FIELD_PWM_MAX) ||    // we have Maxed Out the Field (PWM capping should have been removed during alt_cap mode) --OR--
-            (atTargVoltage) ||                     // Reached terminal voltage?  --OR-- (meaning, we really can not finish determine the Alt cap as the battery is kind of full.....)
-            (measuredRPMs == 0) ||                 // If we are not able to see RPMs, can not reliably do alt-cap setting
-            (shuntAltAmpsMeasured == false) ||     //  And of course, if we are not even able to measure current - not a chance to size the alt!
-            ((enteredMills - altModeChanged) >= SAMPLE_ALT_CAP_DURATION))
-        { // Finally -- have we been doing an Alt Cap Sampling Cycle long enough..
+    persistentBatmV = TO_mV(persistentBatVolts); // Convert these once, the state machine guards only do integer compares.
+    persistentBatdA = TO_dA(persistentBatAmps);
+    measuredBatdA = TO_dA(measuredBatAmps);
 
-            set_charging_mode(bulk_charge); // (was post_ramp) Stop this cycle - go back to Bulk Charge mode.
-        }
-
-        if (measuredAltAmps > altCapAmps)
-        {                                 // Still pushing the alternator hard.
-            altCapAmps = measuredAltAmps; // Take note if we have a new High Amp Value . . .
-            altCapRPMs = measuredRPMs;
-        }
-
-        break; // determine_ALT_cap
-
-         
-        //---  BULK CHARGE MODE
-        //      The purpose of bulk mode is to drive as much energy into the battery as fast as it will take it.
-        //      Bulk is easy, we simply drive the alternator hard until the battery voltage reaches the terminal voltage as defined by .ACPT_BAT_V_SETPOINT in the CPE.
-        //      While in Bulk Mode, we will also see if there is reason for us to re-sample the alternator capacity (if configured to do so), ala the RPM have increased
-        //      indicating the engine has sped up.
-
-    case bulk_charge:
-        chargingStateString = "BULK       ";
-        inChargingStateTime = (enteredMills - altModeChanged);
-
-        if (atTargVoltage)
-        {   // Have we reached terminal voltage during Bulk?
-            adptExitAcceptDuration = (enteredMills - altModeChanged) * ADPT_ACPT_TIME_FACTOR; // Calculate a time-only based acceptance duration based on how long we had been in Bulk mode,
-                                                                                              //    (In case we cannot see Amps.)
-            set_charging_mode(acceptance_charge);                                             // Bulk is easy - got the volts so go into Acceptance Phase!
-        }
-
-        persistentBatAmps = measuredBatAmps; //  While in Bulk as well, just track the actually measured amps and Watts.
-                                             // (Prevents any initial low-amp numbers from clouding the issue once we get into Acceptance)
-
-        if (((enteredMills - rampModeEntered) <= PWM_RAMP_RATE * FIELD_PWM_MAX / PWM_CHANGE_CAP) &&
-            ((enteredMills - lastPWMChanged) <= PWM_RAMP_RATE))
-            return; // If somehow Ramp-mode got short-changed, continue the nice soft ramping until we get to the target voltage.
-
-        // Not at VBat target yet.  See if we need to start a auto-capacity sample cycle on the Alternator                                                                                                     // Not yet.  See if we need to start a auto-capacity sample cycle on the Alternator
-        if (systemConfig.ALT_AMPS_LIMIT != -1) // Are we configured to auto-capacity sample the alternator?
-            break;                             //    Nope - they told us how big it is - so done for now.
-
-        if ((enteredMills - altModeChanged) <= SAMPLE_ALT_CAP_REST) // Did we just do a capacity sample cycle, and if so have we 'rested' the alternator long enough?
-            break;                                                  // Yes we did a cycle, and no we have not rested sufficient.
-
-        // OK, we are configured to do auto Alt Sampling, we have not just done one, so . . .
-        if ((measuredRPMs > (altCapRPMs + SAMPLE_ALT_CAP_RPM_THRESH)) || // IF we are spinning the alternator faster, -OR-
-            (measuredAltAmps > (altCapAmps * SAMPLE_ALT_CAP_AMPS_THRESH_RATIO)))
-        { //    we have seen a new High Amp Value .
-
-            set_charging_mode(determine_ALT_cap); // Start a new 'capacity determining' cycle (If we are not already on one)
-                                                  // This last step is kind of the key.  During a new cycle we will not artificially reduce the output
-                                                  // of the alternator, but instead run it as hard as we can to see if we get a new High Water Mark.
-                                                  // After a short period of time we will then re-enable the reduced current modes (ala smallAltMode)
-        }
-
-        break; // bulk_charge
-
-        //---  ACCEPTANCE CHARGE MODE
-        //      In acceptance phase we are packing in extra energy into the battery until it is fully charged.  We cap the voltage to .ACPT_BAT_V_SETPOINT to keep from overheating
-        //      the battery, and the battery itself controls how many Amps it will 'accept'.  The handling of accept phase is one of the key benefits of using this regulator, as
-        //      by monitoring the accepted amps we can MEASURE the batteries state of charge.  Once the acceptance amps fall below about 1-2% of the batteries Ah capacity, we know
-        //      the battery is fully charged.  The Amp trigger is defined by .EXIT_ACPT_AMPS, once we fall below this level we move on.  We can also move on by staying too long in
-        //      acceptance phase.  CPE entry .EXIT_ACPT_DURATION allows for a time limit to be defined, and if we exceed this time limit we move on.  This can be used when the AMP
-        //      shunt is not connected, but also provides a level of protection increase something goes wrong - protection from boiling the battery dry.
-        //      Finally, the regulator can be configured to disable Amp-based determination of Exit-Acceptance and instead to a time-based exit criteria based on some factor
-        //      of the amount of timer we spent in Bulk.  This will happen if the user has entered -1 in the  EXIT_ACPT_AMPS, OR we do not seem to be able to measure any Amps
-        //      (ala, the user has not connected up the shunt).  Note that even with Adaptive Acceptance duration, we will never exceed the configured EXIT_ACPT_DURATION value.
-    case acceptance_charge:
-        chargingStateString = "ACCEPTANCE ";
-        inChargingStateTime= uint32_t(enteredMills - altModeChanged);
-
-        if (((chargingParms.EXIT_ACPT_DURATION > 0) &&
-             ((enteredMills - altModeChanged) >= chargingParms.EXIT_ACPT_DURATION)) || // 4 ways to exit.  Have we have been in Acceptance Phase long enough?  --OR--
-
-            ((chargingParms.EXIT_ACPT_AMPS == -1) &&                         // Have we been configured to do Adaptive Acceptance?
-             ((enteredMills - altModeChanged) >= adptExitAcceptDuration)) || // ..  Yes, early exit Acceptance Phase if we have exceeded the amount of time in Bulk by x-factor.
-                                                                             //                                                                      --OR--
-
-            ((chargingParms.EXIT_ACPT_AMPS > 0) &&  // Is exiting by Amps enabled, and we have reached that threshold?
-             ((shuntAltAmpsMeasured == true)) &&    //  ... and does it look like we are even measuring Amps?
-             (atTargVoltage) &&    //  ... Also, make sure the low amps are not because the engine is idling, or perhaps a large external load
-             (persistentBatAmps <= (chargingParms.EXIT_ACPT_AMPS * systemAmpMult))) || //  has been applied.  We need to see low amps at the appropriate full voltage!
-
-            ((chargingParms.EXIT_ACPT_DURATION == 0) && (chargingParms.EXIT_ACPT_AMPS == 0)))
-        {   //  if user has set BOTH time and amps = 0, they do not want to do any Acceptance...
-            
-
-            if (chargingParms.LIMIT_OC_AMPS == 0)
-                set_charging_mode(float_charge); //      Yes -- time to float  -- OR --. . . .
-            else
-                set_charging_mode(overcharge_charge); // . . .into OC mode, if it is configured (Limit Amps != 0)
-        }
-        break; // acceptance_charge
-
-        //---  OVERCHARGE MODE
-        //      Overcharge is used by some batteries to pack just-a-little-more in after completing the acceptance phase.  (ala, some AMG batteries like an Overcharge).
-        //      Overcharge holds the charge current at a low level while allowing the voltage to rise.  Once the voltage reaches a defined point, the battery is considered
-        //      fully charged.  Note that to make full use of this capability, the Amp Shunt should be installed on the BATTERY, not the ALTERNATOR.
-        //      The regulator will allow for overcharge to be optionally configured, compete with its own target voltage .EXIT_OC_BAT_VOLTS, Amp limit via .LIMIT_OC_AMPS, and
-        //      a time limit .EXIT_OC_DURATION.    To disable OC mode, set LIMIT_OC_AMPS = 0.  (for safety, Time or Volts = 0 will also disable OC mode)
-
-    case overcharge_charge:
-        chargingStateString = "OVER CHARGE";
-
-        if (((enteredMills - altModeChanged) >= chargingParms.EXIT_OC_DURATION) || // Have we have been in Overcharge Phase long enough?  --OR--
-            (chargingParms.LIMIT_OC_AMPS == 0) ||                                  // Are we even configured to do OC mode? --OR--
-            (chargingParms.EXIT_OC_VOLTS == 0) ||
-            (atTargVoltage))
-        { // Did we reach the terminal voltage for Overcharge mode?
-
-            set_charging_mode(float_charge); // Yes to one of the conditions.  NOW we can go into Acceptance Phase
-        }
-
-        break;  //overcharge_charge
-
-        //---  FLOAT MODE
-        //      Float is not really a Charge mode, it is more intended to just hold station.  To keep the battery at a point where it will neither continue to charge,
-        //      nor discharge.  You can think of it as putting in just enough energy to make up for any self-discharge of the battery.  Exiting Float will happen in several
-        //      ways.  A normal exit will be by time; .EXIT_FLOAT_DURATION in the CPE will tell us how long to stay in float.  Setting this to '0' will cause
-        //      us to never move out of float on to the next charge state (Post Float).  In normal operations, just hanging around in Float once a battery is fully charged is
-        //      the right choice: supplying sufficient energy to keep the battery happy, and also providing any additional amps as needed to drive house loads - so those loads
-        //      do not try and take energy from the battery.
-        //
-        //      But what happens if that house loads gets really large, too large for the Alternator to keep up?  Energy will start to be sapped out of the battery and as some time
-        //      we will have to recognize the battery is no longer fully charged.  The 1st (and preferred) way is if we start to see negative Amps on the shunt.  Configuring the
-        //      Exit Amps value for a neg number will let the regulator watch the battery and then go out of float when it starts to see too much of a discharge.
-        //
-        //      If the Amp Shunt is attached to the Alternator, one COULD also look to see if a large number of Amps is being asked for, perhaps near the full capacity
-        //      of the Alternator.
-        //
-        //      An indirect way to recognize the battery is being drawn upon is if the battery voltage drops below .FLOAT_TO_BULK_VOLTS, the alternator will revert to Bulk mode.
-        //      This is an indirect way of telling of the battery is losing energy.
-        //
-        //      Starting with revision 0.1.3, two new capabilities were added:
-        //         1) Reevaluation of Amps while in Float (See set_alt_targets(), allowed 'managing' battery amps that flow into battery, even down to 0A
-        //         2) Exit criteria based in number of Amp-Hours that have been withdrawn from the battery after first entering Float mode.
-
-    case float_charge:
-        chargingStateString = "FLOAT      ";
-
-        if ((((int32_t)chargingParms.EXIT_FLOAT_DURATION) != 0) && // Has max time for Float been configured?
-            ((enteredMills - altModeChanged) >= chargingParms.EXIT_FLOAT_DURATION))
-        { // And have we been in Float long enough?
-
-            set_charging_mode(post_float); //  Yes, go into Post Float mode for now
-            fieldPWMvalue = FIELD_PWM_MIN; //  Turn off alternator
-            PWMError = 0;
-        }
-
-        if (((chargingParms.FLOAT_TO_BULK_VOLTS != 0) && (persistentBatVolts <= (chargingParms.FLOAT_TO_BULK_VOLTS * systemVoltMult))) ||
-
-            (((shuntAltAmpsMeasured == true)) && // VBat too low, or we are able to measure Amps AND one of the current triggers tripped
-             (((chargingParms.FLOAT_TO_BULK_AMPS != 0) && (persistentBatAmps <= (chargingParms.FLOAT_TO_BULK_AMPS * systemAmpMult))) ||
-
-              ((chargingParms.FLOAT_TO_BULK_AHS != 0) &&
-               ((int)(((accumulatedASecs - modeChangeASecs) / 3600UL) * (ACCUMULATE_SAMPLING_RATE / 1000UL)) <= (chargingParms.FLOAT_TO_BULK_AHS * systemAmpMult))))))
-        {
-
-            //  then we need to go back into Bulk mode?
-            set_charging_mode(ramping); //  (Via ramping, so as to soften shock to fan belts)
-            
-        }
-        break; // float_charge
-
-    case forced_float_charge:                  //  If we have been 'forced' into Float mode via the Feature-in or a missing  'required' Bat temp sensor, we just stay there.
-        chargingStateString = "FORCE FLOAT"; //  (check_inbound() will note when the feature-in signal is removed and take us out of Float
-        break;
-
-    case LIFEPO_FORCED_SHUTDOWN:
-        chargingStateString = "LIFEPO STDN";
-        fieldPWMvalue = 0; //  Turn off alternator.
-        break;
-
-    case post_float: //  During Post-Float the alternator is turned off, but voltage is monitors to see if a large load is placed
-                     //  on the system and we need to restart charging.
-        chargingStateString = "POST FLOAT ";
-
-        if ((((int32_t)chargingParms.EXIT_PF_DURATION) != 0) && // Has max time for Post-Float been configured?
-            ((enteredMills - altModeChanged) >= chargingParms.EXIT_PF_DURATION))
-        { // And have we been in Post-Float long enough?
-
-            set_charging_mode(float_charge); //  Yes, switch back to Float for a while.
-
-            break;
-        }
-
-        if (((chargingParms.PF_TO_BULK_VOLTS != 0.0) && (persistentBatVolts < chargingParms.PF_TO_BULK_VOLTS * systemVoltMult)) ||
-            ((chargingParms.PF_TO_BULK_AHS != 0) && ((shuntAltAmpsMeasured == true)) && // Able to measure current - so do Ah check.
-             ((int)(((accumulatedASecs - modeChangeASecs) / 3600UL) * (ACCUMULATE_SAMPLING_RATE / 1000UL)) <= (chargingParms.PF_TO_BULK_AHS * systemAmpMult))))
-        {
-            //  Do we need to go back into Bulk mode?
-            set_charging_mode(ramping); //      Yes or Yes!  Time to go into Bulk Phase  (Via ramping, so as to soften shock to fan belts)
-                                        //      In this case I go directly back into recharging, as opposed to float.  This is because the battery
-                                        //      has shown some sign of discharging, so no need to flip to float to only then flip to bulk.
-            break;
-        }
-
-        fieldPWMvalue = FIELD_PWM_MIN; //  If still in post Float mode, make sure to turn off alternator.
-        PWMError = 0;
-
-        break;
-
-    case equalize:
-        chargingStateString = "EQUALIZE   ";
-
-        if (((enteredMills - altModeChanged) >= chargingParms.EXIT_EQUAL_DURATION) ||
-            ((chargingParms.EXIT_EQUAL_AMPS != 0) &&
-             ((shuntAltAmpsMeasured == true)) && //  ... and does it look like we are even measuring Amps?
-             (atTargVoltage) &&                                         //
-             (measuredBatAmps <= (chargingParms.EXIT_EQUAL_AMPS * systemAmpMult))))
-        {
-            // Have we have been in Equalize mode long enough?  --OR--
-            //   Is exiting by Amps enabled, and we have reached that threshold while at target voltage?
-            set_charging_mode(float_charge); //      Yes -- time to float  - let the main loop take care of adjusting the PWM.
-        }
-
-        break;
-/*
-    case RBM_CVCC: // Running in true slave mode, doing what the Remote Battery Master is telling us to do.
-        chargingStateString = "RBM-CVCC     ";
-
-        break;
-*/
-    case disabled:
-        if(chargingState == disabled)  chargingStateString = "DISABLED   ";
-    case unknown:
-        if(chargingState == unknown) chargingStateString = "UNKNOWN    ";
-        PWMError = 0;
-        LEDRepeat = 0; // And force a resetting of the LED blinking pattern
-        fieldPWMvalue = 0; //  Turn off alternator.
-        break;
-
-    case FAULTED: // If we got called here while in FAULT condition, do not change anything.
-        chargingStateString = "FAULTED    ";
+    if (run_charging_SM() == true) // Run the Charging State Machine - see SMStates[] and SMTrans[] above.
         return;
 
-    default:
-        chargingStateString = "FAULTED    ";
-        chargingState = FAULTED; // We should never have gotten here.   Something is wrong. . .
-        faultCode = FC_LOG_ALT_STATE1;
-        return;
-
-    } //switch(chargingState)                                                                                             //  End of Switch/case
-
     //-----   Put out the PWM value to the Field control, making sure the adjusted value is within bounds.
     //        (And if the Tach mode is enabled, make sure we have SOME PWM)
     //
+#ifdef USE_PWM_FEED_FORWARD
+    PWMError += manage_FFM(PWMError); // If the learned map says the steady-state PWM has moved (RPMs or Amps target changed), jump there now
+                                      // and leave the PID to correct the residual.
+#endif
+
     fieldPWMvalue += PWMError; // Adjust the field value based on above calculations.
     if (tachMode)
         fieldPWMvalue = max(fieldPWMvalue, thresholdPWMvalue); // But if Tach mode, do not let PWM drop too low - else tach will stop working.
@@ -988,46 +1341,59 @@ void manage_ALT()
     //-----    Before we leave, does the user want to see detailed Debug information of what just happened?
     //
 
-    if ((sendDebugString == true) && (--SDMCounter <= 0))
+    if (((sendDebugString == true) || (subscriptions.ENABLED & (1 << SUB_DBG))) && OB_due(SUB_DBG))
     {
 
-        snprintf_P(charBuffer, OUTBOUND_BUFF_SIZE, PSTR("DBG;,%d.%03d, ,%d,%d, ,%d,%d,%d, ,%d,%d,%d,%d,%d, ,%d,%d, ,%c,%s,%s, ,%d,%d,%s, ,%d\r\n"),
-
-                   (int)(enteredMills / 1000UL), // Timestamp - Seconds
-                   (int)(enteredMills % 1000),   // time-stamp - 1000th of seconds
-
-                   (int)chargingState,
-                   fieldPWMvalue,
-
-                   sample_feature_IN_port1(),
-                   sample_feature_IN_port2(),
-                   sample_feature_IN_port3(),
-
-                   PWMErrorV,
-                   PWMErrorA,
-                   PWMErrorW,
-                   PWMErrorAT,
-                   PWMError,
-
-                   (int)errorAT,
-                   
-
-                   'A',
-                   float2string(measuredAltVolts, 3),
-                   float2string(measuredAltAmps, 1),
-
-                   //usingEXTAmps,
-                   thresholdPWMvalue,
-                   fieldPWMLimit,
-                   float2string(otPullbackFactor, 2),
-
-                   measuredAltTemp,
-                   checkStampStack() // How much of the stack has been used?
-
-        );
-
-        ASCII_write(charBuffer);
-
-        SDMCounter = SDM_SENSITIVITY;
+        OB_begin(SUB_DBG, &w);
+        TXW_str_P(&w, PSTR("DBG;,"));
+        TXW_int(&w, (int)(enteredMills / 1000UL)); // Timestamp - Seconds
+        TXW_char(&w, '.');
+        TXW_pad(&w, (int)(enteredMills % 1000), 3); // time-stamp - 1000th of seconds
+
+        TXW_str_P(&w, PSTR(", ,"));
+        TXW_int(&w, (int)chargingState);
+        TXW_char(&w, ',');
+        TXW_int(&w, fieldPWMvalue);
+
+        TXW_str_P(&w, PSTR(", ,"));
+        TXW_int(&w, sample_feature_IN_port1());
+        TXW_char(&w, ',');
+        TXW_int(&w, sample_feature_IN_port2());
+        TXW_char(&w, ',');
+        TXW_int(&w, sample_feature_IN_port3());
+
+        TXW_str_P(&w, PSTR(", ,"));
+        TXW_int(&w, PWMErrorV);
+        TXW_char(&w, ',');
+        TXW_int(&w, PWMErrorA);
+        TXW_char(&w, ',');
+        TXW_int(&w, PWMErrorW);
+        TXW_char(&w, ',');
+        TXW_int(&w, PWMErrorAT);
+        TXW_char(&w, ',');
+        TXW_int(&w, PWMError);
+
+        TXW_str_P(&w, PSTR(", ,"));
+        TXW_int(&w, (int)errorAT);
+
+        TXW_str_P(&w, PSTR(", ,A,"));
+        TXW_fixed(&w, measuredAltVolts, 3);
+        TXW_char(&w, ',');
+        TXW_fixed(&w, measuredAltAmps, 1);
+
+        TXW_str_P(&w, PSTR(", ,"));
+        TXW_int(&w, thresholdPWMvalue);
+        TXW_char(&w, ',');
+        TXW_int(&w, fieldPWMLimit);
+        TXW_char(&w, ',');
+        TXW_fixed(&w, otPullbackFactor, 2);
+
+        TXW_str_P(&w, PSTR(", ,"));
+        TXW_int(&w, measuredAltTemp);
+        TXW_char(&w, ',');
+        TXW_int(&w, checkStampStack()); // How much of the stack has been used?
+        TXW_str_P(&w, PSTR("\r\n"));
+
+        OB_end(SUB_DBG, &w); // (Dropped if the serial port has fallen behind, manage_ALT() does not wait for it)
     }
 } //manage_ALT()
@@ -27,6 +27,55 @@
 #include "System.h"
 #include "CPE.h"
 
+typedef struct
+{ // Alternator Capability Curve - demonstrated Alternator Amps at each Engine RPM grid point.  Saved in EEPROM.
+    float AMPS[ACC_RPM_BINS]; // Grid point [r] is at (r * ACC_RPM_STEP) RPMs.  0 = Nothing seen yet.
+    uint16_t SAMPLED;         // Bit [r] set once grid point [r] has been seen at full field (or during a Capacity Sample cycle),
+                              //   points without it only hold the highest Amps seen while regulating - a floor, not the capability.
+} tACC;
+
+extern tACC altCapCurve;
+
+//---- Charging State Machine.  manage_ALT() runs the charging states from these two tables (kept in PROGMEM, see Alternator.cpp),
+//     and calculate_ALT_targets(), check_for_faults(), and update_LED() take what they need to know about each state from SMStates[].
+typedef bool (*tSMGuard)(void);  // Returns TRUE if the transition should be taken.
+typedef bool (*tSMAction)(void); // Returns TRUE to have manage_ALT() return right away, leaving the Field PWM as-is this time around.
+                                 //   (Ignored for transition actions)
+
+#define SMT_OFF 0   // Which set points calculate_ALT_targets() uses in a state:   None - Alternator is off
+#define SMT_RAMP 1  //   The lower of Acceptance or Float
+#define SMT_ACPT 2  //   Acceptance
+#define SMT_OC 3    //   Overcharge
+#define SMT_FLOAT 4 //   Float
+#define SMT_EQUAL 5 //   Equalize
+
+#define SMF_RAMP 0x01      // Which checks check_for_faults() makes in a state:  Alt already hot during ramping, and missing required sensors
+#define SMF_SHUNT 0x02     //   Missing required Amp shunt
+#define SMF_VCHARGE 0x04   //   Bat Volts over FAULT_BAT_VOLTS_CHARGE
+#define SMF_VEQUAL 0x08    //   Bat Volts over FAULT_BAT_VOLTS_EQUALIZE
+#define SMF_LOGIC_ERR 0x80 //   Should never be checked in this state - logic error.
+
+typedef struct
+{ // Charging State definition - one for each state manage_ALT() knows how to run.
+    tModes state;
+    char name[12];        // Displayed state name  (11 chars + NULL)
+    tSMAction onTick;     // Called each time the PID engine runs, before checking the transitions.  (NULL = nothing to do)
+    tSMAction onStay;     // Called if no transition was taken.  (NULL = nothing to do)
+    uint8_t targets;      // SMT_xxx
+    uint8_t faultChecks;  // SMF_xxx bits
+    unsigned LEDPattern;  // Blinking pattern while in this state
+    unsigned LEDRate;
+    bool LEDMirror;       //   and should it also be blinked out on the Feature-out LAMP?
+} tSMState;
+
+typedef struct
+{ // Charging State transition.  Checked in table order, the 1st one from the current state whose guard passes is taken.
+    tModes from;
+    tSMGuard guard;
+    tSMAction action; // Called just before changing state.  (NULL = nothing to do)
+    tModes to;
+} tSMTrans;
+
 extern int inChargingStateCount; // seconds left in warmup
 extern uint32_t inChargingStateTime;  // count up milliseconds in current state
 
@@ -53,13 +102,12 @@ extern int thresholdPWMvalue;
 extern bool usingEXTAmps;
 
 extern tCPS chargingParms;
+extern tCompiledCPS compiledCPS;
 
 extern float systemVoltMult;
 extern float systemAmpMult;
 extern uint8_t cpIndex;
 
-extern int8_t SDMCounter;
-extern bool sendDebugString;
 
 void stator_IRQ(void);
 void calculate_RPMs(void);
@@ -67,6 +115,10 @@ void calculate_ALT_targets(void);
 void set_charging_mode(tModes settingMode);
 void set_ALT_PWM(int PWM);
 void manage_ALT(void);
+void compile_CPS(void);
 bool initialize_alternator(void);
+int ALT_cap_at_RPMs(int RPMs);
+void checkpoint_ACC(void);
+bool get_SM_state(tModes state, tSMState *statePtr);
 
 #endif // _ALTERNATOR_H_
@@ -17,33 +17,268 @@
 //
 //*****************************************************************************************
 //
-//    Monitors the BMS_SERIAL_PORT for input indicating forced shutdown
+//    Monitors the BMS_SERIAL_PORT for framed messages from the BMS (see BMS_SERIAL.h for the
+//    frame format):  Its charge voltage and current limits, which set_VAWL() uses as caps on the
+//    targets, pack and cell information, and a warning that it is about to disconnect - which
+//    forces the regulator into LIFEPO_FORCED_SHUTDOWN.
+//
+//    The serial port receive is interrupt driven into the Arduino core's ring buffer, each pass
+//    of the main loop drains it through BMS_parse_byte().   The parser does not touch the serial
+//    port itself, so it can be fed from anywhere.
 //
 //*****************************************************************************************
 
-//TODO complete code here
+#include "Config.h"
+#include "System.h"
+#include "Alternator.h"
+#include "BMS_SERIAL.h"
+
+tBMS bmsData;
+uint32_t bmsShutdownLatency = 0;
+uint32_t bmsShutdownLatencyMax = 0;
+uint16_t bmsLatencyOverruns = 0;
+uint16_t bmsFrameErrors = 0;
+
+enum tBMSParse {BP_HUNT, BP_TYPE, BP_LEN, BP_PAYLOAD, BP_CRC_LO, BP_CRC_HI}; // Where the parser is in the frame
+
+static tBMSParse parseState = BP_HUNT;
+static uint8_t rxType;
+static uint8_t rxLen;
+static uint8_t rxIndex;
+static uint8_t rxPayload[BMS_MAX_PAYLOAD];
+static uint16_t rxCRCCalc;
+static uint16_t rxCRC;
+static uint32_t frameStarted;       // micros() the START of the frame being parsed was received
+static uint32_t warningReceived;    // micros() the START of the disconnect warning was received
+
+//-------       'helper' functions used by BMS_parse_byte();  (CRC16_update() is shared with the binary telemetry, see BinTelemetry.h)
+static uint16_t get_u16(uint8_t i)
+{
+    return (rxPayload[i] | ((uint16_t)rxPayload[i + 1] << 8));
+}
+
+static bool BMS_process_frame(void)
+{
+    uint8_t i;
+
+    switch (rxType)
+    {
+    case BMS_MSG_LIMITS:
+        if (rxLen != 5)
+            return (false);
+        bmsData.CVL_mV = get_u16(0);
+        bmsData.CCL_dA = get_u16(2);
+        if ((rxPayload[4] & BMS_FLAG_DISCONNECT) && !(bmsData.flags & BMS_FLAG_DISCONNECT))
+            warningReceived = frameStarted;
+        bmsData.flags = rxPayload[4];
+        bmsData.lastLimits = millis();
+        break;
+
+    case BMS_MSG_PACK:
+        if (rxLen != 4)
+            return (false);
+        bmsData.packmV = get_u16(0);
+        bmsData.packdA = (int16_t)get_u16(2);
+        break;
+
+    case BMS_MSG_CELLS:
+        if ((rxLen < 1) || (rxPayload[0] > BMS_MAX_CELLS) || (rxLen != (1 + (2 * rxPayload[0]))))
+            return (false);
+        bmsData.cellCount = rxPayload[0];
+        for (i = 0; i < bmsData.cellCount; i++)
+            bmsData.cellmV[i] = get_u16(1 + (2 * i));
+        bmsData.lastCells = millis();
+        break;
+
+    case BMS_MSG_DISCONNECT:
+        if (!(bmsData.flags & BMS_FLAG_DISCONNECT))
+            warningReceived = frameStarted;
+        bmsData.flags |= BMS_FLAG_DISCONNECT; // Held until a LIMITS frame says otherwise.
+        break;
+
+    default:
+        return (false); // Not one we know.
+    }
+
+    return (true);
+}
+
+//------------------------------------------------------------------------------------------------------
+// BMS Parse Byte
+//      Feeds one received byte to the frame parser.   Returns TRUE if it completed a good frame (which has
+//      then been acted on), FALSE if more is needed - or the frame was bad and has been thrown away.
+//
+//------------------------------------------------------------------------------------------------------
+
+bool BMS_parse_byte(uint8_t c)
+{
+    switch (parseState)
+    {
+    case BP_HUNT:
+        if (c == BMS_FRAME_START)
+        {
+            frameStarted = micros();
+            rxCRCCalc = 0xFFFF;
+            parseState = BP_TYPE;
+        }
+        return (false);
+
+    case BP_TYPE:
+        rxType = c;
+        rxCRCCalc = CRC16_update(rxCRCCalc, c);
+        parseState = BP_LEN;
+        return (false);
+
+    case BP_LEN:
+        rxLen = c;
+        rxCRCCalc = CRC16_update(rxCRCCalc, c);
+        rxIndex = 0;
+        if (rxLen > BMS_MAX_PAYLOAD)
+        {
+            bmsFrameErrors++;
+            parseState = BP_HUNT;
+        }
+        else
+            parseState = (rxLen == 0) ? BP_CRC_LO : BP_PAYLOAD;
+        return (false);
+
+    case BP_PAYLOAD:
+        rxPayload[rxIndex++] = c;
+        rxCRCCalc = CRC16_update(rxCRCCalc, c);
+        if (rxIndex >= rxLen)
+            parseState = BP_CRC_LO;
+        return (false);
+
+    case BP_CRC_LO:
+        rxCRC = c;
+        parseState = BP_CRC_HI;
+        return (false);
+
+    case BP_CRC_HI:
+    default:
+        rxCRC |= (uint16_t)c << 8;
+        parseState = BP_HUNT;
+        if ((rxCRC != rxCRCCalc) || (BMS_process_frame() != true))
+        {
+            bmsFrameErrors++;
+            return (false);
+        }
+        return (true);
+    }
+} //BMS_parse_byte
+
+//------------------------------------------------------------------------------------------------------
+// Check BMS Serial In
+//      Called at the start of each pass of the Mainloop.  Works through what has been received from the BMS
+//      (up to BMS_MAX_BYTES_PER_PASS of it, so a chatty BMS cannot stall the loop), and returns TRUE if the
+//      BMS is warning it is about to disconnect - in which case the regulator needs to shut down NOW.
+//
+//      The LIFEPO shutdown alarm Feature-out is also the Force-to-Float alarm (see handle_feature_in()), so it is only
+//      changed here as the warning starts or clears - and left on when it clears if we are in forced_float_charge.
+//
+//------------------------------------------------------------------------------------------------------
 
 bool checkBMS_Serial_In(void)
 {
-// check BMS_SERIAL_IN port for input
-//TODO -- TO BE DEVELOPED
-// parse the input
+    static bool warning = false; // Was the BMS warning last time?
+    uint8_t n = BMS_MAX_BYTES_PER_PASS;
+    bool now;
+
+    while ((n-- > 0) && (BMS_SERIAL_PORT.available() > 0))
+        BMS_parse_byte(BMS_SERIAL_PORT.read());
 
-// if BMS shutdown command received, turn on FEATURE_OUT_LIFEPO_SHUTDOWN_ALARM, and return true
+    now = ((bmsData.flags & BMS_FLAG_DISCONNECT) != 0);
 
-/*
 #ifdef FEATURE_OUT_LIFEPO_SHUTDOWN_ALARM
-   digitalWrite(FEATURE_OUT_LIFEPO_SHUTDOWN_ALARM_PORT,FOP_ON);
+    if (now != warning)
+        digitalWrite(FEATURE_OUT_LIFEPO_SHUTDOWN_ALARM_PORT, (now || (chargingState == forced_float_charge)) ? HIGH : LOW); // (FOP_ON / FOP_OFF)
 #endif
-return(true);
-*/
+    warning = now;
 
-// else, turn off LIFEPO_SHUTDOWN_ALARM_PORT, if feature-out is active, and return false
-/*#ifdef FEATURE_OUT_LIFEPO_SHUTDOWN_ALARM
-   digitalWrite(FEATURE_OUT_LIFEPO_SHUTDOWN_ALARM_PORT,FOP_OFF);
-#endif
-*/
-return(false);  // do not do forced float
+    return (now);
+} //checkBMS_Serial_In
 
+//------------------------------------------------------------------------------------------------------
+// Manage BMS
+//      Called first thing each pass of the Mainloop.  If the BMS is warning it is about to disconnect, drop into
+//      LIFEPO_FORCED_SHUTDOWN with the field turned off right now - not waiting for manage_ALT() to get around to it.
+//      Once the warning clears, charging is restarted (softly, via Ramp).   A FAULT is left as it is.
+//
+//------------------------------------------------------------------------------------------------------
 
-}
\ No newline at end of file
+void manage_BMS(void)
+{
+    if (checkBMS_Serial_In() == true)
+    {
+        if ((chargingState != LIFEPO_FORCED_SHUTDOWN) && (chargingState != FAULTED))
+        {
+            set_charging_mode(LIFEPO_FORCED_SHUTDOWN);
+            fieldPWMvalue = 0;
+            set_ALT_PWM(0);      // Turn off the field now
+            BMS_shutdown_done(); //   and note how long that took.
+        }
+    }
+    else if (chargingState == LIFEPO_FORCED_SHUTDOWN)
+        set_charging_mode(ramping); // BMS has cleared its warning, restart charging.
+} //manage_BMS
+
+//------------------------------------------------------------------------------------------------------
+// BMS Limits Valid
+//      Returns TRUE if we have heard the BMS charge limits recently enough to use them.  If the BMS goes
+//      quiet, the regulator goes back to running on the Charge Profile alone.
+//
+//------------------------------------------------------------------------------------------------------
+
+bool BMS_limits_valid(void)
+{
+    return ((bmsData.lastLimits != 0) && ((millis() - bmsData.lastLimits) < BMS_LIMITS_TIMEOUT));
+} //BMS_limits_valid
+
+//------------------------------------------------------------------------------------------------------
+// BMS Cells
+//      BMS_cells_valid() returns TRUE if we have heard the cell voltages recently enough to use them.
+//      BMS_cell_max() and BMS_cell_spread() then give the highest cell, and the difference between the
+//      highest and lowest cells (in mV).
+//
+//------------------------------------------------------------------------------------------------------
+
+bool BMS_cells_valid(void)
+{
+    return ((bmsData.cellCount != 0) && (bmsData.lastCells != 0) && ((millis() - bmsData.lastCells) < BMS_LIMITS_TIMEOUT));
+} //BMS_cells_valid
+
+uint16_t BMS_cell_max(void)
+{
+    uint16_t maxmV = 0;
+
+    for (uint8_t i = 0; i < bmsData.cellCount; i++)
+        maxmV = max(maxmV, bmsData.cellmV[i]);
+
+    return (maxmV);
+} //BMS_cell_max
+
+uint16_t BMS_cell_spread(void)
+{
+    uint16_t minmV = 0xFFFF;
+
+    for (uint8_t i = 0; i < bmsData.cellCount; i++)
+        minmV = min(minmV, bmsData.cellmV[i]);
+
+    return ((bmsData.cellCount != 0) ? (BMS_cell_max() - minmV) : 0);
+} //BMS_cell_spread
+
+//------------------------------------------------------------------------------------------------------
+// BMS Shutdown Done
+//      Called once the field has been turned off in response to a disconnect warning, to note how long that took
+//      from the warning frame starting to arrive.   (Time the bytes spent in the serial buffer before this pass
+//      of the Mainloop picked them up is not seen, but at most that is one pass of the loop)
+//
+//------------------------------------------------------------------------------------------------------
+
+void BMS_shutdown_done(void)
+{
+    bmsShutdownLatency = micros() - warningReceived;
+    bmsShutdownLatencyMax = max(bmsShutdownLatencyMax, bmsShutdownLatency);
+    if (bmsShutdownLatency > (BMS_LATENCY_BUDGET * 1000UL))
+        bmsLatencyOverruns++;
+} //BMS_shutdown_done
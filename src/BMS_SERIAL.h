@@ -21,6 +21,50 @@
 
 #include "Config.h"
 
+//----- BMS frame format.   All multi-byte values are little-endian.
+//
+//      START  TYPE  LEN  PAYLOAD[LEN]  CRC16-lo  CRC16-hi
+//
+//      CRC-16/CCITT (0xFFFF start) is over TYPE, LEN, and the PAYLOAD.
+//
+#define BMS_FRAME_START 0x7E
+#define BMS_MAX_PAYLOAD 34
+#define BMS_MAX_CELLS 16
+
+#define BMS_MSG_LIMITS 0x01     // uint16 Charge Voltage Limit (mV), uint16 Charge Current Limit (0.1A), uint8 flags (BMS_FLAG_xxx)
+#define BMS_MSG_PACK 0x02       // uint16 Pack Volts (mV), int16 Pack Amps (0.1A, + = charging)
+#define BMS_MSG_CELLS 0x03      // uint8 number of cells, then uint16 Cell Volts (mV) for each
+#define BMS_MSG_DISCONNECT 0x04 // uint8 reason - BMS is about to open its charge disconnect.  (Same as setting BMS_FLAG_DISCONNECT)
+
+#define BMS_FLAG_DISCONNECT 0x01 // BMS is about to disconnect the battery from the charge bus
+#define BMS_FLAG_NO_CHARGE 0x02  // BMS is asking for charging to stop (but is not disconnecting)
+
+typedef struct
+{ // What we know from the BMS.  Volts and Amps are as the BMS sends them, not scaled by systemVoltMult / systemAmpMult.
+   uint16_t CVL_mV;              // Charge Voltage Limit
+   uint16_t CCL_dA;              // Charge Current Limit
+   uint8_t flags;                // BMS_FLAG_xxx
+   uint16_t packmV;
+   int16_t packdA;
+   uint8_t cellCount;
+   uint16_t cellmV[BMS_MAX_CELLS];
+   uint32_t lastLimits;          // millis() the last LIMITS frame was received
+   uint32_t lastCells;           // millis() the last CELLS frame was received
+} tBMS;
+
+extern tBMS bmsData;
+extern uint32_t bmsShutdownLatency;    // uS from receiving a disconnect warning until the field was turned off  (Last time, and worst seen)
+extern uint32_t bmsShutdownLatencyMax;
+extern uint16_t bmsLatencyOverruns;    // Number of times that took longer then BMS_LATENCY_BUDGET
+extern uint16_t bmsFrameErrors;
+
 bool checkBMS_Serial_In(void);
+void manage_BMS(void);
+bool BMS_parse_byte(uint8_t c);
+bool BMS_limits_valid(void);
+bool BMS_cells_valid(void);
+uint16_t BMS_cell_max(void);
+uint16_t BMS_cell_spread(void);
+void BMS_shutdown_done(void);
 
-#endif // _BMS_SERIAL_H_
\ No newline at end of file
+#endif // _BMS_SERIAL_H_
@@ -0,0 +1,247 @@
+//      BinTelemetry.cpp
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//*****************************************************************************************
+//
+//    Binary telemetry framing.  Once the host has asked for it with $BIN:1, send_outbound()
+//    sends the AST, CPE, SST and SCV status as fixed-layout structures (see BinTelemetry.h)
+//    instead of their ASCII strings - about 1/3 the bytes, and no number formatting.
+//    Everything else sent via ASCII_write() is wrapped up in a BT_TEXT frame.  $BIN:0 (or
+//    a reboot) goes back to plain ASCII, commands coming in are always ASCII.
+//
+//    $BIN:2 selects delta mode as well, where between keyframes only the AST fields that have
+//    moved more then their deadband are sent.  (The deadbands may be changed with $DLT)
+//
+//    Frames are built straight into the ASCII transmit ring, see TxRing.cpp.  The only frames
+//    taken in are the Config Backup chunks of $BKL, see BT_decode().
+//
+//*****************************************************************************************
+
+#include "Config.h"
+#include "BinTelemetry.h"
+#include "TxRing.h"
+
+bool binaryMode = false; // Has the host asked for binary telemetry?
+bool deltaMode = false;  //   And only the changes?
+
+static const tBTField astFields[BT_AST_NFIELDS] PROGMEM = {BT_AST_FIELDS};
+
+uint16_t btDeadband[BT_AST_NFIELDS] = { // How far each field must move before it is sent again, in its own units.  (0 = any change, may be changed via $DLT)
+    60,  // runTime         Seconds
+    20,  // batmV
+    5,   // altdA
+    5,   // batdA
+    25,  // altWatts
+    0,   // targetBatmV
+    0,   // targetAltAmps
+    0,   // targetAltWatts
+    0,   // state
+    0,   // batTemp         Deg C
+    0,   // altTemp
+    50,  // RPMs
+    20,  // altmV
+    1,   // FETTemp
+    0,   // fieldAmps
+    1};  // fieldPWM        %
+
+static tBTAST lastAST;               // AST as the host last saw it
+static bool lastASTValid = false;
+
+//-------       'helper' for BT_send(), the COBS encoder.  code = # bytes since the last 0x00 (+1), its place in the frame is held at codeIdx.
+static void COBS_put(uint8_t *frame, uint8_t *pos, uint8_t *codeIdx, uint8_t c)
+{
+    if (c != 0)
+        frame[(*pos)++] = c;
+
+    if ((c == 0) || ((*pos - *codeIdx) == 0xFF))
+    { // Close this block out, and start the next one.
+        frame[*codeIdx] = *pos - *codeIdx;
+        *codeIdx = (*pos)++;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------
+// BT Send
+//      Frames up the passed payload as message 'type', and queues it to the ASCII serial port.
+//      Returns FALSE if it was dropped as there was no room.  (See TX_write() for how highPriority is used)
+//
+//------------------------------------------------------------------------------------------------------
+
+bool BT_send(uint8_t type, const void *payload, uint8_t len, bool highPriority)
+{
+    uint8_t frame[BT_MAX_FRAME];
+    uint8_t pos = 1;
+    uint8_t codeIdx = 0;
+    uint16_t crc = 0xFFFF;
+    const uint8_t *p = (const uint8_t *)payload;
+
+    len = min(len, BT_MAX_PAYLOAD);
+
+    crc = CRC16_update(crc, type);
+    COBS_put(frame, &pos, &codeIdx, type);
+
+    for (uint8_t i = 0; i < len; i++)
+    {
+        crc = CRC16_update(crc, p[i]);
+        COBS_put(frame, &pos, &codeIdx, p[i]);
+    }
+
+    COBS_put(frame, &pos, &codeIdx, (uint8_t)crc);
+    COBS_put(frame, &pos, &codeIdx, (uint8_t)(crc >> 8));
+
+    frame[codeIdx] = pos - codeIdx; // Close out the last block
+    frame[pos++] = 0x00;            //   and mark the end of the frame.
+
+    return (TX_write_bytes(&asciiTX, frame, pos, highPriority));
+} //BT_send
+
+//------------------------------------------------------------------------------------------------------
+// BT Decode
+//      Undoes the COBS encoding of the passed frame in place (less its 0x00), and checks its CRC.  Returns the length of its
+//      payload - which with its TYPE is now at the start of frame[] - or -1 if it is damaged.
+//
+//------------------------------------------------------------------------------------------------------
+
+int16_t BT_decode(uint8_t *frame, uint8_t len)
+{
+    uint8_t in = 0;
+    uint8_t out = 0;
+    uint8_t code;
+    uint16_t crc = 0xFFFF;
+
+    while (in < len)
+    {
+        code = frame[in++];
+        if ((code == 0) || ((in + code - 1) > len))
+            return (-1); // Block runs off the end of the frame
+
+        for (uint8_t i = 1; i < code; i++)
+            frame[out++] = frame[in++]; // (out never passes in, so this can be done in place)
+
+        if ((code != 0xFF) && (in < len))
+            frame[out++] = 0x00;
+    }
+
+    if (out < 3)
+        return (-1); // Must at least have a TYPE and the CRC
+
+    for (uint8_t i = 0; i < (out - 2); i++)
+        crc = CRC16_update(crc, frame[i]);
+
+    if (crc != (frame[out - 2] | ((uint16_t)frame[out - 1] << 8)))
+        return (-1);
+
+    return (out - 3);
+} //BT_decode
+
+//-------       'helper' for BT_send_AST(), returns the passed field as a signed value.
+static int32_t BT_get_field(const tBTAST *ast, const tBTField *f)
+{
+    const uint8_t *p = (const uint8_t *)ast + f->offset;
+
+    switch (f->size)
+    {
+    case 1:
+        return (f->isSigned ? (int32_t)(int8_t)p[0] : (int32_t)p[0]);
+    case 2:
+        return (f->isSigned ? (int32_t)(int16_t)(p[0] | (p[1] << 8)) : (int32_t)(uint16_t)(p[0] | (p[1] << 8)));
+    default:
+        return ((int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24)));
+    }
+}
+
+//------------------------------------------------------------------------------------------------------
+// BT Send AST
+//      Used in delta mode to send the passed Alternator Status - in full if keyframe is TRUE (or the host has
+//      not yet been sent one), else as a BT_AST_DELTA of only the fields that have moved more then their deadband.
+//      Returns FALSE if it was dropped.  (The host will then be sent those fields again next time)
+//
+//------------------------------------------------------------------------------------------------------
+
+bool BT_send_AST(const tBTAST *ast, bool keyframe, bool highPriority)
+{
+    uint8_t delta[BT_AST_NFIELDS + sizeof(tBTAST)]; // TAG + VALUE for every field, worst case
+    uint8_t len = 0;
+    uint16_t changed = 0;
+    tBTField f;
+    uint8_t i;
+
+    if (keyframe || !lastASTValid)
+    {
+        if (!BT_send(BT_AST, ast, sizeof(tBTAST), highPriority))
+            return (false);
+        lastAST = *ast;
+        lastASTValid = true;
+        return (true);
+    }
+
+    for (i = 0; i < BT_AST_NFIELDS; i++)
+    {
+        memcpy_P(&f, &astFields[i], sizeof(tBTField));
+        if (labs(BT_get_field(ast, &f) - BT_get_field(&lastAST, &f)) > btDeadband[i])
+        {
+            delta[len++] = i;
+            memcpy(&delta[len], (const uint8_t *)ast + f.offset, f.size);
+            len += f.size;
+            changed |= (1U << i);
+        }
+    }
+
+    if (len == 0)
+        return (true); // Nothing has moved enough to bother the host with.
+
+    if (!BT_send(BT_AST_DELTA, delta, len, highPriority))
+        return (false);
+
+    for (i = 0; i < BT_AST_NFIELDS; i++)
+    { // Host now has these, move them along.  (Those not sent stay put, so a slow drift still adds up to a change)
+        if (changed & (1U << i))
+        {
+            memcpy_P(&f, &astFields[i], sizeof(tBTField));
+            memcpy((uint8_t *)&lastAST + f.offset, (const uint8_t *)ast + f.offset, f.size);
+        }
+    }
+
+    return (true);
+} //BT_send_AST
+
+//------------------------------------------------------------------------------------------------------
+// BT Reset Delta
+//      Called when entering delta mode, so the next AST goes out in full.
+//
+//------------------------------------------------------------------------------------------------------
+
+void BT_reset_delta(void)
+{
+    lastASTValid = false;
+} //BT_reset_delta
+
+//------------------------------------------------------------------------------------------------------
+// BT Write Text
+//      Sends the passed ASCII string - as-is, or in a BT_TEXT frame if the host has selected binary mode.
+//
+//      Normally called via the ASCII_write() and ASCII_write_LP() macros in Portability.h
+//
+//------------------------------------------------------------------------------------------------------
+
+bool BT_write_text(const char *str, bool highPriority)
+{
+    if (binaryMode)
+        return (BT_send(BT_TEXT, str, strlen(str), highPriority));
+
+    return (TX_write(&asciiTX, str, highPriority));
+} //BT_write_text
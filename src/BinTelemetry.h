@@ -0,0 +1,282 @@
+//      BinTelemetry.h
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//      Binary telemetry protocol, selected with the $BIN:1 command.  (See BinTelemetry.cpp)
+//
+//      This file is also used by the host side decoder (tools/BinTelemetry), so it may only depend on <stdint.h>
+//      (It is included from Portability.h, ahead of Config.h being fully processed)
+//
+//----- Frame format.   All multi-byte values are little-endian.
+//
+//      COBS( TYPE  PAYLOAD[n]  CRC16-lo  CRC16-hi )  0x00
+//
+//      CRC-16/CCITT (0xFFFF start) is over TYPE and the PAYLOAD - the same CRC used on the BMS serial port.
+//      COBS encoding removes all the 0x00 bytes from the frame, so the trailing 0x00 marks the end of each one.
+//
+//      The payload of each TYPE is the matching tBTxxx structure below, carrying the same values as the ASCII
+//      string of the same name in fixed-point:  Volts in mV, Amps in 0.1A (dA), and the rest as noted.
+//      Anything that has no binary form (command responses, AOK, DBG, SOC, BMS, ..) is sent as its ASCII string
+//      in a BT_TEXT frame, so once in binary mode everything coming from the regulator is framed.
+//
+//----- Delta mode  ($BIN:2)
+//
+//      The full BT_AST is sent only as a keyframe (every DELTA_KEYFRAME_RATE, and after $RAS).  In between, a
+//      BT_AST_DELTA frame carries just the fields that have moved more then their deadband since they were last sent:
+//
+//      PAYLOAD = { TAG  VALUE[n] } ...
+//
+//      TAG is the field's index in BT_AST_FIELDS below, which also gives the size n of its VALUE (as in tBTAST).
+//      No frame at all is sent if nothing has moved.   The other messages are sent only if they have changed, or at
+//      least every DELTA_KEYFRAME_RATE.
+//
+//----- Config Backup  ($BKS: / $BKL:)
+//
+//      The whole configuration (tBKImage, see Flash.h) is passed as a run of BT_BACKUP frames in either mode, each
+//      carrying the next chunk of it.  $BKS: sends a 0x00 (ending anything half-received by the host), the frames, and
+//      then AOK.  $BKL: is only taken while the regulator is not charging (disabled, or in warm-up).  Once it is AOK'd the
+//      host sends the frames, one at a time - each is AOK'd once it has been stored, a frame sent again (no AOK seen) is
+//      AOK'd again, and the last one is only AOK'd if the image checked out and has been put in place.  (Which is done a
+//      byte per pass, so may take some seconds - see update_BK_image() in Flash.cpp)  No frame for BK_LOAD_TIMEOUT, or one
+//      out of order, abandons the load.
+//
+//----- Charge History  ($HIS:)
+//
+//      The records held at each level (see History.h) are sent oldest first, level 0 up, as BT_HISTORY frames of up to
+//      BT_HIST_RECS records each - the frame's length says how many.  Then AOK.   Record seq of a level ends at
+//      ((seq + 1) * interval) seconds into the history, which was 'now' seconds long when the frame was sent.
+//      As the seq of a record never changes, a host that reconnects can drop the ones it already has.
+
+#ifndef _BINTELEMETRY_H_
+#define _BINTELEMETRY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BT_AST 0x01  // tBTAST
+#define BT_CPE 0x02  // tBTCPE
+#define BT_SST 0x03  // tBTSST
+#define BT_SCV 0x04  // tBTSCV
+#define BT_AST_DELTA 0x11 // Changed tBTAST fields, see Delta mode above
+#define BT_BACKUP 0x21 // tBTBackup, see Config Backup above
+#define BT_HISTORY 0x22 // tBTHistory, see Charge History above
+#define BT_DISPLAY 0x31 // Serial Display frame  (Only sent to the Serial Display port, see SerialDisplay.h)
+#define BT_TEXT 0x7F // ASCII string, as it would have been sent in ASCII mode  (No NULL)
+
+#define BT_MAX_PAYLOAD 200                                           // Largest ASCII string that may be sent as BT_TEXT  (OUTBOUND_BUFF_SIZE)
+#define BT_MAX_FRAME (1 + BT_MAX_PAYLOAD + 2 + 1 + 1)                // TYPE + PAYLOAD + CRC, 1 COBS overhead byte (good to 254 bytes), and the 0x00
+#define BT_BACKUP_CHUNK 64                                           // Image bytes per BT_BACKUP frame.  (A frame of them must fit in the inbound command buffer)
+#define BT_BACKUP_FRAME (1 + 2 + BT_BACKUP_CHUNK + 2 + 1 + 1)
+#define BT_HIST_RECS 8                                               // Charge History records per BT_HISTORY frame
+
+typedef struct __attribute__((packed))
+{ // AST:  Alternator Status
+    uint32_t runTime;      // Seconds
+    uint16_t batmV;
+    int16_t altdA;
+    int16_t batdA;
+    int16_t altWatts;
+    uint16_t targetBatmV;
+    int16_t targetAltAmps; // Whole Amps, as in the ASCII string
+    int16_t targetAltWatts;
+    uint8_t state;         // tModes
+    int16_t batTemp;       // Deg C
+    int16_t altTemp;
+    uint16_t RPMs;
+    uint16_t altmV;
+    int16_t FETTemp;
+    int16_t fieldAmps;
+    uint8_t fieldPWM;      // In %
+} tBTAST;
+
+typedef struct __attribute__((packed))
+{ // CPE:  Charge Profile Entry   (Durations are in Minutes, Amps and Ahs in whole units as in tCPS)
+    uint8_t index;         // 1..MAX_CPES
+    uint16_t acptmV;
+    uint16_t exitAcptMin;
+    int16_t exitAcptAmps;
+
+    int16_t limitOCAmps;
+    uint16_t exitOCMin;
+    uint16_t exitOCmV;
+
+    uint16_t floatmV;
+    int16_t limitFloatAmps;
+    uint16_t exitFloatMin;
+    int16_t floatToBulkAmps;
+    int16_t floatToBulkAHs;
+    uint16_t floatToBulkmV;
+
+    uint16_t exitPFMin;
+    uint16_t PFToBulkmV;
+    int16_t PFToBulkAHs;
+
+    uint16_t equalmV;
+    int16_t limitEqualAmps;
+    uint16_t exitEqualMin;
+    int16_t exitEqualAmps;
+
+    int16_t tempComp;      // 0.1mV per Deg C
+    int16_t minTempComp;   // Deg C
+    int16_t batMinTemp;
+    int16_t batMaxTemp;
+
+    uint8_t exitAcptSOC;   // In %
+    uint8_t floatToBulkSOC;
+
+    uint16_t cellTapermV;
+    uint16_t cellMaxmV;
+    uint8_t balanceAmps;
+    uint8_t balanceSpreadmV;
+} tBTCPE;
+
+#define BTF_SMALL_ALT 0x01 // tBTSST flags
+#define BTF_TACH_MODE 0x02
+#define BTF_FORCED_TM 0x04
+
+typedef struct __attribute__((packed))
+{ // SST:  System Status
+    char firmware[10];     // NULL padded, not always NULL terminated
+    uint8_t flags;         // BTF_xxx
+    uint8_t cpIndex;       // 1..MAX_CPES
+    uint16_t ampMult;      // x100
+    uint16_t voltMult;     // x100
+    int16_t altCapAmps;
+    int16_t altCapRPMs;
+    int32_t AHs;
+    int32_t WHs;
+    uint16_t txDropped;
+    uint16_t txPeak;
+    uint16_t oledLoad;     // In 0.1%
+    uint16_t oledSliceMax; // uS
+    uint32_t sensorLatency;    // uS
+    uint32_t sensorLatencyMax;
+} tBTSST;
+
+#define BTF_REV_BAT_SHUNT 0x01 // tBTSCV flags
+#define BTF_REV_ALT_SHUNT 0x02
+
+typedef struct __attribute__((packed))
+{ // SCV:  System Configuration
+    uint8_t lockout;
+    uint8_t flags;         // BTF_xxx
+    uint16_t SVOverride;   // x100
+    uint16_t BCOverride;   // x100
+    uint8_t CPOverride;
+
+    uint8_t altTempSetpoint;
+    uint8_t derateNormal;  // In %
+    uint8_t derateSmall;
+    uint8_t derateHalf;
+    int8_t pullbackFactor;
+
+    int16_t altAmpsLimit;
+    int16_t altWattsLimit;
+
+    uint8_t altPoles;
+    uint16_t driveRatio;   // x1000
+    int16_t batShuntRatio;
+    int16_t altShuntRatio;
+
+    int16_t idleRPMs;
+    int8_t fieldTachPWM;   // In %, or -1 = auto-determine
+    int16_t warmup;        // Seconds
+    uint8_t requiredSensors;
+} tBTSCV;
+
+typedef struct __attribute__((packed))
+{ // BACKUP:  One chunk of the Config Backup image
+    uint16_t offset;                // Where in the image data[] goes
+    uint8_t data[BT_BACKUP_CHUNK];  // (The last one may be shorter, the frame's length says how many are there)
+} tBTBackup;
+
+typedef struct __attribute__((packed))
+{ // One Charge History record.   [0] = low, [1] = high, [2] = mean over the interval  (HIST_MIN, HIST_MAX, HIST_AVG)
+    uint16_t batmV[3];
+    int16_t batdA[3];
+    int16_t altdA[3];
+    int8_t altTemp[3];     // Deg C  (-99 = no sensor)
+    uint8_t state;         // tModes at the end of the interval
+} tBTHistRec;
+
+typedef struct __attribute__((packed))
+{ // HISTORY:  A run of Charge History records from one level
+    uint8_t level;
+    uint16_t interval;     // Seconds each record covers
+    uint32_t now;          // Seconds of history taken so far
+    uint32_t seq;          // Of rec[0], the rest follow on from it
+    tBTHistRec rec[BT_HIST_RECS]; // (Fewer may be sent)
+} tBTHistory;
+
+typedef union
+{ // Room for any of the above, used to build them in
+    tBTAST ast;
+    tBTCPE cpe;
+    tBTSST sst;
+    tBTSCV scv;
+} tBTStatus;
+
+typedef struct
+{ // Where to find one field in its structure, used by the delta encoding (and decoding)
+    uint8_t offset;
+    uint8_t size;
+    bool isSigned;
+} tBTField;
+
+#define BT_FIELD(s, f, sg) {offsetof(s, f), sizeof(((s *)0)->f), sg}
+
+#define BT_AST_FIELDS                          \
+    BT_FIELD(tBTAST, runTime, false),         \
+    BT_FIELD(tBTAST, batmV, false),           \
+    BT_FIELD(tBTAST, altdA, true),            \
+    BT_FIELD(tBTAST, batdA, true),            \
+    BT_FIELD(tBTAST, altWatts, true),         \
+    BT_FIELD(tBTAST, targetBatmV, false),     \
+    BT_FIELD(tBTAST, targetAltAmps, true),    \
+    BT_FIELD(tBTAST, targetAltWatts, true),   \
+    BT_FIELD(tBTAST, state, false),           \
+    BT_FIELD(tBTAST, batTemp, true),          \
+    BT_FIELD(tBTAST, altTemp, true),          \
+    BT_FIELD(tBTAST, RPMs, false),            \
+    BT_FIELD(tBTAST, altmV, false),           \
+    BT_FIELD(tBTAST, FETTemp, true),          \
+    BT_FIELD(tBTAST, fieldAmps, true),        \
+    BT_FIELD(tBTAST, fieldPWM, false)
+
+#define BT_AST_NFIELDS 16
+
+static inline uint16_t CRC16_update(uint16_t crc, uint8_t c)
+{ // CRC-16/CCITT, polynomial 0x1021
+    crc ^= (uint16_t)c << 8;
+    for (uint8_t i = 0; i < 8; i++)
+        crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+    return (crc);
+}
+
+#ifdef ARDUINO
+extern bool binaryMode;
+extern bool deltaMode;
+extern uint16_t btDeadband[BT_AST_NFIELDS];
+
+bool BT_send(uint8_t type, const void *payload, uint8_t len, bool highPriority);
+int16_t BT_decode(uint8_t *frame, uint8_t len);
+bool BT_send_AST(const tBTAST *ast, bool keyframe, bool highPriority);
+void BT_reset_delta(void);
+bool BT_write_text(const char *str, bool highPriority);
+#endif
+
+#endif // _BINTELEMETRY_H_
@@ -40,19 +40,37 @@
 const tCPS PROGMEM defaultCPS[MAX_CPES] = {
     
     // eliminated decimal places to fix conversion narrowing problem.  Note that, for example, 6 hours uses 60 here and 4.5 hours uses 45
-    // Name      Bulk/Accpt                     Overcharge                    Float                              Post Float                    Post Float                           Equalization                      Temp Comp
-    //           Target  <--- Exit Accpt --->   Limit  <-- Exit OC ------->   Target  Limit     Exit Float    Float to   Float to  Float to    Exit PF       PF to       PF to      Target  Limit  Exit         Exit   1 Deg C      Min       Bat Temp
-    //           Volts      Duration    Amps    Amps   Volts   Duration       Volts    Amps      Duration     Bulk Amps  Bulk AHrs Bulk Volts  Duration      Bulk Volts  Bulk AHrs  Volts   Amps   Duration     Amps   Compensation Temp Comp Min  Max
-    {"LIFELINE", 14.3,   60 * 360000UL,  15,     0,     0.0,  0 * 360000UL,    13.3,    -1,    0 * 360000UL,    -10,       0,       12.8,      0 * 360000UL,  0.0,       0,          0.0,    0,    0 * 360000UL, 0,    0.0234,      -9,       -45, 45}, // LIFELINE BATTERY #1 Default (safe) profile & AGM #1 (Low Voltage AGM).
-    {"STD FLA",  14.8,   30 * 360000UL,   5,     0,     0.0,  0 * 360000UL,    13.5,    -1,    0 * 360000UL,    -10,       0,       12.8,      0 * 360000UL,  0.0,       0,          0.0,    0,    0 * 360000UL, 0,    0.005 * 6,   -9,       -45, 45}, // #2 Standard FLA (e.g. Starter Battery, small storage)
-    {"HD FLA",   14.6,   45 * 360000UL,   5,     0,     0.0,  0 * 360000UL,    13.2,    -1,    0 * 360000UL,    -10,       0,       12.8,      0 * 360000UL,  0.0,       0,         15.3,   25,   30 * 360000UL, 0,    0.005 * 6,   -9,       -45, 45}, // #3 HD FLA (GC, L16, larger)
-    {"AGM #2",   14.7,   45 * 360000UL,   3,     0,     0.0,  0 * 360000UL,    13.4,    -1,    0 * 360000UL,    -10,       0,       12.8,      0 * 360000UL,  0.0,       0,          0.0,    0,    0 * 360000UL, 0,    0.004 * 6,   -9,       -45, 45}, // #4 AGM #2 (Higher Voltage AGM)
-    {"GEL",      14.1,   60 * 360000UL,   5,     0,     0.0,  0 * 360000UL,    13.5,    -1,    0 * 360000UL,    -10,       0,       12.8,      0 * 360000UL,  0.0,       0,          0.0,    0,    0 * 360000UL, 0,    0.005 * 6,   -9,       -45, 45}, // #5 GEL
-    {"FIREFLY",  14.4,   60 * 360000UL,   7,     0,     0.0,  0 * 360000UL,    13.4,    -1,    0 * 360000UL,    -20,       0,       12.0,      0 * 360000UL,  0.0,       0,         14.4,    0,   30 * 360000UL, 3,    0.024,      -20,       -20, 50}, // #6 Firefly (Carbon Foam)
-    {"CUSTOM ",  14.4,   60 * 360000UL,  15,    15,     5.3, 30 * 360000UL,    13.1,    -1,    0 * 360000UL,    -10,       0,       12.8,      0 * 360000UL,  0.0,       0,         15.3,   25,   30 * 360000UL, 0,    0.005 * 6,   -9,       -45, 45}, // #7 4-stage HD FLA (& Custom #1 changeable profile)
-    {"LiFePO4 ", 13.8,   10 * 360000UL,  15,     0,     0.0,  0 * 360000UL,    13.6,     0,    0 * 360000UL,      0,     -50,       13.3,      0 * 360000UL,  0.0,       0,          0.0,    0,    0 * 360000UL, 0,    0.000 * 6,    0,         0, 40}  // #8 LiFeP04        (& Custom #2 changeable profile)
+    // Name      Bulk/Accpt                     Overcharge                    Float                              Post Float                    Post Float                           Equalization                      Temp Comp   State of Charge   <------ Cell Balancing ------->
+    //           Target  <--- Exit Accpt --->   Limit  <-- Exit OC ------->   Target  Limit     Exit Float    Float to   Float to  Float to    Exit PF       PF to       PF to      Target  Limit  Exit         Exit   1 Deg C      Min       Bat Temp    Exit   Float to   Taper  Max    Balance Balance
+    //           Volts      Duration    Amps    Amps   Volts   Duration       Volts    Amps      Duration     Bulk Amps  Bulk AHrs Bulk Volts  Duration      Bulk Volts  Bulk AHrs  Volts   Amps   Duration     Amps   Compensation Temp Comp Min  Max    Accpt  Bulk   mV     mV     Amps    Spread mV
+    {"LIFELINE", 14.3,   60 * 360000UL,  15,     0,     0.0,  0 * 360000UL,    13.3,    -1,    0 * 360000UL,    -10,       0,       12.8,      0 * 360000UL,  0.0,       0,          0.0,    0,    0 * 360000UL, 0,    0.0234,      -9,       -45, 45,   0,   0,    0,    0,  0,  0}, // LIFELINE BATTERY #1 Default (safe) profile & AGM #1 (Low Voltage AGM).
+    {"STD FLA",  14.8,   30 * 360000UL,   5,     0,     0.0,  0 * 360000UL,    13.5,    -1,    0 * 360000UL,    -10,       0,       12.8,      0 * 360000UL,  0.0,       0,          0.0,    0,    0 * 360000UL, 0,    0.005 * 6,   -9,       -45, 45,   0,   0,    0,    0,  0,  0}, // #2 Standard FLA (e.g. Starter Battery, small storage)
+    {"HD FLA",   14.6,   45 * 360000UL,   5,     0,     0.0,  0 * 360000UL,    13.2,    -1,    0 * 360000UL,    -10,       0,       12.8,      0 * 360000UL,  0.0,       0,         15.3,   25,   30 * 360000UL, 0,    0.005 * 6,   -9,       -45, 45,   0,   0,    0,    0,  0,  0}, // #3 HD FLA (GC, L16, larger)
+    {"AGM #2",   14.7,   45 * 360000UL,   3,     0,     0.0,  0 * 360000UL,    13.4,    -1,    0 * 360000UL,    -10,       0,       12.8,      0 * 360000UL,  0.0,       0,          0.0,    0,    0 * 360000UL, 0,    0.004 * 6,   -9,       -45, 45,   0,   0,    0,    0,  0,  0}, // #4 AGM #2 (Higher Voltage AGM)
+    {"GEL",      14.1,   60 * 360000UL,   5,     0,     0.0,  0 * 360000UL,    13.5,    -1,    0 * 360000UL,    -10,       0,       12.8,      0 * 360000UL,  0.0,       0,          0.0,    0,    0 * 360000UL, 0,    0.005 * 6,   -9,       -45, 45,   0,   0,    0,    0,  0,  0}, // #5 GEL
+    {"FIREFLY",  14.4,   60 * 360000UL,   7,     0,     0.0,  0 * 360000UL,    13.4,    -1,    0 * 360000UL,    -20,       0,       12.0,      0 * 360000UL,  0.0,       0,         14.4,    0,   30 * 360000UL, 3,    0.024,      -20,       -20, 50,   0,   0,    0,    0,  0,  0}, // #6 Firefly (Carbon Foam)
+    {"CUSTOM ",  14.4,   60 * 360000UL,  15,    15,     5.3, 30 * 360000UL,    13.1,    -1,    0 * 360000UL,    -10,       0,       12.8,      0 * 360000UL,  0.0,       0,         15.3,   25,   30 * 360000UL, 0,    0.005 * 6,   -9,       -45, 45,   0,   0,    0,    0,  0,  0}, // #7 4-stage HD FLA (& Custom #1 changeable profile)
+    {"LiFePO4 ", 13.8,   10 * 360000UL,  15,     0,     0.0,  0 * 360000UL,    13.6,     0,    0 * 360000UL,      0,     -50,       13.3,      0 * 360000UL,  0.0,       0,          0.0,    0,    0 * 360000UL, 0,    0.000 * 6,    0,         0, 40,   0,   0, 3450, 3550,  5, 30}  // #8 LiFeP04        (& Custom #2 changeable profile)
 }; //*** be certain to change the ENUM of the CPE names in CPE.h if the profiles above are changed ***
 
+//  Rested Open Circuit Voltage curves, one row for each of the Charge Profile Entries above (same order).  Used by the State of Charge
+//      estimator to anchor its Ah counting when the battery has been resting.  As with the CPEs, these are for a 12v battery
+//      and are multiplied by systemVoltMult when used.   The two Custom changeable profiles keep the curve of their default battery type.
+//
+const tOCV PROGMEM defaultOCV[MAX_CPES] = {
+
+    //  <-------------------------------- Rested Volts (mV) at State of Charge -------------------------------->   Charge
+    //    0%     10%    20%    30%    40%    50%    60%    70%    80%    90%    100%                               Eff %
+    {{11800, 11950, 12050, 12150, 12250, 12350, 12450, 12550, 12650, 12750, 12850},                                 92}, // LIFELINE / AGM #1
+    {{11700, 11850, 11980, 12100, 12200, 12300, 12400, 12480, 12550, 12620, 12700},                                 85}, // #2 Standard FLA
+    {{11700, 11850, 11980, 12100, 12200, 12300, 12400, 12480, 12550, 12620, 12700},                                 85}, // #3 HD FLA
+    {{11800, 11950, 12050, 12150, 12250, 12350, 12450, 12550, 12650, 12750, 12850},                                 92}, // #4 AGM #2
+    {{11800, 11950, 12080, 12200, 12300, 12400, 12500, 12600, 12700, 12800, 12900},                                 90}, // #5 GEL
+    {{11800, 11950, 12050, 12150, 12250, 12350, 12450, 12550, 12650, 12750, 12850},                                 92}, // #6 Firefly
+    {{11700, 11850, 11980, 12100, 12200, 12300, 12400, 12480, 12550, 12620, 12700},                                 85}, // #7 4-stage HD FLA
+    {{12000, 12900, 13000, 13100, 13150, 13200, 13250, 13300, 13330, 13400, 13600},                                 99}  // #8 LiFePO4  (Very flat, so OCV is only a rough guide mid-range)
+};
+
 
 // Side note:  The Arduino programming environment will place the above populated table into EPROM during compile time.
 //              Upon power on, the Startup code will copy the selected CPE entry (table row) into RAM for use.
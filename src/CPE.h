@@ -86,13 +86,63 @@ typedef struct
    int MIN_TEMP_COMP_LIMIT; // If battery temperature falls below this value (in deg-c), limit temp compensation voltage rise to prevent overvoltage in very very cold places.
    int BAT_MIN_CHARGE_TEMP; // If Battery is below this temp (in deg-c), stop charging and force into Float Mode to protect it from under-temperature damage.
    int BAT_MAX_CHARGE_TEMP; // If Battery exceeds this temp (in deg-c),  stop charging and force into Float Mode to protect it from over-temperature damage.
-   uint8_t CPSPLACEHOLDER[8]; // Room for future expansion
+
+   uint8_t EXIT_ACPT_SOC;     // If the estimated State of Charge reaches this % while at the Acceptance voltage, exit Accept mode.  Set = 0 to disable.
+                              //      When EXIT_ACPT_AMPS = -1, this replaces the ADPT_ACPT_TIME_FACTOR adaptive duration whenever the SOC estimate can be trusted.
+   uint8_t FLOAT_TO_BULK_SOC; // If the estimated State of Charge falls to this % while in Float, revert back to BULK.  Set = 0 to disable.
+                              // Note both of these are ONLY usable if USE_SOC_ESTIMATOR is enabled, and the Amp shunt is at the battery.
+                              //      Both are 0 (off) in all the default profiles - the estimate has to be tuned to the battery before it is used.
+
+   // Cell balancing, used when the BMS is sending cell voltages via the BMS serial port.  (Set CELL_TAPER_MV = 0 to disable)
+   uint16_t CELL_TAPER_MV;     // Once the highest cell reaches this voltage (in mV), start tapering back the Amps ..
+   uint16_t CELL_MAX_MV;       //   .. down to BALANCE_AMPS when it reaches this one.  (And no Amps at all once CELL_OVER_MV past it)
+   uint8_t BALANCE_AMPS;       // Amps to hold the highest cell at CELL_MAX_MV with, while the BMS balances the cells.
+   uint8_t BALANCE_SPREAD_MV;  // Do not leave Acceptance until the spread between the highest and lowest cells is this (in mV) or less.
+                               //      (Though EXIT_ACPT_DURATION will still end it.)  Set = 0 to not wait on balancing.
+                               // Note:  The Room for future expansion (CPSPLACEHOLDER[]) has now all been used.
 } tCPS;
 
 #define BAT_TEMP_NOMINAL 25    // Nominal temp which .BAT_TEMP_1C_COMP is based around (in deg-C).
 #define PID_VOLTAGE_SENS 0.020 // When looking at charger mode transitions, if we come within 20mV of the target voltage (for rep 12v battery), consider we have 'met' that voltage condtion. 
                                //  (This is to help with smaller charging sources driving a LARGE battery, where the charging soruce is not really able to push VBat slightly over the limit..)
 
+typedef struct
+{ // Compiled Charging Profile - the thresholds from the working tCPS (chargingParms) scaled for this system by systemVoltMult / systemAmpMult.
+  //   Built once by compile_CPS(), so the charging state machine and fault checks need only integer compares.
+  //   As in tCPS, 0 = the feature is disabled.
+   int16_t EXIT_ACPT_dA;      // Amps are held in 0.1A units
+   int16_t FLOAT_TO_BULK_dA;
+   int16_t EXIT_EQUAL_dA;
+   int16_t FLOAT_TO_BULK_AHS; // Ahs are whole Ahs
+   int16_t PF_TO_BULK_AHS;
+   int32_t FLOAT_TO_BULK_mV;  // Volts are held in mV
+   int32_t PF_TO_BULK_mV;
+   int32_t FAULT_CHARGE_mV;   // FAULT_BAT_VOLTS_xxx from SmartRegulator.h
+   int32_t FAULT_EQUAL_mV;
+   int32_t FAULT_LOW_mV;
+
+   float EXIT_OC_VOLTS;       // And the set points used by calculate_ALT_targets(), already scaled so they only need to be
+   float FLOAT_BAT_VOLTS;     //   used as-is in the (floating point) PID engine.
+   float EQUAL_BAT_VOLTS;
+   float LIMIT_OC_AMPS;
+   float LIMIT_FLOAT_AMPS;
+   float LIMIT_EQUAL_AMPS;
+   float BALANCE_AMPS;
+} tCompiledCPS;
+
+#define TO_mV(v) ((int32_t)((v) * 1000.0 + 0.5))                          // Convert a (positive) floating Volts into mV
+#define TO_dA(a) ((int16_t)((a) * 10.0 + (((a) < 0.0) ? -0.5 : 0.5)))     // Convert a floating Amps into 0.1A units
+
 extern const tCPS defaultCPS[MAX_CPES] PROGMEM;
 
+#define OCV_POINTS 11 // Rested Open Circuit Voltage curve has a point for every 10% of State of Charge, 0% .. 100%
+
+typedef struct
+{ // Open Circuit Voltage curve, one for each Charge Profile Entry.  Used by the State of Charge estimator.
+   uint16_t OCV_mV[OCV_POINTS]; // Rested battery voltage (in mV, for a 12v battery) at 0%, 10%, .. 100% State of Charge
+   uint8_t CHARGE_EFF;          // Charge efficiency in %, how much of the Ahs put in actually end up stored.
+} tOCV;
+
+extern const tOCV defaultOCV[MAX_CPES] PROGMEM;
+
 #endif /*  _CPE_H_ */
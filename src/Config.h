@@ -49,15 +49,49 @@
 // Display Options - both OLED and SERIAL_DISPLAY can be used
 #define USE_OLED     // to use the Geekcreit SSD1306 I2C OLED which also requires the SoftWire shell to the I2CMaster library
 #define OLED_DISPLAY_DEG_IN_F // display temperatures in Degrees F instead of C (comment out for Deg C)
+//#define OLED_SOFT_I2C       // OLED is on its own bit-banged I2C bus (pins set in SmartRegulator.h), not the INA226s' hardware I2C bus.
+                              //   Only for a board hand-wired for it:  both I2C headers on the Mini Mega PCB are on the same D20/D21 (SDA/SCL)
+                              //   nets as the INA226s, so there is no second bus to plug the OLED into.  The OLED's SDA / SCL must be wired
+                              //   to D36 (PC1) / D37 (PC0) instead, with its own pull-ups to 5V.
 
 #define USE_SERIAL_DISPLAY  //output LCD change info on serial line
 #define SERIAL_DISPLAY_PORT Serial1
 #define SERIAL_DISPLAY_BAUD 9600UL
+#define SERIAL_DISPLAY_PERMS (IBP_READ | IBP_CONFIG | IBP_CONTROL) // Commands the Serial Display port will also take, and answer  (IBP_xxx, see OSEnergy_Serial.h)
 
 #define USE_BMS_SERIAL_IN  // Serial input for BMS commands 
 #define BMS_SERIAL_PORT Serial2
 #define BMS_SERIAL_BAUD 9600UL
 
+//#define USE_MODBUS      // Modbus RTU slave, so a PLC can read the measurements and read / write the configuration  (see Modbus.h for the register map)
+#define MODBUS_USART 2    // Which USART (SerialN) it is on.  Modbus drives it directly, so that SerialN may not be used for anything else.
+                          //   On the Mini Mega PCB only USART1 (D18/D19, the Serial Display) and USART2 (D16/D17, the BMS input) reach a
+                          //   connector - so Modbus takes over one of those, and USE_SERIAL_DISPLAY or USE_BMS_SERIAL_IN must be commented out.
+                          //   USART0 is the USB port.  USART3 is not usable as is:  its TX3 is D14, which is the FEATURE_IN_PORT3 net (via R227),
+                          //   and nothing is connected to RX3 (D15).  (Modbus.cpp will not build on USART3 if a Feature-in is assigned to port 3)
+#define MODBUS_BAUD 19200UL
+#define MODBUS_CONFIG SERIAL_8E1 // Modbus default is Even parity.  (Use SERIAL_8N2 for No parity)
+#define MODBUS_SLAVE_ID 1 // Our address on the Modbus, 1..247
+//#define MODBUS_DE_PIN 22  // If using an RS-485 transceiver, the pin its Driver Enable (DE and /RE tied together) is on
+                            // Note:  Modbus uses Timer 5 for the frame timing, so PWM is lost on pins 44..46.
+
+#define USE_HISTORY       // Keep the recent charge curve in RAM (last 8 minutes in detail, last 4 hours in outline), sent back by $HIS:
+                          //   and graphed on the OLED's Battery and Alt Temp screens  (see History.cpp)
+                          //   It takes 1.0K of the ATmega2560's 8K of RAM (see HIST_DEPTH in SmartRegulator.h).
+                          //
+                          // RAM:  The Mega has 8K, shared by the static variables and the stack.  The larger users among the options are
+                          //   USE_HISTORY 1.0K, USE_OLED 1.3K (its shadow framebuffer), and the serial transmit rings 0.75K (TX_ASCII_SIZE +
+                          //   TX_DISPLAY_SIZE).  The regulator checks as it runs that the stack never comes within RAM_MIN_FREE (256) bytes
+                          //   of the variables, and FAULTs (code 43) if it does - so if turning an option on brings that FAULT, turn
+                          //   another off, or make HIST_LEVELS smaller (176 bytes saved per level dropped, each halves how far back it goes).
+
+// Control Options
+#define USE_PWM_FEED_FORWARD  // Learn the Field PWM needed at each RPM / Amps, and use it to move the field quickly to a new operating point (see SmartRegulator.h)
+#define USE_GAIN_SCHEDULING   // Scale the PID gains by Engine RPMs and Alternator Temperature (see GainSchedule.cpp)
+#define USE_THERMAL_MODEL     // Cap Alt Amps using a learned thermal model of the alternator, ahead of the 50% field cut when overheating (see ThermalModel.cpp)
+#define USE_SOC_ESTIMATOR     // Estimate battery State of Charge, and allow it to be used to exit Acceptance / Float  (see SOC.cpp)
+#define USE_TAPER_EXIT        // Exit Acceptance using a fitted taper of the battery Amps, rather than only the slow persistentBatAmps average (see Taper.cpp)
+
 //Note: for faster bench testing, turn on BENCHTEST in SmartRegulator.h
 
 //*************************************************************************************************************************************
@@ -106,6 +140,10 @@
 //     NOTE:  "restore" may be combined with other Feature_in defines, as it impacts only startup operation, not running.
 //            "Restore" is only effective if user selects Charge Profile #6
 
+//#define FEATURE_IN_OLED_SCREEN  // Enable FEATURE_IN port as a push-button to step the OLED on to its next screen  (Needs USE_OLED)
+//  #define FEATURE_IN_OLED_SCREEN_PORT FEATURE_IN_PORT3
+//     NOTE:  Set OLED_SCREEN_TIME in SmartRegulator.h to 0 to have the OLED stay on the screen picked, rather than keep stepping through them.
+
 //*************************************************************************************************************************************
 //*********************************************************************************************
 //*********      SELECT FEATURE_OUT TO USE    SELECT UP TO THREE    ***************************
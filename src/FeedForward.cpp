@@ -0,0 +1,279 @@
+//      FeedForward.cpp
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//*****************************************************************************************
+//
+//    Learns the steady-state Field PWM needed to produce a given Alternator Amps at a given
+//    Engine RPM, and uses that map to move the field directly to a new operating point
+//    when the RPMs or the Amps target change.   The PID engine in manage_ALT() then only
+//    needs to correct the (hopefully small) residual, instead of integrating its way there
+//    at PWM_CHANGE_CAP counts per PWM_CHANGE_RATE.
+//
+//*****************************************************************************************
+
+#include "Config.h"
+#include "System.h"
+#include "Alternator.h"
+#include "Sensors.h"
+#include "Flash.h"
+#include "FeedForward.h"
+
+tFFM ffMap;                 // Working copy of the learned map, checkpointed to EEPROM every so often by checkpoint_FFM()
+bool ffMapChanged = false;  // Has the map been updated since it was last saved?
+
+//------------------------------------------------------------------------------------------------------
+// Initialize Feed-Forward Map
+//      Called once during Startup.  Fetches the learned map from EEPROM, or if there is not a valid one
+//      saved, starts with an empty map (all points unlearned).
+//
+//------------------------------------------------------------------------------------------------------
+
+void initialize_FFM(void)
+{
+    if (read_FFM_EEPROM(&ffMap) != true)
+        memset(&ffMap, FF_UNLEARNED, sizeof(tFFM)); // Nothing saved (or it is corrupt), start learning from scratch.
+
+    ffMapChanged = false;
+} //initialize_FFM
+
+//-------       'helper' function used by lookup_FFM() and learn_FFM();
+//              Finds the grid cell that contains the passed RPMs / Amps, and the bilinear weights of its 4 corners.
+//              Corners are returned in the order [r][a], [r][a+1], [r+1][a], [r+1][a+1]
+static void FFM_corners(int RPMs, float amps, uint8_t *r, uint8_t *a, float *w)
+{
+    float fr;
+    float fa;
+
+    fr = constrain((float)RPMs / FF_RPM_STEP, 0.0, (float)(FF_RPM_BINS - 1));
+    fa = constrain(amps / FF_AMPS_STEP, 0.0, (float)(FF_AMPS_BINS - 1));
+
+    *r = min((int)fr, FF_RPM_BINS - 2); // Keep the cell inside the map, so the top edge is handled as fr (or fa) = 1.0
+    *a = min((int)fa, FF_AMPS_BINS - 2);
+    fr -= *r;
+    fa -= *a;
+
+    w[0] = (1.0 - fr) * (1.0 - fa);
+    w[1] = (1.0 - fr) * fa;
+    w[2] = fr * (1.0 - fa);
+    w[3] = fr * fa;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Lookup Feed-Forward Map
+//      Returns the interpolated steady-state Field PWM for the passed Engine RPMs and Alternator Amps,
+//      or -1 if any of the surrounding grid points that would contribute have not yet been learned.
+//
+//------------------------------------------------------------------------------------------------------
+
+int lookup_FFM(int RPMs, float amps)
+{
+    uint8_t r, a;
+    uint8_t cell;
+    float w[4];
+    float pwm = 0.0;
+
+    FFM_corners(RPMs, amps, &r, &a, w);
+
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        if (w[i] == 0.0)
+            continue; // This corner does not contribute, do not care if it is learned or not.
+
+        cell = ffMap.PWM[r + (i >> 1)][a + (i & 1)];
+        if (cell == FF_UNLEARNED)
+            return (-1);
+
+        pwm += w[i] * cell;
+    }
+
+    return ((int)(pwm + 0.5));
+} //lookup_FFM
+
+//-------       'helper' function used by manage_FFM();
+//              Moves the 4 corners surrounding the passed RPMs / Amps so the interpolated value heads towards the passed PWM,
+//              each corner in proportion to how much it contributes.  Unlearned corners are primed with the measured PWM
+//              as a 1st guess and then refined as more points are seen.
+static void learn_FFM(int RPMs, float amps, int PWM)
+{
+    uint8_t r, a;
+    uint8_t *cellPtr;
+    float w[4];
+    float pwm = 0.0;
+    float wSum = 0.0;
+    int newCell;
+
+    FFM_corners(RPMs, amps, &r, &a, w);
+
+    for (uint8_t i = 0; i < 4; i++)
+    { // 1st, what does the map predict today (using what we know of it)
+        cellPtr = &ffMap.PWM[r + (i >> 1)][a + (i & 1)];
+        if ((w[i] == 0.0) || (*cellPtr == FF_UNLEARNED))
+            continue;
+        pwm += w[i] * *cellPtr;
+        wSum += w[i];
+    }
+
+    if (wSum > 0.0)
+        pwm /= wSum;
+    else
+        pwm = PWM;
+
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        if (w[i] == 0.0)
+            continue;
+
+        cellPtr = &ffMap.PWM[r + (i >> 1)][a + (i & 1)];
+        if (*cellPtr == FF_UNLEARNED)
+            newCell = PWM;
+        else
+            newCell = *cellPtr + (int)((w[i] * (PWM - pwm) / FF_LEARN_RATE) + ((PWM > pwm) ? 0.5 : -0.5));
+
+        newCell = constrain(newCell, FF_UNLEARNED + 1, FIELD_PWM_MAX); // Do not let a learned point fall back to 'unlearned'
+
+        if (*cellPtr != newCell)
+        {
+            *cellPtr = newCell;
+            ffMapChanged = true;
+        }
+    }
+} //learn_FFM
+
+//------------------------------------------------------------------------------------------------------
+// Manage Feed-Forward
+//      Called from manage_ALT() each time the PID engine has calculated its PWM correction (passed in as PWMError,
+//      after all the PID loops have been combined and capped).  It returns an additional adjustment to be made to the
+//      Field PWM, based on how much the learned map says the steady-state PWM has moved since the last time:
+//
+//      -- If the RPMs have changed, how much must the field move to hold the current Amps at the new RPMs?
+//      -- If the Amps target has changed (ala, a set_charging_mode() into OC or Float with an Amps limit), how much
+//            must the field move to get to the new target at the current RPMs?
+//
+//      It also watches for the alternator to settle (the PID is making no real changes and the RPMs are steady) and
+//      when it does, learns the current Field PWM as the steady-state value for the current RPMs and Amps.
+//
+//------------------------------------------------------------------------------------------------------
+
+int manage_FFM(int PWMError)
+{
+    int static priorRPMs = 0;          // RPMs / Amps target of the last time the map was used to move the field.
+    float static priorTargetAmps = 0;
+    int static settleRPMs = 0;         // RPMs at the start of the current settling period.
+    uint8_t static settleCount = 0;    // How many PWM_CHANGE_RATE cycles the field has been steady.
+
+    int ffNow;
+    int ffPrior;
+    int ffAdj = 0;
+    float amps;
+
+    switch (chargingState)
+    { // Only use (and learn) the map while actively regulating.  Ramping, Alt-Cap sampling, Post-Float, etc all
+    case bulk_charge: //   drive the field on purpose in some other way.
+    case acceptance_charge:
+    case overcharge_charge:
+    case float_charge:
+    case forced_float_charge:
+    case equalize:
+        break;
+
+    default:
+        priorRPMs = 0;
+        settleCount = 0;
+        return (0);
+    }
+
+    if ((measuredRPMs == 0) || (shuntAltAmpsMeasured == false))
+    { // The map is indexed by RPMs and Amps, if we can not see both of them it is of no use.
+        priorRPMs = 0;
+        settleCount = 0;
+        return (0);
+    }
+
+    amps = max(measuredAltAmps, 0.0);
+
+    if (priorRPMs == 0)
+    { // Coming in fresh, just take note of where we are.
+        priorRPMs = measuredRPMs;
+        priorTargetAmps = targetAltAmps;
+    }
+
+    //--- Has the engine speed changed?   Use the current Amps for both, so we see only the effect of the RPMs.
+    ffNow = lookup_FFM(measuredRPMs, amps);
+    ffPrior = lookup_FFM(priorRPMs, amps);
+    if ((ffNow != -1) && (ffPrior != -1))
+        ffAdj = ffNow - ffPrior;
+
+    if ((ffAdj != 0) || (ffNow == -1) || (ffPrior == -1))
+        priorRPMs = measuredRPMs; // Move the reference point along only once there has been a whole PWM count of change, so slow drifts in RPMs still add up.
+
+    //--- Has the Amps target changed?   Only the part of the target below what we are producing now matters, as raising the target above
+    //      the present output changes nothing until the other limits (volts, watts, temp) let the PID raise the field.
+    if (targetAltAmps != priorTargetAmps)
+    {
+        ffNow = lookup_FFM(measuredRPMs, min(targetAltAmps, amps));
+        ffPrior = lookup_FFM(measuredRPMs, min(priorTargetAmps, amps));
+        if ((ffNow != -1) && (ffPrior != -1))
+            ffAdj += ffNow - ffPrior;
+
+        priorTargetAmps = targetAltAmps;
+    }
+
+    if ((ffAdj > 0) && (PWMError <= 0))
+        ffAdj = 0; // Only let the map RAISE the field if all the PID loops agree it should go up.  (Volts, Watts, and Temp limits keep priority)
+
+    ffAdj = min(ffAdj, FF_MAX_STEP); // And even then, not by too much at once.  (Note that, as with the PID, pulling down is not capped)
+
+    //--- Now see if things have settled down enough to learn from.
+    if ((ffAdj == 0) &&
+        (abs(PWMError) <= FF_SETTLE_BAND) &&
+        (abs(measuredRPMs - settleRPMs) <= FF_SETTLE_RPMS) &&
+        (amps >= USE_AMPS_THRESHOLD) &&
+        ((measuredBatVolts - targetBatVolts) <= (LD1_THRESHOLD * systemVoltMult))) // (If over-voltage, set_ALT_PWM() is not really sending fieldPWMvalue out)
+    {
+        if (++settleCount >= FF_SETTLE_COUNT)
+        {
+            learn_FFM(measuredRPMs, amps, fieldPWMvalue);
+            settleCount = 0;
+        }
+    }
+    else
+    {
+        settleCount = 0; // Things are moving, start the settling period over again.
+        settleRPMs = measuredRPMs;
+    }
+
+    return (ffAdj);
+} //manage_FFM
+
+//------------------------------------------------------------------------------------------------------
+// Checkpoint Feed-Forward Map
+//      Called from the Mainloop.  If the map has been updated, save it to EEPROM - but no more often than
+//      FF_CHECKPOINT_PERIOD to spare the EEPROM.  (Only the bytes that have changed are actually re-written)
+//
+//------------------------------------------------------------------------------------------------------
+
+void checkpoint_FFM(void)
+{
+    uint32_t static lastCheckpoint = 0;
+
+    if ((ffMapChanged == true) && ((millis() - lastCheckpoint) >= FF_CHECKPOINT_PERIOD))
+    {
+        write_FFM_EEPROM(&ffMap);
+        ffMapChanged = false;
+        lastCheckpoint = millis();
+    }
+} //checkpoint_FFM
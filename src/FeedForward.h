@@ -0,0 +1,38 @@
+//      FeedForward.h
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+
+#ifndef _FEEDFORWARD_H_
+#define _FEEDFORWARD_H_
+
+#include "Config.h"
+
+typedef struct
+{ // Feed-Forward Map - the steady-state Field PWM learned at each grid point of Engine RPMs x Alternator Amps.  Saved in EEPROM.
+    uint8_t PWM[FF_RPM_BINS][FF_AMPS_BINS]; // Grid point [r][a] is at (r * FF_RPM_STEP) RPMs and (a * FF_AMPS_STEP) Amps.
+                                            // FF_UNLEARNED = we have not yet seen the alternator settle near this point.
+} tFFM;
+
+extern tFFM ffMap;
+
+void initialize_FFM(void);
+int lookup_FFM(int RPMs, float amps);
+int manage_FFM(int PWMError);
+void checkpoint_FFM(void);
+
+#endif // _FEEDFORWARD_H_
@@ -24,6 +24,16 @@
 
 #include "Flash.h"
 
+static_assert((STG_FLAG_LOCATION + 1) <= (E2END + 1), "EEPROM - no room left for the Config Backup staging area");
+static_assert((LIFE_FLASH_LOCATION + sizeof(tLKEY) + sizeof(tLIFE)) <= (E2END + 1), "EEPROM - no room left for the Lifetime statistics");
+
+#define BKS_IDLE  0                                                                     // bkState - What update_BK_image() is doing
+#define BKS_CHUNK 1                                                                     //   Writing a chunk of the image into STG
+#define BKS_KEY   2                                                                     //   Writing the new EKEY into STG, behind the image
+#define BKS_COPY  3                                                                     //   Copying the image, and then its EKEY, into place
+
+static uint8_t bkState = BKS_IDLE;                                                      // $BKL: Config Backup image being staged / put in place, see update_BK_image()
+
 //------------------------------------------------------------------------------------------------------
 // CRC-32
 //
@@ -110,6 +120,8 @@ void write_SCS_EEPROM(tSCS *scsPtr) {
 
    tEKEY  key;                                                                          // Structure used to see validate the presence of saved data.
 
+   if (bkState >= BKS_KEY)                                                              // A Config Backup is being put in place, its EKEY would undo this.
+        return;
  
    eeprom_read_block((void *)&key, (void *) EKEY_FLASH_LOCATION  , sizeof(tEKEY));      // Fetch the EKEY structure from EEPROM to update appropriate portions
 
@@ -190,6 +202,8 @@ void write_CPS_EEPROM(uint8_t index, tCPS *cpsPtr) {
 
    tEKEY  key;                                                                          // Structure used to see validate the presence of saved data.
 
+   if (bkState >= BKS_KEY)                                                              // A Config Backup is being put in place, its EKEY would undo this.
+        return;
  
    eeprom_read_block((void *)&key, (void *) EKEY_FLASH_LOCATION  , sizeof(tEKEY));      // Fetch the EKEY structure from EEPROM to update appropriate portions
 
@@ -287,6 +301,8 @@ void write_CAL_EEPROM(tCAL *calPtr) {
 
    tEKEY  key;                                                                          // Structure used to see validate the presence of saved data.
 
+   if (bkState >= BKS_KEY)                                                              // A Config Backup is being put in place, its EKEY would undo this.
+        return;
  
    eeprom_read_block((void *)&key, (void *) EKEY_FLASH_LOCATION  , sizeof(tEKEY));      // Fetch the EKEY structure from EEPROM to update appropriate portions
 
@@ -311,6 +327,442 @@ void write_CAL_EEPROM(tCAL *calPtr) {
 }
 
 
+//------------------------------------------------------------------------------------------------------
+// Read / Write Learned table EEPROM
+//
+//      'helper' functions for the learned tables, which each keep their own tLKEY directly in front of the
+//      table in EEPROM.   read_LRN_EEPROM() copies the saved table into the passed buffer, and returns TRUE if
+//      the keys and CRC check out.  (If FALSE is returned, the contents of the buffer are undefined and
+//      the caller should re-initialize it)
+//      write_LRN_EEPROM() uses eeprom_update_block(), so only bytes that have changed since the last
+//      checkpoint are actually written.  If NULL is passed in for the data pointer, the saved table is invalidated.
+//
+//------------------------------------------------------------------------------------------------------
+
+static bool read_LRN_EEPROM(unsigned location, unsigned ID1, unsigned ID2, uint8_t *ptr, int size) {
+
+   tLKEY  key;
+
+   eeprom_read_block((void *)&key, (const void *)location, sizeof(tLKEY));
+
+   if  ((key.ID1 != ID1) || (key.ID2 != ID2))
+        return(false);
+
+   eeprom_read_block((void *)ptr, (const void *)(location + sizeof(tLKEY)), size);
+
+   return(calc_crc (ptr, size) == key.CRC32);
+}
+
+
+static void write_LRN_EEPROM(unsigned location, unsigned ID1, unsigned ID2, uint8_t *ptr, int size) {
+
+   tLKEY  key;
+
+  if (ptr != NULL) {
+        key.ID1 = ID1;                                                                  // Put in validation tokens
+        key.ID2 = ID2;
+        key.CRC32 = calc_crc (ptr, size);
+        eeprom_update_block((void*)ptr, (void *)(location + sizeof(tLKEY)), size);
+        }
+
+  else  {
+        key.ID1 = 0;                                                                    // Invalidate the saved table
+        key.ID2 = 0;
+        key.CRC32 = 0;
+        }
+
+  eeprom_update_block((void *)&key, (void *)location, sizeof(tLKEY));                   // Key goes last, so a partial write is never seen as valid.
+}
+
+
+bool read_FFM_EEPROM(tFFM *ffmPtr) {
+
+   return(read_LRN_EEPROM(FFM_FLASH_LOCATION, FFM_ID1_K, FFM_ID2_K, (uint8_t*)ffmPtr, sizeof(tFFM)));
+}
+
+
+void write_FFM_EEPROM(tFFM *ffmPtr) {
+
+   write_LRN_EEPROM(FFM_FLASH_LOCATION, FFM_ID1_K, FFM_ID2_K, (uint8_t*)ffmPtr, sizeof(tFFM));
+}
+
+
+bool read_ACC_EEPROM(tACC *accPtr) {
+
+   return(read_LRN_EEPROM(ACC_FLASH_LOCATION, ACC_ID1_K, ACC_ID2_K, (uint8_t*)accPtr, sizeof(tACC)));
+}
+
+
+void write_ACC_EEPROM(tACC *accPtr) {
+
+   write_LRN_EEPROM(ACC_FLASH_LOCATION, ACC_ID1_K, ACC_ID2_K, (uint8_t*)accPtr, sizeof(tACC));
+}
+
+
+bool read_GST_EEPROM(tGST *gstPtr) {
+
+   return(read_LRN_EEPROM(GST_FLASH_LOCATION, GST_ID1_K, GST_ID2_K, (uint8_t*)gstPtr, sizeof(tGST)));
+}
+
+
+void write_GST_EEPROM(tGST *gstPtr) {
+
+   write_LRN_EEPROM(GST_FLASH_LOCATION, GST_ID1_K, GST_ID2_K, (uint8_t*)gstPtr, sizeof(tGST));
+}
+
+
+bool read_SUB_EEPROM(tSUB *subPtr) {
+
+   return(read_LRN_EEPROM(SUB_FLASH_LOCATION, SUB_ID1_K, SUB_ID2_K, (uint8_t*)subPtr, sizeof(tSUB)));
+}
+
+
+void write_SUB_EEPROM(tSUB *subPtr) {
+
+   write_LRN_EEPROM(SUB_FLASH_LOCATION, SUB_ID1_K, SUB_ID2_K, (uint8_t*)subPtr, sizeof(tSUB));
+}
+
+
+bool read_LIFE_EEPROM(tLIFE *lifePtr) {
+
+   return(read_LRN_EEPROM(LIFE_FLASH_LOCATION, LIFE_ID1_K, LIFE_ID2_K, (uint8_t*)lifePtr, sizeof(tLIFE)));
+}
+
+
+void write_LIFE_EEPROM(tLIFE *lifePtr) {
+
+   write_LRN_EEPROM(LIFE_FLASH_LOCATION, LIFE_ID1_K, LIFE_ID2_K, (uint8_t*)lifePtr, sizeof(tLIFE));
+}
+
+
+//------------------------------------------------------------------------------------------------------
+// Read / Write / Commit Config Backup image
+//
+//      The image (see tBKImage in Flash.h) is too big to hold in RAM, so these pass it along a chunk at a time - each call
+//      must pick up where the last one left off, and offset 0 starts over.
+//
+//      read_BK_image() fills the passed buffer with the next (up to) len bytes of the image, taking each structure from
+//      its saved copy in EEPROM or, if there is none, from what is being used in its place.  Returns how many it filled,
+//      0 = the whole image has been read out.
+//
+//      write_BK_image() takes the next len bytes of an image, to go into the STG area of the EEPROM, and returns FALSE if they
+//      are not the next ones, run past its end, or the last ones are still going in.  update_BK_image() (called each Mainloop pass
+//      while a load is going on) writes them out BK_EEPROM_STEP bytes at a time, and returns TRUE once nothing is left to do.
+//
+//      Once all of it is in, commit_BK_image() checks it over and starts putting it in place - saving every structure the image
+//      had saved, and invalidating the rest.  (A factory LOCKED calibration is left as-is)  Returns FALSE, changing nothing, if
+//      the image is incomplete, damaged, or from an incompatible build.   It is put in place in steps, again by update_BK_image():
+//          - The EKEY structure for the new configuration is staged behind the image.
+//          - The STG flag byte is set.  This single byte is the commit:  until it is written the old configuration is untouched,
+//            and from then on the image will be put in place, even if that is cut short.
+//          - The structures are copied into place, then the staged EKEY - and the flag is cleared.
+//      resume_BK_image() (called at Startup, before anything is read from EEPROM) finishes putting in place one that was cut short.
+//
+//------------------------------------------------------------------------------------------------------
+
+static tBKHDR   bkHeader;                                                               // Header of the image being read out
+static unsigned bkReadNext = 0;                                                         //   offset of the next byte of it to be read
+static uint32_t bkReadCRC;                                                              //   and the CRC-32 of those before it
+static unsigned bkWriteNext = 0;                                                        // Same, for the image being written
+static uint32_t bkWriteCRC;
+static unsigned bkChunkAt;                                                              // Where in the image the chunk being staged goes
+static unsigned bkStepAt;                                                               // update_BK_image() - Where it is up to
+static unsigned bkStepEnd;                                                              //   and where it stops
+static uint8_t  bkFlag;                                                                 //   the STG flag (BK_COMMIT_xxx) once set
+static union {                                                                          //   and what it is writing from:
+   uint8_t chunk[BT_BACKUP_CHUNK];                                                      //     The chunk of the image being staged,
+   tEKEY   key;                                                                         //     then the EKEY it will be put in place with.
+   } bkBuf;
+
+
+//-------       'helper' function used by read_BK_image();  Returns byte 'at' of the image, from wherever that part of it is kept.
+static uint8_t BK_image_byte(unsigned at) {
+
+   uint8_t index;
+
+   if (at < offsetof(tBKImage, CAL))
+        return(((uint8_t*)&bkHeader)[at]);
+
+   if (at < offsetof(tBKImage, CPS)) {
+        at -= offsetof(tBKImage, CAL);
+        return((bkHeader.SAVED & BKI_CAL) ? eeprom_read_byte((const uint8_t *)(CAL_FLASH_LOCATION + at)) : ((uint8_t*)&ADCCal)[at]);
+        }
+
+   if (at < offsetof(tBKImage, SCS)) {
+        at -= offsetof(tBKImage, CPS);
+        index = at / sizeof(tCPS);                                                      // (CPS_FLASH_LOCATION needs it to be called 'index')
+        at %= sizeof(tCPS);
+        if (bkHeader.SAVED & (1U << index))
+            return(eeprom_read_byte((const uint8_t *)(CPS_FLASH_LOCATION + at)));
+        return(pgm_read_byte_near((const uint8_t*)&defaultCPS[index] + at));
+        }
+
+   at -= offsetof(tBKImage, SCS);
+   return((bkHeader.SAVED & BKI_SCS) ? eeprom_read_byte((const uint8_t *)(SCS_FLASH_LOCATION + at)) : ((uint8_t*)&systemConfig)[at]);
+}
+
+
+uint8_t read_BK_image(unsigned offset, uint8_t *buf, uint8_t len) {
+
+   uint8_t  n;
+   tCPS     cps;
+   tSCS     scs;
+   tCAL     cal;
+
+   if (offset == 0) {                                                                   // Starting a new one, see what has been saved as of now.
+        bkHeader.ID1   = BK_ID1_K;
+        bkHeader.ID2   = BK_ID2_K;
+        bkHeader.SIZE  = sizeof(tBKImage);
+        bkHeader.SAVED = 0;
+        for (n=0; n<MAX_CPES; n++)
+            if (read_CPS_EEPROM(n, &cps))   bkHeader.SAVED |= (1U << n);
+        if (read_SCS_EEPROM(&scs))          bkHeader.SAVED |= BKI_SCS;
+        if (read_CAL_EEPROM(&cal))          bkHeader.SAVED |= BKI_CAL;
+        bkReadNext = 0;
+        bkReadCRC  = ~0L;
+        }
+
+   if (offset != bkReadNext)
+        return(0);
+
+   for (n=0; (n < len) && (bkReadNext < sizeof(tBKImage)); n++, bkReadNext++) {
+        if (bkReadNext < offsetof(tBKImage, CRC32)) {
+            buf[n]    = BK_image_byte(bkReadNext);
+            bkReadCRC = crc_update(bkReadCRC, buf[n]);
+            }
+        else
+            buf[n] = (uint8_t)(~bkReadCRC >> (8 * (bkReadNext - offsetof(tBKImage, CRC32))));   // And the CRC-32 (as calc_crc() would have given it) to finish.
+        }
+
+   return(n);
+}
+
+
+bool write_BK_image(unsigned offset, const uint8_t *buf, uint8_t len) {
+
+   if (bkState != BKS_IDLE)
+        return(false);
+
+   if (offset == 0) {
+        bkWriteNext = 0;
+        bkWriteCRC  = ~0L;
+        }
+
+   if ((offset != bkWriteNext) || ((offset + len) > sizeof(tBKImage)) || (len > sizeof(bkBuf.chunk)))
+        return(false);
+
+   memcpy(bkBuf.chunk, buf, len);
+   bkChunkAt = offset;
+   bkStepAt  = 0;
+   bkStepEnd = len;
+   bkState   = BKS_CHUNK;
+
+   for (uint8_t n=0; n<len; n++, bkWriteNext++)
+        if (bkWriteNext < offsetof(tBKImage, CRC32))
+            bkWriteCRC = crc_update(bkWriteCRC, buf[n]);
+
+   return(true);
+}
+
+
+bool commit_BK_image(void) {
+
+   tBKHDR   hdr;
+   tEKEY    key;
+   tCPS     cps;
+   tSCS     scs;
+   tCAL     cal;
+   uint32_t crc;
+   uint8_t  index;
+
+   if (bkState != BKS_IDLE)
+        return(false);
+
+   eeprom_read_block((void *)&hdr, (const void *)(STG_FLASH_LOCATION + offsetof(tBKImage, HDR)), sizeof(tBKHDR));
+   eeprom_read_block((void *)&crc, (const void *)(STG_FLASH_LOCATION + offsetof(tBKImage, CRC32)), sizeof(uint32_t));
+
+   if ((bkWriteNext != sizeof(tBKImage)) || (crc != ~bkWriteCRC) ||                               // All of it in, and not damaged on the way?
+       (hdr.ID1 != BK_ID1_K) || (hdr.ID2 != BK_ID2_K) || (hdr.SIZE != sizeof(tBKImage)))//   And from a build with the same structures as ours?
+        return(false);
+
+   bkWriteCRC = ~0L;                                                                    // And did it all make it into the EEPROM?
+   for (unsigned at=0; at<offsetof(tBKImage, CRC32); at++)
+        bkWriteCRC = crc_update(bkWriteCRC, eeprom_read_byte((const uint8_t *)(STG_FLASH_LOCATION + at)));
+   if (crc != ~bkWriteCRC)
+        return(false);
+
+   bkWriteNext = 0;                                                                     // (Only commit it once)
+   eeprom_read_block((void *)&key, (const void *)EKEY_FLASH_LOCATION, sizeof(tEKEY));
+
+   for (index=0; index<MAX_CPES; index++) {
+        if (hdr.SAVED & (1U << index)) {
+            eeprom_read_block((void*)&cps, (const void *)(STG_FLASH_LOCATION + offsetof(tBKImage, CPS) + (sizeof(tCPS) * index)), sizeof(tCPS));
+            memcpy_P(&cps.BATTERY_TYPE, &defaultCPS[index].BATTERY_TYPE, sizeof(cps.BATTERY_TYPE));  // (Points into FLASH, so must be our own - see BK_put_byte())
+            key.CPS_ID1[index]   = CPS_ID1_K;
+            key.CPS_ID2[index]   = CPS_ID2_K;
+            key.CPS_CRC32[index] = calc_crc ((uint8_t*)&cps, sizeof(tCPS));
+            }
+        else  {
+            key.CPS_ID1[index]   = 0;
+            key.CPS_ID2[index]   = 0;
+            key.CPS_CRC32[index] = 0;
+            }
+        }
+
+   if (hdr.SAVED & BKI_SCS) {
+        eeprom_read_block((void*)&scs, (const void *)(STG_FLASH_LOCATION + offsetof(tBKImage, SCS)), sizeof(tSCS));
+        key.SCS_ID1   = SCS_ID1_K;
+        key.SCS_ID2   = SCS_ID2_K;
+        key.SCS_CRC32 = calc_crc ((uint8_t*)&scs, sizeof(tSCS));
+        }
+   else  {
+        key.SCS_ID1   = 0;
+        key.SCS_ID2   = 0;
+        key.SCS_CRC32 = 0;
+        }
+
+   bkFlag = BK_COMMIT_K;
+   if (ADCCal.LOCKED != true) {                                                         // Calibration is board specific, never replace a factory locked one.
+        if (hdr.SAVED & BKI_CAL) {
+            eeprom_read_block((void*)&cal, (const void *)(STG_FLASH_LOCATION + offsetof(tBKImage, CAL)), sizeof(tCAL));
+            key.CAL_ID1   = CAL_ID1_K;
+            key.CAL_ID2   = CAL_ID2_K;
+            key.CAL_CRC32 = calc_crc ((uint8_t*)&cal, sizeof(tCAL));
+            bkFlag |= BK_COMMIT_CAL;
+            }
+        else  {
+            key.CAL_ID1   = 0;
+            key.CAL_ID2   = 0;
+            key.CAL_CRC32 = 0;
+            }
+        }
+
+   bkBuf.key = key;                                                                     // update_BK_image() takes it from here.
+   bkStepAt  = 0;
+   bkStepEnd = sizeof(tEKEY);
+   bkState   = BKS_KEY;
+
+   return(true);
+}
+
+
+//-------       'helper' functions used by update_BK_image() and resume_BK_image();
+//              Write one byte of EEPROM, if it is not already that.  Returns TRUE if it had to be written.
+static bool BK_update_byte(unsigned at, uint8_t b) {
+
+   if (eeprom_read_byte((const uint8_t *)at) == b)
+        return(false);
+
+   eeprom_write_byte((uint8_t *)at, b);                                                 // (Returns as soon as the write is started)
+   return(true);
+}
+
+//              Puts byte 'at' of the staged image into place - or for 'at' past its CAL / CPS / SCS, byte 'at' of the staged EKEY
+//              which follows them.  Structures the image did not have saved are left as they are, the new EKEY invalidates them.
+//              Returns TRUE if a byte had to be written.
+static bool BK_put_byte(unsigned at, uint8_t flag) {
+
+   unsigned saved;
+   uint8_t  index;
+   uint8_t  b;
+
+   if (at >= offsetof(tBKImage, CRC32)) {
+        at -= offsetof(tBKImage, CRC32);
+        return(BK_update_byte(EKEY_FLASH_LOCATION + at, eeprom_read_byte((const uint8_t *)(STG_KEY_LOCATION + at))));
+        }
+
+   b     = eeprom_read_byte((const uint8_t *)(STG_FLASH_LOCATION + at));
+   saved = eeprom_read_word((const uint16_t *)(STG_FLASH_LOCATION + offsetof(tBKImage, HDR) + offsetof(tBKHDR, SAVED)));
+
+   if (at < offsetof(tBKImage, CPS)) {
+        if ((flag & BK_COMMIT_CAL) == 0)
+            return(false);
+        return(BK_update_byte(CAL_FLASH_LOCATION + (at - offsetof(tBKImage, CAL)), b));
+        }
+
+   if (at < offsetof(tBKImage, SCS)) {
+        at -= offsetof(tBKImage, CPS);
+        index = at / sizeof(tCPS);                                                      // (CPS_FLASH_LOCATION needs it to be called 'index')
+        at %= sizeof(tCPS);
+        if ((saved & (1U << index)) == 0)
+            return(false);
+        if ((at >= offsetof(tCPS, BATTERY_TYPE)) && (at < (offsetof(tCPS, BATTERY_TYPE) + sizeof(defaultCPS[0].BATTERY_TYPE))))
+            b = pgm_read_byte_near((const uint8_t*)&defaultCPS[index] + at);           // Points into FLASH, so must be our own.
+        return(BK_update_byte(CPS_FLASH_LOCATION + at, b));
+        }
+
+   if ((saved & BKI_SCS) == 0)
+        return(false);
+   return(BK_update_byte(SCS_FLASH_LOCATION + (at - offsetof(tBKImage, SCS)), b));
+}
+
+
+bool update_BK_image(void) {
+
+   uint8_t written = 0;
+
+   while ((bkState != BKS_IDLE) && (written < BK_EEPROM_STEP)) {
+        if (bkStepAt >= bkStepEnd) {                                                    // Done with this step, on to the next.
+            switch (bkState) {
+                case BKS_KEY:                                                           // New EKEY is staged, now commit to putting the image in place . .
+                    BK_update_byte(STG_FLAG_LOCATION, bkFlag);
+                    written++;
+                    bkStepAt  = offsetof(tBKImage, CAL);
+                    bkStepEnd = offsetof(tBKImage, CRC32) + sizeof(tEKEY);
+                    bkState   = BKS_COPY;
+                    break;
+
+                case BKS_COPY:                                                          //  . . and once it is, it is done.
+                    BK_update_byte(STG_FLAG_LOCATION, 0xFF);
+                    written++;
+                    bkState = BKS_IDLE;
+                    break;
+
+                default:
+                    bkState = BKS_IDLE;
+                    break;
+                }
+            continue;
+            }
+
+        switch (bkState) {
+            case BKS_CHUNK:
+                if (BK_update_byte(STG_FLASH_LOCATION + bkChunkAt + bkStepAt, bkBuf.chunk[bkStepAt]))
+                    written++;
+                break;
+
+            case BKS_KEY:
+                if (BK_update_byte(STG_KEY_LOCATION + bkStepAt, ((uint8_t *)&bkBuf.key)[bkStepAt]))
+                    written++;
+                break;
+
+            default:
+                if (BK_put_byte(bkStepAt, bkFlag))
+                    written++;
+                break;
+            }
+        bkStepAt++;
+        }
+
+   return(bkState == BKS_IDLE);
+}
+
+
+void resume_BK_image(void) {
+
+   uint8_t flag;
+
+   flag = eeprom_read_byte((const uint8_t *)STG_FLAG_LOCATION);
+   if ((flag & ~BK_COMMIT_CAL) != BK_COMMIT_K)
+        return;                                                                         // Nothing was being put in place.
+
+   for (unsigned at=offsetof(tBKImage, CAL); at<(offsetof(tBKImage, CRC32) + sizeof(tEKEY)); at++)
+        BK_put_byte(at, flag);                                                          // (Starting it over from the top does no harm, it is all the same bytes)
+
+   BK_update_byte(STG_FLAG_LOCATION, 0xFF);
+}
+
+
 //------------------------------------------------------------------------------------------------------
 // Restore All
 //
@@ -330,6 +782,11 @@ void    restore_all(){
 
      for (b=0; b<MAX_CPES; b++) 
         write_CPS_EEPROM(b, NULL);                        // Erase any saved charge profiles structures in the EEPROM
+
+     write_FFM_EEPROM(NULL);                              // And forget anything we have learned about the alternator.
+     write_ACC_EEPROM(NULL);
+     write_GST_EEPROM(NULL);                              // Back to the default Gain Schedule.
+     write_SUB_EEPROM(NULL);                              //   and status Subscriptions.
     
      reboot();                                            // And FORCE the system to reset - we will never come back from here!
    }
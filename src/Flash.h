@@ -26,19 +26,39 @@
 #include "Config.h" // Pick up the specific structures and their sizes for this program.
 #include "Sensors.h"
 #include "CPE.h"
+#include "FeedForward.h"
+#include "Alternator.h"
+#include "GainSchedule.h"
+#include "OSEnergy_Serial.h"
 
 void transfer_default_CPS(uint8_t index, tCPS *cpsPtr);
 void write_CPS_EEPROM(uint8_t index, tCPS *cpsPtr);
 void write_SCS_EEPROM(tSCS *scsPtr);
 void write_CAL_EEPROM(tCAL *calPtr);
+void write_FFM_EEPROM(tFFM *ffmPtr);
+void write_ACC_EEPROM(tACC *accPtr);
+void write_GST_EEPROM(tGST *gstPtr);
+void write_SUB_EEPROM(tSUB *subPtr);
+void write_LIFE_EEPROM(tLIFE *lifePtr);
 
 bool read_CPS_EEPROM(uint8_t index, tCPS *cpsPtr);
 bool read_SCS_EEPROM(tSCS *scsPtr);
 bool read_CAL_EEPROM(tCAL *calPtr);
+bool read_FFM_EEPROM(tFFM *ffmPtr);
+bool read_ACC_EEPROM(tACC *accPtr);
+bool read_GST_EEPROM(tGST *gstPtr);
+bool read_SUB_EEPROM(tSUB *subPtr);
+bool read_LIFE_EEPROM(tLIFE *lifePtr);
 
 void restore_all(void);
 void commit_EEPROM(void);
 
+uint8_t read_BK_image(unsigned offset, uint8_t *buf, uint8_t len);
+bool write_BK_image(unsigned offset, const uint8_t *buf, uint8_t len);
+bool commit_BK_image(void);
+bool update_BK_image(void);
+void resume_BK_image(void);
+
 //----- The following are used during the management of the EEPROM, to validate saved data
 //      If a structure format is changed, change these keys to help invalidate prior saved data in the CPU.
 //      Note:  All CRC values changed in v1.2.0, all structeures expanded to include reserve space.
@@ -49,6 +69,24 @@ void commit_EEPROM(void);
 #define CPS_ID2_K 0x0A47 // (Changed in 0.2.0 - as CPS was expanded)
 #define CAL_ID1_K 0xF9AC // Calibration Structure
 #define CAL_ID2_K 0x0A97
+#define FFM_ID1_K 0x5E21 // Learned Feed-Forward Map
+#define FFM_ID2_K 0x0B36
+#define ACC_ID1_K 0xA7C2 // Alternator Capability Curve
+#define ACC_ID2_K 0x1D58
+#define GST_ID1_K 0x3B6E // User modified Gain Schedule
+#define GST_ID2_K 0x0C19
+#define SUB_ID1_K 0x4D2A // Serial status Subscriptions
+#define SUB_ID2_K 0x0D71
+#define LIFE_ID1_K 0x2E95 // Lifetime statistics
+#define LIFE_ID2_K 0x61D4
+#define BK_ID1_K 0x5B3E  // Config Backup image  ($BKS / $BKL)
+#define BK_ID2_K (SCS_ID2_K ^ CPS_ID2_K ^ CAL_ID2_K) //   Changes along with the structures in it, so an image from a build they differ in is refused.
+#define BK_COMMIT_K 0xC0 // STG flag byte - a checked image (and its EKEY) is staged and being put in place.  (Never 0xFF, as erased EEPROM reads)
+#define BK_COMMIT_CAL 0x01 //   and its CAL is to be put in place too.   (Not if it was not saved, or ours is factory LOCKED)
+
+#define BK_EEPROM_STEP 1 // $BKL:  EEPROM bytes update_BK_image() changes per Mainloop pass.  The AVR carries on while a byte is being written (~3.4mS),
+                         //   so at one a pass the Mainloop is never held up for longer than that - rather than the 220mS a whole chunk took,
+                         //   and ~3 seconds to put an image in place.
 
 //-----  EEPROM is laid out in this way:  (I was not able to get #defines to work, as the preprocessor seems to not be able to handle sizeof() )
 //       CAL is placed 1st in hopes it will not be invalidated as revs change.
@@ -59,12 +97,30 @@ void commit_EEPROM(void);
 //          Reserved / expansion space (oritionaly 32 bytes)
 //          CPS
 //          SCS
-//          CCS
+//          Reserved / expansion space (32 bytes)
+//          Learned tables - these change on their own while running, so each carries its own tLKEY in front of it
+//             rather than being in the EKEY structure.  (Saves re-writing EKEY each time one is checkpointed)
+//              FFM
+//              ACC
+//              GST   (Not learned, but the user may change it any time via $GSS - so it is kept the same way)
+//              SUB   (Same, via $SUB)
+//          STG   Staging area for a Config Backup image being loaded via $BKL.  Only copied into place (CAL, CPS, SCS) once all
+//                of it is in and checks out.  Followed by the EKEY structure it is to be put in place with, and the commit flag byte.
+//          LIFE  Lifetime statistics, with its own tLKEY as the learned tables.  (After STG, so adding it moved nothing already saved)
 
 #define EKEY_FLASH_LOCATION 0
 #define CAL_FLASH_LOCATION (sizeof(tEKEY))
 #define CPS_FLASH_LOCATION (sizeof(tEKEY) + sizeof(tCAL) + 32 + (sizeof(tCPS) * index))
 #define SCS_FLASH_LOCATION (sizeof(tEKEY) + sizeof(tCAL) + 32 + (sizeof(tCPS) * MAX_CPES))
+#define LRN_FLASH_LOCATION (SCS_FLASH_LOCATION + sizeof(tSCS) + 32)
+#define FFM_FLASH_LOCATION (LRN_FLASH_LOCATION)
+#define ACC_FLASH_LOCATION (FFM_FLASH_LOCATION + sizeof(tLKEY) + sizeof(tFFM))
+#define GST_FLASH_LOCATION (ACC_FLASH_LOCATION + sizeof(tLKEY) + sizeof(tACC))
+#define SUB_FLASH_LOCATION (GST_FLASH_LOCATION + sizeof(tLKEY) + sizeof(tGST))
+#define STG_FLASH_LOCATION (SUB_FLASH_LOCATION + sizeof(tLKEY) + sizeof(tSUB))
+#define STG_KEY_LOCATION (STG_FLASH_LOCATION + sizeof(tBKImage))
+#define STG_FLAG_LOCATION (STG_KEY_LOCATION + sizeof(tEKEY))
+#define LIFE_FLASH_LOCATION (STG_FLAG_LOCATION + 1)
 
 #
 
@@ -84,4 +140,33 @@ typedef struct
 
 } tEKEY;
 
+typedef struct
+{ // Learned table Key Structure - placed in EEPROM directly ahead of each learned table.
+   unsigned ID1;
+   unsigned ID2;
+   uint32_t CRC32;
+} tLKEY;
+
+#define BKI_SCS (1U << MAX_CPES) // tBKHDR.SAVED bits - [n] is CPS n, and these two
+#define BKI_CAL (1U << (MAX_CPES + 1))
+
+typedef struct
+{ // Config Backup image header
+   unsigned ID1;   // BK_ID1_K
+   unsigned ID2;   // BK_ID2_K
+   unsigned SIZE;  // sizeof(tBKImage)
+   unsigned SAVED; // BKI_xxx bits set = that structure had been saved in EEPROM.  If not the image holds what was being used in its
+                   //   place (default CPS, current SCS / CAL), and loading it puts the target back to using its own defaults.
+} tBKHDR;
+
+typedef struct
+{ // Config Backup image - the whole configuration, as sent by $BKS and taken back by $BKL.  Never held in RAM all at once, it is
+  //   read out and staged a chunk at a time.  (See read_BK_image() / write_BK_image() in Flash.cpp)
+   tBKHDR HDR;
+   tCAL CAL;
+   tCPS CPS[MAX_CPES];
+   tSCS SCS;
+   uint32_t CRC32; // CRC-32 of all of the above
+} tBKImage;
+
 #endif //_FLASH_H_
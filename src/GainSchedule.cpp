@@ -0,0 +1,97 @@
+//      GainSchedule.cpp
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//*****************************************************************************************
+//
+//    Gain scheduling for the PID engine in manage_ALT().   The gain from Field PWM to Alternator Amps
+//    is several times higher at cruise RPMs than it is at idle, and rises again as the alternator
+//    heats up - so a single set of PID gains is either sluggish at idle or oscillates at speed.
+//    Here we keep a small table of multipliers for the V, A, and W loop gains, indexed by Engine RPMs
+//    and Alternator Temperature, and interpolate it each time the PID engine runs.
+//
+//*****************************************************************************************
+
+#include "Config.h"
+#include "System.h"
+#include "Flash.h"
+#include "GainSchedule.h"
+
+const tGST PROGMEM defaultGST = {{
+    //  20C  60C 100C         (GS_MULT_ONE = 64 = 1.0x)
+    {   80,  88,  96 },    //    0 RPMs  -  Idle, little response from the alternator; push harder.
+    {   80,  84,  88 },    //  800 RPMs
+    {   64,  68,  72 },    // 1600 RPMs  -  Around where the fixed gains were originally tuned.
+    {   48,  52,  56 },    // 2400 RPMs  -  Cruise, a small change in PWM is a large change in Amps; back off.
+    {   40,  44,  48 }     // 3200 RPMs  (and faster)
+}};
+
+tGST gainSchedule; // Working copy of the Gain Schedule, may be changed via the $GSS command.
+
+//------------------------------------------------------------------------------------------------------
+// Initialize Gain Schedule
+//      Called once during Startup.  Fetches a user modified schedule from EEPROM, or if there is not a valid one
+//      saved, uses the default one from FLASH.
+//
+//------------------------------------------------------------------------------------------------------
+
+void initialize_GST(void)
+{
+    if (read_GST_EEPROM(&gainSchedule) != true)
+        transfer_default_GST(&gainSchedule);
+} //initialize_GST
+
+void transfer_default_GST(tGST *gstPtr)
+{
+    uint8_t *wp = (uint8_t *)gstPtr;
+    uint8_t *ep = (uint8_t *)&defaultGST; //----- Copy the default Gain Schedule from FLASH into the working structure
+
+    for (unsigned int u = 0; u < sizeof(tGST); u++)
+        *wp++ = (uint8_t)pgm_read_byte_near(ep++);
+} //transfer_default_GST
+
+//------------------------------------------------------------------------------------------------------
+// Gain Schedule Multiplier
+//      Returns the bilinear interpolated gain multiplier for the passed Engine RPMs and Alternator Temperature.
+//      If we can not see the RPMs (ala, no stator signal) or the temperature (no sensor), there is nothing to
+//      schedule against and 1.0 is returned - leaving the PID gains as they were always tuned.
+//
+//------------------------------------------------------------------------------------------------------
+
+float gain_schedule_mult(int RPMs, int altTemp)
+{
+    float fr;
+    float ft;
+    uint8_t r, t;
+    float lo, hi;
+
+    if ((RPMs == 0) || (altTemp <= -99))
+        return (1.0);
+
+    fr = constrain((float)RPMs / GS_RPM_STEP, 0.0, (float)(GS_RPM_BINS - 1));
+    ft = constrain((float)(altTemp - GS_TEMP_MIN) / GS_TEMP_STEP, 0.0, (float)(GS_TEMP_BINS - 1));
+
+    r = min((int)fr, GS_RPM_BINS - 2); // Keep the cell inside the table, so the top edge is handled as fr (or ft) = 1.0
+    t = min((int)ft, GS_TEMP_BINS - 2);
+    fr -= r;
+    ft -= t;
+
+    lo = gainSchedule.MULT[r][t] + ft * (gainSchedule.MULT[r][t + 1] - gainSchedule.MULT[r][t]);
+    hi = gainSchedule.MULT[r + 1][t] + ft * (gainSchedule.MULT[r + 1][t + 1] - gainSchedule.MULT[r + 1][t]);
+
+    return ((lo + fr * (hi - lo)) / GS_MULT_ONE);
+} //gain_schedule_mult
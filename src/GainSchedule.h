@@ -0,0 +1,38 @@
+//      GainSchedule.h
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+
+#ifndef _GAINSCHEDULE_H_
+#define _GAINSCHEDULE_H_
+
+#include "Config.h"
+
+typedef struct
+{ // Gain Schedule - multipliers applied to the V, A, and W PID gains at each grid point of Engine RPMs x Alternator Temperature.  Saved in EEPROM.
+    uint8_t MULT[GS_RPM_BINS][GS_TEMP_BINS]; // Grid point [r][t] is at (r * GS_RPM_STEP) RPMs and (GS_TEMP_MIN + t * GS_TEMP_STEP) degrees C.
+                                             // Values are in 1/GS_MULT_ONE units, ala GS_MULT_ONE = a multiplier of 1.0
+} tGST;
+
+extern tGST gainSchedule;
+extern const tGST defaultGST PROGMEM;
+
+void initialize_GST(void);
+void transfer_default_GST(tGST *gstPtr);
+float gain_schedule_mult(int RPMs, int altTemp);
+
+#endif // _GAINSCHEDULE_H_
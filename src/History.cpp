@@ -0,0 +1,232 @@
+//      History.cpp
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//*****************************************************************************************
+//
+//    Charge History.   Keeps the low, high, and mean of the Battery Volts, Battery Amps,
+//    Alternator Amps, and Alternator Temperature (and the charging state) over each interval,
+//    so a display or logger that has just connected can be sent the charge curve so far
+//    with $HIS:, rather than having to be watching all along.
+//
+//    Each level holds the last HIST_DEPTH records, and each level's records cover twice the time
+//    of the level below:  Every 2nd record made in a level is paired up with the one before it
+//    and the pair makes the next record of the level above.  So a few records per level reach from
+//    the last few minutes in detail back to the last few hours in outline, in a small fixed amount of RAM.
+//
+//    Kept in RAM only, the history starts over at each power-up.
+//
+//*****************************************************************************************
+
+#include "Config.h"
+#include "System.h"
+#include "Sensors.h"
+#include "CPE.h"
+#include "History.h"
+
+#ifdef USE_HISTORY
+
+#define HIST_SLOTS (HIST_LEVELS * HIST_DEPTH)
+
+#define HF_BAT_V 0 // Index of each value in the working arrays below
+#define HF_BAT_A 1
+#define HF_ALT_A 2
+#define HF_ALT_T 3
+#define HF_VALUES 4
+
+uint32_t histSamples = 0; // Seconds of history taken so far
+
+//---- The records, one array per value so each is kept no larger then it needs to be.   Slot (level * HIST_DEPTH) + (seq % HIST_DEPTH)
+//     holds record seq of that level.   [HIST_MIN], [HIST_MAX], [HIST_AVG]
+static uint16_t histBatV[3][HIST_SLOTS]; // Battery Volts, in 10mV
+static int16_t histBatA[3][HIST_SLOTS];  // Battery Amps, in 0.1A
+static int16_t histAltA[3][HIST_SLOTS];  // Alternator Amps, in 0.1A
+static int8_t histAltT[3][HIST_SLOTS];   // Alternator Temp, in Deg C  (-99 = no sensor)
+static uint8_t histState[HIST_SLOTS];    // chargingState at the end of the interval
+
+static int16_t accLow[HF_VALUES];  // The level 0 interval being sampled
+static int16_t accHigh[HF_VALUES];
+static int32_t accSum[HF_VALUES];
+
+//-------       'helper' function used by manage_history() and get_history();
+//              Which slot holds record seq of the passed level?
+static uint8_t HIS_slot(uint8_t level, uint32_t seq)
+{
+    return ((level * HIST_DEPTH) + (uint8_t)(seq % HIST_DEPTH));
+}
+
+//-------       'helper' functions used by manage_history() and get_history();
+//              Move a record between its slot and the working arrays.
+static void HIS_get(uint8_t slot, int16_t v[3][HF_VALUES])
+{
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        v[i][HF_BAT_V] = histBatV[i][slot];
+        v[i][HF_BAT_A] = histBatA[i][slot];
+        v[i][HF_ALT_A] = histAltA[i][slot];
+        v[i][HF_ALT_T] = histAltT[i][slot];
+    }
+}
+
+static void HIS_put(uint8_t slot, int16_t v[3][HF_VALUES], uint8_t state)
+{
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        histBatV[i][slot] = v[i][HF_BAT_V];
+        histBatA[i][slot] = v[i][HF_BAT_A];
+        histAltA[i][slot] = v[i][HF_ALT_A];
+        histAltT[i][slot] = v[i][HF_ALT_T];
+    }
+    histState[slot] = state;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Manage History
+//      Called each pass of the Mainloop.  Takes a sample every HIST_SAMPLE_RATE, and once HIST_INTERVAL_SAMPLES
+//      of them have been taken adds a record to level 0 - and then to as many of the levels above it as now have
+//      a pair of records to make one out of.
+//
+//      The first sample is one HIST_SAMPLE_RATE after the first call (not at once, however long Startup took), and if
+//      the Mainloop has been held up for more than a whole HIST_SAMPLE_RATE the beat is picked up again from now -
+//      one sample for the gap, not a run of them back to back all holding the same readings.
+//
+//------------------------------------------------------------------------------------------------------
+
+void manage_history(void)
+{
+    uint32_t static lastSample;
+    bool static started = false;
+
+    int16_t v[HF_VALUES];
+    int16_t rec[3][HF_VALUES];
+    int16_t prev[3][HF_VALUES];
+    uint32_t n;
+    uint8_t level;
+    uint8_t i;
+
+    if (!started)
+    {
+        lastSample = millis();
+        started = true;
+    }
+    if ((millis() - lastSample) < HIST_SAMPLE_RATE)
+        return;
+    if ((millis() - lastSample) < (2 * HIST_SAMPLE_RATE))
+        lastSample += HIST_SAMPLE_RATE; // Keep to the beat, so histSamples stays in step with the clock ..
+    else
+        lastSample = millis();          //   .. unless a whole beat or more was missed, then start it again from here.
+
+    v[HF_BAT_V] = constrain(TO_mV(measuredBatVolts) / 10, 0, (int32_t)(UINT16_MAX / 10)); //   (So it still fits once back in mV)
+    v[HF_BAT_A] = TO_dA(measuredBatAmps);
+    v[HF_ALT_A] = TO_dA(measuredAltAmps);
+    v[HF_ALT_T] = constrain(measuredAltTemp, INT8_MIN, INT8_MAX);
+
+    for (i = 0; i < HF_VALUES; i++)
+    {
+        if ((histSamples % HIST_INTERVAL_SAMPLES) == 0)
+        { // 1st sample of a new interval
+            accLow[i] = v[i];
+            accHigh[i] = v[i];
+            accSum[i] = 0;
+        }
+        accLow[i] = min(accLow[i], v[i]);
+        accHigh[i] = max(accHigh[i], v[i]);
+        accSum[i] += v[i];
+    }
+
+    histSamples++;
+    if ((histSamples % HIST_INTERVAL_SAMPLES) != 0)
+        return;
+
+    for (i = 0; i < HF_VALUES; i++)
+    { // That is the interval done, make its record
+        rec[HIST_MIN][i] = accLow[i];
+        rec[HIST_MAX][i] = accHigh[i];
+        rec[HIST_AVG][i] = accSum[i] / HIST_INTERVAL_SAMPLES;
+    }
+
+    n = histSamples / HIST_INTERVAL_SAMPLES; // Records made in level 0, this one included
+    HIS_put(HIS_slot(0, n - 1), rec, (uint8_t)chargingState);
+
+    for (level = 0; (level < (HIST_LEVELS - 1)) && ((n & 1) == 0); level++, n >>= 1)
+    { // That made a pair, combine them into the next record of the level above.  (Which may in turn make a pair there . . )
+        HIS_get(HIS_slot(level, n - 2), prev);
+        HIS_get(HIS_slot(level, n - 1), rec);
+        for (i = 0; i < HF_VALUES; i++)
+        {
+            rec[HIST_MIN][i] = min(rec[HIST_MIN][i], prev[HIST_MIN][i]);
+            rec[HIST_MAX][i] = max(rec[HIST_MAX][i], prev[HIST_MAX][i]);
+            rec[HIST_AVG][i] = ((int32_t)rec[HIST_AVG][i] + prev[HIST_AVG][i]) / 2; // (Both cover the same amount of time)
+        }
+        HIS_put(HIS_slot(level + 1, (n >> 1) - 1), rec, histState[HIS_slot(level, n - 1)]);
+    }
+} //manage_history
+
+//------------------------------------------------------------------------------------------------------
+// History Interval / Count / Oldest
+//      How many seconds each record of the passed level covers, how many records that level has made so far,
+//      and the seq of the oldest one it still holds.   (Records history_oldest() .. history_count()-1 may be fetched)
+//
+//------------------------------------------------------------------------------------------------------
+
+uint16_t history_interval(uint8_t level)
+{
+    return ((uint16_t)HIST_INTERVAL_SAMPLES << level);
+} //history_interval
+
+uint32_t history_count(uint8_t level)
+{
+    return ((histSamples / HIST_INTERVAL_SAMPLES) >> level);
+} //history_count
+
+uint32_t history_oldest(uint8_t level)
+{
+    uint32_t n = history_count(level);
+
+    return ((n > HIST_DEPTH) ? (n - HIST_DEPTH) : 0);
+} //history_oldest
+
+//------------------------------------------------------------------------------------------------------
+// Get History
+//      Fills in rec with record seq of the passed level, in the units the BT_HISTORY frame carries.
+//      Returns FALSE if it is not held.  (Not made yet, or long since written over)
+//
+//------------------------------------------------------------------------------------------------------
+
+bool get_history(uint8_t level, uint32_t seq, tBTHistRec *rec)
+{
+    int16_t v[3][HF_VALUES];
+    uint8_t slot;
+
+    if ((level >= HIST_LEVELS) || (seq >= history_count(level)) || (seq < history_oldest(level)))
+        return (false);
+
+    slot = HIS_slot(level, seq);
+    HIS_get(slot, v);
+
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        rec->batmV[i] = (uint16_t)v[i][HF_BAT_V] * 10U;
+        rec->batdA[i] = v[i][HF_BAT_A];
+        rec->altdA[i] = v[i][HF_ALT_A];
+        rec->altTemp[i] = v[i][HF_ALT_T];
+    }
+    rec->state = histState[slot];
+
+    return (true);
+} //get_history
+
+#endif // USE_HISTORY
@@ -0,0 +1,42 @@
+//      History.h
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+
+#ifndef _HISTORY_H_
+#define _HISTORY_H_
+
+#include "Config.h"
+
+//----- Charge History.   HIST_LEVELS rings of HIST_DEPTH records each, level n records covering (HIST_INTERVAL_SAMPLES << n) seconds.
+//      Records at each level are numbered from 0 (the first one ever made) up, record s of level n ends at ((s + 1) * history_interval(n))
+//      seconds of histSamples.  Only the last HIST_DEPTH of them are held, see history_oldest().
+//      Records are handed out in the same form as the BT_HISTORY frame carries them, see tBTHistRec in BinTelemetry.h
+
+#define HIST_MIN 0 // tBTHistRec value index:  Lowest seen in the interval
+#define HIST_MAX 1 //   Highest
+#define HIST_AVG 2 //   Mean
+
+extern uint32_t histSamples; // Seconds of history taken so far
+
+void manage_history(void);
+uint16_t history_interval(uint8_t level);
+uint32_t history_count(uint8_t level);
+uint32_t history_oldest(uint8_t level);
+bool get_history(uint8_t level, uint32_t seq, tBTHistRec *rec);
+
+#endif // _HISTORY_H_
@@ -21,9 +21,259 @@
 
 #define LCD_ADDRESS 0x03C          // I2C address of the Geekcreit SSD1306
 #include "SSD1306Ascii.h"
-#include "SSD1306AsciiWire.h"
+#include "TxWriter.h"
+#include "SerialDisplay.h"
 
-SSD1306AsciiWire oled;
+#ifdef OLED_SOFT_I2C
+  #undef SDA_PIN                // The OLED has its own bus, bit-banged by SoftI2CMaster on the pins given in SmartRegulator.h
+  #undef SCL_PIN
+  #define SDA_PORT OLED_SDA_PORT
+  #define SDA_PIN  OLED_SDA_BIT
+  #define SCL_PORT OLED_SCL_PORT
+  #define SCL_PIN  OLED_SCL_BIT
+  #define I2C_FASTMODE 1        //   run at up to 400kHz, the SSD1306 is good for that.
+  #include <SoftI2CMaster.h>
+#else
+  #include <Wire.h>             // Else it shares the hardware TWI with the INA226s
+#endif
+
+//----- Shadow framebuffer.  Everything drawn goes into m_shadow[][] - a copy of what the SSD1306's own RAM should be holding - and
+//      only the bytes that actually change are flagged in m_dirty[][].  Nothing goes over I2C until display() is called, which then
+//      sends just the flagged column runs, one page at a time.  Re-drawing a field with the same value costs no I2C traffic at all,
+//      and one changed digit costs ~3 transactions rather than a full clearField() + re-print of the field.
+//      (1152 bytes of RAM)
+#define OLED_PAGES          8  // 128x64 SSD1306:  8 pages of 8 pixel rows
+#define OLED_COLS         128  //   x 128 columns
+#define OLED_RUN_GAP        4  // Send up to this many unchanged columns to join two runs, rather than start a new one  (Addressing costs 5 bytes)
+#define OLED_I2C_DATA      30  // Most data bytes sent per transaction  (Wire's buffer is 32 bytes, less Address and Control bytes)
+#define OLED_ADDR_BYTES     5  // Bytes on the bus to address a run:  I2C Address, Control, and 3 Commands
+
+class SSD1306AsciiShadow : public SSD1306Ascii {
+  public:
+    void begin(const DevType *dev, uint8_t i2cAddr)
+    {
+#ifdef OLED_SOFT_I2C
+        i2c_init();
+#endif
+        m_i2cAddr = i2cAddr;
+        m_cmdArgs = 0;
+        m_atPage = OLED_PAGES;
+        memset(m_shadow, 0, sizeof(m_shadow));
+        m_direct = true; // Init commands go straight out  (Its clear() just zeros the already zeroed shadow)
+        init(dev);
+        m_direct = false;
+
+        memset(m_dirty, 0xFF, sizeof(m_dirty)); // Now really clear it, whatever the display powered up holding.
+        display();
+    }
+
+    uint16_t display(uint16_t maxBytes = 0xFFFF);
+    void plotLine(uint8_t line, const uint8_t *bits);
+
+  protected:
+    void writeDisplay(uint8_t b, uint8_t mode);
+
+  private:
+    void bus_start(uint8_t control) // One transaction to the display:  start it, with the Control byte  (0x00 = Commands, 0x40 = Data follow)
+    {
+#ifdef OLED_SOFT_I2C
+        i2c_start((m_i2cAddr << 1) | I2C_WRITE);
+        i2c_write(control);
+#else
+        Wire.beginTransmission(m_i2cAddr);
+        Wire.write(control);
+#endif
+    }
+
+    void bus_write(uint8_t b) //   send its bytes
+    {
+#ifdef OLED_SOFT_I2C
+        i2c_write(b);
+#else
+        Wire.write(b);
+#endif
+    }
+
+    void bus_stop(void) //   and end it.
+    {
+#ifdef OLED_SOFT_I2C
+        i2c_stop();
+#else
+        Wire.endTransmission();
+#endif
+    }
+
+    uint8_t m_i2cAddr;
+    uint8_t m_shadow[OLED_PAGES][OLED_COLS];
+    uint8_t m_dirty[OLED_PAGES][OLED_COLS / 8]; // Bit (col & 7) of [page][col / 8] set = that column differs from what the display holds
+    uint8_t m_cmdArgs;                          // Argument bytes still to come for the last multi-byte command passed through
+    uint8_t m_atPage;                           // Where the display's RAM pointer was left by the last data sent  (OLED_PAGES = not known)
+    uint8_t m_atCol;
+    bool m_direct;
+};
+
+//------------------------------------------------------------------------------------------------------
+//
+//      Write Display  (Shadowed)
+//
+//      All of SSD1306Ascii's output comes through here.  RAM bytes are placed in the shadow at the cursor (m_col / m_row, which
+//      SSD1306Ascii keeps up to date itself), Column and Page addressing commands are dropped - display() sends its own - and any
+//      other command is passed on to the display as-is.
+//
+//------------------------------------------------------------------------------------------------------
+void SSD1306AsciiShadow::writeDisplay(uint8_t b, uint8_t mode)
+{
+    if (mode == SSD1306_MODE_CMD)
+    {
+        if (m_direct)
+            m_cmdArgs = 0; // Initializing, everything goes out as-is.
+        else if (m_cmdArgs)
+            m_cmdArgs--; // Argument for the previous command  (ex: the value after SETCONTRAST), send it along.
+        else if ((b < 0x20) || ((b & 0xF8) == SSD1306_SETSTARTPAGE))
+            return; // Column / Page addressing
+        else
+            switch (b)
+            { // Commands that take arguments  (See the SSD1306 data sheet)
+            case SSD1306_MEMORYMODE:
+            case SSD1306_SETCONTRAST:
+            case SSD1306_CHARGEPUMP:
+            case SSD1306_SETMULTIPLEX:
+            case SSD1306_SETDISPLAYOFFSET:
+            case SSD1306_SETDISPLAYCLOCKDIV:
+            case SSD1306_SETPRECHARGE:
+            case SSD1306_SETCOMPINS:
+            case SSD1306_SETVCOMDETECT:
+                m_cmdArgs = 1;
+                break;
+
+            case 0x21: // Column Address
+            case 0x22: // Page Address
+            case 0xA3: // Vertical Scroll Area
+                m_cmdArgs = 2;
+                break;
+            }
+
+        bus_start(0x00);
+        bus_write(b);
+        bus_stop();
+        return;
+    }
+
+    if ((m_row < OLED_PAGES) && (m_col < OLED_COLS) && (m_shadow[m_row][m_col] != b))
+    {
+        m_shadow[m_row][m_col] = b;
+        m_dirty[m_row][m_col >> 3] |= (1 << (m_col & 7));
+    }
+} //writeDisplay
+
+//------------------------------------------------------------------------------------------------------
+//
+//      Display
+//
+//      Sends whatever has changed in the shadow since the last time out to the display.  Each run of changed columns in a page
+//      (joined across small gaps, see OLED_RUN_GAP) gets one addressing transaction - unless the display is already pointing at
+//      it, as when picking up a run that was cut short last time - then its data, OLED_I2C_DATA bytes per transaction.
+//
+//      Stops once maxBytes have gone out on the bus (at least one data byte is always sent, if anything has changed), leaving the
+//      rest flagged for the next call - so the caller can bound how long it spends here.  Returns the number of bytes put on the
+//      bus, 0 = nothing had changed.
+//
+//------------------------------------------------------------------------------------------------------
+uint16_t SSD1306AsciiShadow::display(uint16_t maxBytes)
+{
+    uint16_t sent = 0;
+
+    for (uint8_t page = 0; page < OLED_PAGES; page++)
+    {
+        uint8_t col = 0;
+
+        while (col < OLED_COLS)
+        {
+            if (m_dirty[page][col >> 3] == 0)
+            { // Skip over clean groups of 8 quickly
+                col = (col | 7) + 1;
+                continue;
+            }
+            if ((m_dirty[page][col >> 3] & (1 << (col & 7))) == 0)
+            {
+                col++;
+                continue;
+            }
+
+            uint8_t last = col; // Found the start of a run, find its end.
+            for (uint8_t c = col + 1; (c < OLED_COLS) && ((c - last) <= OLED_RUN_GAP); c++)
+                if (m_dirty[page][c >> 3] & (1 << (c & 7)))
+                    last = c;
+
+            bool addressed = ((page == m_atPage) && (col == m_atCol));
+
+            if ((sent != 0) && ((sent + (addressed ? 0 : OLED_ADDR_BYTES) + 3) > maxBytes))
+                return (sent); // No room left to send any of this run.
+
+            if (!addressed)
+            {
+                uint8_t addr = col + m_colOffset;
+                bus_start(0x00); // Commands follow
+                bus_write(SSD1306_SETLOWCOLUMN | (addr & 0x0F));
+                bus_write(SSD1306_SETHIGHCOLUMN | (addr >> 4));
+                bus_write(SSD1306_SETSTARTPAGE | page);
+                bus_stop();
+                sent += OLED_ADDR_BYTES;
+            }
+
+            while (col <= last)
+            {
+                uint16_t room = (maxBytes > (sent + 3)) ? (maxBytes - sent - 2) : 1;
+                uint8_t n;
+
+                bus_start(0x40); // Data follows
+                for (n = 0; (n < OLED_I2C_DATA) && (n < room) && (col <= last); n++, col++)
+                {
+                    bus_write(m_shadow[page][col]);
+                    m_dirty[page][col >> 3] &= ~(1 << (col & 7));
+                }
+                bus_stop();
+                sent += n + 2;
+                m_atPage = page; // Display's column pointer moves along with the data.
+                m_atCol = col;
+
+                if (sent >= maxBytes)
+                    return (sent); // The rest of the run stays flagged.
+            }
+        }
+    }
+
+    return (sent);
+} //display
+
+//------------------------------------------------------------------------------------------------------
+//
+//      Plot Line
+//
+//      Sets one line of pixels (RAM line 0..63, across the whole width) in the shadow to the passed bitmap:  Bit (col & 7) of
+//      bits[col / 8] set = that pixel lit.  Only the columns where it differs from what the line held get flagged to be sent.
+//
+//------------------------------------------------------------------------------------------------------
+void SSD1306AsciiShadow::plotLine(uint8_t line, const uint8_t *bits)
+{
+    uint8_t page = (line >> 3) & (OLED_PAGES - 1);
+    uint8_t mask = 1 << (line & 7);
+
+    for (uint8_t col = 0; col < OLED_COLS; col++)
+    {
+        uint8_t b = m_shadow[page][col] & ~mask;
+
+        if (bits[col >> 3] & (1 << (col & 7)))
+            b |= mask;
+        if (b != m_shadow[page][col])
+        {
+            m_shadow[page][col] = b;
+            m_dirty[page][col >> 3] |= (1 << (col & 7));
+        }
+    }
+} //plotLine
+
+SSD1306AsciiShadow oled;
 
 extern const char *  chargingStateString;
 extern int    inChargingStateCount;
@@ -50,6 +300,25 @@ enum FieldNumber {
   fnSCREEN2 = 92 // Clear screen, write Screen2
 };
 
+//Screens manage_OLED() steps through, in this order
+#define OLED_SCREEN_DATA    0 // The data screen  (Screen2)
+#define OLED_SCREEN_BAT     1 // Battery Volts and Amps graph
+#define OLED_SCREEN_TEMP    2 // Alternator Temperature graph
+#define OLED_SCREEN_LIFE    3 // Lifetime statistics
+#define OLED_SCREEN_FAULTS  4 // Fault history
+#define OLED_SCREENS        5
+
+#define OLED_GRAPH_LINES ((OLED_PAGES - 1) * 8) // A graph is a line per History interval, below a row of text with its scale
+#define graphBatWidth       62                   // Battery graph:  Volts across columns 0..61,
+#define graphBatColDiv      64                   //   a dotted line down column 64,
+#define graphBatColAmps     66                   //   and Amps across 66..127
+#define graphSpanVolt       50                   // Least span of each scale, in the units graph_values() gives:  0.5V,
+#define graphSpanAmp        50                   //   5A,
+#define graphSpanTemp       10                   //   and 10 Deg C
+
+uint8_t lcdScreen = OLED_SCREEN_DATA; // Screen showing.  The data screen's fields are only drawn when it is, see the Template Functions
+bool lcdRedraw = false;               // The data screen has just been put back up:  Draw each field, changed or not.
+
 
 //Top row is 0
 #define screen2RowVolt      1
@@ -134,6 +403,9 @@ class LCDfield {
 
     void Write(T);
     void Update(T);
+#ifdef USE_SERIAL_DISPLAY
+    void Send(tTXWriter *w);
+#endif
 }; // don't forget the semicolon at the end of the class
 
 //                      (optional)
@@ -153,6 +425,15 @@ LCDfield <int>   LCDCount(            fnCD,       screen2ColCount,  screen2RowCo
 LCDfield <char *> LCDCount2(          fnTM,       screen2ColCount2, screen2RowCount,  screen2EraseCount2, 0, screen2FormatCount);
 //LCDfield <const char *> LCDCountString(fnCD,      screen2ColCount3, screen2RowCount,  screen2EraseCount2, 0, screen2FormatCount);
 LCDfield <const char *> LCDScuba(     fnSB,       screen2ColScuba,  screen2RowPWM,  screen2EraseScuba,  0, screen2FormatScuba);
+#define OLED_FIELDS 10  // Number of pieces WriteOLEDDynamicField() draws the above in
+#define OLED_PIECES (OLED_FIELDS + 1)  //   and then one more, to send the Serial Display its frame  (See manage_OLED())
+
+#ifdef USE_SERIAL_DISPLAY
+uint16_t lcdChanged = 0;  // Bit [FieldNumber] set = that field has changed since the last frame sent to the Serial Display
+
+// Order the fields go out in a frame - the order they used to be sent in, as some share space on the remote display.
+const uint8_t LCDFrameOrder[] PROGMEM = {fnAV, fnBV, fnAA, fnBA, fnAT, fnBT, fnPW, fnCD, fnTM, fnCS, fnSB, fnCR};
+#endif
 
 
 // Utility to round floating number precision to a specified number of decimal places
@@ -170,21 +451,47 @@ float roundoff(float num,int precision)
       return num;
 }//float roundoff(float num,int precision)
 
-//Template Functions
+// Helper for the Template Functions, finishes off a field once its value has been printed:  adds the Format character, then blanks
+//   out whatever is left of the field.  (Same end result as the clearField() before printing it used to be, but each column is
+//   drawn only once - so the shadow only sees the columns that really changed)
+void LCD_field_end(uint8_t column, uint8_t row, uint8_t eraseWidth, char format)
+{
+    uint8_t fieldEnd = column + oled.fieldWidth(eraseWidth);
+
+    oled.print(format);
+    if (oled.col() < fieldEnd)
+        oled.clear(oled.col(), fieldEnd - 1, row, row + oled.fontRows() - 1);
+}
+
+#ifdef USE_SERIAL_DISPLAY
+// Helper for the Send() Template Functions, finishes off a field in the Serial Display frame
+void LCD_send_end(tTXWriter *w, char format)
+{
+    if (format != '\0')
+        TXW_char(w, format); // (A NULL format ended the string, back when it was sprintf()'d)
+}
+#endif
+
+//Template Functions  - these keep m_lastValue (and the Serial Display) up to date whichever screen the OLED is showing, but only draw
+//                     the field if it is the data screen.
 
 template <>  //forced write to the field.  No checking for changed field
 void LCDfield<char *>::Write(char *newValue) {
-    oled.clearField(m_column, m_row, m_eraseWidth);
-    oled.print(newValue);
-    oled.println(m_Format);
+    m_lastValue = newValue;
+    if (lcdScreen == OLED_SCREEN_DATA) {
+      oled.setCursor(m_column, m_row);
+      oled.print(newValue);
+      LCD_field_end(m_column, m_row, m_eraseWidth, m_Format);
+    }
 #ifdef USE_SERIAL_DISPLAY
-    char buffer[40];
+    static uint16_t lastCRC = 0;  // The buffer passed is re-used, so it is the text that has to be checked for a change
+    uint16_t crc = 0xFFFF;
 
-    //sprintf_P(buffer, PSTR("DSP:%d,%s%c"),  // alternative to use program memory instead of RAM
-    sprintf(buffer, "$D:%d,%s%c",
-            m_ObjectNumber,
-            newValue, m_Format);
-    SERIAL_DISPLAY_PORT.println(buffer);
+    for (const char *p = newValue; *p; p++)
+      crc = CRC16_update(crc, (uint8_t)*p);
+    if (crc != lastCRC)
+      lcdChanged |= (1U << m_ObjectNumber);
+    lastCRC = crc;
 #endif
   }
 
@@ -192,19 +499,18 @@ template <>  //overload function for const char* strings
 void LCDfield<const char *>::Update(const char* newValue) {
   if (newValue != m_lastValue) {
     m_lastValue = newValue;
-    oled.clearField(m_column, m_row, m_eraseWidth);
-    oled.print(newValue);
-    oled.println(m_Format);
 #ifdef USE_SERIAL_DISPLAY
-    char buffer[40];
-
-    //sprintf_P(buffer, PSTR("DSP:%d,%s%c"),  // alternative to use program memory instead of RAM
-    sprintf(buffer, "$D:%d,%s%c",
-            m_ObjectNumber,
-            newValue, m_Format);
-    SERIAL_DISPLAY_PORT.println(buffer);
+    lcdChanged |= (1U << m_ObjectNumber);
 #endif
   }
+  else if (!lcdRedraw)
+    return;
+
+  if (lcdScreen == OLED_SCREEN_DATA) {
+    oled.setCursor(m_column, m_row);
+    oled.print(newValue);
+    LCD_field_end(m_column, m_row, m_eraseWidth, m_Format);
+  }
 }
 
 template <>  //catches floats
@@ -212,20 +518,18 @@ void LCDfield<float>::Update(float newValue) {
   newValue = roundoff(newValue, 2); // set precision to two decimal places
   if (newValue != m_lastValue) {
     m_lastValue = newValue;
-
-    oled.clearField(m_column, m_row, m_eraseWidth);
-    oled.print(newValue, m_Digits);  // this funtion call format will not work with const char* or String
-    oled.println(m_Format);
 #ifdef USE_SERIAL_DISPLAY
-    char buffer[40];
-    extern char *float2string(float v, uint8_t decimals);
-    //sprintf_P(buffer, PSTR("DSP:%d,%s%c"),  // alternative to use program memory instead of RAM
-    sprintf(buffer, "$D:%d,%s%c",
-            m_ObjectNumber,
-            float2string(newValue, m_Digits), m_Format);
-    SERIAL_DISPLAY_PORT.println(buffer);
+    lcdChanged |= (1U << m_ObjectNumber);
 #endif
   }//if (newValue != m_lastValue) 
+  else if (!lcdRedraw)
+    return;
+
+  if (lcdScreen == OLED_SCREEN_DATA) {
+    oled.setCursor(m_column, m_row);
+    oled.print(newValue, m_Digits);  // this funtion call format will not work with const char* or String
+    LCD_field_end(m_column, m_row, m_eraseWidth, m_Format);
+  }
 }//void LCDfield<float>::Update(T newValue) 
 
 template <typename T>  //catches all other types  ... integers
@@ -243,30 +547,126 @@ void LCDfield<T>::Update(T newValue) {
     } //if(this==&LCDPWM)
 */
   m_lastValue = newValue;
-  oled.clearField(m_column, m_row, m_eraseWidth);  // does not matter if it clears the field twice...
-  oled.print(newValue);
-  oled.println(m_Format);
-
 #ifdef USE_SERIAL_DISPLAY
-    char buffer[40];
-    // TRAP TO FIX DANGLING COUNTDOWN DIGIT ON REMOTE SERIAL DISPLAY
-    if ((m_ObjectNumber == fnCD) && (newValue == 0)) 
-    { //Trap to catch dangling countdown digit on remote display
-      sprintf(buffer, "$D:%d,%s%c",
-              m_ObjectNumber,
-              "  ", m_Format);
-    }//if (m_ObjectNumber == fnCD)
-    // END OF TRAP for dangling countdown digit
-    else {
-      //sprintf_P(buffer, PSTR("DSP:%d,%d%c"), // alternative to use program memory instead of RAM
-      sprintf(buffer, "$D:%d,%d%c",
-              m_ObjectNumber,
-              newValue, m_Format);
-    }//else
-    SERIAL_DISPLAY_PORT.println(buffer);
+    lcdChanged |= (1U << m_ObjectNumber);
 #endif
   }//if (newValue != m_lastValue) 
+  else if (!lcdRedraw)
+    return;
+
+  if (lcdScreen == OLED_SCREEN_DATA) {
+    oled.setCursor(m_column, m_row);
+    oled.print(newValue);
+    LCD_field_end(m_column, m_row, m_eraseWidth, m_Format);
+  }
 }//void LCDfield<T>::Update(T newValue) 
 
+#ifdef USE_SERIAL_DISPLAY
+// Send() adds the field, as it now stands, to the Serial Display frame being built in w.
+
+template <>
+void LCDfield<char *>::Send(tTXWriter *w) {
+  SD_field(w, m_ObjectNumber);
+  if (m_lastValue != NULL)
+    TXW_str(w, m_lastValue);
+  LCD_send_end(w, m_Format);
+}
+
+template <>
+void LCDfield<const char *>::Send(tTXWriter *w) {
+  SD_field(w, m_ObjectNumber);
+  if (m_lastValue != NULL)
+    TXW_str(w, m_lastValue);
+  LCD_send_end(w, m_Format);
+}
+
+template <>
+void LCDfield<float>::Send(tTXWriter *w) {
+  SD_field(w, m_ObjectNumber);
+  TXW_fixed(w, m_lastValue, m_Digits);
+  LCD_send_end(w, m_Format);
+}
+
+template <typename T>
+void LCDfield<T>::Send(tTXWriter *w) {
+  SD_field(w, m_ObjectNumber);
+  // TRAP TO FIX DANGLING COUNTDOWN DIGIT ON REMOTE SERIAL DISPLAY
+  if ((m_ObjectNumber == fnCD) && (m_lastValue == 0)) 
+  { //Trap to catch dangling countdown digit on remote display
+    TXW_str_P(w, PSTR("  "));
+  }//if (m_ObjectNumber == fnCD)
+  // END OF TRAP for dangling countdown digit
+  else {
+    TXW_int(w, m_lastValue);
+  }//else
+  LCD_send_end(w, m_Format);
+}
+
+//------------------------------------------------------------------------------------------------------
+//
+//      LCD Send Frame
+//
+//      Called once each refresh of the data screen has drawn all the fields:  Sends the Serial Display one frame with all the
+//      fields that changed  (or all of them, if it has asked to be resynced).  If the frame does not fit in the transmit ring the
+//      fields are left flagged, and go in the next one.  (A display still on $D: lines gets them the same way, a line per field)
+//
+//------------------------------------------------------------------------------------------------------
+void LCD_send_frame(void)
+{
+  tTXWriter w;
+  uint16_t changed = lcdChanged;
+  uint8_t field;
+
+  if (sdResync)
+    changed = 0xFFFF;
+  if (changed & (1U << fnCS))
+    changed |= (1U << fnSB);  // SCUBA shares the line with the charging state on the remote display, so goes out again after it.
+#ifdef ENABLE_FEATURE_IN_SCUBA
+  if (!sdFrames)
+    changed |= (1U << fnSB);  //   ($D: lines displays have always been sent it every refresh, so keep doing that)
+#endif
+  if (changed == 0)
+    return;
+
+  SD_begin(&w);
+  for (uint8_t i = 0; i < sizeof(LCDFrameOrder); i++)
+  {
+    field = pgm_read_byte(&LCDFrameOrder[i]);
+    if (!(changed & (1U << field)))
+      continue;
+
+    switch (field)
+    {
+      case fnAV:  LCDaltVolts.Send(&w);   break;
+      case fnBV:  LCDbatVolts.Send(&w);   break;
+      case fnAA:  LCDaltAmps.Send(&w);    break;
+      case fnBA:  LCDbatAmps.Send(&w);    break;
+      case fnAT:  LCDaltTemp.Send(&w);    break;
+      case fnBT:  LCDbatTemp.Send(&w);    break;
+      case fnPW:  LCDPWM.Send(&w);        break;
+      case fnCD:  LCDCount.Send(&w);      break;
+      case fnTM:  LCDCount2.Send(&w);     break;
+      case fnCS:  LCDState.Send(&w);      break;
+#ifdef ENABLE_FEATURE_IN_SCUBA
+      case fnSB:  LCDScuba.Send(&w);      break;
+#endif
+      case fnCR:
+        if (sdResync)
+        { // (Only sent at Startup, or when all is asked for)
+          SD_field(&w, fnCR);
+          TXW_str_P(&w, PSTR(REV_FORK));
+        }
+        break;
+    }
+  }
+
+  if (SD_end(&w))
+  {
+    lcdChanged = 0;
+    sdResync = false;
+  }
+} //LCD_send_frame
+#endif // USE_SERIAL_DISPLAY
+
 
 #endif
\ No newline at end of file
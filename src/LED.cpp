@@ -22,6 +22,7 @@
 
 #include "Config.h" // Pick up the specific structures and their sizes for this program.
 #include "LED.h"
+#include "Alternator.h"
 
 unsigned LEDPattern; // Holds the requested bit pattern to send to the LED.  Send LSB 1st.
 unsigned LEDBitMask; // Used to select one bit at a time to 'send to the LED'
@@ -57,40 +58,15 @@ bool LEDFOMirror;    // When Blinking Out to the LED, should we also blink out t
 
 void update_LED()
 {
+  tSMState st;
 
   if (refresh_LED() == true) // If there is already a pattern blinking out, let it finish before overwriting it.
     return;
 
-  switch (chargingState)  // update blinking pattern
-  {
-  case ramping:
-  case determine_ALT_cap:
-  case bulk_charge:
-    blink_LED(LED_BULK, LED_RATE_NORMAL, -1, false);
-    break;
-
-  case acceptance_charge:
-    blink_LED(LED_ACCEPT, LED_RATE_NORMAL, -1, false);
-    break;
-
-  case overcharge_charge:
-    blink_LED(LED_OC, LED_RATE_SLOW, -1, false);
-    break;
-
-  case float_charge:
-  case forced_float_charge:
-  case post_float:
-    blink_LED(LED_FLOAT, LED_RATE_NORMAL, -1, false);
-    break;
-
-  case equalize:
-    blink_LED(LED_EQUALIZE, LED_RATE_FAST, -1, OUT_LAMP_MIRROR_EQUALIZE); // Include the dash LAMP while equalizing
-    break;
-
-  default:
+  if (get_SM_state(chargingState, &st) == true) // Each charging state has its blinking pattern in SMStates[] (see Alternator.cpp)
+    blink_LED(st.LEDPattern, st.LEDRate, -1, st.LEDMirror);
+  else
     blink_LED(LED_IDLE, LED_RATE_NORMAL, -1, false);
-    break;
-  }
 } //update_LED
 
 //------------------------------------------------------------------------------------------------------
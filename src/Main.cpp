@@ -74,6 +74,12 @@
 #include "Sensors.h"
 #include "LED.h"
 #include "BMS_SERIAL.h"
+#include "FeedForward.h"
+#include "GainSchedule.h"
+#include "SOC.h"
+#include "Modbus.h"
+#include "History.h"
+#include "SerialDisplay.h"
 
 /***************************************************************************************
 ****************************************************************************************
@@ -113,17 +119,17 @@ void setup()
     }
     // output revision of this code to serial display
     delay(1000); // let remote display boot
-    char buffer[40];
-    sprintf(buffer, "$D:%d,%s",
-         11, // fnCR (which is not in scope here)
-         REV_FORK);
-    SERIAL_DISPLAY_PORT.println(buffer);
+    SD_send_text(11, REV_FORK); // fnCR (which is not in scope here)
   #endif
 
   #ifdef USE_BMS_SERIAL_IN
     BMS_SERIAL_PORT.begin(BMS_SERIAL_BAUD); // Start the BMS_SERIAL_PORT.
     while(!BMS_SERIAL_PORT){};  // wait for BMS_SERIAL_PORT to start successfully
   #endif
+
+  #ifdef USE_MODBUS
+    initialize_MODBUS(); // Start the Modbus port (and its frame timer)
+  #endif
   
   wdt_reset(); // pat the watchdog timer
 
@@ -191,6 +197,7 @@ void setup()
   //------  Fetch Configuration files from EEPROM.  The structures already contain their heir 'default' values compiled FLASH.  But we check to see if there are
   //        validated user-saved overrides in EEPROM memory.
 
+  resume_BK_image();              // Finish putting in place a Config Backup image ($BKL:) if that was cut short, before anything is read.
   read_SCS_EEPROM(&systemConfig); // See if there are valid structures that have been saved in the EEPROM to overwrite the default (as-compiled) values
   read_CAL_EEPROM(&ADCCal);       // See if there is an existing Calibration structure contained in the EEPROM.
 
@@ -203,6 +210,13 @@ void setup()
   //
   initialize_sensors();
   initialize_alternator();
+#ifdef USE_PWM_FEED_FORWARD
+  initialize_FFM();
+#endif
+#ifdef USE_GAIN_SCHEDULING
+  initialize_GST();
+#endif
+  initialize_SUB();
 
   //-----  Sample the System Voltage and adjust system to accommodate different VBats
   //
@@ -229,6 +243,10 @@ void setup()
 
   if (read_CPS_EEPROM(cpIndex, &chargingParms) != true) // See if there is a valid user modified CPE in EEPROM we should be using.
     transfer_default_CPS(cpIndex, &chargingParms);      // No, so prime the working Charge profile tables with default values from the FLASH (PROGMEM) store.
+  compile_CPS();                                        // And scale its thresholds for this system, now that we know the Volts and Amps multipliers.
+#ifdef USE_SOC_ESTIMATOR
+  initialize_SOC();                                     // With the profile and battery size known, take a starting State of Charge from the battery voltage.
+#endif
 
     //---- And after all that, is the user requesting a Master Reset?
 
@@ -256,6 +274,9 @@ void setup()
   WriteOLEDDIPSettings();
   WriteOLEDDataScreenStaticData();
 #endif
+
+  TX_flush(); // Let all the startup output get on its way, from here on TX_service() in the Mainloop keeps the serial ports fed.
+  stampFreeStack(); // And stamp the free RAM, so check_free_RAM() can see how much of it the stack ever uses.
 } // End of the Setup() function.
 
 /****************************************************************************************
@@ -281,8 +302,9 @@ void setup()
 //
 //      Not quite as good as hardware enforced fences, but better then nothing.
 //
+//      The stamp is put down at the end of Startup, and check_free_RAM() looks at what is left of it from the Mainloop.
+//
 //------------------------------------------------------------------------------------------------------
-#ifdef DEBUG
 
 void stampFreeStack(void) {
   uint8_t *stmpPtr;
@@ -290,7 +312,7 @@ void stampFreeStack(void) {
   extern unsigned int __heap_start;
   extern void *__brkval;
 
-  if ((int)__brkval == 0)
+  if (__brkval == NULL)
     stmpPtr = (uint8_t*)&__heap_start;
   else
     stmpPtr = (uint8_t*)__brkval;
@@ -315,7 +337,7 @@ int checkStampStack(void) {
   extern unsigned int __heap_start;
   extern void *__brkval;
 
-  if ((int)__brkval == 0)
+  if (__brkval == NULL)
     stmpPtr = (uint8_t*)&__heap_start;
   else
     stmpPtr = (uint8_t*)__brkval;
@@ -342,11 +364,28 @@ int checkStampStack(void) {
 
   return (unusedCnt);
 }
-#else
-int checkStampStack(void) {
-  return (-1);  // Need dummy function when not compiling debug..
+
+//------------------------------------------------------------------------------------------------------
+// Check Free RAM
+//      Called from the Mainloop.  Every RAM_CHECK_PERIOD it sees how close the stack has come to the static
+//      variables (how much of the stamp put down at Startup is still untouched), and FAULTs the regulator - field
+//      off - if that is ever under RAM_MIN_FREE bytes.  Better that than carry on until the stack runs into the
+//      variables.  (A build with too many of the RAM hungry options in Config.h turned on will trip this)
+//
+//------------------------------------------------------------------------------------------------------
+
+void check_free_RAM(void) {
+  static uint32_t lastCheck = 0;
+
+  if ((millis() - lastCheck) < RAM_CHECK_PERIOD)
+    return;
+  lastCheck = millis();
+
+  if (checkStampStack() < RAM_MIN_FREE) {
+    chargingState = FAULTED;
+    faultCode     = FC_SYS_LOW_RAM;
+  }
 }
-#endif
 
 //------------------------------------------------------------------------------------------------------
 // Read DIP Switch
@@ -439,11 +478,8 @@ void reboot()
 #endif
 
 #ifdef USE_SERIAL_DISPLAY // Clear fault display line
-  char buffer[40];
-  sprintf(buffer, "$D:%d,%s",
-          11, // CAUTION hard-coded for fnFL
-          "          ");
-  SERIAL_DISPLAY_PORT.println(buffer);
+  SD_send_text(11, "          "); // CAUTION hard-coded for fnFL
+  TX_flush();
 #endif
 
 #ifdef OPTIBOOT
@@ -478,13 +514,10 @@ void reboot()
 
 void loop()
 {
+  TX_service(); // Keep the serial ports fed
   // first things first, check if BMS is getting ready to shutdown
   #ifdef USE_BMS_SERIAL_IN
-    if(checkBMS_Serial_In())
-    {
-       chargingState = LIFEPO_FORCED_SHUTDOWN;
-       //TODO add code for fault state (and new fault code)
-    }
+    manage_BMS(); // (Drops into LIFEPO_FORCED_SHUTDOWN, field off, if the BMS is about to disconnect)
   #endif
 
   if (chargingState == FAULTED)
@@ -533,11 +566,30 @@ void loop()
   //
   handle_feature_in();
   check_inbound(); // See if any communication is coming in via the Bluetooth (or DEBUG terminal), or Feature-in port.
+#ifdef USE_MODBUS
+  check_MODBUS();  //   or a Modbus request has come in.
+#endif
 
   update_run_summary(); // Update the Run Summary variables
+#ifdef USE_SOC_ESTIMATOR
+  manage_SOC();         // And the battery State of Charge estimate.
+#endif
+#ifdef USE_HISTORY
+  manage_history();     // And the Charge History.
+#endif
   send_outbound(false); // And send the status via serial port - pacing the strings out.
+  TX_service();
+#ifdef USE_OLED
+  manage_OLED();        // Refresh the OLED, a slice at a time.
+#endif
   update_LED();         // Set the blinking pattern and refresh it. (Will also blink the FEATURE_OUT if so configured via #defines
   update_feature_out(); // Handle any other FEATURE_OUT mode (as defined by #defines) other then Blinking.
+  checkpoint_ACC();     // Save the Alternator Capability Curve every so often.
+  checkpoint_LIFE();    //   and the Lifetime statistics.
+#ifdef USE_PWM_FEED_FORWARD
+  checkpoint_FFM();     // Save the learned Feed-Forward map every so often.
+#endif
+  check_free_RAM();     // And make sure the stack has not come too close to the variables.
 
   wdt_reset(); // Pet the Dog so he does not bit us!
 
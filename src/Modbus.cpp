@@ -0,0 +1,644 @@
+// Modbus.cpp
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//*****************************************************************************************
+//
+//    Modbus RTU slave, so a PLC (or any other Modbus master) can read the measurements and
+//    the saved configuration as blocks of registers - rather than parsing the ASCII status
+//    strings.  See Modbus.h for the register map.
+//
+//    RTU frames are delimited by silence on the line:  a frame ends once the line has been
+//    quiet for 3.5 character times (t3.5), and any gap of more than 1.5 character times (t1.5)
+//    inside a frame makes it bad.  Doing that by polling from the Mainloop is not good enough
+//    (the Mainloop can take longer than t3.5), so the Modbus USART is driven directly rather
+//    than through the Arduino core:
+//      - The receive interrupt stores each byte, checks the gap since the last one against
+//        t1.5, and restarts Timer 5 to interrupt t3.5 later.
+//      - The Timer 5 interrupt, seeing the line has been quiet for t3.5, hands the frame
+//        to the Mainloop.  Anything arriving before it has been answered is ignored.
+//      - check_MODBUS() (from the Mainloop) answers it via MB_process(), and the transmit
+//        interrupts send the response - releasing the RS-485 driver once the last bit is out.
+//
+//    MB_process() and everything it calls has no hardware in it (its tables are read through
+//    the FLASH_xxx shims in Portability.h), so it can be built and tested on a PC - see
+//    test/host/modbus.cpp.
+//
+//*****************************************************************************************
+
+#include "Config.h"
+#include "System.h"
+#include "Sensors.h"
+#include "Alternator.h"
+#include "CPE.h"
+#include "Flash.h"
+#include "Modbus.h"
+
+#define MB_READ_HOLDING 0x03 // Function codes supported
+#define MB_READ_INPUT 0x04
+#define MB_WRITE_SINGLE 0x06
+#define MB_WRITE_MULTIPLE 0x10
+
+#define MB_EX_FUNCTION 0x01 // Exception codes
+#define MB_EX_ADDRESS 0x02
+#define MB_EX_VALUE 0x03
+#define MB_EX_FAILURE 0x04
+
+//---- Holding registers - where each one is in its structure, and how it is scaled.
+#define MBT_BOOL 0   // bool                         0 / 1
+#define MBT_U8 1     // uint8_t
+#define MBT_INT 2    // int                          (signed)
+#define MBT_U16 3    // uint16_t
+#define MBT_MIN 4    // uint32_t mS                  as Minutes
+#define MBT_X100 5   // float                        x100    (signed)
+#define MBT_X1000 6  // float                        x1000   (signed, Volts as mV)
+#define MBT_X10000 7 // float                        x10000  (signed)
+
+typedef struct
+{
+    uint8_t offset; // Where in the structure
+    uint8_t type;   // MBT_xxx
+    int16_t low;    // Limits a written value must be within, in register units.  (As used by the matching $SC* / $CP* command)
+    int16_t high;
+} tMBReg;
+
+#define MB_REG(s, f, t, l, h) {offsetof(s, f), t, l, h}
+
+const tMBReg FLASH_TABLE MBSCSRegs[] = {
+    MB_REG(tSCS, REVERSED_BAT_SHUNT, MBT_BOOL, 0, 1),           //  0
+    MB_REG(tSCS, REVERSED_ALT_SHUNT, MBT_BOOL, 0, 1),           //  1
+    MB_REG(tSCS, ALT_TEMP_SETPOINT, MBT_U8, 15, 120),           //  2
+    MB_REG(tSCS, ALT_AMP_DERATE_NORMAL, MBT_X100, 10, 100),     //  3
+    MB_REG(tSCS, ALT_AMP_DERATE_SMALL_MODE, MBT_X100, 10, 100), //  4
+    MB_REG(tSCS, ALT_AMP_DERATE_HALF_POWER, MBT_X100, 10, 100), //  5
+    MB_REG(tSCS, ALT_PULLBACK_FACTOR, MBT_INT, -1, 10),         //  6
+    MB_REG(tSCS, ALT_IDLE_RPM, MBT_INT, 0, 1500),               //  7
+    MB_REG(tSCS, ALT_AMPS_LIMIT, MBT_INT, -1, 500),             //  8
+    MB_REG(tSCS, ALT_WATTS_LIMIT, MBT_INT, -1, 20000),          //  9
+    MB_REG(tSCS, ALTERNATOR_POLES, MBT_U8, 2, 25),              // 10
+    MB_REG(tSCS, ENGINE_ALT_DRIVE_RATIO, MBT_X1000, 500, 20000), // 11
+    MB_REG(tSCS, BAT_AMP_SHUNT_RATIO, MBT_INT, 500, 20000),     // 12
+    MB_REG(tSCS, ALT_AMP_SHUNT_RATIO, MBT_INT, 500, 20000),     // 13
+    MB_REG(tSCS, FIELD_TACH_PWM, MBT_INT, -1, MAX_TACH_PWM),    // 14  (Raw PWM, not % as $SCT takes)
+    MB_REG(tSCS, FORCED_TM, MBT_BOOL, 0, 1),                    // 15
+    MB_REG(tSCS, CP_INDEX_OVERRIDE, MBT_U8, 0, 8),              // 16
+    MB_REG(tSCS, BC_MULT_OVERRIDE, MBT_X100, 0, 1000),          // 17
+    MB_REG(tSCS, SV_OVERRIDE, MBT_X100, 0, 400),                // 18
+    MB_REG(tSCS, CONFIG_LOCKOUT, MBT_U8, 0, 2),                 // 19
+    MB_REG(tSCS, ENGINE_WARMUP_DURATION, MBT_INT, 15, 600),     // 20
+    MB_REG(tSCS, REQURED_SENSORS, MBT_U8, 0, 255)};             // 21
+
+const tMBReg FLASH_TABLE MBCPSRegs[] = {
+    MB_REG(tCPS, ACPT_BAT_V_SETPOINT, MBT_X1000, 0, 20000),     //  0
+    MB_REG(tCPS, EXIT_ACPT_DURATION, MBT_MIN, 0, 600),          //  1
+    MB_REG(tCPS, EXIT_ACPT_AMPS, MBT_INT, -1, 200),             //  2
+    MB_REG(tCPS, LIMIT_OC_AMPS, MBT_INT, 0, 50),                //  3
+    MB_REG(tCPS, EXIT_OC_DURATION, MBT_MIN, 0, 600),            //  4
+    MB_REG(tCPS, EXIT_OC_VOLTS, MBT_X1000, 0, 20000),           //  5
+    MB_REG(tCPS, FLOAT_BAT_V_SETPOINT, MBT_X1000, 0, 20000),    //  6
+    MB_REG(tCPS, LIMIT_FLOAT_AMPS, MBT_INT, -1, 50),            //  7
+    MB_REG(tCPS, EXIT_FLOAT_DURATION, MBT_MIN, 0, 30000),       //  8
+    MB_REG(tCPS, FLOAT_TO_BULK_AMPS, MBT_INT, -300, 0),         //  9
+    MB_REG(tCPS, FLOAT_TO_BULK_AHS, MBT_INT, -250, 0),          // 10
+    MB_REG(tCPS, FLOAT_TO_BULK_VOLTS, MBT_X1000, 0, 20000),     // 11
+    MB_REG(tCPS, EXIT_PF_DURATION, MBT_MIN, 0, 30000),          // 12
+    MB_REG(tCPS, PF_TO_BULK_VOLTS, MBT_X1000, 0, 20000),        // 13
+    MB_REG(tCPS, PF_TO_BULK_AHS, MBT_INT, -250, 0),             // 14
+    MB_REG(tCPS, EQUAL_BAT_V_SETPOINT, MBT_X1000, 0, 25000),    // 15
+    MB_REG(tCPS, LIMIT_EQUAL_AMPS, MBT_INT, 0, 50),             // 16
+    MB_REG(tCPS, EXIT_EQUAL_DURATION, MBT_MIN, 0, 240),         // 17
+    MB_REG(tCPS, EXIT_EQUAL_AMPS, MBT_INT, 0, 50),              // 18
+    MB_REG(tCPS, BAT_TEMP_1C_COMP, MBT_X10000, 0, 1000),        // 19
+    MB_REG(tCPS, MIN_TEMP_COMP_LIMIT, MBT_INT, -30, 40),        // 20
+    MB_REG(tCPS, BAT_MIN_CHARGE_TEMP, MBT_INT, -50, 10),        // 21
+    MB_REG(tCPS, BAT_MAX_CHARGE_TEMP, MBT_INT, 20, 95),         // 22
+    MB_REG(tCPS, EXIT_ACPT_SOC, MBT_U8, 0, 100),                // 23
+    MB_REG(tCPS, FLOAT_TO_BULK_SOC, MBT_U8, 0, 100),            // 24
+    MB_REG(tCPS, CELL_TAPER_MV, MBT_U16, 0, 5000),              // 25
+    MB_REG(tCPS, CELL_MAX_MV, MBT_U16, 0, 5000),                // 26
+    MB_REG(tCPS, BALANCE_AMPS, MBT_U8, 0, 100),                 // 27
+    MB_REG(tCPS, BALANCE_SPREAD_MV, MBT_U8, 0, 250)};           // 28
+
+#define MB_SCS_REGS (sizeof(MBSCSRegs) / sizeof(tMBReg))
+#define MB_CPS_REGS (sizeof(MBCPSRegs) / sizeof(tMBReg))
+#define MB_SCS -1  // MB_find() - The registers are in the tSCS
+#define MB_NONE -2 //   or are not all in any one structure
+
+static_assert(MB_CPS_REGS <= MB_CPS_STRIDE, "MBCPSRegs[] - more registers than MB_CPS_STRIDE leaves room for");
+static_assert(MB_SCS_REGS <= MB_CPS_BASE, "MBSCSRegs[] - more registers than MB_CPS_BASE leaves room for");
+
+typedef union
+{ // Working copy of whichever structure the holding registers are in
+    tSCS scs;
+    tCPS cps;
+} tMBBlock;
+
+//---- CRC-16/MODBUS  (Reflected polynomial 0xA001, 0xFFFF start) - one table lookup per byte.
+const uint16_t FLASH_TABLE MBCRCTable[256] = {
+    0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+    0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+    0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+    0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+    0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+    0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+    0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+    0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+    0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+    0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+    0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+    0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+    0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+    0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+    0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+    0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+    0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+    0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+    0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+    0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+    0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+    0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+    0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+    0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+    0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+    0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+    0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+    0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+    0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+    0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+    0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+    0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040
+};
+
+//------------------------------------------------------------------------------------------------------
+// Modbus CRC-16
+//      Returns the CRC of the passed bytes.  It is sent low byte first, so a whole frame (CRC included) checks out to 0.
+//
+//------------------------------------------------------------------------------------------------------
+
+uint16_t MB_CRC16(const uint8_t *data, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+
+    while (len--)
+        crc = (crc >> 8) ^ FLASH_read_word(&MBCRCTable[(crc ^ *data++) & 0xFF]);
+
+    return (crc);
+} //MB_CRC16
+
+//-------       'helper' function used by MB_process();
+//              Takes a snapshot of all the Input Registers, so a multi-register read (ala a 32 bit value) is all from the same moment.
+static void MB_prep_inputs(uint16_t *regs)
+{
+    int32_t ahs = (accumulatedASecs / 3600L) * (int32_t)(ACCUMULATE_SAMPLING_RATE / 1000UL); // (Kept signed - the battery may be discharging)
+    int32_t whs = (accumulatedWSecs / 3600L) * (int32_t)(ACCUMULATE_SAMPLING_RATE / 1000UL);
+    uint32_t runTime = generatorLrRunTime / 1000UL;
+
+    regs[MB_IR_BAT_MV] = TO_mV(measuredBatVolts);
+    regs[MB_IR_BAT_DA] = TO_dA(measuredBatAmps);
+    regs[MB_IR_ALT_MV] = TO_mV(measuredAltVolts);
+    regs[MB_IR_ALT_DA] = TO_dA(measuredAltAmps);
+    regs[MB_IR_ALT_WATTS] = measuredAltWatts;
+    regs[MB_IR_BAT_TEMP] = measuredBatTemp;
+    regs[MB_IR_ALT_TEMP] = measuredAltTemp;
+    regs[MB_IR_FET_TEMP] = measuredFETTemp;
+    regs[MB_IR_RPMS] = measuredRPMs;
+    regs[MB_IR_FIELD_PWM] = fieldPWMvalue;
+    regs[MB_IR_FIELD_AMPS] = measuredFieldAmps;
+    regs[MB_IR_STATE] = chargingState;
+    regs[MB_IR_TARGET_BAT_MV] = TO_mV(targetBatVolts);
+    regs[MB_IR_TARGET_ALT_A] = (int)targetAltAmps;
+    regs[MB_IR_TARGET_ALT_W] = targetAltWatts;
+    regs[MB_IR_AHS_HI] = (uint32_t)ahs >> 16;
+    regs[MB_IR_AHS_LO] = (uint32_t)ahs & 0xFFFF;
+    regs[MB_IR_WHS_HI] = (uint32_t)whs >> 16;
+    regs[MB_IR_WHS_LO] = (uint32_t)whs & 0xFFFF;
+    regs[MB_IR_RUNTIME_HI] = runTime >> 16;
+    regs[MB_IR_RUNTIME_LO] = runTime & 0xFFFF;
+    regs[MB_IR_CP_INDEX] = cpIndex + 1;
+}
+
+//-------       'helper' function used by MB_process();
+//              Which structure are holding registers start .. start+count-1 in?   Returns MB_SCS, the Charge Profile index (0..MAX_CPES-1),
+//              or MB_NONE if they are not all in the same one.  *first is set to the 1st one's index in its register table.
+static int8_t MB_find(uint16_t start, uint16_t count, uint8_t *first)
+{
+    uint16_t n;
+
+    if (((uint32_t)start + count) <= MB_SCS_REGS)
+    {
+        *first = start;
+        return (MB_SCS);
+    }
+
+    if (start < MB_CPS_BASE)
+        return (MB_NONE);
+
+    n = (start - MB_CPS_BASE) / MB_CPS_STRIDE;
+    *first = (start - MB_CPS_BASE) % MB_CPS_STRIDE;
+
+    if ((n >= MAX_CPES) || ((*first + count) > MB_CPS_REGS))
+        return (MB_NONE);
+
+    return (n);
+}
+
+//-------       'helper' function used by MB_process();
+//              Loads the saved copy of the structure MB_find() found into *block - or if none has been saved, what is being used now.
+//              (The same as the $SC* and $CP* commands start from)   Returns the structure's register table.
+static const tMBReg *MB_load(int8_t which, tMBBlock *block)
+{
+    if (which == MB_SCS)
+    {
+        if (read_SCS_EEPROM(&block->scs) != true)
+            block->scs = systemConfig;
+        return (MBSCSRegs);
+    }
+
+    if (read_CPS_EEPROM(which, &block->cps) != true)
+        transfer_default_CPS(which, &block->cps);
+    return (MBCPSRegs);
+}
+
+//-------       'helper' functions used by MB_process();
+//              Get (or set) the register described by *reg in the passed structure, scaling it as its type says.  MB_put() returns FALSE if the
+//              value is outside the register's limits.
+static float MB_scale(uint8_t type)
+{
+    return ((type == MBT_X100) ? 100.0 : ((type == MBT_X1000) ? 1000.0 : 10000.0));
+}
+
+static uint16_t MB_get(const tMBReg *reg, const uint8_t *base)
+{
+    const void *p = base + reg->offset;
+
+    switch (reg->type)
+    {
+    case MBT_BOOL:
+        return (*(const bool *)p ? 1 : 0);
+    case MBT_U8:
+        return (*(const uint8_t *)p);
+    case MBT_INT:
+        return ((uint16_t)(*(const int *)p));
+    case MBT_U16:
+        return (*(const uint16_t *)p);
+    case MBT_MIN:
+        return ((uint16_t)(*(const uint32_t *)p / 60000UL));
+    default:
+        return ((uint16_t)(int16_t)lround(*(const float *)p * MB_scale(reg->type)));
+    }
+}
+
+static bool MB_put(const tMBReg *reg, uint8_t *base, uint16_t raw)
+{
+    void *p = base + reg->offset;
+    int32_t v;
+
+    v = ((reg->type == MBT_INT) || (reg->type >= MBT_X100)) ? (int32_t)(int16_t)raw : (int32_t)raw;
+    if ((v < reg->low) || (v > reg->high))
+        return (false);
+
+    switch (reg->type)
+    {
+    case MBT_BOOL:
+        *(bool *)p = (v != 0);
+        break;
+    case MBT_U8:
+        *(uint8_t *)p = v;
+        break;
+    case MBT_INT:
+        *(int *)p = v;
+        break;
+    case MBT_U16:
+        *(uint16_t *)p = v;
+        break;
+    case MBT_MIN:
+        *(uint32_t *)p = (uint32_t)v * 60000UL;
+        break;
+    default:
+        *(float *)p = (float)v / MB_scale(reg->type);
+        break;
+    }
+
+    return (true);
+}
+
+//-------       'helper' function used by MB_process();
+//              Writes count holding registers from start, with the values (high byte first) at data.  Either they all go in and the structure
+//              is saved back to EEPROM, or none do.   Returns 0, or the exception code.
+static uint8_t MB_write(uint16_t start, uint16_t count, const uint8_t *data)
+{
+    tMBBlock block;
+    tMBReg reg;
+    const tMBReg *regs;
+    uint8_t first;
+    int8_t which;
+
+    which = MB_find(start, count, &first);
+    if ((which == MB_NONE) || ((which != MB_SCS) && (which < (MAX_CPES - CUSTOM_CPES))))
+        return (MB_EX_ADDRESS); // (Only the last two Charge Profiles may be modified, as with $CP*)
+
+    if (systemConfig.CONFIG_LOCKOUT != 0)
+        return (MB_EX_FAILURE); // If system is locked-out, do not allow any changes...
+
+    regs = MB_load(which, &block);
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        FLASH_copy(&reg, &regs[first + i], sizeof(tMBReg));
+        if (!MB_put(&reg, (uint8_t *)&block, ((uint16_t)data[2 * i] << 8) | data[(2 * i) + 1]))
+            return (MB_EX_VALUE);
+    }
+
+    if (which == MB_SCS)
+        write_SCS_EEPROM(&block.scs);
+    else
+        write_CPS_EEPROM(which, &block.cps);
+
+    return (0);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Modbus Process
+//      Answers the passed RTU frame (Address, Function code, Data, CRC).  The response is built in its place, and its length
+//      returned - or 0 if there should be no response:  the frame was bad, not for us, or a broadcast.
+//
+//------------------------------------------------------------------------------------------------------
+
+uint16_t MB_process(uint8_t *frame, uint16_t len)
+{
+    tMBBlock block;
+    tMBReg reg;
+    const tMBReg *regs;
+    uint16_t inputs[MB_INPUT_REGS];
+    uint16_t start;
+    uint16_t count;
+    uint16_t v;
+    uint16_t crc;
+    uint8_t first;
+    int8_t which;
+    uint8_t ex = 0;
+    uint16_t n = 0;
+
+    if ((len < 4) || (MB_CRC16(frame, len) != 0))
+        return (0); // Too short to be anything, or damaged
+
+    if ((frame[0] != MODBUS_SLAVE_ID) && (frame[0] != 0))
+        return (0); // Someone else's
+
+    start = ((uint16_t)frame[2] << 8) | frame[3]; // (Not there for every function, but harmless to pick up)
+    count = ((uint16_t)frame[4] << 8) | frame[5];
+
+    switch (frame[1])
+    {
+    case MB_READ_HOLDING:
+    case MB_READ_INPUT:
+        if (len != 8)
+            return (0);
+        if ((count == 0) || (count > MB_MAX_READ))
+        {
+            ex = MB_EX_VALUE;
+            break;
+        }
+
+        if (frame[1] == MB_READ_INPUT)
+        {
+            if (((uint32_t)start + count) > MB_INPUT_REGS)
+            {
+                ex = MB_EX_ADDRESS;
+                break;
+            }
+            MB_prep_inputs(inputs);
+        }
+        else
+        {
+            which = MB_find(start, count, &first);
+            if (which == MB_NONE)
+            {
+                ex = MB_EX_ADDRESS;
+                break;
+            }
+            regs = MB_load(which, &block);
+        }
+
+        for (uint16_t i = 0; i < count; i++)
+        { // (start and count have been picked up, so the response can now go over the request)
+            if (frame[1] == MB_READ_INPUT)
+                v = inputs[start + i];
+            else
+            {
+                FLASH_copy(&reg, &regs[first + i], sizeof(tMBReg));
+                v = MB_get(&reg, (const uint8_t *)&block);
+            }
+            frame[3 + (2 * i)] = v >> 8;
+            frame[4 + (2 * i)] = v & 0xFF;
+        }
+        frame[2] = count * 2;
+        n = 3 + (count * 2);
+        break;
+
+    case MB_WRITE_SINGLE:
+        if (len != 8)
+            return (0);
+        ex = MB_write(start, 1, &frame[4]);
+        n = 6; // Response is the request, echoed back
+        break;
+
+    case MB_WRITE_MULTIPLE:
+        if ((len < 9) || (len != (9U + frame[6])))
+            return (0);
+        if ((count == 0) || (count > MB_MAX_WRITE) || (frame[6] != (count * 2)))
+        {
+            ex = MB_EX_VALUE;
+            break;
+        }
+        ex = MB_write(start, count, &frame[7]);
+        n = 6; // Response is the address, function, start, and count
+        break;
+
+    default:
+        ex = MB_EX_FUNCTION;
+        break;
+    }
+
+    if (frame[0] == 0)
+        return (0); // Broadcasts are never answered
+
+    if (ex != 0)
+    {
+        frame[1] |= 0x80;
+        frame[2] = ex;
+        n = 3;
+    }
+
+    crc = MB_CRC16(frame, n);
+    frame[n++] = crc & 0xFF;
+    frame[n++] = crc >> 8;
+
+    return (n);
+} //MB_process
+
+#ifdef USE_MODBUS
+//---- TX3 is wired to the Feature-in port 3 input (see MODBUS_USART in Config.h), so USART3 cannot be shared with it.
+#if (MODBUS_USART == 3) && ((defined(FEATURE_IN_EQUALIZE) && (FEATURE_IN_EQUALIZE_PORT == FEATURE_IN_PORT3)) ||                    \
+                            (defined(ENABLE_FEATURE_IN_SCUBA) && (ENABLE_FEATURE_IN_SCUBA_PORT == FEATURE_IN_PORT3)) ||          \
+                            (defined(FEATURE_IN_FORCE_TO_FLOAT) && (FEATURE_IN_FORCE_TO_FLOAT_PORT == FEATURE_IN_PORT3)) ||      \
+                            (defined(FEATURE_IN_RESTORE) && (FEATURE_IN_RESTORE_PORT == FEATURE_IN_PORT3)) ||                    \
+                            (defined(FEATURE_IN_OLED_SCREEN) && (FEATURE_IN_OLED_SCREEN_PORT == FEATURE_IN_PORT3)))
+#error "MODBUS_USART 3 - TX3 is the FEATURE_IN_PORT3 pin (D14), pick another USART or move that Feature-in off port 3  (see Config.h)"
+#endif
+
+//---- The USART the Modbus link is on is driven directly (see top of file), these pick out its registers and vectors.
+//     Bit positions are the same in all of the Mega's USARTs, so the USART0 names are used for them.
+#define MB_CAT(a, b, c) a##b##c
+#define MB_XCAT(a, b, c) MB_CAT(a, b, c)
+#define MB_UDR MB_XCAT(UDR, MODBUS_USART, )
+#define MB_UBRR MB_XCAT(UBRR, MODBUS_USART, )
+#define MB_UCSRA MB_XCAT(UCSR, MODBUS_USART, A)
+#define MB_UCSRB MB_XCAT(UCSR, MODBUS_USART, B)
+#define MB_UCSRC MB_XCAT(UCSR, MODBUS_USART, C)
+#define MB_RX_vect MB_XCAT(USART, MODBUS_USART, _RX_vect)
+#define MB_UDRE_vect MB_XCAT(USART, MODBUS_USART, _UDRE_vect)
+#define MB_TX_vect MB_XCAT(USART, MODBUS_USART, _TX_vect)
+
+#define MB_TICK_US 4UL                                                          // Timer 5 at F_CPU / 64
+#define MB_CHAR_US (11000000UL / MODBUS_BAUD)                                   // One character  (Start, 8 data, parity or 2nd stop, stop)
+#define MB_T15_US ((MODBUS_BAUD > 19200UL) ? 750UL : ((MB_CHAR_US * 3) / 2))    // Above 19200 Baud the spec fixes t1.5 and t3.5
+#define MB_T35_US ((MODBUS_BAUD > 19200UL) ? 1750UL : ((MB_CHAR_US * 7) / 2))
+#define MB_T15_TICKS ((MB_CHAR_US + MB_T15_US) / MB_TICK_US)                    // Timer 5 is restarted at the end of each character, so the next
+#define MB_T35_TICKS (MB_T35_US / MB_TICK_US)                                   //   one ends a character time later even with no gap at all.
+
+#define MBS_RECEIVING 0 // Assembling a request
+#define MBS_READY 1     //   Got one, waiting on check_MODBUS() to answer it
+#define MBS_SENDING 2   //   Sending the answer
+
+static uint8_t mbBuf[MB_MAX_FRAME]; // Request, and then the response built over it.  (RTU is half duplex, so one buffer does)
+static volatile uint16_t mbLen = 0;
+static volatile uint16_t mbTxPos = 0;
+static volatile uint8_t mbState = MBS_RECEIVING;
+static volatile bool mbBad = false; // The frame being received had a framing / overrun / parity error, a t1.5 gap, or was too long.
+
+ISR(MB_RX_vect)
+{
+    uint8_t err = MB_UCSRA & (_BV(FE0) | _BV(DOR0) | _BV(UPE0));
+    uint8_t c = MB_UDR;
+
+    if (mbState != MBS_RECEIVING)
+        return; // Still working on the last one (or sending its answer), this cannot be for us.
+
+    if ((mbLen > 0) && (TCNT5 > MB_T15_TICKS))
+        mbBad = true;
+
+    if ((err != 0) || (mbLen >= MB_MAX_FRAME))
+        mbBad = true;
+    else
+        mbBuf[mbLen++] = c;
+
+    TCNT5 = 0; // And look again in t3.5
+    TIFR5 = _BV(OCF5A);
+    TIMSK5 |= _BV(OCIE5A);
+}
+
+ISR(TIMER5_COMPA_vect)
+{ // The line has been quiet for t3.5 - that is the end of the frame.
+    TIMSK5 &= ~_BV(OCIE5A);
+
+    if (mbState != MBS_RECEIVING)
+        return;
+
+    if (mbBad || (mbLen == 0))
+    { // Throw away a bad one, and start looking for the next.
+        mbLen = 0;
+        mbBad = false;
+    }
+    else
+        mbState = MBS_READY;
+}
+
+ISR(MB_UDRE_vect)
+{
+    MB_UDR = mbBuf[mbTxPos++];
+
+    if (mbTxPos >= mbLen)
+        MB_UCSRB &= ~_BV(UDRIE0); // Last one is on its way, MB_TX_vect will see it out.
+}
+
+ISR(MB_TX_vect)
+{ // Last bit of the response has left, let go of the RS-485 bus and listen again.
+#ifdef MODBUS_DE_PIN
+    digitalWrite(MODBUS_DE_PIN, LOW);
+#endif
+    mbLen = 0;
+    mbBad = false;
+    mbState = MBS_RECEIVING;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Initialize Modbus
+//      Called once during Startup, sets up the Modbus USART and Timer 5.   (Which means Timer 5's PWM pins, 44..46, may not be
+//      used with analogWrite(), and the matching SerialN may not be used for anything else)
+//
+//------------------------------------------------------------------------------------------------------
+
+void initialize_MODBUS(void)
+{
+#ifdef MODBUS_DE_PIN
+    pinMode(MODBUS_DE_PIN, OUTPUT);
+    digitalWrite(MODBUS_DE_PIN, LOW);
+#endif
+
+    MB_UBRR = ((F_CPU / 4UL / MODBUS_BAUD) - 1) / 2; // (Double speed mode, as the Arduino core does it)
+    MB_UCSRA = _BV(U2X0);
+    MB_UCSRC = MODBUS_CONFIG;
+    MB_UCSRB = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0) | _BV(TXCIE0);
+
+    TCCR5A = 0; // Normal mode, count up and wrap
+    TCCR5B = _BV(CS51) | _BV(CS50);
+    OCR5A = MB_T35_TICKS;
+    TIMSK5 = 0;
+} //initialize_MODBUS
+
+//------------------------------------------------------------------------------------------------------
+// Check Modbus
+//      Called from the Mainloop.  If a request has come in, answer it and start the response on its way.
+//
+//------------------------------------------------------------------------------------------------------
+
+void check_MODBUS(void)
+{
+    uint16_t n;
+
+    if (mbState != MBS_READY)
+        return;
+
+    n = MB_process(mbBuf, mbLen); // (The receive interrupt leaves mbBuf[] alone until mbState is put back)
+
+    if (n == 0)
+    {
+        mbLen = 0;
+        mbState = MBS_RECEIVING;
+        return;
+    }
+
+#ifdef MODBUS_DE_PIN
+    digitalWrite(MODBUS_DE_PIN, HIGH);
+#endif
+    mbLen = n;
+    mbTxPos = 0;
+    mbState = MBS_SENDING;
+    MB_UCSRA = (MB_UCSRA & _BV(U2X0)) | _BV(TXC0); // Clear any old Transmit Complete, so MB_TX_vect only sees the end of this one.
+    MB_UCSRB |= _BV(UDRIE0);
+} //check_MODBUS
+#endif // USE_MODBUS
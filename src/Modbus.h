@@ -0,0 +1,72 @@
+// Modbus.h
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+#ifndef _MODBUS_H_
+#define _MODBUS_H_
+
+#include "Config.h"
+
+//----- Modbus RTU slave.   Function codes 03 (Read Holding), 04 (Read Input), 06 (Write Single) and 16 (Write Multiple).
+//      Registers are 16 bits, sent high byte first.  32 bit values take two registers, high word first.
+//      Out of range addresses get exception 02, out of limit values exception 03 (and nothing is saved), writes while
+//      CONFIG_LOCKOUT is set exception 04.   Broadcast (address 0) writes are done, but not answered.
+//
+//----- Input Registers  (Read only, a snapshot taken as each request is answered)
+#define MB_IR_BAT_MV          0 // Battery Volts, in mV                 (Same fixed-point as the binary AST, see BinTelemetry.h)
+#define MB_IR_BAT_DA          1 // Battery Amps, in 0.1A                (signed)
+#define MB_IR_ALT_MV          2 // Alternator Volts, in mV
+#define MB_IR_ALT_DA          3 // Alternator Amps, in 0.1A             (signed)
+#define MB_IR_ALT_WATTS       4
+#define MB_IR_BAT_TEMP        5 // Deg C                                (signed, -99 = no sensor)
+#define MB_IR_ALT_TEMP        6
+#define MB_IR_FET_TEMP        7
+#define MB_IR_RPMS            8 // Engine RPMs
+#define MB_IR_FIELD_PWM       9 // fieldPWMvalue, 0..FIELD_PWM_MAX
+#define MB_IR_FIELD_AMPS     10
+#define MB_IR_STATE          11 // chargingState  (tModes)
+#define MB_IR_TARGET_BAT_MV  12
+#define MB_IR_TARGET_ALT_A   13 // Whole Amps
+#define MB_IR_TARGET_ALT_W   14
+#define MB_IR_AHS_HI         15 // Ahs since power-on  (signed 32 bit)
+#define MB_IR_AHS_LO         16
+#define MB_IR_WHS_HI         17 // Whs since power-on  (signed 32 bit)
+#define MB_IR_WHS_LO         18
+#define MB_IR_RUNTIME_HI     19 // Seconds the alternator has been running  (32 bit)
+#define MB_IR_RUNTIME_LO     20
+#define MB_IR_CP_INDEX       21 // Charge Profile in use, 1..MAX_CPES
+#define MB_INPUT_REGS        22
+
+//----- Holding Registers  (Read / Write, backed by the saved copies in EEPROM - see Flash.cpp)
+//      As with the $SC* and $CP* commands, changes are saved right away but only used after a reboot ($RBT).
+//
+//      0..MB_SCS_REGS-1        System Configuration  (tSCS) - see MBSCSRegs[] in Modbus.cpp for the order and scaling
+//      MB_CPS_BASE + (MB_CPS_STRIDE * n) + 0..MB_CPS_REGS-1
+//                              Charge Profile n  (tCPS, n = 0..MAX_CPES-1) - see MBCPSRegs[].  Only the last CUSTOM_CPES may be written.
+#define MB_CPS_BASE         100
+#define MB_CPS_STRIDE        32
+
+#define MB_MAX_FRAME        256 // Longest RTU frame (Address + PDU + CRC)
+#define MB_MAX_READ         125 // Most registers one request may read
+#define MB_MAX_WRITE        123 //   or write
+
+uint16_t MB_CRC16(const uint8_t *data, uint16_t len);
+uint16_t MB_process(uint8_t *frame, uint16_t len);
+void initialize_MODBUS(void);
+void check_MODBUS(void);
+
+#endif // _MODBUS_H_
@@ -25,14 +25,83 @@
 #include "Sensors.h"
 #include "Flash.h"
 #include "Alternator.h"
+#include "GainSchedule.h"
+#include "SOC.h"
+#include "BMS_SERIAL.h"
+#include "History.h"
+#include "SerialDisplay.h"
 
-extern void WriteOLEDDynamicData(void);
 
-char ibBuf[INBOUND_BUFF_SIZE + 1]; // Static buffer used to assemble inbound data in background. (+1 to allow for NULL terminator)
-bool ibBufFilling = false;         // Static flag used to manage filling of ibBuf.  If this is set = true, we have indentified the start of
-                                   // a new command 'string' and are working to get the rest of it.
-                                   // During this time period, all normal 'status updates' outputs from the regulator will be suspended.
-                                   // This is to make a more direct linkage between a command that asks for a response and the actual response.
+//---- The command's fields are parsed as each character arrives (see IB_parse()), so there is nothing left to do but hand them out
+//     once the whole command is in.  Numbers are held as a whole part plus a fixed-point fraction - no atof() needed.
+#define IB_FRAC_DIGITS 4         // Decimal places kept in the fraction  (Must match IBFracWeight[])
+#define IB_WHOLE_MAX 1000000L    // Whole part saturates here, rather than wrapping around as atoi() would have.
+
+#define IBF_STARTED 0x01         // Have seen a sign, digit, or '.'   (Until then, leading spaces are skipped - as atoi() did)
+#define IBF_NEG 0x02             //   It was a '-' sign
+#define IBF_FRAC 0x04            //   Now past the '.'
+#define IBF_DONE 0x08            // Hit something that is not part of a number, the rest of the field is ignored.  (Again, as atoi() did)
+
+typedef struct
+{
+    int32_t whole;  // Whole part  (Without the sign)
+    uint16_t frac;  // Fraction, in 1/10000ths
+    uint8_t start;  // Where in ibBuf[] the field starts
+    uint8_t state;  // IBF_xxx, plus the number of fraction digits taken so far in the upper nibble
+} tIBField;
+
+const uint16_t PROGMEM IBFracWeight[IB_FRAC_DIGITS] = {1000, 100, 10, 1};
+
+//---- Commands are taken from each serial port listed in ibPorts[], and each has its own command buffer and parser state so commands
+//     arriving on two ports at once do not get mixed together.   Responses are sent back out the port the command came from.
+typedef struct
+{
+    HardwareSerial *serial;
+    uint8_t txPort;                     // TX_PORT_xxx  - Where responses go, and also which status messages are held back while filling  (see send_outbound())
+    uint8_t perms;                      // IBP_xxx      - Which commands may be given from this port
+    char buf[INBOUND_BUFF_SIZE + 1];    // Buffer used to assemble inbound data in background. (+1 to allow for NULL terminator)
+    uint8_t index;                      // Next character goes here
+    bool filling;                       // Set = true once we have indentified the start of a new command 'string' and are working to get the rest of it.
+                                        //   During this time period, all normal 'status updates' to the port will be suspended.
+                                        //   This is to make a more direct linkage between a command that asks for a response and the actual response.
+    uint32_t fillStarted;               // Will contain the time the last 'start' of a string happened
+    tIBField fields[IB_MAX_FIELDS];
+    uint8_t fieldCount;                 // Fields found so far in the current command  (The last one may still be filling)
+    bool inField;                       // Is the next character part of fields[fieldCount-1]?   (FALSE = it starts a new one)
+} tIBPort;
+
+tIBPort ibPorts[] = {
+    {&Serial, TX_PORT_ASCII, IBP_ALL},
+#ifdef USE_SERIAL_DISPLAY
+    {&SERIAL_DISPLAY_PORT, TX_PORT_DISPLAY, SERIAL_DISPLAY_PERMS}, // (Skipped if SERIAL_DISPLAY_PORT is also Serial)
+#endif
+};
+
+#define IB_PORTS (sizeof(ibPorts) / sizeof(tIBPort))
+
+tIBPort *ibPort = &ibPorts[0]; // Port the command being run came from  (Or the ASCII port, when no command is being run)
+char *ibBuf = ibPorts[0].buf;  //   and its command string, for the handlers.
+uint8_t ibFieldNext = 0;       // Next field the getXXX() helpers will hand out
+
+#define BKW_NONE 0                 // bkLoadWait - Nothing
+#define BKW_CHUNK 1                //   The last chunk received
+#define BKW_COMMIT 2               //   The whole image, being put in place
+
+static int16_t bkSendAt = -1;  // $BKS:  Offset of the next Config Backup image chunk to send  (-1 = not sending one)
+static int16_t bkLoadAt = -1;  // $BKL:  Offset of the next chunk expected  (-1 = not loading one)
+static int16_t bkLoadPrev;     //   and of the last one stored, in case it is sent again
+static uint32_t bkLoadLast;    //   and when that was
+static uint8_t bkLoadWait = BKW_NONE; //   and what is still going into EEPROM, to be AOK'd once it is there
+
+#ifdef USE_HISTORY
+static int8_t hisSendLevel = -1; // $HIS:  Level of the next Charge History records to send  (-1 = not sending any)
+static int8_t hisLastLevel;      //   and the last level to send
+static uint32_t hisSendSeq;      //   and the seq of the next record
+static uint8_t hisSendPort;      //   to this TX_PORT_xxx
+static bool hisSendFramed;       //   as BT_HISTORY frames?  (Else as HIS; strings)
+#endif
+
+static_assert((BT_BACKUP_FRAME - 1) <= (INBOUND_BUFF_SIZE + 1), "BT_BACKUP_CHUNK - a $BKL: frame will not fit in the inbound buffer");
 
 //---- Local only helper function prototypes for Check_inbound() & Send_outbound()
 bool getInt(char *buffer, int *dest, int LLim, int HLim);
@@ -42,9 +111,14 @@ bool getDurationS(char *buffer, uint32_t *dest, int HLim);
 bool getDurationTh(char *buffer, uint32_t *dest, int HLim);
 bool getFloat(char *buffer, float *dest, float LLim, float HLim);
 bool getBool(char *buffer, bool *dest);
-void append_string(char *dest, const char *src, int n);
 void send_AOK(void);
+void send_AOK_to(uint8_t port);
 
+bool BIN_handler(char *StrPtr);  //$BIN:1,r - Switch to BINary telemetry, AST sent every r mS (100..32767, default as subscribed)
+                                 //$BIN:2,r - Switch to BINary telemetry, sending only what has changed
+                                 //$BIN:0 - Switch back to ASCII
+bool BKx_handler(char *StrPtr);  //$BKS: - Send the Config BacKup image  (All the saved configuration, see BinTelemetry.h)
+                                 //$BKL: - Load a Config BacKup image, which follows as BT_BACKUP frames
 // NOT NEEDED IN SHIELD VERSION -- bool CCx_handler(char *StrPtr);  //$CCN: - Change parameters in the CAN Configuration table
                                  //$CCR: - RESTORES CAN Configuration table to defaul
 bool CPx_handler(char *StrPtr);  //$CPA:n - Change ACCEPT parameters in CPE user entry n (n = 7 or 8)
@@ -53,10 +127,26 @@ bool CPx_handler(char *StrPtr);  //$CPA:n - Change ACCEPT parameters in CPE user
                                  //$CPP:n - Change POST-FLOAT parameters in CPE user entry n (n = 7 or 8) 
                                  //$CPE:n - Change EQUALIZE parameters in CPE user entry n (n = 7 or 8)
                                  //$CPB:n - Change BATTERY parameters in CPE user entry n (n = 7 or 8) 
+                                 //$CPS:n - Change STATE OF CHARGE parameters in CPE user entry n (n = 7 or 8)
+                                 //$CPC:n - Change CELL BALANCING parameters in CPE user entry n (n = 7 or 8)
                                  //$CPR:n - RESTORES Charge Profile ‘n’ to default values
 //bool EBA_handler(char* StrPtr);  REDACTED  2-26-2018
+bool DLT_handler(char *StrPtr);  //$DLT:t,d - Set the Delta mode deadband of AST field t to d
+#ifdef USE_SERIAL_DISPLAY
+bool DRS_handler(char *StrPtr);  //$DRS: - Display ReSync, send the Serial Display all of its fields
+                                 //$DRS:1 - and from now on as binary frames  ($DRS:0 - as ASCII frames)
+#endif
 bool EDB_handler(char *StrPtr);  //$EDB: - Enable DeBug serial strings
 bool FRM_handler(char *StrPtr);  //$FRM: - Force Regulator Mode
+#ifdef USE_GAIN_SCHEDULING
+bool GSx_handler(char *StrPtr);  //$GSS: - Set one multiplier in the PID Gain Schedule
+                                 //$GSR: - RESTORES the PID Gain Schedule to default
+bool RGS_handler(char *StrPtr);  //$RGS: - Request to send back the PID Gain Schedule
+#endif
+#ifdef USE_HISTORY
+bool HIS_handler(char *StrPtr);  //$HIS: - Request to send back the Charge HIStory  (All levels)
+                                 //$HIS:n - Request to send back level n of the Charge History
+#endif
 bool MSR_handler(char *StrPtr);  //$MSR: - RESTORE all parameters (to as defined at program compile time)
 bool RAS_handler(char *StrPtr);  //$RAS: - Request All Status back
 bool RBT_handler(char *StrPtr);  //$RBT: - ReBooT system
@@ -67,109 +157,502 @@ bool SCx_handler(char *StrPtr);  //$SCA: - Changes ALTERNATOR parameters in Syst
                                  //$SCO: - Override features
                                  //  NOT PARSED: $SCN: - Changes NAME (and PASSWORD)  
                                  //$SCR: - RESTORES System Configuration table to default
+bool SUB_handler(char *StrPtr);  //$SUB:m,e,s,p - SUBscribe to status message m: enabled, every s seconds, to port p
+                                 //$SUB: - Request to send back the Subscriptions
+                                 //$SUB:R - RESTORES the Subscriptions to default
+
+void prep_AST(tTXWriter *w);     //AST; -- ALTERNATOR STATUS
+void prep_CPE(tTXWriter *w, tCPS *cpsPtr, int Index); //CPE; -- CHARGE PROFILE ENTRY
+void prep_default_CPE(tTXWriter *w); //CPE; -- CHARGE PROFILE ENTRY
+void prep_SST(tTXWriter *w);     //SST; -- SYSTEM STATUS 
+void prep_SCV(tTXWriter *w);     //SCV; -- SYSTEM CONFIGURATION
+void prep_SUB(tTXWriter *w);     //SUB; -- STATUS SUBSCRIPTIONS
+#ifdef USE_GAIN_SCHEDULING
+void prep_PGS(tTXWriter *w);     //PGS; -- PID GAIN SCHEDULE
+#endif
+#ifdef USE_SOC_ESTIMATOR
+void prep_SOC(tTXWriter *w);     //SOC; -- BATTERY STATE OF CHARGE
+#endif
+#ifdef USE_BMS_SERIAL_IN
+void prep_BMS(tTXWriter *w);     //BMS; -- BMS LIMITS AND STATUS
+#endif
+#ifdef USE_HISTORY
+void prep_HIS(tTXWriter *w, uint8_t level, uint32_t seq, const tBTHistRec *rec); //HIS; -- CHARGE HISTORY RECORD
+#endif
 
-void prep_AST(char *buffer);     //AST; -- ALTERNATOR STATUS
-void prep_CPE(char *buffer, tCPS *cpsPtr, int Index); //CPE; -- CHARGE PROFILE ENTRY
-void prep_default_CPE(char *buffer); //CPE; -- CHARGE PROFILE ENTRY
-void prep_SST(char *buffer);     //SST; -- SYSTEM STATUS 
-void prep_SCV(char *buffer);     //SCV; -- SYSTEM CONFIGURATION
+uint8_t bprep_AST(void *buffer); // Binary forms of the above, see BinTelemetry.h
+uint8_t bprep_CPE(void *buffer, tCPS *cpsPtr, int index);
+uint8_t bprep_default_CPE(void *buffer);
+uint8_t bprep_SST(void *buffer);
+uint8_t bprep_SCV(void *buffer);
 
 typedef struct
 {
     char command[3];
     bool (*handler)(char *strPtr); // Return TRUE and 'AOK' will be sent to serial port.
+    uint8_t perms;                 // IBP_xxx - The port the command came from must allow this
 } tIBHandlers;
 
-const tIBHandlers IBHandlers[] = {   // Lookup table used by check_inbound()
-   // NOT NEEDED IN SHIELD VERSION (CAN) {{'C', 'C', '*'}, &CCx_handler}, //!! HEY!!!  Can we get this into PROGMEM sometime?
-    {{'C', 'P', '*'}, &CPx_handler},
+//---- Command dispatch table, used by check_inbound().   Rather than scanning it, each command is placed in the slot
+//     its 1st two letters hash to - that is all the wild-card commands have, and no two commands share them.  So the one
+//     slot IB_HASH() picks is the only one that can match.   When adding a command put it in its slot (the static_assert
+//     below will complain if it is wrong), and if that slot is taken try another multiplier until they all fit.
+#define IB_HASH(c0, c1) (((((uint8_t)(c0)) << 1) + (((uint8_t)(c1)) * 5)) & (IB_HASH_SIZE - 1))
+#define IB_EMPTY {{0, 0, 0}, NULL, 0}
+
+constexpr tIBHandlers IBHandlers[IB_HASH_SIZE] PROGMEM = {
+    IB_EMPTY, IB_EMPTY,
+#ifdef USE_SERIAL_DISPLAY
+    {{'D', 'R', 'S'}, &DRS_handler, IBP_READ},      //  2
+#else
+    IB_EMPTY,
+#endif
+    IB_EMPTY,
+    {{'D', 'L', 'T'}, &DLT_handler, IBP_READ},      //  4
+    IB_EMPTY,
+    {{'F', 'R', 'M'}, &FRM_handler, IBP_CONTROL},   //  6
+#ifdef USE_GAIN_SCHEDULING
+    {{'R', 'G', 'S'}, &RGS_handler, IBP_READ},      //  7
+#else
+    IB_EMPTY,
+#endif
+    IB_EMPTY,
+    {{'R', 'A', 'S'}, &RAS_handler, IBP_READ},      //  9
+    IB_EMPTY, IB_EMPTY, IB_EMPTY,
+#ifdef USE_GAIN_SCHEDULING
+    {{'G', 'S', '*'}, &GSx_handler, IBP_CONFIG},    // 13
+#else
+    IB_EMPTY,
+#endif
+    {{'R', 'B', 'T'}, &RBT_handler, IBP_CONTROL},   // 14
+    {{'S', 'U', 'B'}, &SUB_handler, IBP_READ},      // 15
+    IB_EMPTY,
+    {{'B', 'I', 'N'}, &BIN_handler, IBP_READ},      // 17
+    IB_EMPTY,
+    {{'R', 'C', 'P'}, &RCP_handler, IBP_READ},      // 19
+    IB_EMPTY,
+    {{'S', 'C', '*'}, &SCx_handler, IBP_CONFIG},    // 21
+    {{'C', 'P', '*'}, &CPx_handler, IBP_CONFIG},    // 22
+    IB_EMPTY, IB_EMPTY,
+    {{'M', 'S', 'R'}, &MSR_handler, IBP_RESTORE},   // 25
+    IB_EMPTY,
+    {{'B', 'K', '*'}, &BKx_handler, IBP_CONFIG},    // 27
+    IB_EMPTY,
+#ifdef USE_HISTORY
+    {{'H', 'I', 'S'}, &HIS_handler, IBP_READ},      // 29
+#else
+    IB_EMPTY,
+#endif
+    {{'E', 'D', 'B'}, &EDB_handler, IBP_READ},      // 30
+    IB_EMPTY};
+    // NOT NEEDED IN SHIELD VERSION (CAN) {{'C', 'C', '*'}, &CCx_handler, IBP_CONFIG} would land in slot 21 (SC*), and so would need another multiplier.
     // {{'E','B','A'},  &EBA_handler},  REDACTED 2-18-2018
-    {{'E', 'D', 'B'}, &EDB_handler},
-    {{'F', 'R', 'M'}, &FRM_handler},
-    {{'M', 'S', 'R'}, &MSR_handler},
-    {{'R', 'A', 'S'}, &RAS_handler},
-    {{'R', 'B', 'T'}, &RBT_handler},
-    {{'R', 'C', 'P'}, &RCP_handler},
-    {{'S', 'C', '*'}, &SCx_handler},
-    {{0, 0, 0}, NULL}};
+
+constexpr bool IB_slots_ok(uint8_t i)
+{ // Checked at compile time:  Is every command in the slot it hashes to?
+    return ((i >= IB_HASH_SIZE) ||
+            (((IBHandlers[i].command[0] == 0) || (IB_HASH(IBHandlers[i].command[0], IBHandlers[i].command[1]) == i)) && IB_slots_ok(i + 1)));
+}
+static_assert(IB_slots_ok(0), "IBHandlers[] - a command is not in the slot IB_HASH() puts it in");
 
 typedef struct
 {
-    void (*preper)(char *strPtr);
-    bool HP;
+    void (*preper)(tTXWriter *w);
+    uint8_t (*binPreper)(void *bufPtr); // Fills in the binary form, returns its size.  (NULL = none, send the ASCII string in a BT_TEXT frame)
+    uint8_t binType;
+    uint8_t subID;                      // SUB_xxx - which Subscription controls how often (and where) it is sent
 } tOBPrepers;
 
 const tOBPrepers OBPrepers[] = {
-    {&prep_AST, true},
-    {&prep_default_CPE, false},
-    {&prep_SST, false},
-    {&prep_SCV, false},
-    {NULL, false}};
+    {&prep_AST, &bprep_AST, BT_AST, SUB_AST},
+    {&prep_default_CPE, &bprep_default_CPE, BT_CPE, SUB_CPE},
+    {&prep_SST, &bprep_SST, BT_SST, SUB_SST},
+    {&prep_SCV, &bprep_SCV, BT_SCV, SUB_SCV},
+#ifdef USE_SOC_ESTIMATOR
+    {&prep_SOC, NULL, BT_TEXT, SUB_SOC},
+#endif
+#ifdef USE_BMS_SERIAL_IN
+    {&prep_BMS, NULL, BT_TEXT, SUB_BMS},
+#endif
+    {NULL, NULL, 0, 0}};
+
+const tSUB PROGMEM defaultSUB = {
+    // AST               CPE     SST     SCV     SOC     BMS     DBG    (spare)
+    {UPDATE_STATUS_RATE, 30000U, 30000U, 30000U, 30000U, 30000U, 1000U, 30000U}, // PERIOD - mS
+    {TX_PORT_ASCII, TX_PORT_ASCII, TX_PORT_ASCII, TX_PORT_ASCII, TX_PORT_ASCII, TX_PORT_ASCII, TX_PORT_ASCII, TX_PORT_ASCII}, // PORT
+    (uint8_t) ~(1 << SUB_DBG)}; // ENABLED - everything but the DBG string  (That still needs a $EDB:, or a $SUB: for it)
+
+tSUB subscriptions; // Working copy of the Subscriptions, see initialize_SUB()
+
+//------------------------------------------------------------------------------------------------------
+// Initialize Subscriptions
+//      Called once during Startup.  Fetches the saved Subscriptions from EEPROM, or if there are none
+//      uses the defaults:  AST every second, the others every 30 seconds, all to the ASCII port.
+//
+//------------------------------------------------------------------------------------------------------
+
+void initialize_SUB(void)
+{
+    if (read_SUB_EEPROM(&subscriptions) != true)
+        transfer_default_SUB(&subscriptions);
+} //initialize_SUB
+
+void transfer_default_SUB(tSUB *subPtr)
+{
+    uint8_t *wp = (uint8_t *)subPtr;
+    uint8_t *ep = (uint8_t *)&defaultSUB; //----- Copy the default Subscriptions from FLASH into the working structure
+
+    for (unsigned int u = 0; u < sizeof(tSUB); u++)
+        *wp++ = (uint8_t)pgm_read_byte_near(ep++);
+} //transfer_default_SUB
+
+//-------       'helper' function used by fill_ib_buffer();
+//              Parses each character of the command's fields as it arrives, so by the time the terminator is seen the
+//              numbers are all ready for the getXXX() helpers.  Follows the lead of the strtok() / atoi() / atof() calls it replaces:
+//              empty fields (ala ",,") are passed over, leading spaces are skipped, and anything that is not part of a number ends it.
+//              Returns FALSE if there are more than IB_MAX_FIELDS fields - the command should be abandoned.
+static bool IB_parse(tIBPort *p, char c)
+{
+    tIBField *fp;
+    uint8_t places;
+
+    if (p->index < 4)
+        return (true); // Still in the command itself  ("xxx:")
+
+    if (c == ',')
+    {
+        p->inField = false; // The next character (if it is not another ',') starts a new field.
+        return (true);
+    }
+
+    if (!p->inField)
+    {
+        if (p->fieldCount >= IB_MAX_FIELDS)
+            return (false);
+
+        fp = &p->fields[p->fieldCount++];
+        fp->whole = 0;
+        fp->frac = 0;
+        fp->start = p->index;
+        fp->state = 0;
+        p->inField = true;
+    }
+    else
+        fp = &p->fields[p->fieldCount - 1];
+
+    if (fp->state & IBF_DONE)
+        return (true);
+
+    if ((c >= '0') && (c <= '9'))
+    {
+        if (fp->state & IBF_FRAC)
+        {
+            places = fp->state >> 4;
+            if (places < IB_FRAC_DIGITS)
+            { // (Any digits past what we keep are dropped)
+                fp->frac += (c - '0') * pgm_read_word_near(&IBFracWeight[places]);
+                fp->state += 0x10;
+            }
+        }
+        else if (fp->whole < (IB_WHOLE_MAX / 10))
+            fp->whole = (fp->whole * 10) + (c - '0');
+        else
+            fp->whole = IB_WHOLE_MAX;
+
+        fp->state |= IBF_STARTED;
+    }
+    else if ((c == '.') && !(fp->state & IBF_FRAC))
+        fp->state |= (IBF_FRAC | IBF_STARTED);
+    else if (((c == '-') || (c == '+')) && !(fp->state & IBF_STARTED))
+        fp->state |= ((c == '-') ? (IBF_NEG | IBF_STARTED) : IBF_STARTED);
+    else if (((c == ' ') || (c == '\t')) && !(fp->state & IBF_STARTED))
+        ; // Skip leading white space
+    else
+        fp->state |= IBF_DONE;
+
+    return (true);
+} //IB_parse
+
+//-------       'helper' function used by fill_ib_buffer();
+//              Starts (or abandons) a command, leaving nothing of any prior one for check_inbound() or the getXXX() helpers to find.
+static void IB_reset(tIBPort *p, bool filling)
+{
+    p->buf[0] = 0;
+    p->index = 0;
+    p->fieldCount = 0;
+    p->inField = false;
+    p->filling = filling;
+    p->fillStarted = millis();
+} //IB_reset
+
+//-------       'helper' function used by send_outbound();
+//              Is a command being assembled on the port status messages to TX_PORT_xxx port would go out of?
+//              (Or a Config Backup image being passed over it - that has the port to itself until done)
+static bool IB_filling(uint8_t port)
+{
+    if (((bkSendAt >= 0) || (bkLoadAt >= 0)) && (TX_ring(port) == &asciiTX))
+        return (true);
+
+    for (uint8_t i = 0; i < IB_PORTS; i++)
+        if ((ibPorts[i].filling == true) && (TX_ring(ibPorts[i].txPort) == TX_ring(port)))
+            return (true);
+
+    return (false);
+} //IB_filling
+
+//-------       'helper' functions used by the command handlers;
+//              Where should a response go, and how?   (Binary telemetry is only ever used on the ASCII port)
+static tTXRing *IB_reply_ring(void)
+{
+    return (TX_ring(ibPort->txPort));
+}
+
+static uint8_t IB_reply_mode(void)
+{
+    return (((IB_reply_ring() == &asciiTX) && binaryMode) ? TXW_FRAMED : 0);
+}
+
+//-------       'helper' function used by fill_ib_buffer();
+//              Takes in the BT_BACKUP frames following $BKL: on the ASCII port, passing each chunk along to write_BK_image() and
+//              AOK'ing it once it is in EEPROM.  (See BinTelemetry.h)   The frame is assembled in the port's command buffer, nothing else
+//              is using it now.  The EEPROM is written a little each pass by update_BK_image(), and the next frame is left waiting in
+//              the port until it is done - the host sends no more until the AOK anyway.
+static void BK_load(tIBPort *p)
+{
+    uint8_t c;
+    int16_t len;
+    int16_t offset;
+
+    if (!update_BK_image())
+    {
+        bkLoadLast = millis(); // (Not the host's doing, so no timing out)
+        return;
+    }
+
+    switch (bkLoadWait)
+    {
+    case BKW_CHUNK:
+        bkLoadWait = BKW_NONE;
+        if (bkLoadAt < (int16_t)sizeof(tBKImage))
+        {
+            send_AOK_to(TX_PORT_ASCII);
+            break;
+        }
+        if (commit_BK_image())
+        { // That was the last of it, and it checks out.  Put it in place, and AOK it once it is.
+            bkLoadWait = BKW_COMMIT;
+            return;
+        }
+        bkLoadAt = -1;
+        break;
+
+    case BKW_COMMIT:
+        bkLoadWait = BKW_NONE;
+        send_AOK_to(TX_PORT_ASCII);
+        bkLoadAt = -1;
+        break;
+    }
+
+    while ((bkLoadAt >= 0) && ASCII_RxAvailable(p->serial))
+    {
+        c = ASCII_read(p->serial);
+
+        if (c != 0x00)
+        { // Still collecting the frame
+            if (p->index < sizeof(p->buf))
+                p->buf[p->index] = c;
+            if (p->index < 0xFF)
+                p->index++; //   (Too long and it is thrown away at its 0x00)
+            continue;
+        }
+
+        len = (p->index <= sizeof(p->buf)) ? BT_decode((uint8_t *)p->buf, p->index) : -1;
+        p->index = 0;
+
+        if ((len < (int16_t)offsetof(tBTBackup, data)) || ((uint8_t)p->buf[0] != BT_BACKUP))
+            continue; // Damaged, with no AOK the host will send it again.
+
+        offset = (uint8_t)p->buf[1] | ((uint16_t)(uint8_t)p->buf[2] << 8);
+        len -= offsetof(tBTBackup, data);
+        bkLoadLast = millis();
+
+        if ((offset == bkLoadPrev) && (offset != bkLoadAt))
+        { // Host missed the AOK for the last one
+            send_AOK_to(TX_PORT_ASCII);
+            continue;
+        }
+
+        if (!write_BK_image(offset, (const uint8_t *)&p->buf[1 + offsetof(tBTBackup, data)], len))
+        { // Out of order, or too much of it.  Give up.
+            bkLoadAt = -1;
+            break;
+        }
+
+        bkLoadPrev = offset;
+        bkLoadAt = offset + len;
+        bkLoadWait = BKW_CHUNK; // AOK'd once update_BK_image() has it in EEPROM.
+        break;
+    }
+
+    if ((bkLoadAt >= 0) && ((millis() - bkLoadLast) > BK_LOAD_TIMEOUT))
+        bkLoadAt = -1; // Host has gone away.
+
+    if (bkLoadAt < 0)
+        IB_reset(p, false); // Back to taking commands
+} //BK_load
+
+//-------       'helper' function used by send_outbound();
+//              Sends the next chunks of the Config Backup image asked for by $BKS:, as room in the ASCII ring allows.
+static void BK_send(void)
+{
+    static const uint8_t sync = 0x00;
+    tBTBackup chunk;
+    uint8_t len;
+
+    while (TX_free(&asciiTX) >= (BT_BACKUP_FRAME + TX_HP_RESERVE))
+    {
+        if (bkSendAt == 0)
+            TX_write_bytes(&asciiTX, &sync, 1, true); // End anything the host has half received, so the 1st frame is seen whole.
+
+        len = read_BK_image(bkSendAt, chunk.data, BT_BACKUP_CHUNK);
+        if (len == 0)
+        { // All sent
+            bkSendAt = -1;
+            send_AOK_to(TX_PORT_ASCII);
+            return;
+        }
+
+        chunk.offset = bkSendAt;
+        BT_send(BT_BACKUP, &chunk, offsetof(tBTBackup, data) + len, true);
+        bkSendAt += len;
+    }
+} //BK_send
+
+#ifdef USE_HISTORY
+//-------       'helper' function used by send_outbound();
+//              Sends the next Charge History records asked for by $HIS:, as room in the ring allows.  A level is sent from the
+//              oldest record it holds up to the newest, including any made while it was being sent.
+static void HIS_send(void)
+{
+    tTXRing *ring = TX_ring(hisSendPort);
+    tTXWriter w;
+    tBTHistory frame;
+    uint8_t n;
+
+    while (TX_free(ring) >= (BT_MAX_FRAME + TX_HP_RESERVE))
+    {
+        if (hisSendSeq < history_oldest(hisSendLevel))
+            hisSendSeq = history_oldest(hisSendLevel); // Written over while waiting for room, skip ahead.
+
+        if (hisSendSeq >= history_count(hisSendLevel))
+        { // This level is all sent
+            if (++hisSendLevel > hisLastLevel)
+            {
+                hisSendLevel = -1;
+                send_AOK_to(hisSendPort);
+                return;
+            }
+            hisSendSeq = 0;
+            continue;
+        }
+
+        if (hisSendFramed)
+        {
+            frame.level = hisSendLevel;
+            frame.interval = history_interval(hisSendLevel);
+            frame.now = histSamples;
+            frame.seq = hisSendSeq;
+            for (n = 0; (n < BT_HIST_RECS) && get_history(hisSendLevel, hisSendSeq, &frame.rec[n]); n++)
+                hisSendSeq++;
+            BT_send(BT_HISTORY, &frame, offsetof(tBTHistory, rec) + (n * sizeof(tBTHistRec)), true);
+        }
+        else
+        {
+            get_history(hisSendLevel, hisSendSeq, &frame.rec[0]);
+            TXW_begin(&w, ring, 0, true);
+            prep_HIS(&w, hisSendLevel, hisSendSeq, &frame.rec[0]);
+            TXW_end(&w);
+            hisSendSeq++;
+        }
+    }
+} //HIS_send
+#endif
 
 //------------------------------------------------------------------------------------------------------
 // Fill Inbound Buffer
 //
-//      This helper function will look to the Serial Port (TTL and Bluetooth) and assemble a complete command string
-//      starting after the $ and up to the terminating CR/LF, or '@' char (the latter used to work around bug in Arduino IDE)
+//      This helper function will look to the passed Serial Port (TTL and Bluetooth, or the Serial Display) and assemble a complete
+//      command string starting after the $ and up to the terminating CR/LF, or '@' char (the latter used to work around bug in Arduino IDE)
 //      It is non-blocking and will return FALSE if the string entire string is not ready, or TRUE
 //      once the string has been assembled.
 //
 //      If this is a CAN enabled target, the CAN terminal buffer will also be looked at.
 //
+//      Each character is also handed to IB_parse() as it is stored, so the command's fields are already parsed
+//      by the time the terminator arrives.  A command that is too long, has too many fields, or times out is thrown away whole.
 //
+//      While a Config Backup image is being loaded ($BKL:) the ASCII port is taking its frames instead, see BK_load().
 //
 //------------------------------------------------------------------------------------------------------
-bool fill_ib_buffer()
+bool fill_ib_buffer(tIBPort *p)
 {
-    static uint8_t ibIndex = 0;       // This pointer retains its value between function calls.
-    static uint32_t ibBufFillStarted; // Will contain the time the last 'start' of a string happened
     char c;
 
-    while (Serial.available() > 0)
+    if ((p == &ibPorts[0]) && (bkLoadAt >= 0))
+    {
+        BK_load(p);
+        return (false);
+    }
+
+    if ((p->filling == true) && (IB_BUFF_FILL_TIMEOUT != 0UL) && //  Have we timed-out waiting for a complete command string to be send to us?
+        ((millis() - p->fillStarted) > IB_BUFF_FILL_TIMEOUT))   //  (Checked before taking any more, so the tail end of a stale one can not complete it)
+    {
+        IB_reset(p, false); //  Yes, abort this and start looking for a new command initiator character ('$')
+    }
+
+    while (ASCII_RxAvailable(p->serial))
     {
-        c = Serial.read();
+        c = ASCII_read(p->serial);
 
         if (c == '$')
-        {                        // "$" (start of command) character?
-            ibIndex = 0;         //   Yes!  Initialize ibIndex variable
-            ibBufFilling = true; //   And start storing the remaining characters into the buffer.
-            ibBufFillStarted = millis();
-            break; //   (The '$' character is not saved in the buffer...)
+        {                      // "$" (start of command) character?
+            IB_reset(p, true); //   Yes!  Start storing the remaining characters into the buffer.
+            break;             //   (The '$' character is not saved in the buffer...)
         }
 
-        if (ibBufFilling == true)
+        if (p->filling == true)
         { // We are actively filling the inbound buffer, as we found the start '$' character.
-            if (ibIndex >= (INBOUND_BUFF_SIZE - 1))
-            {                         // Are we about to overflow the buffer array?  (Need to leave room for null terminator)
-                ibBufFilling = false; //  Yes, abort and start looking again for a shorter one - something must have gone wrong....
+            if (p->index >= (INBOUND_BUFF_SIZE - 1))
+            {                       // Are we about to overflow the buffer array?  (Need to leave room for null terminator)
+                IB_reset(p, false); //  Yes, abort and start looking again for a shorter one - something must have gone wrong....
                 break;
             }
 
             if ((c == '\n') || (c == '@'))
             { // Did we find the termination character? ('@' for BUG in Arduino IDE, will not send CR\LF, so 'fake it' using @)
-                if (ibIndex < 3)
-                {                         // If terminator is found before the command string is AT LEAST 4 characters in length, something is wrong.
-                    ibBufFilling = false; // ALL valid commands are in form of xxx:, so must be at least 4 characters long.  So, abandon this and start over.
+                if (p->index < 3)
+                {                       // If terminator is found before the command string is AT LEAST 4 characters in length, something is wrong.
+                    IB_reset(p, false); // ALL valid commands are in form of xxx:, so must be at least 4 characters long.  So, abandon this and start over.
                     break;
                 }
 
-                ibBufFilling = false; // All done storing strings his time around - start looking again for a $
-                return (true);        // Return that we have a valid command string!
+                p->filling = false; // All done storing strings his time around - start looking again for a $
+                return (true);      // Return that we have a valid command string!
             }
             else
             {
-                ibBuf[ibIndex++] = c; // Just a plane character, put it into the buffer
-                ibBuf[ibIndex] = 0;   // And add a null terminate just-in-case
+                if (!IB_parse(p, c))
+                {                       // Too many fields, abandon this one too.
+                    IB_reset(p, false);
+                    break;
+                }
+
+                p->buf[p->index++] = c; // Just a plane character, put it into the buffer
+                p->buf[p->index] = 0;   // And add a null terminate just-in-case
             }
         }
     } // while
 
-    if ((ibBufFilling == true) && (IB_BUFF_FILL_TIMEOUT != 0UL) && //  Have we timed-out waiting for a complete command string to be send to us?
-        ((millis() - ibBufFillStarted) > IB_BUFF_FILL_TIMEOUT))
-    {
-        ibBufFilling = false; //  Yes, abort this and start looking for a new command initiator character ('$')
-    }
-
     return (false); // We have read all there is in the Serial queue, so go back and try to get the rest later.
 } //fill_ib_buffer
 
@@ -180,41 +663,49 @@ bool fill_ib_buffer()
 //      an attached Debug terminal.  It is used not only during debug, but also during operation to allow for
 //      simple user configuration of the device (ala adjusting custom charging profiles - to be stored in FLASH)
 //
+//      The Serial Display port is listened to as well, so a remote display (or a bridge on that port) can do the same - as far
+//      as SERIAL_DISPLAY_PERMS allows.  Responses are sent back to the port the command came from.
+//
 //------------------------------------------------------------------------------------------------------
 void check_inbound()
 {
-    int i;
+    tIBHandlers entry;
 
     //----- Serial Port (TTL) receiving code.  Read the 'packet', verify it, and make changes as needed.
     //      Store those changes in FLASH if needed.
 
-    if (fill_ib_buffer() == true)
-    { // Assemble a string, and see if it is "completed" yet..
+    for (uint8_t i = 0; i < IB_PORTS; i++)
+    {
+        if ((i != 0) && (ibPorts[i].serial == ibPorts[0].serial))
+            continue; // (Serial Display is sharing the ASCII port, it has already been looked at)
 
-        if (ibBuf[3] != ':')
-            return; // ALL valid commands have a ":" in the 4th position.
+        if (fill_ib_buffer(&ibPorts[i]) != true)
+            continue; // Assemble a string, and see if it is "completed" yet..
 
-        if (chargingState == warm_up)
-            set_charging_mode(warm_up); // User is trying to bench-conf the regulator, let them do all they need to do before we
-                                          // move on and start ramping.
+        ibPort = &ibPorts[i];
+        ibBuf = ibPort->buf;
 
-        for (i = 0; IBHandlers[i].command[0] != 0; i++)
-        { // Scan the table, looking for match
+        if (ibBuf[3] == ':')
+        { // ALL valid commands have a ":" in the 4th position.
 
-            if ((IBHandlers[i].command[0] != ibBuf[0]) ||
-                (IBHandlers[i].command[1] != ibBuf[1]))
-                continue; // No match on 1st two characters, keep looking.
+            if (chargingState == warm_up)
+                set_charging_mode(warm_up); // User is trying to bench-conf the regulator, let them do all they need to do before we
+                                            // move on and start ramping.
 
-            if ((IBHandlers[i].command[2] != '*') &&
-                (IBHandlers[i].command[2] != ibBuf[2]))
-                continue; // Last table entery might be a wildcard, if not it must also match
+            memcpy_P(&entry, &IBHandlers[IB_HASH(ibBuf[0], ibBuf[1])], sizeof(tIBHandlers)); // Only one slot can hold a match, go straight to it.
 
-            if (IBHandlers[i].handler(ibBuf))
-            {               // Got a match!  Call the matching command procedure
-                send_AOK(); //   -- If command procedure was accepted, send user acknowledgment.
-                return;     //   And we are all done now.
+            if ((entry.command[0] == ibBuf[0]) &&               // Must match on the 1st two characters  (Else an empty slot, not a command we know)
+                (entry.command[1] == ibBuf[1]) &&
+                ((entry.command[2] == '*') || (entry.command[2] == ibBuf[2])) && // Table entry might be a wildcard, if not it must also match
+                (entry.perms & ibPort->perms))                   //   and it must be allowed from this port.
+            {
+                if (entry.handler(ibBuf))
+                    send_AOK(); // Got a match!  Call the matching command procedure, and if it was accepted, send user acknowledgment.
             }
         }
+
+        ibPort = &ibPorts[0]; // All done, anything sent from here on out is not a response.
+        ibBuf = ibPort->buf;
     }
 } //check_inbound
 
@@ -226,6 +717,66 @@ void check_inbound()
 //
 //------------------------------------------------------------------------------------------------------
 
+//--------- $BIN:  Select BINary or ASCII telemetry
+bool BIN_handler(char *StrPtr)
+{
+    int rate;
+
+    if (IB_reply_ring() != &asciiTX)
+        return (false); // Binary telemetry is only for the ASCII port.
+
+    switch (ibBuf[4])
+    {
+    case '0':
+        binaryMode = false;
+        deltaMode = false;
+        break;
+
+    case '1':
+    case '2':
+        if (getInt((ibBuf + 5), &rate, 100, 32767)) //   Optional AST rate following the ','  (Not saved, use $SUB: for that)
+            subscriptions.PERIOD[SUB_AST] = rate;
+        binaryMode = true; //   (The AOK for this command will already be framed)
+        deltaMode = (ibBuf[4] == '2');
+        if (deltaMode)
+            BT_reset_delta();
+        break;
+
+    default:
+        return (false);
+    }
+
+    return (true);
+} //BIN_handler
+
+//--------- BK*:  Config BacKup image  (This one is a wild-card)
+bool BKx_handler(char *StrPtr)
+{
+    if ((IB_reply_ring() != &asciiTX) || (bkSendAt >= 0))
+        return (false); // Frames are only for the ASCII port, and one image at a time.
+
+    switch (ibBuf[2])
+    {
+    case 'S':
+        bkSendAt = 0;   //   send_outbound() sends it along as there is room, and will finish up with an 'AOK' message.
+        return (false);
+
+    case 'L':
+        if (systemConfig.CONFIG_LOCKOUT != 0)
+            return (false); // If system is locked-out, do not allow any changes...
+        if ((chargingState != disabled) && (chargingState != warm_up))
+            return (false); //   or while it is charging - the port is tied up, and the EEPROM kept busy, for some seconds.
+        bkLoadAt = 0;   //   From here on fill_ib_buffer() takes frames, not commands.  (Used after the next $RBT, as with $SC* and $CP*)
+        bkLoadPrev = -1;
+        bkLoadLast = millis();
+        IB_reset(ibPort, false);
+        return (true);
+
+    default:
+        return (false);
+    }
+} //BKx_handler
+
 //--------- CC*:  Something to do with the CAN Configuration . . .  (This one is a wild-card)
 //
 bool CCx_handler(char *StrPtr)
@@ -338,6 +889,30 @@ bool CPx_handler(char *StrPtr)
             return (false); //  Cap at 95 to protect NTC sensor? (Esp Epoxy filling?)
         break;
 
+    case 'S': // Change STATE OF CHARGE parameters in CPE user entry n
+              //   $CPS:n     <Exit Accpt SOC>, <Float to Bulk SOC>
+
+        if (!getByte((ibBuf + 5), &buffCP.EXIT_ACPT_SOC, 0, 100))
+            return (false); //  In %, 0 = disabled
+        if (!getByte(NULL, &buffCP.FLOAT_TO_BULK_SOC, 0, 100))
+            return (false);
+        break;
+
+    case 'C': // Change CELL BALANCING parameters in CPE user entry n
+              //   $CPC:n     <Cell Taper mV>, <Cell Max mV>, <Balance Amps>, <Balance Spread mV>
+
+        if (!getInt((ibBuf + 5), &j, 0, 5000))
+            return (false); //  0 = disabled
+        buffCP.CELL_TAPER_MV = j;
+        if (!getInt(NULL, &j, 0, 5000))
+            return (false);
+        buffCP.CELL_MAX_MV = j;
+        if (!getByte(NULL, &buffCP.BALANCE_AMPS, 0, 100))
+            return (false);
+        if (!getByte(NULL, &buffCP.BALANCE_SPREAD_MV, 0, 250))
+            return (false);
+        break;
+
     case 'R':                          // $CPR:n  RESTORES Charge Profile table entry 'n' to default
         write_CPS_EEPROM(index, NULL); // Erase selected saved systemConfig structure in the EEPROM (if present)
         return (true);                 // Let user know we understand.
@@ -350,12 +925,52 @@ bool CPx_handler(char *StrPtr)
     return (true);                    // Let user know we understand.  User must issue $RBT command for changes                                                                     //   to be loaded into regulators working memory.
 } //CPx_handler
 
+//--------- $DLT:  Set a Delta mode deadband
+bool DLT_handler(char *StrPtr)
+{
+    int tag;
+    int band;
+
+    if (!getInt((ibBuf + 4), &tag, -1, BT_AST_NFIELDS))
+        return (false);
+    if ((tag < 0) || (tag >= BT_AST_NFIELDS))
+        return (false);
+    if (!getInt(NULL, &band, 0, 32767))
+        return (false);
+
+    btDeadband[tag] = band;
+    return (true);
+} //DLT_handler
+
+#ifdef USE_SERIAL_DISPLAY
+//--------- $DRS:m  Display ReSync
+bool DRS_handler(char *StrPtr)
+{
+    switch (ibBuf[4])
+    {
+    case '\0':
+    case '\r':
+        break; //   Keep sending as we are.  (A display sending with println() ends it with a CR)
+
+    case '0':
+    case '1':
+        sdBinary = (ibBuf[4] == '1');
+        break;
+
+    default:
+        return (false);
+    }
+
+    sdFrames = true; //   The display knows about frames, so send it those from now on rather then $D: lines.
+    sdResync = true; //   The next frame carries every field, that is the reply.  (No AOK, the display may not be expecting ASCII)
+    return (false);
+} //DRS_handler
+#endif
+
 //--------- $EDB:  Enable DeBug ASCII string
 bool EDB_handler(char *StrPtr)
 {
-
-    SDMCounter = SDM_SENSITIVITY; // Set up the counters and turn on the DBG string switch!
-    sendDebugString = true;
+    sendDebugString = true; // Turn on the DBG string switch!   (Sent as often, and where, its Subscription says)
     return (true);
 } //EDB_handler
 
@@ -396,6 +1011,69 @@ bool FRM_handler(char *StrPtr)
     return (true);
 } //FRM_handler
 
+#ifdef USE_GAIN_SCHEDULING
+//--------- GS*:  Something about changing the PID Gain Schedule  (This one is a wild-card)
+//      Unlike the System Config and Charge Profiles, changes take effect right away - no $RBT needed.
+bool GSx_handler(char *StrPtr)
+{
+    uint8_t r;
+    uint8_t t;
+    float mult;
+
+    if (systemConfig.CONFIG_LOCKOUT != 0)
+        return (false); // If system is locked-out, do not allow any changes...
+
+    switch (ibBuf[2])
+    {
+
+    case 'S': // Set one grid point of the Gain Schedule
+              // $GSS: <RPM index (0..GS_RPM_BINS-1)>, <Temp index (0..GS_TEMP_BINS-1)>, <Multiplier (0.1..3.0)>
+
+        if (!getByte((ibBuf + 4), &r, 0, GS_RPM_BINS - 1))
+            return (false);
+        if (!getByte(NULL, &t, 0, GS_TEMP_BINS - 1))
+            return (false);
+        if (!getFloat(NULL, &mult, 0.1, 3.0))
+            return (false);
+
+        gainSchedule.MULT[r][t] = (uint8_t)((mult * GS_MULT_ONE) + 0.5);
+        break;
+
+    case 'R': // RESTORES the Gain Schedule to default
+        transfer_default_GST(&gainSchedule);
+        write_GST_EEPROM(NULL); // Erase any saved Gain Schedule in the EEPROM
+        return (true);
+
+    default:
+        return (false);
+    } //switch
+
+    write_GST_EEPROM(&gainSchedule); // Save back the new Gain Schedule
+    return (true);
+} //GSx_handler
+#endif
+
+#ifdef USE_HISTORY
+//--------- $HIS:n  Request Charge HIStory
+bool HIS_handler(char *StrPtr)
+{
+    uint8_t level;
+
+    if (hisSendLevel >= 0)
+        return (false); // One at a time.
+
+    hisSendLevel = 0;
+    hisLastLevel = HIST_LEVELS - 1;
+    if (getByte((ibBuf + 4), &level, 0, HIST_LEVELS - 1)) //   Just the one level?
+        hisSendLevel = hisLastLevel = level;
+
+    hisSendSeq = 0;
+    hisSendPort = ibPort->txPort;
+    hisSendFramed = (IB_reply_mode() == TXW_FRAMED);
+    return (false); //   send_outbound() sends them along as there is room, and will finish up with an 'AOK' message.
+} //HIS_handler
+#endif
+
 //--------- $MSR:  Master System Restore
 bool MSR_handler(char *StrPtr)
 {
@@ -428,7 +1106,8 @@ bool RBT_handler(char *StrPtr)
 //--------- $RCP:n  Request Charge Profile
 bool RCP_handler(char *StrPtr)
 {
-    char charBuffer[OUTBOUND_BUFF_SIZE + 1];
+    tTXWriter w;
+    tBTCPE payload;
     tCPS buffCP;
     int8_t index;
 
@@ -444,12 +1123,32 @@ bool RCP_handler(char *StrPtr)
     if (read_CPS_EEPROM(index, &buffCP) != true) //   See if there is a valid user modified CPE in EEPROM we should be using.
         transfer_default_CPS(index, &buffCP);    //   No, so get the correct entry from the values in the FLASH (PROGMEM) store.
 
-    prep_CPE(charBuffer, &buffCP, index); //   And Finally,  assemble the string to send out requested information.
-    ASCII_write(charBuffer);              //   Send it out via Serial port
+    if (IB_reply_mode() == TXW_FRAMED)
+        BT_send(BT_CPE, &payload, bprep_CPE(&payload, &buffCP, index), true);
+    else
+    {
+        TXW_begin(&w, IB_reply_ring(), 0, true);
+        prep_CPE(&w, &buffCP, index); //   And Finally,  assemble the string to send out requested information
+        TXW_end(&w);                  //     straight into the Serial port's transmit ring.
+    }
 
     return (true);
 } //RCP_handler
 
+#ifdef USE_GAIN_SCHEDULING
+//--------- $RGS:  Request Gain Schedule
+bool RGS_handler(char *StrPtr)
+{
+    tTXWriter w;
+
+    TXW_begin(&w, IB_reply_ring(), IB_reply_mode(), true);
+    prep_PGS(&w);
+    TXW_end(&w);
+
+    return (true);
+} //RGS_handler
+#endif
+
 //--------- SC*:  Something about changing a System Config  (This one is a wild-card)
 bool SCx_handler(char *StrPtr)
 {
@@ -548,90 +1247,315 @@ bool SCx_handler(char *StrPtr)
                                //   to be loaded into regulators working memory.
 } //SCx_handler
 
+//--------- $SUB:  SUBscribe to a status message
+//      Not held back by CONFIG_LOCKOUT, as it only changes what is sent out - nothing about how the alternator is run.
+bool SUB_handler(char *StrPtr)
+{
+    tTXWriter w;
+    uint8_t m;
+    uint8_t port;
+    bool enable;
+    float period;
+
+    switch (ibBuf[4])
+    {
+    case '\0': // $SUB:  - Send back the Subscriptions
+        TXW_begin(&w, IB_reply_ring(), IB_reply_mode(), true);
+        prep_SUB(&w);
+        TXW_end(&w);
+        return (true);
+
+    case 'R': // RESTORES the Subscriptions to default
+        transfer_default_SUB(&subscriptions);
+        write_SUB_EEPROM(NULL); // Erase any saved Subscriptions in the EEPROM
+        return (true);
+
+    default: // $SUB: <Message (SUB_xxx)>, <Enabled (0/1)>, <Period in seconds (0.1..65.0)>, <Port (0 = ASCII, 1 = Serial Display)>
+        if (!getByte((ibBuf + 4), &m, 0, SUB_MAX - 1))
+            return (false);
+        if (!getBool(NULL, &enable))
+            return (false);
+        if (!getFloat(NULL, &period, 0.1, 65.0))
+            return (false);
+        if (!getByte(NULL, &port, TX_PORT_ASCII, TX_PORT_DISPLAY))
+            return (false);
+
+        if (enable)
+            subscriptions.ENABLED |= (1 << m);
+        else
+            subscriptions.ENABLED &= ~(1 << m);
+        subscriptions.PERIOD[m] = (uint16_t)((period * 1000.0) + 0.5);
+        subscriptions.PORT[m] = port;
+        break;
+    } //switch
+
+    write_SUB_EEPROM(&subscriptions); // Save back the new Subscriptions
+    return (true);
+} //SUB_handler
+
 //---- Helper functions for Check_inbound()
+//      Each hands out the next field IB_parse() found.  Passing a pointer into ibBuf[] (rather than NULL) starts over with the
+//      1st field at or after that spot - the same way the strtok() based helpers these replaced were called.
+static tIBField *IB_next_field(char *buffer)
+{
+    if (buffer != NULL)
+        for (ibFieldNext = 0; (ibFieldNext < ibPort->fieldCount) && (ibPort->fields[ibFieldNext].start < (uint8_t)(buffer - ibBuf)); ibFieldNext++)
+            ;
+
+    if (ibFieldNext >= ibPort->fieldCount)
+        return (NULL);
+
+    return (&ibPort->fields[ibFieldNext++]);
+}
+
+static int32_t IB_whole(tIBField *fp)
+{
+    return ((fp->state & IBF_NEG) ? -fp->whole : fp->whole);
+}
+
 bool getInt(char *buffer, int *dest, int LLim, int HLim)
 {
-    char *cp;
-    cp = strtok(buffer, ",");
-    if (cp == NULL)
+    tIBField *fp;
+    fp = IB_next_field(buffer);
+    if (fp == NULL)
         return (false);
-    *dest = constrain(atoi(cp), LLim, HLim);
+    *dest = constrain(IB_whole(fp), LLim, HLim);
     return (true);
 }
 
 bool getByte(char *buffer, uint8_t *dest, uint8_t LLim, uint8_t HLim)
 {
-    char *cp;
-    cp = strtok(buffer, ",");
-    if (cp == NULL)
+    tIBField *fp;
+    fp = IB_next_field(buffer);
+    if (fp == NULL)
         return (false);
-    *dest = (uint8_t)constrain(atoi(cp), LLim, HLim);
+    *dest = (uint8_t)constrain(IB_whole(fp), LLim, HLim);
     return (true);
 }
 
 bool getDurationMin(char *buffer, uint32_t *dest, int HLim)
 { // Time in Minutes converted to mS
-    char *cp;
-    cp = strtok(buffer, ",");
-    if (cp == NULL)
+    tIBField *fp;
+    fp = IB_next_field(buffer);
+    if (fp == NULL)
         return (false);
-    *dest = (uint32_t)(constrain(atoi(cp), 0, HLim)) * 60000UL; // Noticed, EVERY duration has this 60000UL multiplier and 0 LLim, so no need to pass as separate parameter...
+    *dest = (uint32_t)(constrain(IB_whole(fp), 0, HLim)) * 60000UL; // Noticed, EVERY duration has this 60000UL multiplier and 0 LLim, so no need to pass as separate parameter...
     return (true);
 }
 
 bool getDurationS(char *buffer, uint32_t *dest, int HLim)
 { // Time in Seconds converted to mS
-    char *cp;
-    cp = strtok(buffer, ",");
-    if (cp == NULL)
+    tIBField *fp;
+    fp = IB_next_field(buffer);
+    if (fp == NULL)
         return (false);
-    *dest = (uint32_t)(constrain(atoi(cp), 0, HLim)) * 1000UL;
+    *dest = (uint32_t)(constrain(IB_whole(fp), 0, HLim)) * 1000UL;
     return (true);
 }
 
 bool getDurationTh(char *buffer, uint32_t *dest, int HLim)
 { // Time in Tenths of a second converted to mS
-    char *cp;
-    cp = strtok(buffer, ",");
-    if (cp == NULL)
+    tIBField *fp;
+    fp = IB_next_field(buffer);
+    if (fp == NULL)
         return (false);
-    *dest = (uint32_t)(constrain(atoi(cp), 0, HLim)) * 100UL;
+    *dest = (uint32_t)(constrain(IB_whole(fp), 0, HLim)) * 100UL;
     return (true);
 }
 
 bool getFloat(char *buffer, float *dest, float LLim, float HLim)
 {
-    char *cp;
-    cp = strtok(buffer, ",");
-    if (cp == NULL)
+    tIBField *fp;
+    float f;
+    fp = IB_next_field(buffer);
+    if (fp == NULL)
         return (false);
-    *dest = constrain(atof(cp), LLim, HLim);
+    f = (float)fp->whole + ((float)fp->frac / 10000.0); // (10000 = 10^IB_FRAC_DIGITS)
+    if (fp->state & IBF_NEG)
+        f = -f;
+    *dest = constrain(f, LLim, HLim);
     return (true);
 }
 
 bool getBool(char *buffer, bool *dest)
 {
-    char *cp;
-    cp = strtok(buffer, ",");
-    if (cp == NULL)
+    tIBField *fp;
+    fp = IB_next_field(buffer);
+    if (fp == NULL)
         return (false);
-    *dest = (atoi(cp) == 1);
+    *dest = (IB_whole(fp) == 1);
     return (true);
 }
 
 void send_AOK(void)
+{ // Acknowledge the command being run, back to the port it came from
+    send_AOK_to(ibPort->txPort);
+}
+
+void send_AOK_to(uint8_t port)
+{
+    if (TX_ring(port) == &asciiTX)
+        ASCII_write("AOK;\r\n"); // (Framed if in binary mode)
+    else
+        TX_write(TX_ring(port), "AOK;\r\n", true);
+}
+
+//-------       'helper' functions used by OB_send() in delta mode;
+//              OB_changed() returns TRUE if the message with the passed CRC has changed since it was last sent (or it is being
+//              forced out, or has not been sent for DELTA_KEYFRAME_RATE).  OB_delivered() then notes it as sent - only once it
+//              has made it into the ring, so one that was dropped goes out again next time around.
+static uint16_t obLastCRC[sizeof(OBPrepers) / sizeof(tOBPrepers)];
+static uint32_t obLastSent[sizeof(OBPrepers) / sizeof(tOBPrepers)];
+
+static bool OB_changed(uint8_t index, uint16_t crc, bool force)
+{
+    return (force || (crc != obLastCRC[index]) || ((millis() - obLastSent[index]) >= DELTA_KEYFRAME_RATE));
+}
+
+static void OB_delivered(uint8_t index, uint16_t crc)
+{
+    obLastCRC[index] = crc;
+    obLastSent[index] = millis();
+}
+
+//-------       'helper' functions for the Subscriptions.   Each port has a budget of bytes (kept in 1/1000ths) the scheduled
+//              status may send, which fills at SUB_BUDGET_PCT of its Baud rate.
+static int32_t portBudget[2];          // [TX_PORT_xxx]
+static uint32_t subLastSent[SUB_MAX];  // When each message was last sent  (Moved along by its PERIOD, so the rate holds steady)
+
+static uint8_t OB_port(uint8_t msg)
+{ // Which port (budget) does this message go to?
+    return ((TX_ring(subscriptions.PORT[msg]) == &asciiTX) ? TX_PORT_ASCII : TX_PORT_DISPLAY);
+}
+
+static void OB_refill_budget(void)
+{
+    static uint32_t lastRefill = 0U;
+    uint32_t elapsed;
+
+    elapsed = millis() - lastRefill;
+    lastRefill += elapsed;
+    elapsed = min(elapsed, 1000UL); // (A full second will top it up anyway)
+
+    portBudget[TX_PORT_ASCII] = min(portBudget[TX_PORT_ASCII] + (int32_t)(elapsed * ((SYSTEM_BAUD / 10UL) * SUB_BUDGET_PCT / 100UL)), SUB_BUDGET_BURST * 1000L);
+#ifdef USE_SERIAL_DISPLAY
+    portBudget[TX_PORT_DISPLAY] = min(portBudget[TX_PORT_DISPLAY] + (int32_t)(elapsed * ((SERIAL_DISPLAY_BAUD / 10UL) * SUB_BUDGET_PCT / 100UL)), SUB_BUDGET_BURST * 1000L);
+#endif
+}
+
+static bool OB_ready(uint8_t msg)
+{ // Is it time for this message, and is there room (and budget) on its port to send it?
+    uint8_t port = OB_port(msg);
+
+    return (((millis() - subLastSent[msg]) >= subscriptions.PERIOD[msg]) &&
+            (portBudget[port] > 0) &&
+            (TX_free(TX_ring(port)) >= (OUTBOUND_BUFF_SIZE + TX_HP_RESERVE)));
+}
+
+static void OB_sent(uint8_t msg, uint16_t bytes)
 {
-    ASCII_write("AOK;\r\n");
+    portBudget[OB_port(msg)] -= (int32_t)bytes * 1000L;
+
+    if ((millis() - subLastSent[msg]) >= (2UL * subscriptions.PERIOD[msg]))
+        subLastSent[msg] = millis(); // Fallen well behind (or just turned on), start again from now
+    else
+        subLastSent[msg] += subscriptions.PERIOD[msg];
 }
 
+//-------       'helper' function used by send_outbound();
+//              Builds and sends OBPrepers[index] to the passed port - in binary (or only the changes) if the host has asked
+//              for that on the ASCII port, else as its ASCII string.   Returns how many bytes that took.
+static uint16_t OB_send(uint8_t index, uint8_t port, bool highPriority)
+{
+    tTXRing *ring = TX_ring(port);
+    uint16_t queued = ring->queued;
+    uint32_t static lastKeyframe = 0U; // When was the full AST last sent in delta mode?
+    tBTStatus payload;
+    tTXWriter w;
+    uint16_t crc = 0xFFFF;
+    uint8_t len;
+
+    if ((ring == &asciiTX) && binaryMode && (OBPrepers[index].binPreper != NULL))
+    {
+        len = OBPrepers[index].binPreper(&payload);
+
+        if (deltaMode && (OBPrepers[index].binType == BT_AST))
+        { // AST is sent as the changed fields, with a keyframe every so often.
+            if (highPriority || ((millis() - lastKeyframe) >= DELTA_KEYFRAME_RATE))
+            {
+                if (BT_send_AST(&payload.ast, true, highPriority))
+                    lastKeyframe = millis(); // (Dropped, try the keyframe again next time)
+            }
+            else
+                BT_send_AST(&payload.ast, false, highPriority);
+            return (ring->queued - queued);
+        }
+
+        for (uint8_t i = 0; i < len; i++)
+            crc = CRC16_update(crc, ((const uint8_t *)&payload)[i]);
+
+        if (!deltaMode)
+            BT_send(OBPrepers[index].binType, &payload, len, highPriority);
+        else if (OB_changed(index, crc, highPriority) && BT_send(OBPrepers[index].binType, &payload, len, highPriority))
+            OB_delivered(index, crc);
+    }
+    else if (ring != &asciiTX)
+    { // (The Serial Display port is always sent ASCII)
+        TXW_begin(&w, ring, 0, highPriority);
+        OBPrepers[index].preper(&w); // Envoke the selected message creation function
+        TXW_end(&w);
+    }
+    else
+    {
+        TXW_begin(&w, ring, ((binaryMode ? TXW_FRAMED : 0) | (deltaMode ? TXW_CRC : 0)), highPriority);
+        OBPrepers[index].preper(&w);
+
+        if (!deltaMode)
+            TXW_end(&w); // And send it out.
+        else if (OB_changed(index, w.crc, highPriority) && (TXW_end(&w) != 0))
+            OB_delivered(index, w.crc); //   (Else just let it go, the host already has it - or it was dropped, and goes again next time)
+    }
+
+    return (ring->queued - queued);
+}
+
+//------------------------------------------------------------------------------------------------------
+// OB Due / OB Begin / OB End
+//      Used for subscribed messages that are not sent by send_outbound() - ala the DBG string from manage_ALT().
+//      OB_due() returns TRUE if it is time to send message msg (and its port has room for it).  OB_begin() then
+//      starts it in the passed writer for the caller to fill in, and OB_end() sends it.
+//
+//------------------------------------------------------------------------------------------------------
+
+bool OB_due(uint8_t msg)
+{
+    OB_refill_budget();
+    return (OB_ready(msg));
+} //OB_due
+
+void OB_begin(uint8_t msg, tTXWriter *w)
+{
+    tTXRing *ring = TX_ring(OB_port(msg));
+
+    TXW_begin(w, ring, (((ring == &asciiTX) && binaryMode) ? TXW_FRAMED : 0), false);
+} //OB_begin
+
+void OB_end(uint8_t msg, tTXWriter *w)
+{
+    OB_sent(msg, TXW_end(w));
+} //OB_end
+
 //------------------------------------------------------------------------------------------------------
 // Send Outbound
 //
 //      This function will send to the Serial Terminal the current system status.  It is used to send
 //      information primarily via the Bluetooth to an external HUI program.
 //
-//      If pushAll was requested, all the satus strings will be sent out in order.  This is usefull in the case of FAULTED condition.
-//      as well as the $RAS: command.
+//      Which messages are sent, how often, and to which port, is set by the subscriptions table ($SUB).  Each time
+//      through the most overdue one whose port has room (and budget) for it is sent.
+//
+//      If pushAll was requested, all the satus strings will be sent out in order to the port the $RAS: command came from
+//      (or the ASCII port, if not called for a command).  This is usefull in the case of FAULTED condition, as well as the $RAS: command.
 //
 //      FALSE is retuned if send_outbound has no more strings it wants to send out, else TRUE is returned indicating there are
 //      more strings to be sent as a result of a prior call with pushAll
@@ -640,113 +1564,127 @@ void send_AOK(void)
 //------------------------------------------------------------------------------------------------------
 bool send_outbound(bool pushAll)
 {
-    char charBuffer[OUTBOUND_BUFF_SIZE + 1]; // Large working buffer to assemble strings before sending to the serial port.
-    uint8_t static indexMajor = 0;           // Index into OBPrepers[] array of which message to send next.
-    uint8_t static indexMinor = 0;
-    uint8_t static minorCounter = 0; // Used to see if it is time to send out a MINOR message this time around.
     uint8_t index;
-    uint32_t static lastStatusSent = 0U; // When was the Status last sent?
+    uint8_t msg;
+    uint8_t best = 0xFF;
+    uint32_t late;
+    uint32_t bestLate = 0U;
     int8_t static pushingAllIndex = -1;  // If we have been asked to push-all, this will contain the index to the next 'message' we should push out.
                                          //  -1 = not pushing all.
+    uint8_t static pushingAllPort = TX_PORT_ASCII; //  And the TX_PORT_xxx they are going to.
 
     if (pushAll)
+    {
         pushingAllIndex = 0; // We are being asked to push-all, start with the AST and work up.
+        pushingAllPort = ibPort->txPort;
+    }
+
+    TX_service();
+    OB_refill_budget();
+
+    if (bkSendAt >= 0)
+        BK_send(); // Sending a Config Backup image?  (Status to the ASCII port is held back until it is done, see IB_filling())
+#ifdef USE_HISTORY
+    if (hisSendLevel >= 0)
+        HIS_send(); //   or the Charge History?
+#endif
 
     if (pushingAllIndex >= 0)
     { // Doing  'Push-all' block?
+        if (TX_free(TX_ring(pushingAllPort)) < (OUTBOUND_BUFF_SIZE + TX_HP_RESERVE))
+            return (true); // Not enough room in the transmit ring for another string, hold off until it has drained some.
+                           //   (Sending it later beats dropping it, or waiting here on the UART)
+
         if (OBPrepers[pushingAllIndex].preper == NULL)
         {                         // Are we at the end of the list?
-            send_AOK();           // Yup, send out the AOK now and be done.
+            send_AOK_to(pushingAllPort); // Yup, send out the AOK now and be done.
             pushingAllIndex = -1; // And the next one is the end of the list, so we are all done after the one.
             return (false);
         }
 
-        index = pushingAllIndex++; // Yes, and this is the one we will do this time.
+        OB_send(pushingAllIndex++, pushingAllPort, true);
+        return (true); // Let caller know there are more push-all messages that need to go.
     }
-    else
-    { // Not pushing all
-        //--    OK, we will be sending out a normal message.  See if it is time  and if so which one  (Minor or Major).
-        if ((millis() - lastStatusSent) < UPDATE_STATUS_RATE)
-            return (false); // Time to send Update packet?  No, not just yet.
-        if (ibBufFilling == true)
-            return (false); // Also, we suspend the sending of status updates while a new command is being assembled.
-                            //   (This way there is no confusion over data received from the regulator as to if it)
-
-        if (++minorCounter >= 10)
-        { // Time for a Minor message, work the Minor index.
-            do
-            { // Looking for a non-high prioity message
-                indexMinor++;
-                if (OBPrepers[indexMinor].preper == NULL) // At end of list...
-                    indexMinor = 0;
-            } while (OBPrepers[indexMinor].HP != false);
-
-            index = indexMinor; // Got one!  This is the one we will use.
-            minorCounter = 0;
-        }
-        else
-        { // Doing a Major this time.
-            do
-            { // Looking for a high priority message
-                indexMajor++;
-                if (OBPrepers[indexMajor].preper == NULL) // At end of list...
-                    indexMajor = 0;
-            } while (OBPrepers[indexMajor].HP != true);
-
-            index = indexMajor; // Got one!  This is the one we will use.
+
+    for (index = 0; OBPrepers[index].preper != NULL; index++)
+    { // Find the most overdue subscribed message that can be sent now.
+        msg = OBPrepers[index].subID;
+        if (!(subscriptions.ENABLED & (1 << msg)) || !OB_ready(msg))
+            continue;
+
+        if (IB_filling(OB_port(msg)))
+            continue; // We suspend the sending of status updates to a port while a new command is being assembled from it.
+                      //   (This way there is no confusion over data received from the regulator as to if it)
+
+        late = millis() - subLastSent[msg] - subscriptions.PERIOD[msg];
+        if ((best == 0xFF) || (late > bestLate))
+        {
+            best = index;
+            bestLate = late;
         }
     }
 
-    OBPrepers[index].preper(charBuffer); // Envoke the selected message creation function
-    ASCII_write(charBuffer);             // And send it out.  (Even if Null - will not hurt anything.)
-
-#ifdef USE_OLED
-  if(chargingState!= FAULTED)
-  {
-    WriteOLEDDynamicData(); // OUTPUT UPDATE TO THE I2C LCD
-  }  
-#endif
+    if (best != 0xFF)
+    {
+        msg = OBPrepers[best].subID;
+        OB_sent(msg, OB_send(best, OB_port(msg), false)); // (Regular status updates are low priority, another one will be along soon enough)
+    }
 
-    lastStatusSent = millis();
-    return (pushingAllIndex != -1); // Let caller know if there are more push-all messages taht need to go.
+    return (false);
 } //send_outbound
 
 //------------------------------------------------------------------------------------------------------
 // Prep Outbound strings
 //
-//      These functions will assemble the outbound strings into the passed buffer.
-//      Note that the passed buffer MUST BE AT LEAST 'OUTBOUND_BUFF_SIZE' in size.
-//      If the called message is not supported by the target compiled device, no change will be made
-//      to the passed buffer.
+//      These functions will assemble the outbound strings in the passed writer, straight into the transmit ring.
+//      (See TxWriter.cpp)  The caller starts the writer with TXW_begin(), and sends the string with TXW_end().
+//      The strings are never more then OUTBOUND_BUFF_SIZE, send_outbound() counts on that when checking for room.
 //
 //
 //------------------------------------------------------------------------------------------------------
 
-void prep_AST(char *buffer)
+void prep_AST(tTXWriter *w)
 { // AST: Alternator Status ASCII string.
-    snprintf_P(buffer, OUTBOUND_BUFF_SIZE, PSTR("AST;,%d.%02d, ,%s,%s,%s,%d, ,%s,%d,%d,%d, ,%d,%d, ,%d, ,%s,%d,%d,%d\r\n"),
-               (int)(generatorLrRunTime / (3600UL * 1000UL)),       // Runtime Hours
-               (int)((generatorLrRunTime / (3600UL * 10UL)) % 100), // Runtime 1/100th
-
-               float2string(measuredBatVolts, 2),
-               float2string(measuredAltAmps, 1),
-               float2string(measuredBatAmps, 1),
-               measuredAltWatts,
-
-               float2string(targetBatVolts, 2),
-               (int)targetAltAmps,
-               targetAltWatts,
-               chargingState,
-
-               measuredBatTemp, // In deg C
-               measuredAltTemp, //was ... max(measuredAltTemp, measuredAlt2Temp),
-
-               measuredRPMs,
-
-               float2string(measuredAltVolts, 3),
-               measuredFETTemp,
-               measuredFieldAmps,
-               ((100 * fieldPWMvalue) / FIELD_PWM_MAX));
+    TXW_str_P(w, PSTR("AST;,"));
+    TXW_int(w, (int)(generatorLrRunTime / (3600UL * 1000UL)));   // Runtime Hours
+    TXW_char(w, '.');
+    TXW_pad(w, (int)((generatorLrRunTime / (3600UL * 10UL)) % 100), 2); // Runtime 1/100th
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_fixed(w, measuredBatVolts, 2);
+    TXW_char(w, ',');
+    TXW_fixed(w, measuredAltAmps, 1);
+    TXW_char(w, ',');
+    TXW_fixed(w, measuredBatAmps, 1);
+    TXW_char(w, ',');
+    TXW_int(w, measuredAltWatts);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_fixed(w, targetBatVolts, 2);
+    TXW_char(w, ',');
+    TXW_int(w, (int)targetAltAmps);
+    TXW_char(w, ',');
+    TXW_int(w, targetAltWatts);
+    TXW_char(w, ',');
+    TXW_int(w, chargingState);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_int(w, measuredBatTemp); // In deg C
+    TXW_char(w, ',');
+    TXW_int(w, measuredAltTemp); //was ... max(measuredAltTemp, measuredAlt2Temp),
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_int(w, measuredRPMs);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_fixed(w, measuredAltVolts, 3);
+    TXW_char(w, ',');
+    TXW_int(w, measuredFETTemp);
+    TXW_char(w, ',');
+    TXW_int(w, measuredFieldAmps);
+    TXW_char(w, ',');
+    TXW_int(w, ((100 * fieldPWMvalue) / FIELD_PWM_MAX));
+    TXW_str_P(w, PSTR("\r\n"));
 } //prep_AST
 
 //void prep_GST(char *buffer) {                                                           // Assembled the Generator Status ASCII string.
@@ -755,45 +1693,83 @@ void prep_AST(char *buffer)
 //void prep_BST(char *buffer) {                                                           // BST:  Battery Status ASCII string.
 //}
 
-void prep_default_CPE(char *buffer)
+void prep_default_CPE(tTXWriter *w)
 {
-    prep_CPE(buffer, &chargingParms, cpIndex);
+    prep_CPE(w, &chargingParms, cpIndex);
 }
 
-void prep_CPE(char *buffer, tCPS *cpsPtr, int index)
-{
-    snprintf_P(buffer, OUTBOUND_BUFF_SIZE, PSTR("CPE;,%d,%s,%d,%d,%d, ,%d,%d,%s,%d, ,%s,%d,%d,%d,%d,%s, ,%d,%s,%d, ,%s,%d,%d,%d, ,%s,%d,%d,%d\r\n"),
-               (index + 1), // Convert from "0-origin" of array indexes for display
-               float2string(cpsPtr->ACPT_BAT_V_SETPOINT, 2),
-               (unsigned int)(cpsPtr->EXIT_ACPT_DURATION / 60000UL), // Show time running in Minutes, as opposed to mS
-               cpsPtr->EXIT_ACPT_AMPS,
-               (int)0, // Place holder for future dV/dT exit parameter, hard coded = 0 for now.
-
-               cpsPtr->LIMIT_OC_AMPS,
-               (unsigned int)(cpsPtr->EXIT_OC_DURATION / 60000UL),
-               float2string(cpsPtr->EXIT_OC_VOLTS, 2),
-               (int)0, // Place holder for future dV/dT exit parameter, hard coded = 0 for now.
-
-               float2string(cpsPtr->FLOAT_BAT_V_SETPOINT, 2),
-               cpsPtr->LIMIT_FLOAT_AMPS,
-               (unsigned int)(cpsPtr->EXIT_FLOAT_DURATION / 60000UL),
-               cpsPtr->FLOAT_TO_BULK_AMPS,
-               cpsPtr->FLOAT_TO_BULK_AHS,
-               float2string(cpsPtr->FLOAT_TO_BULK_VOLTS, 2),
-
-               (unsigned int)(cpsPtr->EXIT_PF_DURATION / 60000UL), //  Show in Minutes, as opposed to mS,
-               float2string(cpsPtr->PF_TO_BULK_VOLTS, 2),
-               cpsPtr->PF_TO_BULK_AHS,
-
-               float2string(cpsPtr->EQUAL_BAT_V_SETPOINT, 2),
-               cpsPtr->LIMIT_EQUAL_AMPS,
-               (unsigned int)(cpsPtr->EXIT_EQUAL_DURATION / 60000UL), //  Show in Minutes, as opposed to mS,
-               cpsPtr->EXIT_EQUAL_AMPS,
-
-               float2string(cpsPtr->BAT_TEMP_1C_COMP, 3),
-               cpsPtr->MIN_TEMP_COMP_LIMIT,
-               cpsPtr->BAT_MIN_CHARGE_TEMP,
-               cpsPtr->BAT_MAX_CHARGE_TEMP);
+void prep_CPE(tTXWriter *w, tCPS *cpsPtr, int index)
+{
+    TXW_str_P(w, PSTR("CPE;,"));
+    TXW_int(w, (index + 1)); // Convert from "0-origin" of array indexes for display
+    TXW_char(w, ',');
+    TXW_fixed(w, cpsPtr->ACPT_BAT_V_SETPOINT, 2);
+    TXW_char(w, ',');
+    TXW_int(w, (unsigned int)(cpsPtr->EXIT_ACPT_DURATION / 60000UL)); // Show time running in Minutes, as opposed to mS
+    TXW_char(w, ',');
+    TXW_int(w, cpsPtr->EXIT_ACPT_AMPS);
+    TXW_str_P(w, PSTR(",0")); // Place holder for future dV/dT exit parameter, hard coded = 0 for now.
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_int(w, cpsPtr->LIMIT_OC_AMPS);
+    TXW_char(w, ',');
+    TXW_int(w, (unsigned int)(cpsPtr->EXIT_OC_DURATION / 60000UL));
+    TXW_char(w, ',');
+    TXW_fixed(w, cpsPtr->EXIT_OC_VOLTS, 2);
+    TXW_str_P(w, PSTR(",0")); // Place holder for future dV/dT exit parameter, hard coded = 0 for now.
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_fixed(w, cpsPtr->FLOAT_BAT_V_SETPOINT, 2);
+    TXW_char(w, ',');
+    TXW_int(w, cpsPtr->LIMIT_FLOAT_AMPS);
+    TXW_char(w, ',');
+    TXW_int(w, (unsigned int)(cpsPtr->EXIT_FLOAT_DURATION / 60000UL));
+    TXW_char(w, ',');
+    TXW_int(w, cpsPtr->FLOAT_TO_BULK_AMPS);
+    TXW_char(w, ',');
+    TXW_int(w, cpsPtr->FLOAT_TO_BULK_AHS);
+    TXW_char(w, ',');
+    TXW_fixed(w, cpsPtr->FLOAT_TO_BULK_VOLTS, 2);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_int(w, (unsigned int)(cpsPtr->EXIT_PF_DURATION / 60000UL)); //  Show in Minutes, as opposed to mS,
+    TXW_char(w, ',');
+    TXW_fixed(w, cpsPtr->PF_TO_BULK_VOLTS, 2);
+    TXW_char(w, ',');
+    TXW_int(w, cpsPtr->PF_TO_BULK_AHS);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_fixed(w, cpsPtr->EQUAL_BAT_V_SETPOINT, 2);
+    TXW_char(w, ',');
+    TXW_int(w, cpsPtr->LIMIT_EQUAL_AMPS);
+    TXW_char(w, ',');
+    TXW_int(w, (unsigned int)(cpsPtr->EXIT_EQUAL_DURATION / 60000UL)); //  Show in Minutes, as opposed to mS,
+    TXW_char(w, ',');
+    TXW_int(w, cpsPtr->EXIT_EQUAL_AMPS);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_fixed(w, cpsPtr->BAT_TEMP_1C_COMP, 3);
+    TXW_char(w, ',');
+    TXW_int(w, cpsPtr->MIN_TEMP_COMP_LIMIT);
+    TXW_char(w, ',');
+    TXW_int(w, cpsPtr->BAT_MIN_CHARGE_TEMP);
+    TXW_char(w, ',');
+    TXW_int(w, cpsPtr->BAT_MAX_CHARGE_TEMP);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_int(w, cpsPtr->EXIT_ACPT_SOC);
+    TXW_char(w, ',');
+    TXW_int(w, cpsPtr->FLOAT_TO_BULK_SOC);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_uint(w, cpsPtr->CELL_TAPER_MV);
+    TXW_char(w, ',');
+    TXW_uint(w, cpsPtr->CELL_MAX_MV);
+    TXW_char(w, ',');
+    TXW_int(w, cpsPtr->BALANCE_AMPS);
+    TXW_char(w, ',');
+    TXW_int(w, cpsPtr->BALANCE_SPREAD_MV);
+    TXW_str_P(w, PSTR("\r\n"));
 } //prep_CPE
 
 //void prep_CST(char *buffer) {   // Prep  the CAN Control Variable string. (Only on CAN enabled regulator)
@@ -819,108 +1795,402 @@ void prep_NPC(char *buffer)
 }
 */
 
-void prep_SCV(char *buffer)
+void prep_SCV(tTXWriter *w)
 { // Prep the System Control Variables.
-    snprintf_P(buffer, OUTBOUND_BUFF_SIZE, PSTR("SCV;,%1u,%1u,%1u,%s,%s,%1u, ,%d,%s,%s,%s,%d, ,%d,%d, ,%d,%s,%d,%d, ,%d,%d,%d,%u\r\n"),
-               systemConfig.CONFIG_LOCKOUT,
-               systemConfig.REVERSED_BAT_SHUNT,
-               systemConfig.REVERSED_ALT_SHUNT,
-               float2string(systemConfig.SV_OVERRIDE, 2),
-               float2string(systemConfig.BC_MULT_OVERRIDE, 2),
-               systemConfig.CP_INDEX_OVERRIDE,
-
-               systemConfig.ALT_TEMP_SETPOINT,
-               float2string(systemConfig.ALT_AMP_DERATE_NORMAL, 2),
-               float2string(systemConfig.ALT_AMP_DERATE_SMALL_MODE, 2),
-               float2string(systemConfig.ALT_AMP_DERATE_HALF_POWER, 2),
-               systemConfig.ALT_PULLBACK_FACTOR,
-
-               systemConfig.ALT_AMPS_LIMIT,
-               systemConfig.ALT_WATTS_LIMIT,
-
-               systemConfig.ALTERNATOR_POLES,
-               float2string(systemConfig.ENGINE_ALT_DRIVE_RATIO, 3),
-               systemConfig.BAT_AMP_SHUNT_RATIO,
-               systemConfig.ALT_AMP_SHUNT_RATIO,
-
-               systemConfig.ALT_IDLE_RPM,
-               ((systemConfig.FIELD_TACH_PWM > 0) ? ((100 * systemConfig.FIELD_TACH_PWM) / FIELD_PWM_MAX) : systemConfig.FIELD_TACH_PWM),
-               systemConfig.ENGINE_WARMUP_DURATION,
-               systemConfig.REQURED_SENSORS);
+    TXW_str_P(w, PSTR("SCV;,"));
+    TXW_uint(w, systemConfig.CONFIG_LOCKOUT);
+    TXW_char(w, ',');
+    TXW_uint(w, systemConfig.REVERSED_BAT_SHUNT);
+    TXW_char(w, ',');
+    TXW_uint(w, systemConfig.REVERSED_ALT_SHUNT);
+    TXW_char(w, ',');
+    TXW_fixed(w, systemConfig.SV_OVERRIDE, 2);
+    TXW_char(w, ',');
+    TXW_fixed(w, systemConfig.BC_MULT_OVERRIDE, 2);
+    TXW_char(w, ',');
+    TXW_uint(w, systemConfig.CP_INDEX_OVERRIDE);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_int(w, systemConfig.ALT_TEMP_SETPOINT);
+    TXW_char(w, ',');
+    TXW_fixed(w, systemConfig.ALT_AMP_DERATE_NORMAL, 2);
+    TXW_char(w, ',');
+    TXW_fixed(w, systemConfig.ALT_AMP_DERATE_SMALL_MODE, 2);
+    TXW_char(w, ',');
+    TXW_fixed(w, systemConfig.ALT_AMP_DERATE_HALF_POWER, 2);
+    TXW_char(w, ',');
+    TXW_int(w, systemConfig.ALT_PULLBACK_FACTOR);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_int(w, systemConfig.ALT_AMPS_LIMIT);
+    TXW_char(w, ',');
+    TXW_int(w, systemConfig.ALT_WATTS_LIMIT);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_int(w, systemConfig.ALTERNATOR_POLES);
+    TXW_char(w, ',');
+    TXW_fixed(w, systemConfig.ENGINE_ALT_DRIVE_RATIO, 3);
+    TXW_char(w, ',');
+    TXW_int(w, systemConfig.BAT_AMP_SHUNT_RATIO);
+    TXW_char(w, ',');
+    TXW_int(w, systemConfig.ALT_AMP_SHUNT_RATIO);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_int(w, systemConfig.ALT_IDLE_RPM);
+    TXW_char(w, ',');
+    TXW_int(w, ((systemConfig.FIELD_TACH_PWM > 0) ? ((100 * systemConfig.FIELD_TACH_PWM) / FIELD_PWM_MAX) : systemConfig.FIELD_TACH_PWM));
+    TXW_char(w, ',');
+    TXW_int(w, systemConfig.ENGINE_WARMUP_DURATION);
+    TXW_char(w, ',');
+    TXW_uint(w, systemConfig.REQURED_SENSORS);
+    TXW_str_P(w, PSTR("\r\n"));
 } //prep_SCV
 
-void prep_SST(char *buffer)
-{
-    snprintf_P(buffer, OUTBOUND_BUFF_SIZE - 3, PSTR("SST;,%s, ,%1u,%1u, ,%d,%s,%s, ,%d,%d, ,%d,%d, ,%1u\r\n"), //  System Status
-               firmwareVersion,
-
-               smallAltMode,
-               tachMode,
+void prep_SST(tTXWriter *w)
+{ //  System Status
+    TXW_str_P(w, PSTR("SST;,"));
+    TXW_str(w, firmwareVersion);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_uint(w, smallAltMode);
+    TXW_char(w, ',');
+    TXW_uint(w, tachMode);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_int(w, (int)(cpIndex + 1));
+    TXW_char(w, ',');
+    TXW_fixed(w, systemAmpMult, 2);
+    TXW_char(w, ',');
+    TXW_fixed(w, systemVoltMult, 2);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_int(w, altCapAmps);
+    TXW_char(w, ',');
+    TXW_int(w, altCapRPMs);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_int(w, (int)((accumulatedASecs / 3600UL) * (ACCUMULATE_SAMPLING_RATE / 1000UL))); // Convert into actual AHs
+    TXW_char(w, ',');
+    TXW_int(w, (int)((accumulatedWSecs / 3600UL) * (ACCUMULATE_SAMPLING_RATE / 1000UL))); // Convert into actual WHs
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_uint(w, systemConfig.FORCED_TM);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_uint(w, asciiTX.dropped); // Bytes of serial output that had to be dropped
+    TXW_char(w, ',');
+    TXW_uint(w, asciiTX.peak);    //   and the most that have been waiting to go out.
+
+    TXW_str_P(w, PSTR(", ,"));
+#ifdef USE_OLED
+    TXW_fixed(w, oledLoad / 10.0, 1); // Share of the Mainloop's time going to the OLED, in %
+    TXW_char(w, ',');
+    TXW_uint(w, oledSliceMax);        //   and the longest slice of it, in uS.
+#else
+    TXW_str_P(w, PSTR("0.0,0"));
+#endif
 
-               (int)(cpIndex + 1),
-               float2string(systemAmpMult, 2),
-               float2string(systemVoltMult, 2),
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_ulong(w, sensorLatency);      // uS from starting the INA226s sampling until they were read
+    TXW_char(w, ',');
+    TXW_ulong(w, sensorLatencyMax);
+    TXW_str_P(w, PSTR("\r\n"));
+} //prep_SST
 
-               altCapAmps,
-               altCapRPMs,
+//------------------------------------------------------------------------------------------------------
+// Prep Binary Outbound structures
+//
+//      These fill in the binary form of the matching ASCII string above (see BinTelemetry.h), in the passed
+//      buffer, and return its size.   Used in place of the ASCII strings once the host has sent $BIN:1
+//
+//------------------------------------------------------------------------------------------------------
 
-               (int)((accumulatedASecs / 3600UL) * (ACCUMULATE_SAMPLING_RATE / 1000UL)), // Convert into actual AHs
-               (int)((accumulatedWSecs / 3600UL) * (ACCUMULATE_SAMPLING_RATE / 1000UL)), // Convert into actual WHs
+uint8_t bprep_AST(void *buffer)
+{
+    tBTAST *p = (tBTAST *)buffer;
+
+    p->runTime = generatorLrRunTime / 1000UL;
+    p->batmV = TO_mV(measuredBatVolts);
+    p->altdA = TO_dA(measuredAltAmps);
+    p->batdA = TO_dA(measuredBatAmps);
+    p->altWatts = measuredAltWatts;
+    p->targetBatmV = TO_mV(targetBatVolts);
+    p->targetAltAmps = (int)targetAltAmps;
+    p->targetAltWatts = targetAltWatts;
+    p->state = chargingState;
+    p->batTemp = measuredBatTemp;
+    p->altTemp = measuredAltTemp;
+    p->RPMs = measuredRPMs;
+    p->altmV = TO_mV(measuredAltVolts);
+    p->FETTemp = measuredFETTemp;
+    p->fieldAmps = measuredFieldAmps;
+    p->fieldPWM = (100 * fieldPWMvalue) / FIELD_PWM_MAX;
+
+    return (sizeof(tBTAST));
+} //bprep_AST
+
+uint8_t bprep_default_CPE(void *buffer)
+{
+    return (bprep_CPE(buffer, &chargingParms, cpIndex));
+}
 
-               systemConfig.FORCED_TM);
-} //prep_SST
+uint8_t bprep_CPE(void *buffer, tCPS *cpsPtr, int index)
+{
+    tBTCPE *p = (tBTCPE *)buffer;
+
+    p->index = index + 1;
+    p->acptmV = TO_mV(cpsPtr->ACPT_BAT_V_SETPOINT);
+    p->exitAcptMin = cpsPtr->EXIT_ACPT_DURATION / 60000UL;
+    p->exitAcptAmps = cpsPtr->EXIT_ACPT_AMPS;
+
+    p->limitOCAmps = cpsPtr->LIMIT_OC_AMPS;
+    p->exitOCMin = cpsPtr->EXIT_OC_DURATION / 60000UL;
+    p->exitOCmV = TO_mV(cpsPtr->EXIT_OC_VOLTS);
+
+    p->floatmV = TO_mV(cpsPtr->FLOAT_BAT_V_SETPOINT);
+    p->limitFloatAmps = cpsPtr->LIMIT_FLOAT_AMPS;
+    p->exitFloatMin = cpsPtr->EXIT_FLOAT_DURATION / 60000UL;
+    p->floatToBulkAmps = cpsPtr->FLOAT_TO_BULK_AMPS;
+    p->floatToBulkAHs = cpsPtr->FLOAT_TO_BULK_AHS;
+    p->floatToBulkmV = TO_mV(cpsPtr->FLOAT_TO_BULK_VOLTS);
+
+    p->exitPFMin = cpsPtr->EXIT_PF_DURATION / 60000UL;
+    p->PFToBulkmV = TO_mV(cpsPtr->PF_TO_BULK_VOLTS);
+    p->PFToBulkAHs = cpsPtr->PF_TO_BULK_AHS;
+
+    p->equalmV = TO_mV(cpsPtr->EQUAL_BAT_V_SETPOINT);
+    p->limitEqualAmps = cpsPtr->LIMIT_EQUAL_AMPS;
+    p->exitEqualMin = cpsPtr->EXIT_EQUAL_DURATION / 60000UL;
+    p->exitEqualAmps = cpsPtr->EXIT_EQUAL_AMPS;
+
+    p->tempComp = (int16_t)lround(cpsPtr->BAT_TEMP_1C_COMP * 10000.0); // Volts --> 0.1mV
+    p->minTempComp = cpsPtr->MIN_TEMP_COMP_LIMIT;
+    p->batMinTemp = cpsPtr->BAT_MIN_CHARGE_TEMP;
+    p->batMaxTemp = cpsPtr->BAT_MAX_CHARGE_TEMP;
+
+    p->exitAcptSOC = cpsPtr->EXIT_ACPT_SOC;
+    p->floatToBulkSOC = cpsPtr->FLOAT_TO_BULK_SOC;
+
+    p->cellTapermV = cpsPtr->CELL_TAPER_MV;
+    p->cellMaxmV = cpsPtr->CELL_MAX_MV;
+    p->balanceAmps = cpsPtr->BALANCE_AMPS;
+    p->balanceSpreadmV = cpsPtr->BALANCE_SPREAD_MV;
+
+    return (sizeof(tBTCPE));
+} //bprep_CPE
+
+uint8_t bprep_SST(void *buffer)
+{
+    tBTSST *p = (tBTSST *)buffer;
+
+    strncpy(p->firmware, firmwareVersion, sizeof(p->firmware));
+    p->flags = (smallAltMode ? BTF_SMALL_ALT : 0) |
+               (tachMode ? BTF_TACH_MODE : 0) |
+               (systemConfig.FORCED_TM ? BTF_FORCED_TM : 0);
+    p->cpIndex = cpIndex + 1;
+    p->ampMult = (uint16_t)lround(systemAmpMult * 100.0);
+    p->voltMult = (uint16_t)lround(systemVoltMult * 100.0);
+    p->altCapAmps = altCapAmps;
+    p->altCapRPMs = altCapRPMs;
+    p->AHs = (accumulatedASecs / 3600UL) * (ACCUMULATE_SAMPLING_RATE / 1000UL);
+    p->WHs = (accumulatedWSecs / 3600UL) * (ACCUMULATE_SAMPLING_RATE / 1000UL);
+    p->txDropped = asciiTX.dropped;
+    p->txPeak = asciiTX.peak;
+#ifdef USE_OLED
+    p->oledLoad = oledLoad;
+    p->oledSliceMax = oledSliceMax;
+#else
+    p->oledLoad = 0;
+    p->oledSliceMax = 0;
+#endif
+    p->sensorLatency = sensorLatency;
+    p->sensorLatencyMax = sensorLatencyMax;
 
-//----  Helper function for Send_outbound();
-//
-// floatString converts a float to a string
-// We return one of a set of static buffers
-//  (Thank-you to Ron K. for this concept / code stub)
+    return (sizeof(tBTSST));
+} //bprep_SST
 
-char *float2string(float v, uint8_t decimals)
+uint8_t bprep_SCV(void *buffer)
 {
-    const int OUTPUT_BUFS = 7; // maximum number of floats in a single sprintf
-    const int MAX_OUTPUT = 13; // largest possible output string
-    float absV;
-    static char outputBuffers[OUTPUT_BUFS][MAX_OUTPUT + 1];
-    static uint8_t callCount;
-    char formatter[] = "%d.%0_d";
+    tBTSCV *p = (tBTSCV *)buffer;
+
+    p->lockout = systemConfig.CONFIG_LOCKOUT;
+    p->flags = (systemConfig.REVERSED_BAT_SHUNT ? BTF_REV_BAT_SHUNT : 0) |
+               (systemConfig.REVERSED_ALT_SHUNT ? BTF_REV_ALT_SHUNT : 0);
+    p->SVOverride = (uint16_t)lround(systemConfig.SV_OVERRIDE * 100.0);
+    p->BCOverride = (uint16_t)lround(systemConfig.BC_MULT_OVERRIDE * 100.0);
+    p->CPOverride = systemConfig.CP_INDEX_OVERRIDE;
+
+    p->altTempSetpoint = systemConfig.ALT_TEMP_SETPOINT;
+    p->derateNormal = (uint8_t)lround(systemConfig.ALT_AMP_DERATE_NORMAL * 100.0);
+    p->derateSmall = (uint8_t)lround(systemConfig.ALT_AMP_DERATE_SMALL_MODE * 100.0);
+    p->derateHalf = (uint8_t)lround(systemConfig.ALT_AMP_DERATE_HALF_POWER * 100.0);
+    p->pullbackFactor = systemConfig.ALT_PULLBACK_FACTOR;
+
+    p->altAmpsLimit = systemConfig.ALT_AMPS_LIMIT;
+    p->altWattsLimit = systemConfig.ALT_WATTS_LIMIT;
+
+    p->altPoles = systemConfig.ALTERNATOR_POLES;
+    p->driveRatio = (uint16_t)lround(systemConfig.ENGINE_ALT_DRIVE_RATIO * 1000.0);
+    p->batShuntRatio = systemConfig.BAT_AMP_SHUNT_RATIO;
+    p->altShuntRatio = systemConfig.ALT_AMP_SHUNT_RATIO;
+
+    p->idleRPMs = systemConfig.ALT_IDLE_RPM;
+    p->fieldTachPWM = (systemConfig.FIELD_TACH_PWM > 0) ? ((100 * systemConfig.FIELD_TACH_PWM) / FIELD_PWM_MAX) : systemConfig.FIELD_TACH_PWM;
+    p->warmup = systemConfig.ENGINE_WARMUP_DURATION;
+    p->requiredSensors = systemConfig.REQURED_SENSORS;
+
+    return (sizeof(tBTSCV));
+} //bprep_SCV
+
+#ifdef USE_SOC_ESTIMATOR
+void prep_SOC(tTXWriter *w)
+{ // SOC: Battery State of Charge string.
+    TXW_str_P(w, PSTR("SOC;,"));
+    TXW_fixed(w, batterySOC, 1); // In %
+    TXW_char(w, ',');
+    TXW_int(w, socTimeToFull);   // In Minutes, -1 if not charging
+    TXW_char(w, ',');
+    TXW_uint(w, SOC_valid());    // Can the estimate be used for charging decisions yet?
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_int(w, (int)socCapacityAh);
+    TXW_str_P(w, PSTR("\r\n"));
+} //prep_SOC
+#endif
+
+#ifdef USE_BMS_SERIAL_IN
+void prep_BMS(tTXWriter *w)
+{ // BMS: What the BMS has told us, and how quickly we have responded to its disconnect warnings.
+    uint16_t minmV = 0xFFFF;
+    uint16_t maxmV = 0;
+    uint8_t i;
 
-    char *pos = outputBuffers[++callCount % OUTPUT_BUFS]; // Select buffer to use this time (Round-robben)
-    //__ return (dtostrf(v,MAX_OUTPUT , decimals, pos));    //<<-- This works GREAT, but is about 1.2K in code size larger then what is here.
+    for (i = 0; i < bmsData.cellCount; i++)
+    {
+        minmV = min(minmV, bmsData.cellmV[i]);
+        maxmV = max(maxmV, bmsData.cellmV[i]);
+    }
 
-    formatter[5] = decimals + '0'; // create the number for the # of decimal characters we ultimatly want.
+    TXW_str_P(w, PSTR("BMS;,"));
+    TXW_uint(w, BMS_limits_valid());
+    TXW_char(w, ',');
+    TXW_uint(w, bmsData.CVL_mV);
+    TXW_char(w, ',');
+    TXW_uint(w, bmsData.CCL_dA);
+    TXW_char(w, ',');
+    TXW_uint(w, bmsData.flags);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_uint(w, bmsData.packmV);
+    TXW_char(w, ',');
+    TXW_int(w, bmsData.packdA);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_uint(w, bmsData.cellCount);
+    TXW_char(w, ',');
+    TXW_uint(w, ((bmsData.cellCount != 0) ? minmV : 0)); // Lowest and highest cell, in mV
+    TXW_char(w, ',');
+    TXW_uint(w, maxmV);
+
+    TXW_str_P(w, PSTR(", ,"));
+    TXW_ulong(w, bmsShutdownLatency / 1000UL); // In mS
+    TXW_char(w, ',');
+    TXW_ulong(w, bmsShutdownLatencyMax / 1000UL);
+    TXW_char(w, ',');
+    TXW_uint(w, bmsLatencyOverruns);
+    TXW_char(w, ',');
+    TXW_uint(w, bmsFrameErrors);
+    TXW_str_P(w, PSTR("\r\n"));
+} //prep_BMS
+#endif
 
-    unsigned int mult = 1; // Calc multplier for fractional portion of number
-    uint8_t multleft = decimals;
-    while (multleft--)
+#ifdef USE_HISTORY
+void prep_HIS(tTXWriter *w, uint8_t level, uint32_t seq, const tBTHistRec *rec)
+{ // HIS: One Charge History record - where it is in the history, and the low, high, and mean of each value over it.
+    uint16_t interval = history_interval(level);
+    uint8_t i;
+
+    TXW_str_P(w, PSTR("HIS;,"));
+    TXW_uint(w, level);
+    TXW_char(w, ',');
+    TXW_ulong(w, seq);
+    TXW_char(w, ',');
+    TXW_uint(w, interval);                                // Seconds it covers
+    TXW_char(w, ',');
+    TXW_ulong(w, histSamples - ((seq + 1) * interval));   // and how many ago it ended
+    TXW_char(w, ',');
+    TXW_uint(w, rec->state);
+
+    TXW_str_P(w, PSTR(", "));
+    for (i = 0; i < 3; i++)
     {
-        mult *= 10;
+        TXW_char(w, ',');
+        TXW_fixed(w, rec->batmV[i] / 1000.0, 2);
     }
+    TXW_str_P(w, PSTR(", "));
+    for (i = 0; i < 3; i++)
+    {
+        TXW_char(w, ',');
+        TXW_fixed(w, rec->batdA[i] / 10.0, 1);
+    }
+    TXW_str_P(w, PSTR(", "));
+    for (i = 0; i < 3; i++)
+    {
+        TXW_char(w, ',');
+        TXW_fixed(w, rec->altdA[i] / 10.0, 1);
+    }
+    TXW_str_P(w, PSTR(", "));
+    for (i = 0; i < 3; i++)
+    {
+        TXW_char(w, ',');
+        TXW_int(w, rec->altTemp[i]);
+    }
+    TXW_str_P(w, PSTR("\r\n"));
+} //prep_HIS
+#endif
 
-    absV = v;
-    if (absV < 0)
-        absV *= -1;
+#ifdef USE_GAIN_SCHEDULING
+void prep_PGS(tTXWriter *w)
+{ // Prep the PID Gain Schedule string.  Grid spacing, then the multipliers one RPM grid point (row) at a time, coldest temperature 1st.
+    uint8_t r;
+    uint8_t t;
 
-    snprintf(pos, MAX_OUTPUT, formatter,
-             (int)v,                                // Whole number, with its sign
-             (unsigned int)((absV * mult)) % mult); // Fraction, w/o a sign.
+    TXW_str_P(w, PSTR("PGS;,"));
+    TXW_int(w, GS_RPM_STEP);
+    TXW_char(w, ',');
+    TXW_int(w, GS_TEMP_MIN);
+    TXW_char(w, ',');
+    TXW_int(w, GS_TEMP_STEP);
 
-    return pos;
-} //float2string
+    for (r = 0; r < GS_RPM_BINS; r++)
+    {
+        TXW_str_P(w, PSTR(", "));
+        for (t = 0; t < GS_TEMP_BINS; t++)
+        {
+            TXW_char(w, ',');
+            TXW_fixed(w, (float)gainSchedule.MULT[r][t] / GS_MULT_ONE, 2);
+        }
+    }
 
-void append_string(char *dest, const char *src, int n)
-{
-    int i;
-    int offset;
-    int limit;
+    TXW_str_P(w, PSTR("\r\n"));
+} //prep_PGS
+#endif
 
-    offset = strlen(dest); // Where should we start appending?
-    limit = n - offset;    // Figure out how much room is left in the destination string
+void prep_SUB(tTXWriter *w)
+{ // Prep the Subscriptions string.  Enabled bits, then the period (mS) and port of each message in SUB_xxx order.
+    uint8_t m;
 
-    for (i = 0; (i < limit) && *(src + i); i++)
-    {                                      // As long as we have not exceeded the remaining room (leaving room for a final \o), and have not reached the end of the 'src' string
-        *(dest + i + offset) = *(src + i); // copy over the character from the Source to the Destination.
+    TXW_str_P(w, PSTR("SUB;,"));
+    TXW_uint(w, subscriptions.ENABLED);
+    TXW_str_P(w, PSTR(", "));
+
+    for (m = 0; m < SUB_MAX; m++)
+    {
+        TXW_char(w, ',');
+        TXW_uint(w, subscriptions.PERIOD[m]);
+        TXW_char(w, ',');
+        TXW_uint(w, subscriptions.PORT[m]);
     }
 
-    *(dest + i + offset) = '\0'; // NULL terminator goes at the end.
-} //append_string
+    TXW_str_P(w, PSTR("\r\n"));
+} //prep_SUB
@@ -26,22 +26,57 @@
 
 #include "Config.h"
 #include "CPE.h"    
+#include "TxWriter.h"
 
 
                                 //----- External communications, Baud rate, buffer sizes, timeouts, etc..
                                 //
 #define UPDATE_STATUS_RATE         1000UL               // Send an update of the Status (via Bluetooth / Serial port) every 1 seconds.
-#define UPDATE_MAJOR_SENSITIVITY     60                 // Every 60 Update cycles, send the not-so-critical information.... (Max 126)
+#define DELTA_KEYFRAME_RATE       10000UL               // In delta mode ($BIN:2) send the full status at least every 10 seconds, even if nothing has changed.
 #define INBOUND_BUFF_SIZE            70                 // Size of input command buffer (CAUTION:  250 -- 8-bit indexes are used)
-#define OUTBOUND_BUFF_SIZE          200                 // Large Outbound buffer, make sure we do not overrun (Primarily CPE;)(CAUTION:  250 -- 8-bit indexes are used)
+#define OUTBOUND_BUFF_SIZE          200                 // Longest outbound string (Primarily CPE;), see TXW_char()  (CAUTION:  250 -- 8-bit indexes are used)
 #define IB_BUFF_FILL_TIMEOUT     60000UL                // If a complete 'command' string is not received within 60 seconds, abort it.  Set = 0 to disable this feature.
-#define SDM_SENSITIVITY             10                 // Send Debug Material:  only update the Serial Port with debug info every 10 times through. 
-                                                        // (Set = 1 for max updates, max value 126)
+#define IB_MAX_FIELDS               16                  // Most ',' separated fields a command may carry  ($SCA: has 15).  Any more and the command is abandoned.
+#define IB_HASH_SIZE                32                  // Slots in the command dispatch table, see IB_HASH() in OSEnergy_Serial.cpp
+#define BK_LOAD_TIMEOUT           5000UL                // $BKL:  If the next Config Backup frame has not arrived within 5 seconds, give up on it and go back to taking commands.
 
-//extern tRVCGenCmd       ASCIIGenRequest;
+                                //----- Command permissions.  Each command needs one of these, and each port commands are taken from allows some of them.
+                                //      (The ASCII port allows everything, the Serial Display port what SERIAL_DISPLAY_PERMS in Config.h says)
+#define IBP_READ                  0x01                  // Only changes what is sent back  ($RAS, $RCP, $SUB, $BIN, etc)
+#define IBP_CONFIG                0x02                  // Changes a saved setting  (Charge Profiles, System Config, Gain Schedule)
+#define IBP_CONTROL               0x04                  // Changes what the regulator is doing right now  (Force Mode, Reboot)
+#define IBP_RESTORE               0x08                  // Erases all saved settings  ($MSR)
+#define IBP_ALL                   0xFF
+#define SUB_BUDGET_PCT              80                 // Scheduled status may use up to 80% of each port's Baud rate, leaving the rest for command responses and display updates.
+#define SUB_BUDGET_BURST           400                  //   and may get up to 400 bytes ahead of that.
+
+                                //----- Subscriptions - which status messages are sent, how often, and to which port.   Set via $SUB, saved in EEPROM.
+                                //      (Message numbers are fixed, so a saved table stays good whichever features are compiled in)
+#define SUB_AST 0
+#define SUB_CPE 1
+#define SUB_SST 2
+#define SUB_SCV 3
+#define SUB_SOC 4
+#define SUB_BMS 5
+#define SUB_DBG 6
+#define SUB_MAX 8                                       // (Room for one more)
+
+typedef struct
+{
+    uint16_t PERIOD[SUB_MAX];   // mS between sending message [m]
+    uint8_t PORT[SUB_MAX];      // TX_PORT_xxx it is sent to
+    uint8_t ENABLED;            // Bit [m] set = message [m] is being sent
+} tSUB;
+
+extern tSUB subscriptions;
+extern bool sendDebugString;
 
 void check_inbound(void);
 bool send_outbound(bool pushAll);
-char *float2string(float v, uint8_t decimals);
+void initialize_SUB(void);
+void transfer_default_SUB(tSUB *subPtr);
+bool OB_due(uint8_t msg);
+void OB_begin(uint8_t msg, tTXWriter *w);
+void OB_end(uint8_t msg, tTXWriter *w);
  
 #endif  // _OSENERGY_SERIAL_H_
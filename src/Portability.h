@@ -48,15 +48,24 @@
     #include <avr/wdt.h>     
     #include <MemoryFree.h>
     #include "System.h"
+    #include "TxRing.h"
+    #include "BinTelemetry.h"
                                                         
     //-- Some #defines to allow for more common code across different CPUs, w/o a TON of #ifdefs
     #define sample_feature_IN_port1()   digitalRead(FEATURE_IN_PORT1)    
     #define sample_feature_IN_port2()   digitalRead(FEATURE_IN_PORT2) 
     #define sample_feature_IN_port3()   digitalRead(FEATURE_IN_PORT3)                                                   
 
-    #define ASCII_read(v)          Serial.read()
-    #define ASCII_RxAvailable(v)  (Serial.available() > 0)
-    #define ASCII_write(v)         Serial.write(v)
-    #define Serial_flush();        Serial.flush();
+    #define ASCII_read(v)          (v)->read()                     // Passed the HardwareSerial port, see fill_ib_buffer()
+    #define ASCII_RxAvailable(v)  ((v)->available() > 0)
+    #define ASCII_write(v)         BT_write_text((v), true)        // Queued, see TxRing.cpp  (And framed if in binary mode, see BinTelemetry.cpp)
+    #define ASCII_write_LP(v)      BT_write_text((v), false)       //   (Low priority - dropped if the queue is getting full)
+    #define Serial_flush();        TX_flush(); Serial.flush();
+
+    //-- Constant tables kept in FLASH, and reading them back.  (The AVR has a separate program address space - on a CPU with one address
+    //   space these become plain const data, a plain read and memcpy())
+    #define FLASH_TABLE             PROGMEM
+    #define FLASH_read_word(a)      pgm_read_word_near(a)
+    #define FLASH_copy(d, s, n)     memcpy_P((d), (s), (n))
     
  #endif  // _PORTABILITY_H_
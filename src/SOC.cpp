@@ -0,0 +1,166 @@
+//      SOC.cpp
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//*****************************************************************************************
+//
+//    Battery State of Charge estimator.   Counts the Ahs going into (less the charge efficiency)
+//    and out of the battery, and corrects that count whenever there is something better to go on:
+//
+//      -- Any time the battery has been seen resting (no field drive, and next to no Amps) for
+//           SOC_REST_TIME, the rested voltage is looked up on the Open Circuit Voltage curve of
+//           the selected Charge Profile.  (See defaultOCV[] in CPE.cpp)  The power-up voltage is
+//           only a first guess, and is not used for charge decisions.
+//      -- Any time the battery has been held at its charge voltage with the current tailed off to
+//           SOC_TAIL_AMPS for SOC_SYNC_TIME, it is full.
+//
+//    The charging state machine can then use the estimate to leave Acceptance once the battery is
+//    actually full, and to go back to Bulk if it is being drawn down while in Float.
+//
+//*****************************************************************************************
+
+#include "Config.h"
+#include "System.h"
+#include "Alternator.h"
+#include "Sensors.h"
+#include "CPE.h"
+#include "SOC.h"
+
+float batterySOC = -1;     // Estimated State of Charge in %, -1 = not known.
+int socTimeToFull = -1;    // Minutes to full at the present charge current, -1 = not charging (or not known)
+float socCapacityAh = 0;   // Battery capacity in Ahs
+
+static tOCV ocv;           // OCV curve of the selected Charge Profile, copied out of FLASH
+static float socAh;        // Ahs presently held in the battery
+static bool socAnchored;   // Has the Ah count been tied to a rested OCV, or to a full battery, yet?
+
+//-------       'helper' function used by initialize_SOC() and manage_SOC();
+//              Looks up the passed (rested) battery voltage on the OCV curve, and returns the State of Charge in %
+static float SOC_from_OCV(float volts)
+{
+    float mV = volts * 1000.0 / systemVoltMult; // Bring it back to a 12v battery
+    uint8_t i;
+
+    if (mV <= ocv.OCV_mV[0])
+        return (0.0);
+
+    for (i = 1; i < OCV_POINTS; i++)
+        if (mV < ocv.OCV_mV[i])
+            return ((i - 1 + (mV - ocv.OCV_mV[i - 1]) / (float)(ocv.OCV_mV[i] - ocv.OCV_mV[i - 1])) * (100.0 / (OCV_POINTS - 1)));
+
+    return (100.0);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Initialize SOC
+//      Called once during Startup, after the Charge Profile has been selected and the system Volts / Amps
+//      multipliers are known.  Takes a starting State of Charge from the battery voltage, for display only:
+//      there is no telling how long the battery has been resting (or if it has been cranking an engine a
+//      moment ago), so the estimate is not trusted for charge decisions until manage_SOC() has seen a full
+//      SOC_REST_TIME of rest, or a full battery.
+//
+//------------------------------------------------------------------------------------------------------
+
+void initialize_SOC(void)
+{
+    memcpy_P(&ocv, &defaultOCV[cpIndex], sizeof(tOCV));
+
+    socCapacityAh = SOC_NOMINAL_AH * systemAmpMult;
+    socAh = SOC_from_OCV(measuredBatVolts) * socCapacityAh / 100.0;
+    socAnchored = false;
+    batterySOC = socAh * 100.0 / socCapacityAh;
+} //initialize_SOC
+
+//------------------------------------------------------------------------------------------------------
+// SOC Valid
+//      Returns TRUE if the estimate can be used to make charging decisions.
+//
+//------------------------------------------------------------------------------------------------------
+
+bool SOC_valid(void)
+{
+    return ((socAnchored == true) && (shuntAltAmpsMeasured == true)); // Need to have something to count from, and be able to count..
+} //SOC_valid
+
+//------------------------------------------------------------------------------------------------------
+// Manage SOC
+//      Called from the Mainloop.  Every SOC_SAMPLE_RATE, counts the Battery Amps into the estimate, checks
+//      to see if the battery has been resting (or has become full) long enough to re-anchor the count, and
+//      updates the time to full.
+//
+//------------------------------------------------------------------------------------------------------
+
+void manage_SOC(void)
+{
+    uint32_t static lastSample = 0;
+    uint32_t static restStarted = 0;
+    uint32_t static fullStarted = 0;
+    bool static tailing = false;
+
+    float amps;
+    float ah;
+
+    if ((millis() - lastSample) < SOC_SAMPLE_RATE)
+        return;
+
+    amps = measuredBatAmps;
+    ah = amps * (millis() - lastSample) / 3600000.0;
+    lastSample = millis();
+
+    if (ah > 0.0)
+        ah *= ocv.CHARGE_EFF / 100.0; // Not all that goes in stays in.
+    socAh = constrain(socAh + ah, 0.0, socCapacityAh);
+
+    //--- Resting?  Once it has been long enough, the OCV curve is a better guide than the counting done so far.
+    if ((fabs(amps) <= (SOC_REST_AMPS * systemAmpMult)) && (fieldPWMvalue == 0))
+    {
+        if ((lastSample - restStarted) >= SOC_REST_TIME)
+        {
+            socAh = SOC_from_OCV(measuredBatVolts) * socCapacityAh / 100.0;
+            socAnchored = true;
+            restStarted = lastSample; // And check again after another rest period.
+        }
+    }
+    else
+        restStarted = lastSample;
+
+    //--- Full?  Held at the charging voltage with the Amps tailed off.
+    if (((chargingState == acceptance_charge) || (chargingState == overcharge_charge) || (chargingState == float_charge)) &&
+        (measuredBatVolts >= (targetBatVolts - (PID_VOLTAGE_SENS * systemVoltMult))) &&
+        (amps >= 0.0) && (amps <= (SOC_TAIL_AMPS * systemAmpMult)))
+    {
+        if (tailing != true)
+        {
+            tailing = true;
+            fullStarted = lastSample;
+        }
+        else if ((lastSample - fullStarted) >= SOC_SYNC_TIME)
+        {
+            socAh = socCapacityAh;
+            socAnchored = true;
+        }
+    }
+    else
+        tailing = false;
+
+    batterySOC = socAh * 100.0 / socCapacityAh;
+
+    if (amps > (SOC_REST_AMPS * systemAmpMult))
+        socTimeToFull = (int)min(((socCapacityAh - socAh) * 60.0) / (amps * ocv.CHARGE_EFF / 100.0), 5999.0); // (Cap at ~100 hours)
+    else
+        socTimeToFull = -1;
+} //manage_SOC
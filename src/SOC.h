@@ -0,0 +1,33 @@
+//      SOC.h
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+
+#ifndef _SOC_H_
+#define _SOC_H_
+
+#include "Config.h"
+
+extern float batterySOC;
+extern int socTimeToFull;
+extern float socCapacityAh;
+
+void initialize_SOC(void);
+void manage_SOC(void);
+bool SOC_valid(void);
+
+#endif // _SOC_H_
@@ -23,6 +23,7 @@
 #include "Sensors.h"
 #include "Alternator.h"
 #include "Flash.h"
+#include "History.h"
 #include <Wire.h>
 
 #include <I2Cx.h> // Newer I2C lib with improved reliability and error checking.
@@ -31,6 +32,9 @@
 #ifdef USE_OLED
   #include "I2C_OLED.h"
   char buffer2[20];
+  uint16_t oledLoad = 0;      // Share of the Mainloop's time spent in manage_OLED(), in 0.1%  (Over the last OLED_LOAD_WINDOW)
+  uint16_t oledSliceMax = 0;  //   and the longest it took in one pass, in uS.
+  bool oledStepScreen = false; // Set to have the OLED move on to its next screen  (See FEATURE_IN_OLED_SCREEN)
 #else
   #include <SoftI2CMaster.h> // http://homepage.hispeed.ch/peterfleury/avr-software.html
 #endif                     //USE_OLED   // DUBLER 061420 new URL https://github.com/felias-fogg/SoftI2CMaster 
@@ -60,6 +64,8 @@ bool batTempExternal = false; // Have we received the battery temperature from a
 int measuredFieldAmps = -99; // What is the current being delivered to the field?  -99 indicated we are not able to measure it.
 bool updatingBatVAs = false; // Are we in the process of updating the Volts and Amps?  (Meaning, hold off doing anything critical until we get new data..)
 bool updatingAltVAs = false; 
+uint32_t sensorLatency = 0;    // uS from starting an INA226 sample cycle until both have been read  (Last time, and worst seen)
+uint32_t sensorLatencyMax = 0; //   Includes their conversion time, and however long the Mainloop took to get back around to them.
 //----- Calibration buffer
 //      Future releases may allow for calibration of individual boards.  Either by user, or by some external manufacturing process.
 //      Would allow for use of lower-cost resistors in all the dividers.  This structure is saved in the FLASH of each device.
@@ -79,6 +85,7 @@ tCAL ADCCal = {false, // locked   == Let user do calibration if they wish to.
 
 //----  Internal veriables and prototypes
 uint32_t sensorsLastSampled; // Used in the main loop to force an sensor (INA226, NTC) sample cycle if alternator isn't running.
+uint32_t sensorSampleStarted = 0U; // micros() the INA226 sample cycle was started, 0 = it has been read.
 
 uint32_t accumulatedNTC_A = 0; // Accumulated RAW A/D readings from sample_ADCs();  Used to calculate temperatures after averaging NTC_AVERAGING A/D readings.
 uint32_t accumulatedNTC_B = 0;
@@ -91,6 +98,7 @@ uint32_t generatorLrStarted; // At what time (mills) did the Generator start pro
 uint32_t generatorLrRunTime; // Accumulated time for the last Alternator run (in mills)
 int32_t accumulatedASecs;    // Accumulated Amp-Seconds of current charge cycle.   This actually holds Amps @ ACCUMULATED_SAMPLING rate.  Need to divide to get true value.
 int32_t accumulatedWSecs;    // Accumulated Watt-Seconds of current charge cycle.  This actually holds Watts @ ACCUMULATED_SAMPLING rate. Need to divide to get true value.
+tLIFE lifeStats;             // Lifetime statistics.  Loaded from EEPROM at Startup, see checkpoint_LIFE().
 
 int16_t savedShuntRawADC; // Place holder for the last raw Shunt ADC reading during read_INA().  Used by calibrate_ADCs() to determine offset error of board
 
@@ -124,7 +132,9 @@ bool initialize_sensors(void)
   I2c.pullup(0);            // Disable internal pull-ups, there are external pull-up resisters.
 
 #ifdef USE_OLED
+  #ifndef OLED_SOFT_I2C
   Wire.begin();                             // wire.begin will also do an i2c_init since we are using the wire.h shell of I2CMaster
+  #endif
   oled.begin(&Adafruit128x64, LCD_ADDRESS); // start up the SDD1306 OLED
 #else
   i2c_init();
@@ -132,6 +142,11 @@ bool initialize_sensors(void)
 
   sensorsLastSampled = millis(); // Prime all the loop counters;
   reset_run_summary();
+
+  if (read_LIFE_EEPROM(&lifeStats))
+    lifeStats.restarts++; // Carry on with the Lifetime statistics last saved.
+  else
+    memset(&lifeStats, 0, sizeof(lifeStats)); // None saved yet  (or they did not check out), start them over.
   sample_ALT_and_BAT_VoltAmps(); // Let's get these guys doing a round of sampling for use to decide system voltage.
 
   return (true);
@@ -173,11 +188,21 @@ bool read_sensors(void)
     sample_ADCs_for_Temperatures(); // Use the same pacing rate for the local NTC ADC sampling conversions.
 
     sensorsLastSampled = millis();
+    sensorSampleStarted = micros();
     statorIRQflag = false; // Clear the Stator Flag for next time.
   }
 
   resolve_ADCs_for_Temperatures();
-  return (read_ALT_and_BAT_VoltAmps()); // here we update the actual values, having already started the read earlier, and return the status
+  if (!read_ALT_and_BAT_VoltAmps())     // here we update the actual values, having already started the read earlier, and return the status
+    return (false);
+
+  if ((sensorSampleStarted != 0U) && !updatingBatVAs && !updatingAltVAs)
+  { // Both INA226s have been read, how long did it take since they were started?
+    sensorLatency = micros() - sensorSampleStarted;
+    sensorLatencyMax = max(sensorLatencyMax, sensorLatency);
+    sensorSampleStarted = 0U;
+  }
+  return (true);
 } //read_sensors
 
 //------------------------------------------------------------------------------------------------------
@@ -430,21 +455,35 @@ int normalizeNTCAverage(uint32_t accumulatedSample, int beta, bool hasRG)
 //
 //      This function will update the global accumulate variables Ah and Wh, as well as Run Time.
 //      Used to drive Last Run Summary display screen, and also provide values for exiting Float mode via Ahs.
+//      Also keeps the Lifetime statistics.
 //
 //------------------------------------------------------------------------------------------------------
 void update_run_summary(void)
 {
+  const int32_t secs = ACCUMULATE_SAMPLING_RATE / 1000UL;
+
   if ((millis() - accumulateUpdated) < ACCUMULATE_SAMPLING_RATE) // Update the runtime accumulators?
     return;                                                      //  Not yet.  (Do it every 1 second)
 
   accumulateUpdated = millis();
+  lifeStats.upSecs += secs;
 
   if ((chargingState >= warm_up) && (chargingState <= equalize))
   { //  If the Alternator is running, update the last-run vars.
     generatorLrRunTime = millis() - generatorLrStarted;
     accumulatedASecs += measuredAltAmps;
     accumulatedWSecs += measuredAltWatts;
+
+    lifeStats.runSecs += secs; //  And the Lifetime ones, a whole Amp-Hour / Watt-Hour at a time so they do not overflow.
+    lifeStats.ASecs += (int32_t)measuredAltAmps * secs;
+    lifeStats.WSecs += (int32_t)measuredAltWatts * secs;
+    lifeStats.AHs += lifeStats.ASecs / 3600L;
+    lifeStats.ASecs %= 3600L;
+    lifeStats.WHs += lifeStats.WSecs / 3600L;
+    lifeStats.WSecs %= 3600L;
+    lifeStats.peakAltAmps = max(lifeStats.peakAltAmps, (int16_t)measuredAltAmps);
   }
+  lifeStats.peakAltTemp = max(lifeStats.peakAltTemp, (int16_t)measuredAltTemp);
 
 } //void update_run_summary(void) {
 
@@ -464,6 +503,52 @@ void reset_run_summary(void)
   accumulatedWSecs = 0;
 }
 
+//------------------------------------------------------------------------------------------------------
+//
+//  log_fault()
+//
+//      Adds the passed FAULT code to the Lifetime statistics' fault history, pushing out the oldest one - and saves them
+//      to EEPROM now, as a restarting FAULT will not wait for the next checkpoint.  Other then when it is the same FAULT as
+//      the last one, again within LIFE_CHECKPOINT_PERIOD:  a FAULT that keeps restarting the regulator is saved the once, not
+//      each time around.
+//
+//------------------------------------------------------------------------------------------------------
+void log_fault(unsigned code)
+{
+  bool repeat = (lifeStats.faults != 0) && (lifeStats.faultCode[0] == code) &&
+                ((lifeStats.upSecs - lifeStats.faultSecs[0]) < (LIFE_CHECKPOINT_PERIOD / 1000UL));
+
+  for (uint8_t i = FAULT_LOG_DEPTH - 1; i > 0; i--)
+  {
+    lifeStats.faultCode[i] = lifeStats.faultCode[i - 1];
+    lifeStats.faultSecs[i] = lifeStats.faultSecs[i - 1];
+  }
+  lifeStats.faultCode[0] = code;
+  lifeStats.faultSecs[0] = lifeStats.upSecs;
+  lifeStats.faults++;
+
+  if (!repeat)
+    write_LIFE_EEPROM(&lifeStats);
+} //log_fault
+
+//------------------------------------------------------------------------------------------------------
+// Checkpoint Lifetime statistics
+//      Called from the Mainloop.  Saves the Lifetime statistics to EEPROM every LIFE_CHECKPOINT_PERIOD.   (Only the bytes
+//      that have changed are actually re-written)
+//
+//------------------------------------------------------------------------------------------------------
+
+void checkpoint_LIFE(void)
+{
+  uint32_t static lastCheckpoint = 0;
+
+  if ((millis() - lastCheckpoint) >= LIFE_CHECKPOINT_PERIOD)
+  {
+    write_LIFE_EEPROM(&lifeStats);
+    lastCheckpoint = millis();
+  }
+} //checkpoint_LIFE
+
 #ifdef USE_OLED
 
 void WriteOLEDTitlePage(void)
@@ -477,6 +562,7 @@ void WriteOLEDTitlePage(void)
   oled.println(REV_FORK);
   oled.setCursor(30,6);
   oled.println(DATE_CODE);
+  oled.display();
   delay(2000);
 }
   
@@ -510,6 +596,7 @@ void WriteOLEDBatteryType(void)
       break;
   }
   
+  oled.display();
   delay(2000);
 }
 
@@ -526,6 +613,7 @@ void WriteOLEDDIPSettings(void)
   oled.print("TACH MODE:  ");
   if(tachMode) oled.println("ON");
   else oled.println("OFF");
+  oled.display();
   delay(2000);
 }
 
@@ -537,6 +625,7 @@ void WriteOLEDFactoryReset(void)
   oled.println("FACTORY");
   oled.setCursor(30, 4);
   oled.println(" RESET");
+  oled.display();
   delay(2000);
 }
 
@@ -649,7 +738,7 @@ void WriteOLEDFaultString(void)
       oled.println("Unknown Error ");
       break;
   }
-
+  oled.display();
 }
 
 void WriteOLEDDataScreenStaticData(void)
@@ -658,8 +747,16 @@ void WriteOLEDDataScreenStaticData(void)
   oled.setFont(Callibri15);
   oled.setCursor(3, 2);
   oled.println(chargingStateString);
+  oled.display();
   delay(2000);
 
+  WriteOLEDDataScreenLabels();
+  oled.display();
+} //void WriteOLEDDataScreenStaticData(void) {
+
+// Helper, draws the data screen's labels into the shadow framebuffer.  (Also used to put it back up, see manage_OLED())
+void WriteOLEDDataScreenLabels(void)
+{
   oled.setFont(font5x7);
   oled.clear();
   oled.println("        ALT     BAT");
@@ -669,78 +766,523 @@ void WriteOLEDDataScreenStaticData(void)
 
   oled.setCursor(0, 5);
   oled.println("FIELD PWM: ");
-} //void WriteOLEDDataScreenStaticData(void) {
+}
 
-void WriteOLEDDynamicData(void)
-{  //********************************************************************************
-  //   OUTPUT LCD DYNAMIC DATA
-  //********************************************************************************
-  extern const char *chargingStateString;
-  extern int inChargingStateCount;
- 
-  #ifdef ENABLE_FEATURE_IN_SCUBA
-    extern const char *scubaModeString;
-    static String lcdLastScubaModeString;
-    char buffer[40];
-  #endif
+#ifdef OLED_DISPLAY_DEG_IN_F
+  #define OLED_DEG(t) ((t) * 9 / 5 + 32) // Temps are kept in deg C, convert to deg F to show them.
+#else
+  #define OLED_DEG(t) (t)
+#endif
 
-  LCDaltVolts.Update(measuredAltVolts); //Check for change and if change, save value into lastValue and print to OLED
-  LCDbatVolts.Update(measuredBatVolts);
-  LCDaltAmps.Update(measuredAltAmps);
-  LCDbatAmps.Update(measuredBatAmps);
-  LCDbatAmps.Update(measuredBatAmps);
-  
-  #ifdef OLED_DISPLAY_DEG_IN_F
-  LCDaltTemp.Update(measuredAltTemp * 9 / 5 + 32); // Temp is stored in deg C.  Convert to def F.
-  LCDbatTemp.Update(measuredBatTemp * 9 / 5 + 32);
-  #else
-  LCDaltTemp.Update(measuredAltTemp); // Display in degrees C
-  LCDbatTemp.Update(measuredBatTemp);
-  #endif
-  
-  LCDPWM.Update((100 * fieldPWMvalue) / FIELD_PWM_MAX);
+//------------------------------------------------------------------------------------------------------
+//
+//      Graph screens
+//
+//      Battery Volts and Amps, or Alternator Temperature, one line per level 0 History interval with the newest at the bottom:  Each
+//      line is lit from the lowest to the highest value seen in that interval.   When put up, the graph is filled in from what the
+//      History holds - the older lines from its coarser levels - and scaled to fit.   From then on each new interval scrolls the
+//      display up a line with the SSD1306's Start Line register, and only the line that has come round to the bottom is drawn.
+//      (The row of text with the scale scrolls off the top along with the oldest lines, it is put back the next time the screen is)
+//
+//------------------------------------------------------------------------------------------------------
+#ifdef USE_HISTORY
+static uint32_t graphSeq;    // Next level 0 History record to add to the graph
+static int16_t graphLo[2];   // Its scale:  Value at the left and right of each plot, in the units graph_values() gives
+static int16_t graphHi[2];
+
+//-------       'helper' function used by the graph screens;
+//              How many plots across the graph showing, and plot n's low, high, and mean values from a History record.
+static uint8_t graph_plots(void)
+{
+  return ((lcdScreen == OLED_SCREEN_BAT) ? 2 : 1);
+}
 
-  // add countdown time field data
-  if ((chargingState == warm_up) || (chargingState == ramping))
+static void graph_values(uint8_t plot, const tBTHistRec *rec, int16_t *v)
+{
+  for (uint8_t i = 0; i < 3; i++)
   {
-    LCDCount.Update(inChargingStateCount);
+    if (lcdScreen == OLED_SCREEN_TEMP)
+      v[i] = rec->altTemp[i]; // Deg C
+    else if (plot == 0)
+      v[i] = rec->batmV[i] / 10U; // Battery Volts, in 10mV
+    else
+      v[i] = rec->batdA[i]; // Battery Amps, in 0.1A
   }
-  else 
-  { 
-  // not Warmup or Ramping so make sure the CountDown is zero - sets up for trap in the LCDfield Update method
-    LCDCount.Update(0);
-    
-    if ((chargingState == acceptance_charge) || (chargingState == bulk_charge))
+}
+
+//-------       'helper' function used by the graph screens;
+//              Fetches level 0 record seq - or if it is no longer held, the record of the finest level above that covers it.
+static bool graph_record(uint32_t seq, tBTHistRec *rec)
+{
+  for (uint8_t level = 0; level < HIST_LEVELS; level++)
+    if (get_history(level, seq >> level, rec))
+      return (true);
+  return (false);
+}
+
+//-------       'helper' function used by the graph screens;
+//              Which column the passed value of plot n goes in.
+static uint8_t graph_col(uint8_t plot, int16_t value)
+{
+  uint8_t col = 0;
+  uint8_t width = OLED_COLS;
+
+  if (lcdScreen == OLED_SCREEN_BAT)
+  {
+    width = graphBatWidth;
+    if (plot == 1)
+      col = graphBatColAmps;
+  }
+  value = constrain(value, graphLo[plot], graphHi[plot]);
+  return (col + (uint8_t)(((int32_t)(value - graphLo[plot]) * (width - 1)) / (graphHi[plot] - graphLo[plot])));
+}
+
+// Draws History record seq as RAM line 'line' of the graph  (Or a blank line, if there is no such record)
+void WriteOLEDGraphLine(uint8_t line, uint32_t seq, bool have)
+{
+  uint8_t bits[OLED_COLS / 8];
+  tBTHistRec rec;
+  int16_t v[3];
+
+  memset(bits, 0, sizeof(bits));
+  if (have && graph_record(seq, &rec))
+    for (uint8_t plot = 0; plot < graph_plots(); plot++)
     {
-      // convert inChargingStateTime to HH:MM:SS format
-      unsigned long val = inChargingStateTime/1000UL;
-      int hours = numberOfHours(val);
-      int minutes = numberOfMinutes(val);
-      int seconds = numberOfSeconds(val);
-          
-      sprintf(buffer2, "%02d:%02d:%02d" , hours, minutes, seconds);
-      
+      graph_values(plot, &rec, v);
+      for (uint8_t col = graph_col(plot, v[HIST_MIN]); col <= graph_col(plot, v[HIST_MAX]); col++)
+        bits[col >> 3] |= (1 << (col & 7));
+    }
+
+  if (lcdScreen == OLED_SCREEN_BAT)
+  {
+    if (line & 1)
+      bits[graphBatColDiv >> 3] |= (1 << (graphBatColDiv & 7)); // Dotted line between the Volts and the Amps,
+    if ((line & 3) == 0)
+    {
+      uint8_t col = graph_col(1, 0); //   and a fainter one down 0A.
+      bits[col >> 3] |= (1 << (col & 7));
+    }
+  }
+  oled.plotLine(line, bits);
+}
+
+// Helper, for the row of text giving the scale:  Blanks the rest of the row up to column 'end'
+void WriteOLEDGraphTextEnd(uint8_t end)
+{
+  if (oled.col() < end)
+    oled.clear(oled.col(), end - 1, 0, 0);
+}
+
+// Scales the graph to what the History holds, and draws the row of text giving the scale.  (The 1st piece of putting up a graph screen)
+void WriteOLEDGraphScale(void)
+{
+  tBTHistRec rec;
+  int16_t v[3];
+  uint8_t plot;
+
+  graphSeq = history_count(0);
+  for (plot = 0; plot < graph_plots(); plot++)
+  {
+    graphLo[plot] = INT16_MAX;
+    graphHi[plot] = INT16_MIN;
+  }
+
+  for (uint8_t k = 0; (k < OLED_GRAPH_LINES) && (k < graphSeq); k++)
+    if (graph_record(graphSeq - 1 - k, &rec))
+      for (plot = 0; plot < graph_plots(); plot++)
+      {
+        graph_values(plot, &rec, v);
+        graphLo[plot] = min(graphLo[plot], v[HIST_MIN]);
+        graphHi[plot] = max(graphHi[plot], v[HIST_MAX]);
+      }
+
+  for (plot = 0; plot < graph_plots(); plot++)
+  {
+    int16_t span = graphSpanTemp;
+
+    if (graphLo[plot] > graphHi[plot])
+    { // No History yet, scale it around how things are now.
+      if (lcdScreen == OLED_SCREEN_TEMP)
+        graphLo[plot] = measuredAltTemp;
+      else if (plot == 0)
+        graphLo[plot] = TO_mV(measuredBatVolts) / 10;
+      else
+        graphLo[plot] = TO_dA(measuredBatAmps);
+      graphHi[plot] = graphLo[plot];
     }
-    else // in other chargingStates, erase the LCDCount2 field
+    if (lcdScreen == OLED_SCREEN_BAT)
+      span = (plot == 0) ? graphSpanVolt : graphSpanAmp;
+    if (plot == 1)
+    { // Amps scale always takes in 0A.
+      graphLo[plot] = min(graphLo[plot], 0);
+      graphHi[plot] = max(graphHi[plot], 0);
+    }
+    if ((graphHi[plot] - graphLo[plot]) < span)
+    { // Too little change to see, widen it around the middle.
+      graphLo[plot] -= (span - (graphHi[plot] - graphLo[plot])) / 2;
+      graphHi[plot] = graphLo[plot] + span;
+    }
+  }
+
+  oled.setCursor(0, 0);
+  if (lcdScreen == OLED_SCREEN_BAT)
+  {
+    oled.print(graphLo[0] / 100.0, 1);
+    oled.print('-');
+    oled.print(graphHi[0] / 100.0, 1);
+    oled.print('V');
+    WriteOLEDGraphTextEnd(graphBatColAmps);
+    oled.setCursor(graphBatColAmps, 0);
+    oled.print(graphLo[1] / 10);
+    oled.print('/');
+    oled.print(graphHi[1] / 10);
+    oled.print('A');
+  }
+  else
+  {
+    oled.print("ALT TEMP ");
+    oled.print(OLED_DEG(graphLo[0]));
+    oled.print('-');
+    oled.print(OLED_DEG(graphHi[0]));
+    oled.print(screen2FormatTemp);
+  }
+  WriteOLEDGraphTextEnd(OLED_COLS);
+}
+
+// Draws line n of the graph, counting from the top, when putting it up.
+void WriteOLEDGraphFill(uint8_t n)
+{
+  uint8_t back = OLED_GRAPH_LINES - 1 - n; // Intervals back from the latest
+
+  WriteOLEDGraphLine(n + 8, graphSeq - 1 - back, (graphSeq > back));
+}
+
+// Adds the next History interval to the bottom of the graph showing.
+void WriteOLEDGraphStep(void)
+{
+  oled.scrollDisplay(1);
+  WriteOLEDGraphLine((oled.startLine() + (OLED_PAGES * 8) - 1) & ((OLED_PAGES * 8) - 1), graphSeq, true);
+  graphSeq++;
+}
+#endif // USE_HISTORY
+
+//------------------------------------------------------------------------------------------------------
+//
+//      Text screens
+//
+//      Draw one row of the Lifetime statistics or the Fault history.  Each row is written out in full, so it overwrites whatever
+//      screen was there before - and as the shadow only sends what changes, redrawing it every refresh costs next to nothing.
+//
+//------------------------------------------------------------------------------------------------------
+void WriteOLEDTextRow(uint8_t row)
+{
+  char buf[24];
+  uint8_t i = row - 1;
+
+  buf[0] = '\0';
+  if (lcdScreen == OLED_SCREEN_LIFE)
+    switch (row)
     {
-      sprintf(buffer2, "        ");
+      case 0:
+        strcpy_P(buf, PSTR("  LIFETIME TOTALS"));
+        break;
+
+      case 1:
+        snprintf_P(buf, sizeof(buf), PSTR("UP TIME   %lu:%02u"), lifeStats.upSecs / 3600UL, (unsigned)((lifeStats.upSecs / 60UL) % 60UL));
+        break;
+
+      case 2:
+        snprintf_P(buf, sizeof(buf), PSTR("RUN TIME  %lu:%02u"), lifeStats.runSecs / 3600UL, (unsigned)((lifeStats.runSecs / 60UL) % 60UL));
+        break;
+
+      case 3:
+        snprintf_P(buf, sizeof(buf), PSTR("AMP-HRS   %ld"), lifeStats.AHs);
+        break;
+
+      case 4:
+        snprintf_P(buf, sizeof(buf), PSTR("WATT-HRS  %ld"), lifeStats.WHs);
+        break;
+
+      case 5:
+        snprintf_P(buf, sizeof(buf), PSTR("PEAK AMPS %d"), lifeStats.peakAltAmps);
+        break;
+
+      case 6:
+        snprintf_P(buf, sizeof(buf), PSTR("PEAK TEMP %d%c"), OLED_DEG(lifeStats.peakAltTemp), screen2FormatTemp);
+        break;
+
+      case 7:
+        snprintf_P(buf, sizeof(buf), PSTR("RESTARTS %u FAULTS %u"), lifeStats.restarts, lifeStats.faults);
+        break;
     }
-    LCDCount2.Write(buffer2);
+  else if (row == 0)
+    strcpy_P(buf, PSTR("   FAULT HISTORY"));
+  else if (row == (OLED_PAGES - 1))
+    strcpy_P(buf, PSTR(" (@ UP TIME HRS:MIN)"));
+  else if ((i < FAULT_LOG_DEPTH) && (i < lifeStats.faults))
+    snprintf_P(buf, sizeof(buf), PSTR("FAULT %-4u @%lu:%02u"), lifeStats.faultCode[i],
+               lifeStats.faultSecs[i] / 3600UL, (unsigned)((lifeStats.faultSecs[i] / 60UL) % 60UL));
+  else if (row == 1)
+    strcpy_P(buf, PSTR("  NONE"));
+
+  oled.setCursor(0, row);
+  oled.print(buf);
+  oled.clearToEOL();
+}
+
+//-------       'helper' functions used by manage_OLED();
+//              Which screen comes after the passed one, and how many pieces it takes to put one up.
+static uint8_t OLED_next_screen(uint8_t screen)
+{
+  screen = (screen + 1) % OLED_SCREENS;
+#ifndef USE_HISTORY
+  if ((screen == OLED_SCREEN_BAT) || (screen == OLED_SCREEN_TEMP))
+    screen = OLED_SCREEN_LIFE; // (No graphs without the History to draw them from)
+#endif
+  return (screen);
+}
+
+static uint8_t OLED_screen_pieces(uint8_t screen)
+{
+  switch (screen)
+  {
+    case OLED_SCREEN_DATA:
+      return (1); // Its labels  (The fields are drawn by each refresh)
+
+    case OLED_SCREEN_BAT:
+    case OLED_SCREEN_TEMP:
+      return (1 + OLED_GRAPH_LINES); // The scale, then a line at a time
+
+    default:
+      return (OLED_PAGES); // A row of text at a time
   }
-  LCDState.Update(chargingStateString);  // write the chargingStateString after the inChargingStateCount
-                                         //   so it overwrites the numbers if state changes during WarmUp or ramping
+}
 
+// Does piece n of putting up the screen showing.
+void WriteOLEDScreenPiece(uint8_t n)
+{
+  switch (lcdScreen)
+  {
+    case OLED_SCREEN_DATA:
+      WriteOLEDDataScreenLabels();
+      lcdRedraw = true; // (Have the fields all drawn back in, changed or not)
+      break;
+
+#ifdef USE_HISTORY
+    case OLED_SCREEN_BAT:
+    case OLED_SCREEN_TEMP:
+      if (n == 0)
+        WriteOLEDGraphScale();
+      else
+        WriteOLEDGraphFill(n - 1);
+      break;
+#endif
+
+    default:
+      WriteOLEDTextRow(n);
+      break;
+  }
+}
+
+//------------------------------------------------------------------------------------------------------
+//
+//      Write OLED Dynamic Field
+//
+//      Draws one of the data screen's fields into the OLED's shadow framebuffer (and flags it for the Serial Display's next frame, if
+//      it has changed).  Nothing goes out over I2C here, see manage_OLED().   Fields are drawn in order 0..OLED_FIELDS-1, the order matters
+//      as some of them share space on the screen.
+//
+//------------------------------------------------------------------------------------------------------
+void WriteOLEDDynamicField(uint8_t field)
+{
+  extern const char *chargingStateString;
+  extern int inChargingStateCount;
+
+  #ifdef ENABLE_FEATURE_IN_SCUBA
+    extern const char *scubaModeString;
+  #endif
+
+  switch (field)
+  {
+    case 0:
+      LCDaltVolts.Update(measuredAltVolts); //Check for change and if change, save value into lastValue and print to OLED
+      break;
+
+    case 1:
+      LCDbatVolts.Update(measuredBatVolts);
+      break;
+
+    case 2:
+      LCDaltAmps.Update(measuredAltAmps);
+      break;
+
+    case 3:
+      LCDbatAmps.Update(measuredBatAmps);
+      break;
+
+    case 4:
+      #ifdef OLED_DISPLAY_DEG_IN_F
+      LCDaltTemp.Update(measuredAltTemp * 9 / 5 + 32); // Temp is stored in deg C.  Convert to def F.
+      #else
+      LCDaltTemp.Update(measuredAltTemp); // Display in degrees C
+      #endif
+      break;
+
+    case 5:
+      #ifdef OLED_DISPLAY_DEG_IN_F
+      LCDbatTemp.Update(measuredBatTemp * 9 / 5 + 32);
+      #else
+      LCDbatTemp.Update(measuredBatTemp);
+      #endif
+      break;
+
+    case 6:
+      LCDPWM.Update((100 * fieldPWMvalue) / FIELD_PWM_MAX);
+      break;
+
+    case 7:
+      // add countdown time field data
+      if ((chargingState == warm_up) || (chargingState == ramping))
+      {
+        LCDCount.Update(inChargingStateCount);
+      }
+      else 
+      { 
+      // not Warmup or Ramping so make sure the CountDown is zero - sets up for trap in the LCDfield Update method
+        LCDCount.Update(0);
+        
+        if ((chargingState == acceptance_charge) || (chargingState == bulk_charge))
+        {
+          // convert inChargingStateTime to HH:MM:SS format
+          unsigned long val = inChargingStateTime/1000UL;
+          int hours = numberOfHours(val);
+          int minutes = numberOfMinutes(val);
+          int seconds = numberOfSeconds(val);
+              
+          sprintf(buffer2, "%02d:%02d:%02d" , hours, minutes, seconds);
+          
+        }
+        else // in other chargingStates, erase the LCDCount2 field
+        {
+          sprintf(buffer2, "        ");
+        }
+        LCDCount2.Write(buffer2);
+      }
+      break;
+
+    case 8:
+      LCDState.Update(chargingStateString);  // write the chargingStateString after the inChargingStateCount
+                                             //   so it overwrites the numbers if state changes during WarmUp or ramping
+      break;
+
+    case 9:
 #ifdef ENABLE_FEATURE_IN_SCUBA
-  // add scuba mode label - write this on every pass since it can change at random times and can create times when it is not displayed
-  LCDScuba.Update(scubaModeString);
-  //LCDScuba.Update(scubaModeString); does not work when charging state changes while scubaMode is true.  Direct print each pass is simple solution
-  #ifdef USE_SERIAL_DISPLAY
-    sprintf(buffer, "$D:%d,%s",
-            fnSB,
-            scubaModeString);
-    SERIAL_DISPLAY_PORT.println(buffer);
-  #endif //USE_SERIAL_DISPLAY
+      // add scuba mode label
+      LCDScuba.Update(scubaModeString);
+      //  (The remote Serial Display is sent it again whenever the charging state changes, see LCD_send_frame())
 #endif //ENABLE_FEATURE_IN_SCUBA
-} //WriteOLEDDynamicData
+      break;
+  }
+} //WriteOLEDDynamicField
+
+//------------------------------------------------------------------------------------------------------
+//
+//      Manage OLED
+//
+//      The display task, called each pass of the Mainloop.  Every UPDATE_STATUS_RATE it starts a refresh of the data screen,
+//      which is then worked through a piece at a time:  each field is drawn into the shadow framebuffer, one per piece, the fields that
+//      changed are sent to the Serial Display in one frame, and then what changed is sent out OLED_SLICE_BYTES (_SOFT) per piece.  A piece is only started if the longest one seen so far will still
+//      fit into what is left of OLED_SLICE_US, so a full redraw is spread over as many passes as it takes rather than holding up
+//      the control loop.  (At least one piece is done each pass, so it always gets there)
+//
+//      Every OLED_SCREEN_TIME (or push of the FEATURE_IN_OLED_SCREEN button) the OLED moves on to its next screen, which is put up
+//      the same way - a few labels, graph line, or row of text per piece.  While another screen is showing the data screen's fields
+//      are still refreshed for the Serial Display, just not drawn.  A graph screen then adds a line per History interval, see
+//      WriteOLEDGraphStep().  All of it goes out through the same OLED_SLICE_BYTES (_SOFT) per piece.
+//
+//      Also measures each slice, and what share of the Mainloop's time is going to the display - see oledLoad / oledSliceMax.
+//
+//------------------------------------------------------------------------------------------------------
+void manage_OLED(void)
+{
+  static uint32_t lastRefresh = 0U;
+  static uint32_t lastPass = 0U;
+  static uint32_t loopUs = 0U;     // Mainloop time in this OLED_LOAD_WINDOW
+  static uint32_t displayUs = 0U;  //   and how much of it was spent here.
+  static uint16_t sliceMax = 0;
+  static uint16_t pieceMax = 0;    // Longest single piece of work seen this window
+  static uint8_t field = OLED_PIECES; // Next field to draw, OLED_FIELDS = the Serial Display frame, OLED_PIECES = all done
+  static uint8_t piece = UINT8_MAX;   // Next piece of putting up the screen, past OLED_screen_pieces() = it is all up
+  static uint32_t screenShown = 0U;
+  uint32_t started = micros();
+  uint32_t pieceUs;
+  uint16_t used;
+
+  if (lastPass != 0U)
+    loopUs += started - lastPass;
+  lastPass = started;
+
+  if ((millis() - lastRefresh) >= UPDATE_STATUS_RATE)
+  {
+    lastRefresh = millis();
+    field = 0; // Time to start another refresh.
+
+    if (oledStepScreen || ((OLED_SCREEN_TIME != 0UL) && ((millis() - screenShown) >= OLED_SCREEN_TIME)))
+    { //  And to put up the next screen?
+      oledStepScreen = false;
+      screenShown = millis();
+      lcdScreen = OLED_next_screen(lcdScreen);
+      oled.setFont(font5x7);
+      oled.setStartLine(0); // (In case a graph had scrolled it)
+      piece = 0;
+    }
+    else if (lcdScreen >= OLED_SCREEN_LIFE)
+      piece = 0; // Text screens are drawn again each refresh.
+  }
+
+  do
+  {
+    pieceUs = micros();
+    if (piece < OLED_screen_pieces(lcdScreen))
+      WriteOLEDScreenPiece(piece++);
+    else if (field < OLED_FIELDS)
+      WriteOLEDDynamicField(field++);
+    else if (field < OLED_PIECES)
+    {
+      lcdRedraw = false; // (All the fields have been drawn by now)
+#ifdef USE_SERIAL_DISPLAY
+      LCD_send_frame();
+#endif
+      field++;
+    }
+#ifdef USE_HISTORY
+    else if (((lcdScreen == OLED_SCREEN_BAT) || (lcdScreen == OLED_SCREEN_TEMP)) && (graphSeq < history_count(0)))
+      WriteOLEDGraphStep();
+#endif
+#ifdef OLED_SOFT_I2C
+    else if (oled.display(OLED_SLICE_BYTES_SOFT) == 0)
+#else
+    else if (oled.display(OLED_SLICE_BYTES) == 0)
+#endif
+      break; // Nothing (left) to send.
+    pieceUs = micros() - pieceUs;
+    pieceMax = max(pieceMax, (uint16_t)pieceUs);
+    used = micros() - started;
+  } while ((used + pieceMax) <= OLED_SLICE_US);
+
+  used = micros() - started;
+  displayUs += used;
+  sliceMax = max(sliceMax, used);
+
+  if (loopUs >= OLED_LOAD_WINDOW)
+  {
+    oledLoad = displayUs / (loopUs / 1000UL); // In 0.1%
+    oledSliceMax = sliceMax;
+    loopUs = 0U;
+    displayUs = 0U;
+    sliceMax = 0;
+    pieceMax = 0;
+  }
+} //manage_OLED
 
 #endif // USE_OLED
@@ -32,6 +32,22 @@ typedef struct { // Calibration Structure - holds board specific values, set at
       uint8_t   CALPLACEHOLDER[16];  // Room for future expansion 
       } tCAL;
 
+typedef struct { // Lifetime statistics - checkpointed to EEPROM, so they carry on across restarts and power-downs  (Losing at most the
+                 //   last LIFE_CHECKPOINT_PERIOD of them at a power-down).   See update_run_summary() / log_fault() / checkpoint_LIFE()
+      uint32_t  upSecs;            // Seconds the regulator has been running
+      uint32_t  runSecs;           // Seconds the alternator has been charging for
+      int32_t   AHs;               // Amp-Hours and Watt-Hours it has made
+      int32_t   WHs;
+      int32_t   ASecs;             //   (and the Amp-Seconds and Watt-Seconds not yet making a whole one)
+      int32_t   WSecs;
+      int16_t   peakAltAmps;       // Most Amps seen from the alternator
+      int16_t   peakAltTemp;       //   and the hottest it has been, in Deg C
+      uint16_t  restarts;          // Number of Startups  (power-ups and restarts)
+      uint16_t  faults;            //   and of FAULTs
+      uint16_t  faultCode[FAULT_LOG_DEPTH];  // The last few FAULTs, [0] = the latest  (Code, without the restart bit)
+      uint32_t  faultSecs[FAULT_LOG_DEPTH];  //   and upSecs when it happened
+      } tLIFE;
+
 void WriteOLEDTitlePage(void);
 void WriteOLEDBatteryType(void);
 void WriteOLEDDIPSettings(void);
@@ -41,7 +57,20 @@ void WriteOLEDNonResetFault(void);
 void WriteOLEDFault(void);
 void WriteOLEDFaultString(void);
 void WriteOLEDDataScreenStaticData(void);
-void WriteOLEDDynamicData(void);
+void WriteOLEDDataScreenLabels(void);
+void WriteOLEDDynamicField(uint8_t field);
+void WriteOLEDGraphLine(uint8_t line, uint32_t seq, bool have);
+void WriteOLEDGraphTextEnd(uint8_t end);
+void WriteOLEDGraphScale(void);
+void WriteOLEDGraphFill(uint8_t n);
+void WriteOLEDGraphStep(void);
+void WriteOLEDTextRow(uint8_t row);
+void WriteOLEDScreenPiece(uint8_t n);
+void manage_OLED(void);
+
+extern uint16_t oledLoad;
+extern uint16_t oledSliceMax;
+extern bool oledStepScreen;
 
 
 //extern int inChargingStateCount; // seconds left in warmup
@@ -49,6 +78,8 @@ void WriteOLEDDynamicData(void);
 
 extern bool    updatingBatVAs;
 extern bool    updatingAltVAs;
+extern uint32_t sensorLatency;
+extern uint32_t sensorLatencyMax;
 extern bool    shuntAltAmpsMeasured; 
 
 extern float   measuredAltVolts;
@@ -66,6 +97,7 @@ extern int     measuredBatTemp;
 extern int32_t   accumulatedASecs;
 extern int32_t   accumulatedWSecs;
 extern uint32_t  generatorLrRunTime;
+extern tLIFE     lifeStats;
 
 extern tCAL  ADCCal;
 
@@ -76,5 +108,7 @@ bool sample_ALT_and_BAT_VoltAmps(void);
 bool read_ALT_and_BAT_VoltAmps(void);
 void update_run_summary(void);
 void reset_run_summary(void);
+void log_fault(unsigned code);
+void checkpoint_LIFE(void);
 
 #endif  /*  _SENSORS_H_ */
@@ -0,0 +1,159 @@
+//      SerialDisplay.cpp
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//*****************************************************************************************
+//
+//    Output for the remote Serial Display.   The fields that changed over an update period go
+//    out together, so the display never shows half of an update.  Until the display asks for
+//    them with $DRS: that is as the "$D:" lines it has always been sent, one per field - after
+//    that as one frame, from whose sequence number and CRC the display can tell when it has
+//    missed or garbled one and should ask for them all again ($DRS:).
+//    See SerialDisplay.h for the formats.
+//
+//    The frame is built with a TX writer straight into the display's transmit ring, as
+//    the status strings are:
+//
+//          tTXWriter w;
+//          SD_begin(&w);
+//          SD_field(&w, fnBV);
+//          TXW_fixed(&w, measuredBatVolts, 2);
+//              . . .
+//          SD_end(&w);
+//
+//*****************************************************************************************
+
+#include "Config.h"
+#include "SerialDisplay.h"
+
+#ifdef USE_SERIAL_DISPLAY
+
+bool sdFrames = false;      // Sending frames?  (Not until the display has sent a $DRS:, until then $D: lines)
+bool sdBinary = false;      // Sending binary frames?  ($DRS:1)
+bool sdResync = true;       // Send every field in the next frame?  (The display has nothing yet at power-up)
+static uint8_t sdSeq = 0;   // Sequence number of the next frame
+static bool sdNoField;      // No field in this one yet?
+static bool sdAllFit;       // Did all the $D: lines so far fit in the transmit ring?
+
+//-------       'helper' functions
+static void SD_line_end(tTXWriter *w)
+{ // Finish off a $D: line and send it.
+    TXW_str_P(w, PSTR("\r\n"));
+    if (TXW_end(w) == 0)
+        sdAllFit = false;
+}
+
+//------------------------------------------------------------------------------------------------------
+// SD Begin / Field / End
+//      Start a frame in the passed writer, start each field in it, and finish it off and send it.  SD_end() returns FALSE
+//      if it did not fit in the transmit ring, and so was not sent.   (Its <seq> is then used for the next one)
+//      Until sdFrames is set the "frame" is a $D: line per field, each put into the ring on its own as they always were  (so
+//      SD_end() returns FALSE if any of them did not fit, and they all go again - no harm, the display just redraws the same text)
+//
+//------------------------------------------------------------------------------------------------------
+
+void SD_begin(tTXWriter *w)
+{
+    tTXRing *ring = TX_ring(TX_PORT_DISPLAY);
+
+    sdNoField = true;
+    sdAllFit = true;
+    if (!sdFrames)
+        return; //   (Each line is started by SD_field())
+    if (sdBinary)
+    {
+        TXW_begin_type(w, ring, TXW_FRAMED, BT_DISPLAY, true);
+        TXW_char(w, (char)sdSeq);
+    }
+    else
+    {
+        TXW_begin(w, ring, TXW_CRC, true);
+        TXW_str_P(w, PSTR("$DF:"));
+        TXW_uint(w, sdSeq);
+    }
+} //SD_begin
+
+void SD_field(tTXWriter *w, uint8_t field)
+{
+    if (!sdFrames)
+    {
+        if (!sdNoField)
+            SD_line_end(w);
+        TXW_begin(w, TX_ring(TX_PORT_DISPLAY), 0, true);
+        TXW_str_P(w, PSTR("$D:"));
+        TXW_uint(w, field);
+        TXW_char(w, ',');
+    }
+    else if (sdBinary)
+        TXW_char(w, (char)(0x80 | field));
+    else
+    {
+        TXW_char(w, ';');
+        TXW_uint(w, field);
+        TXW_char(w, ',');
+    }
+    sdNoField = false;
+} //SD_field
+
+bool SD_end(tTXWriter *w)
+{
+    uint16_t crc;
+    uint8_t n;
+
+    if (!sdFrames)
+    {
+        if (!sdNoField)
+            SD_line_end(w);
+        return (sdAllFit);
+    }
+
+    crc = w->crc;
+    if (!sdBinary)
+    { // (Binary frames carry their own CRC)
+        TXW_char(w, '*');
+        for (int8_t shift = 12; shift >= 0; shift -= 4)
+        {
+            n = (crc >> shift) & 0x0F;
+            TXW_char(w, (n < 10) ? ('0' + n) : ('A' + n - 10));
+        }
+        TXW_str_P(w, PSTR("\r\n"));
+    }
+
+    if (TXW_end(w) == 0)
+        return (false);
+
+    sdSeq++;
+    return (true);
+} //SD_end
+
+//------------------------------------------------------------------------------------------------------
+// SD Send Text
+//      Sends the passed text for one field in a frame of its own, right away.  For the Startup, Reset, and Fault messages,
+//      which are not part of the regular updates.
+//
+//------------------------------------------------------------------------------------------------------
+
+void SD_send_text(uint8_t field, const char *text)
+{
+    tTXWriter w;
+
+    SD_begin(&w);
+    SD_field(&w, field);
+    TXW_str(&w, text);
+    SD_end(&w);
+} //SD_send_text
+
+#endif // USE_SERIAL_DISPLAY
@@ -0,0 +1,56 @@
+//      SerialDisplay.h
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+
+#ifndef _SERIALDISPLAY_H_
+#define _SERIALDISPLAY_H_
+
+#include "Config.h"
+#include "TxWriter.h"
+
+//----- Serial Display output.   Each update period, all the fields that have changed are sent together, as one of:
+//
+//      Lines:   $D:<field>,<text>\r\n  for each field  (The default - what a display that has never sent $DRS: is expecting)
+//
+//               <field> is the FieldNumber (see I2C_OLED.h), and <text> what the field now shows, with its format character.
+//
+//      Once the display has sent a $DRS: it is sent frames instead, until the regulator is restarted:
+//
+//      ASCII:   $DF:<seq>;<field>,<text>;<field>,<text> . . *<CRC>\r\n
+//
+//               <seq> counts the frames sent, 0..255 and around again.  <field> and <text> are as in the lines.  <CRC> is 4 hex
+//               digits of the CRC-16/CCITT of everything from the '$' up to the '*'.
+//
+//      Binary:  A BT_DISPLAY frame  (COBS and CRC-16 framed, see BinTelemetry.h) with the same content:
+//               <seq>  then for each field  <0x80 + field> <text>
+//
+//      If the display sees a <seq> go missing, or a bad CRC, it sends $DRS: and the next frame carries every field.
+//      ($DRS:1 also switches to the binary frames, $DRS:0 back to ASCII)
+//
+//      All of it is written up for display builders in Documentation/Serial Display Protocol.md
+
+extern bool sdFrames; // Sending frames?  (Else $D: lines)
+extern bool sdBinary; // Sending binary frames?
+extern bool sdResync; // Send every field in the next frame?
+
+void SD_begin(tTXWriter *w);
+void SD_field(tTXWriter *w, uint8_t field);
+bool SD_end(tTXWriter *w);
+void SD_send_text(uint8_t field, const char *text);
+
+#endif // _SERIALDISPLAY_H_
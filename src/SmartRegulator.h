@@ -104,6 +104,10 @@
                               ////    #define CHARGE_PUMP_PORT                 6              // PWM port that drives the FET boost-voltage Charge Pump
 #define SDA_PIN SDA
 #define SCL_PIN SCL
+#define OLED_SDA_PORT PORTC  // OLED's own I2C bus  (If OLED_SOFT_I2C is defined in Config.h):  SDA on pin 36, PC1  (Not brought out to a header, hand-wire it)
+#define OLED_SDA_BIT 1       //   (SoftI2CMaster wants them as port and bit, and only ports A..G will do)
+#define OLED_SCL_PORT PORTC  //   SCL on pin 37, PC0
+#define OLED_SCL_BIT 0
 #define I2C_TIMEOUT 20 // timeout after 20 msec -- do not wait for clock stretching longer than this time
 
 #define RX1 RXD1
@@ -226,6 +230,31 @@
 #define PID_I_WINDUP_CAP 0.9 // Capping value for the 'I' factor in the PID engines.  I is not allowed to influence the PWM any more then this limit 
                              // to prevent 'integrator Runaway' .
 
+//---- Feed-Forward map of Field PWM  (Used if USE_PWM_FEED_FORWARD is defined in Config.h)
+//     The steady-state Field PWM is learned at grid points of Engine RPMs x Alternator Amps.  When RPMs or the Amps target change, manage_ALT()
+//     moves the field by the difference the map predicts and leaves the PID engine to correct only what is left over.
+#define FF_RPM_BINS 8                  // Grid points at 0, 500, 1000 .. 3500 Engine RPMs   (Faster than that is treated as the last point)
+#define FF_RPM_STEP 500
+#define FF_AMPS_BINS 8                 // Grid points at 0, 32, 64 .. 224 Alternator Amps   (Same here, more Amps uses the last point)
+#define FF_AMPS_STEP 32
+#define FF_UNLEARNED 0                 // Map value that means 'not learned yet'.
+#define FF_SETTLE_COUNT 20             // The PID must be making changes of no more than +/- FF_SETTLE_BAND for this many PWM_CHANGE_RATE
+#define FF_SETTLE_BAND 1               //   cycles (~2 seconds), with RPMs steady to within FF_SETTLE_RPMS, before we learn the current PWM.
+#define FF_SETTLE_RPMS 50
+#define FF_LEARN_RATE 4                // Each time we learn, move the map 1/4 of the way to the newly seen value.
+#define FF_MAX_STEP 40                 // Never let the map raise the field more than this in one go.  (Pulling down is not capped)
+#define FF_CHECKPOINT_PERIOD 1800000UL // Save an updated map to EEPROM no more often than every 30 minutes.
+
+//---- Gain Schedule for the V, A, and W PID loops  (Used if USE_GAIN_SCHEDULING is defined in Config.h)
+//     The Kp, Ki, and Kd above are multiplied by a factor interpolated from a table of Engine RPMs x Alternator Temperature.
+//     Default table is defaultGST in GainSchedule.cpp, and may be changed via the $GSS command.
+#define GS_RPM_BINS 5      // Grid points at 0, 800, 1600 .. 3200 Engine RPMs   (Faster than that is treated as the last point)
+#define GS_RPM_STEP 800
+#define GS_TEMP_BINS 3     // Grid points at 20, 60, 100 degrees C Alternator Temperature  (Colder / hotter uses the end points)
+#define GS_TEMP_MIN 20
+#define GS_TEMP_STEP 40
+#define GS_MULT_ONE 64     // Table value that represents a gain multiplier of 1.0
+
 //---- Load Dump / Raw Overvoltage - over temp -  detection thresholds and actions.
 //     (These action occur asynchronous to the PID engine -- handled in real time linked to the ADCs sampling rate.)
 
@@ -241,6 +270,85 @@
 #define AOT_PULLBACK_THRESHOLD 1.03 // If we find we are 3% over alternator temperature goal, the PID engine is not keeping up.
 #define AOT_PULLBACK_RESUME 0.90    //  (And do not resume normal operation until we are at 90% of goal temperature or less)
 #define AOT_PULLBACK_FACTOR 0.50    // Do something dramatic, cut field drive by 50% before it continues to rise and we fault out.
+                                    //   (Only used if the Thermal Model below is not enabled, or has not yet learned enough to be trusted)
+
+//---- Alternator Thermal Model  (Used if USE_THERMAL_MODEL is defined in Config.h)
+//     A 1st order model of the alternator temperature is fitted online, and used to cap the Alt Amps so the temperature predicted
+//     THM_HORIZON minutes ahead stays below ALT_TEMP_SETPOINT.  See ThermalModel.cpp for the model itself.
+#define THM_SAMPLE_PERIOD 30000UL // Fit the model to the change in alternator temperature every 30 seconds.
+#define THM_TEMP_SMOOTHING 100.0  // Alt temp is smoothed over ~100x PWM_CHANGE_RATE (NTCs only read whole degrees)
+#define THM_HORIZON 5.0           // Predict this many minutes ahead.
+#define THM_MARGIN 2              // And keep the prediction this many degrees C under the set point.
+#define THM_AMPS_REF 100.0        // Heat input is scaled as (Amps / 100)^2 ..
+#define THM_FIELD_WEIGHT 0.2      //   plus this much for the field winding at full field.
+#define THM_RPM_REF 2000.0        // Cooling doubles (over standing still) by this many Engine RPMs.
+#define THM_K_INITIAL 8.0         // Starting guesses, before anything is learned:   K  (Degrees C / minute at u = 1.0)
+#define THM_C_INITIAL 0.0667      //      c  (1 / minutes, ala 15 minute time constant with g() = 1)
+#define THM_TA_INITIAL 30.0       //      Ta (Degrees C)
+#define THM_P_INITIAL 10.0        // How un-sure we are of those guesses.
+#define THM_FORGET 0.995          // RLS forgetting factor, gives a look-back of ~200 samples  (~1.5 hours)
+#define THM_MIN_SAMPLES 20        // Do not trust the model until it has seen 10 minutes of running ..
+#define THM_TA_MIN -10            // .. and it has learned a believable ambient (engine room) temperature.
+#define THM_TA_MAX 70
+
+//---- Battery State of Charge estimator  (Used if USE_SOC_ESTIMATOR is defined in Config.h)
+//     Coulomb counts the Battery Amps, and re-anchors to the rested Open Circuit Voltage curve of the selected profile (see defaultOCV[] in CPE.cpp)
+//     whenever the battery has been resting long enough, or to 100% once it is clearly full.  As with the CPEs, Amps are for a normalized 500Ah battery.
+#define SOC_SAMPLE_RATE 1000UL        // Count the Amps every 1 second
+#define SOC_NOMINAL_AH 500.0          // Battery capacity is taken as 500Ah * systemAmpMult
+#define SOC_REST_AMPS 0.5             // Battery is considered 'resting' if there is less then this many Amps in / out ..
+#define SOC_REST_TIME (120 * 60000UL) //   .. for 2 hours, at which time the OCV curve can be believed.
+#define SOC_TAIL_AMPS 2.5             // Battery is considered full if at the charge target voltage and the charge current is down to 0.5% of capacity ..
+#define SOC_SYNC_TIME (5 * 60000UL)   //   .. for 5 minutes.
+
+//---- Acceptance current taper fit  (Used if USE_TAPER_EXIT is defined in Config.h)
+//     While in Acceptance, the decay of battery Amps is fitted to an exponential, so Acceptance can be exited on the fitted current
+//     rather than the slow persistentBatAmps average.  See Taper.cpp.  Amps are for a normalized 500Ah battery.
+#define TPR_SAMPLE_PERIOD 30000UL // Average the battery Amps over 30 seconds for each sample of the fit.
+#define TPR_FORGET 0.97           // Fit looks back over ~30 samples  (~15 minutes)
+#define TPR_MIN_SAMPLES 10        // Do not use the fit until it has seen 5 minutes of the taper ..
+#define TPR_NOISE_MAX 1.0         //   .. and the samples are within 1A (std dev) of the fitted curve.
+#define TPR_B_MAX 0.998           // Ignore fits with a time constant over ~4 hours, the current is not really tapering.
+#define TPR_FLOOR_MAX 15.0        // Only consider the current has 'flattened out' if the fitted floor is under 15A (3% of capacity) ..
+#define TPR_FLOOR_BAND 0.5        //   .. and the present current is within 0.5A (plus the noise) of it.
+
+//---- BMS serial input  (Used if USE_BMS_SERIAL_IN is defined in Config.h)   See BMS_SERIAL.cpp
+#define BMS_MAX_BYTES_PER_PASS 64      // Parse at most this many received bytes each pass of the Mainloop.
+#define BMS_LIMITS_TIMEOUT 10000UL     // If no LIMITS frame in 10 seconds, stop using the BMS limits and go back to the Charge Profile alone.
+#define CELL_OVER_MV 20                // Highest cell held at BALANCE_AMPS from CELL_MAX_MV up to 20mV past it.  Only past that are the Amps cut
+                                       //   to 0, until it is back down to CELL_MAX_MV.  (See calculate_ALT_targets())
+#define BMS_LATENCY_BUDGET 50UL        // Field should be off within 50mS of a disconnect warning starting to arrive, count the times it is not.
+
+//---- OLED display task  (Used if USE_OLED is defined in Config.h)   See manage_OLED() in Sensors.cpp
+#define OLED_SLICE_US 1000UL          // Spend no more then ~1mS updating the OLED each pass of the Mainloop.
+#define OLED_SLICE_BYTES 10           // Send the OLED at most 10 bytes at a time  (~0.9mS at the 100kHz the shared I2C bus runs at)
+#define OLED_SLICE_BYTES_SOFT 32      //   or 32 on its own bus  (OLED_SOFT_I2C, ~0.8mS if it reaches ~400kHz - worked out, not measured)
+#define OLED_LOAD_WINDOW 5000000UL    // Work out the display's share of the Mainloop's time every 5 seconds  (In uS)
+#define OLED_SCREEN_TIME 10000UL      // Show each of the OLED's screens for 10 seconds, then move on to the next.  0 = stay on the one picked
+                                      //   with the FEATURE_IN_OLED_SCREEN port  (See Config.h)
+
+//---- Lifetime statistics  (Kept in EEPROM, over restarts and power-downs)   See update_run_summary() in Sensors.cpp
+#define FAULT_LOG_DEPTH 6             // Remember the last 6 FAULTs, for the OLED's fault history screen.
+#define LIFE_CHECKPOINT_PERIOD 3600000UL // Save them to EEPROM every hour  (and at each FAULT).  Some bytes change every time, so this is
+                                      //   what sets the EEPROM's life:  at 100,000 writes that is 11 years of running around the clock.
+
+//---- Charge History  (Used if USE_HISTORY is defined in Config.h)   See History.cpp
+//     Level 0 keeps the last HIST_DEPTH intervals, and each level above it the same number of intervals twice as long.  With these that
+//     is 8 x 1 minute (the last 8 minutes), 8 x 2 minutes, .. up to 8 x 32 minutes (the last 4.3 hours).  22 bytes of RAM per record.
+//     The OLED graphs show the last OLED_GRAPH_LINES (56) minutes, which with 8 records a level comes from levels 0..3.
+#define HIST_SAMPLE_RATE 1000UL      // Sample the Volts, Amps, and Temperature every 1 second ..
+#define HIST_INTERVAL_SAMPLES 60     //   .. and make a level 0 record of each 60 of them.
+#define HIST_LEVELS 6
+#define HIST_DEPTH 8                 // Records kept at each level  (6 x 8 x 22 = 1056 bytes)
+
+//---- Serial transmit rings   See TxRing.cpp
+#define TX_ASCII_SIZE 512    // Status, DBG, and command responses - room for a couple of the largest strings ahead of the one being sent.
+#define TX_DISPLAY_SIZE 256  // Serial Display updates, enough for a full redraw of the data screen.
+#define TX_HP_RESERVE 128    // Low priority strings may not use the last 128 bytes of the ASCII ring, leaving it for command responses.
+
+//---- Free RAM check   See check_free_RAM() in Main.cpp, and the RAM notes in Config.h
+#define RAM_CHECK_PERIOD 5000UL      // Look every 5 seconds at how close the stack has come to the static variables ..
+#define RAM_MIN_FREE 256             //   .. and FAULT if it was ever within 256 bytes.  (Room for an ISR or two on top of the deepest call seen)
 
 // Any time we go over-temp, it seems we have a condition
 // of a fight between that temp value and the amp/watts target - creating an osculation situation.
@@ -261,9 +369,13 @@
 #define VOLTS_PERSISTENCE_FACTOR 300 // Volts will be averaged over this number of samples at "PWM_CHANGE_RATE". (300 = ~1/2 min look-back) 
                                      // Set = 1 to disable  (Used to exit post_float mode)
 
-// Desensitizing parameters for deciding when to initiate a new Alternator Capacity Measurement cycle,
-#define SAMPLE_ALT_CAP_RPM_THRESH 250         // Initiate a new Capacity Sample if we have seen in increase in RPMs / Amps from the prior reading.
-#define SAMPLE_ALT_CAP_AMPS_THRESH_RATIO 1.05 // To keep from being too twitchy ..
+// Alternator Capability Curve - used when the Alternator size is auto-determined  (ALT_AMPS_LIMIT = -1)
+//     The demonstrated Amps capability is kept for each RPM grid point and saved in EEPROM.  A new Capacity Sample cycle (full field)
+//     is only started when running at an RPM whose grid point has never been sampled.
+#define ACC_RPM_BINS 12                 // Grid points at 0, 300, 600 .. 3300 Engine RPMs  (Faster than that uses the last point)
+#define ACC_RPM_STEP 300
+#define ACC_PERSISTENCE_FACTOR 256      // While at full field, let the capability of a grid point fall slowly towards what is measured now (ala, a hot alternator)
+#define ACC_CHECKPOINT_PERIOD 1800000UL // Save an updated curve to EEPROM no more often than every 30 minutes.  (It is also saved after each Capacity Sample)
 
 // --------  INA226 Registers & configuration
 
@@ -335,7 +447,9 @@
 
 //---  Functions and global vars exported from SmartRegulator.ino
 uint8_t readDipSwitch(void);
+void stampFreeStack(void);
 int checkStampStack(void);
+void check_free_RAM(void);
 void reboot(void);
 
 extern uint8_t requiredSensorsFlag;
@@ -32,6 +32,8 @@
 #include "System.h"
 #include "LED.h"
 #include "Alternator.h"
+#include "SerialDisplay.h"
+#include "BMS_SERIAL.h"
 
 //
 //------------------------------------------------------------------------------------------------------
@@ -282,6 +284,9 @@ void handle_feature_in(void)
             else
             {  // Feature_in() is no longer being held active.
               #ifdef FEATURE_OUT_LIFEPO_SHUTDOWN_ALARM
+                #ifdef USE_BMS_SERIAL_IN
+                  if ((bmsData.flags & BMS_FLAG_DISCONNECT) == 0)  // (Shared with the BMS disconnect warning, leave it on while that is)
+                #endif
                   digitalWrite(FEATURE_OUT_LIFEPO_SHUTDOWN_ALARM_PORT,FOP_OFF); 
               #endif
               if ((chargingState == forced_float_charge) && ((requiredSensorsFlag & RQBatTempSen) == 0)) // All right, Feature-in port is NOT asking use to force float mode.   By chance, did it?
@@ -293,6 +298,22 @@ void handle_feature_in(void)
           }
 #endif  // FEATURE_IN_FORCE_TO_FLOAT
 
+#ifdef FEATURE_IN_OLED_SCREEN
+    if (port_number == FEATURE_IN_OLED_SCREEN_PORT)
+    {
+      if (port_state == true)
+      {
+        if (have_seen_low == true)
+        { // Each push of the button steps the OLED on to its next screen, once.
+          oledStepScreen = true;
+          All_FI_Ports[i]->Set_Have_Seen_Low(false);
+        }
+      }
+      else
+        All_FI_Ports[i]->Set_Have_Seen_Low(true);
+    }
+#endif // FEATURE_IN_OLED_SCREEN
+
       } // for (size_t i = 0; i < sizeof All_FI_Ports / sizeof All_FI_Ports[0]; i++)
 } //handle_feature_in
 
@@ -404,74 +425,70 @@ bool check_for_faults()
 {
 
   unsigned u;
+  tSMState st;
+  int32_t batmV = TO_mV(measuredBatVolts); // Compared against the precompiled Volts thresholds in compiledCPS
 
   //----  Alternator doing OK?
   //
-  //      Take note how this Switch statement is structured, with many fall-thoughs to allow testing at approperate stages.
+  //      Which checks apply in each charging state are in the faultChecks of SMStates[] (see Alternator.cpp).
+  //      Take note of the order, the checks are made from the earliest stages of a charge cycle on.
   //
 
   u = 0; // Assume there is no fault present.
-  switch (chargingState)
+  if ((get_SM_state(chargingState, &st) != true) || (st.faultChecks & SMF_LOGIC_ERR))
+    u = FC_LOG_ALT_STATE; //  Some odd, unsupported mode.   Logic error!
+  else
   {
-  case unknown:
-  case disabled:
-  case warm_up:
-  case post_float:
-    break;
-
-  case ramping:
-  //case post_ramp:
-    if (measuredAltTemp >= systemConfig.ALT_TEMP_SETPOINT)
-      u = FC_LOOP_ALT_TEMP_RAMP;
-    // If we reach alternator temp limit while ramping, it means something is wrong.
-    // Alt is already too hot before we really even start to do anything...
-
-    //----   And at this point we also check to see if some of the REQUIRED sensors are missing.
-    //       If so, we set approperte flags to notify the rest of the code that different behaivious is exptected.
-    //
-    if ((systemConfig.REQURED_SENSORS & RQAltTempSen) && (measuredAltTemp == -99))
-      requiredSensorsFlag |= RQAltTempSen;
-    if ((systemConfig.REQURED_SENSORS & RQBatTempSen) && (measuredBatTemp == -99))
+    if (st.faultChecks & SMF_RAMP)
     {
-      requiredSensorsFlag |= RQBatTempSen;
-      set_charging_mode(forced_float_charge);
+      if (measuredAltTemp >= systemConfig.ALT_TEMP_SETPOINT)
+        u = FC_LOOP_ALT_TEMP_RAMP;
+      // If we reach alternator temp limit while ramping, it means something is wrong.
+      // Alt is already too hot before we really even start to do anything...
+
+      //----   And at this point we also check to see if some of the REQUIRED sensors are missing.
+      //       If so, we set approperte flags to notify the rest of the code that different behaivious is exptected.
+      //
+      if ((systemConfig.REQURED_SENSORS & RQAltTempSen) && (measuredAltTemp == -99))
+        requiredSensorsFlag |= RQAltTempSen;
+      if ((systemConfig.REQURED_SENSORS & RQBatTempSen) && (measuredBatTemp == -99))
+      {
+        requiredSensorsFlag |= RQBatTempSen;
+        set_charging_mode(forced_float_charge);
+      }
     }
 
-  case determine_ALT_cap:
-  case acceptance_charge:
-  case overcharge_charge:
-    if ((systemConfig.REQURED_SENSORS & RQAmpShunt) && (shuntAltAmpsMeasured != true))
+    if (st.faultChecks & SMF_SHUNT)
     {
-      requiredSensorsFlag |= RQAmpShunt;
-      u = FC_SYS_REQIRED_SENSOR;
+      if ((systemConfig.REQURED_SENSORS & RQAmpShunt) && (shuntAltAmpsMeasured != true))
+      {
+        requiredSensorsFlag |= RQAmpShunt;
+        u = FC_SYS_REQIRED_SENSOR;
+      }
+      // By this time we SHOULD have seen some indication of the amps present..
     }
-    // By this time we SHOULD have seen some indication of the amps present..
-
-  case bulk_charge: //  Do some more checks if we are running.
-    if (measuredBatVolts > (FAULT_BAT_VOLTS_CHARGE * systemVoltMult))
-      u = FC_LOOP_BAT_VOLTS;
-    //  Slightly lower limit when not equalizing.
-    break;
 
-  case equalize:
-  case float_charge:
-  case forced_float_charge:
-  case LIFEPO_FORCED_SHUTDOWN:
-    if (measuredBatVolts > (FAULT_BAT_VOLTS_EQUALIZE * systemVoltMult))
-      u = FC_LOOP_BAT_VOLTS;
-    // We check for Float overvolt using the higher Equalize level, because when we
-    // leave Equalize we will go into Float mode.  This prevents a false-fault, though it
-    // does leave us a bit less protected while in Float mode...
-    break; // If we make it to here, all is well with the Alternator!
+    if (st.faultChecks & SMF_VCHARGE)
+    { //  Do some more checks if we are running.
+      if (batmV > compiledCPS.FAULT_CHARGE_mV)
+        u = FC_LOOP_BAT_VOLTS;
+      //  Slightly lower limit when not equalizing.
+    }
 
-  default:
-    u = FC_LOG_ALT_STATE; //  Some odd, unsupported mode.   Logic error!
-  }                       //switch
+    if (st.faultChecks & SMF_VEQUAL)
+    {
+      if (batmV > compiledCPS.FAULT_EQUAL_mV)
+        u = FC_LOOP_BAT_VOLTS;
+      // We check for Float overvolt using the higher Equalize level, because when we
+      // leave Equalize we will go into Float mode.  This prevents a false-fault, though it
+      // does leave us a bit less protected while in Float mode...
+    }
+  }
 
   if (measuredAltTemp > (systemConfig.ALT_TEMP_SETPOINT * FAULT_ALT_TEMP))
     u = FC_LOOP_ALT_TEMP;
   
-  if ((measuredBatVolts < (FAULT_BAT_VOLTS_LOW * systemVoltMult)) && (fieldPWMvalue > (FIELD_PWM_MAX - FIELD_PWM_MIN) / 3))
+  if ((batmV < compiledCPS.FAULT_LOW_mV) && (fieldPWMvalue > (FIELD_PWM_MAX - FIELD_PWM_MIN) / 3))
     u = FC_LOOP_BAT_LOWV;
   // Check for low battery voltage, but hold off until we have applied at least 1/3 field drive.
   // In this way, we CAN start charging a very low battery, but will not go wild driving the alternator
@@ -537,6 +554,13 @@ void handle_fault_condition()
 
   j = faultCode & 0x7FFFU; // Masking off the restart bit.
 
+  static bool logged = false;
+  if (!logged)
+  { // (A non-restarting FAULT keeps coming back here, only log it the once)
+    log_fault(j);
+    logged = true;
+  }
+
   #ifdef USE_OLED
     if(faultCode & 0x8000U) // check for restart bit
       WriteOLEDFault();
@@ -545,10 +569,8 @@ void handle_fault_condition()
   #endif
 
 #ifdef USE_SERIAL_DISPLAY // output fault code to serial display
-  sprintf(buffer, "$D:%d,FAULT %d",
-          11, // CAUTION hard-coded for fnFL
-          j);
-  SERIAL_DISPLAY_PORT.println(buffer);
+  snprintf_P(buffer, sizeof(buffer), PSTR("FAULT %d"), j);
+  SD_send_text(11, buffer); // CAUTION hard-coded for fnFL
 #endif
 
   snprintf_P(buffer, sizeof(buffer) - 1, PSTR("FLT;,%d,%d\r\n"), // Send out the Fault Code number and the Required Sensor Flag.
@@ -559,6 +581,7 @@ void handle_fault_condition()
   send_outbound(true); // And follow it with all the rest of the status information.
   while (send_outbound(false))
     ; //  (Keep calling until all the strings are pushed out)
+  TX_flush(); // And make sure they get out the port, the Mainloop will not be around to do it.
 
   blink_LED(LED_FAULTED, LED_RATE_FAST, 2, OUT_LAMP_MIRROR_FAULT); // Blink out 'Faulted' pattern to both LED and LAMP
   while (refresh_LED() == true)
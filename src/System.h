@@ -140,6 +140,7 @@ const uint8_t RQFault      = 0x80;    // If any of the required sensors are miss
         
 #define FC_SYS_FET_TEMP                 41              // Internal Field FET temperature exceed limit.
 #define FC_SYS_REQIRED_SENSOR           42              // A 'Required' sensor is missing, and we are configured to FAULT out.
+#define FC_SYS_LOW_RAM                  43              // The stack came within RAM_MIN_FREE bytes of the static variables (too many RAM hungry options in Config.h)
 #define FC_ADC_READ_ERROR               71              // Internal error - unable to use ADC subsystem
 
 #define FC_BAT_INA226_READ_ERROR        100 + 0x8000U   // Returned I2C error code is added to this, see I2C lib for error codes.
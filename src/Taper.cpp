@@ -0,0 +1,163 @@
+//      Taper.cpp
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//*****************************************************************************************
+//
+//    Acceptance current taper model.   While held at the Acceptance voltage, the battery Amps
+//    decay roughly exponentially towards some floor (what the battery will still take once
+//    full, plus any house loads if the shunt is not at the battery):
+//
+//          I(t)  =  Iinf  +  (I0 - Iinf) * e^(-t / tau)
+//
+//    Sampled every TPR_SAMPLE_PERIOD this is    I[k+1]  =  a  +  b * I[k]      with  b = e^(-period / tau)
+//    and Iinf = a / (1 - b), a straight line fit of each sample against the one before it.   That is kept
+//    as five running sums (with forgetting), so each sample costs a handful of float operations.
+//
+//    This lets Acceptance be exited on the fitted current rather than on persistentBatAmps, which being
+//    a slow average lags the battery by many minutes - and also once the current has flattened out
+//    onto its floor, even if that floor never gets down to EXIT_ACPT_AMPS.
+//
+//*****************************************************************************************
+
+#include "Config.h"
+#include "System.h"
+#include "Alternator.h"
+#include "Sensors.h"
+#include "Taper.h"
+#include <math.h>
+
+static float Sw, Sx, Sy, Sxx, Sxy, Syy; // Weighted running sums of the fit:  x = prior sample, y = this sample
+static uint8_t fitCount;                // Number of sample pairs the fit has seen  (Caps at 255)
+static float lastSample = -1;           // Most recent averaged Amps sample, -1 = none (or the chain of samples was broken)
+static float tprA, tprB, tprSigma;      // Fitted a, b, and the standard deviation of the residuals
+static uint32_t fitStarted;             // altModeChanged of the Acceptance phase being fitted
+
+//-------       'helper' function used by update_TPR();
+//              Solves the running sums for a and b, and the spread of the samples around the fitted line.
+static void TPR_solve(void)
+{
+    float den = (Sw * Sxx) - (Sx * Sx);
+
+    if (fabs(den) < 1e-6)
+    {
+        fitCount = 0; // Not enough spread in the samples to fit anything, (ala, current is flat) - treat as not fitted.
+        return;
+    }
+
+    tprB = ((Sw * Sxy) - (Sx * Sy)) / den;
+    tprA = (Sy - (tprB * Sx)) / Sw;
+    tprSigma = sqrt(max((Syy - (tprA * Sy) - (tprB * Sxy)) / max(Sw - 2.0, 1.0), 0.0));
+}
+
+//------------------------------------------------------------------------------------------------------
+// Update Taper
+//      Called from the charging state machine each time the PID engine runs while in Acceptance.
+//      Averages the Battery Amps over TPR_SAMPLE_PERIOD, and adds each average to the fit.  Samples are
+//      only taken while the battery is being held at its target voltage; if that is lost (ala, the engine
+//      drops to idle), the chain of samples is broken and picks up again once back at voltage.
+//
+//------------------------------------------------------------------------------------------------------
+
+void update_TPR(bool atTargetVolts)
+{
+    uint32_t static sampleStarted = 0;
+    float static ampsSum = 0.0;
+    uint16_t static ampsCount = 0;
+    float y;
+
+    if (fitStarted != altModeChanged)
+    { // New Acceptance phase, start the fit over.
+        fitStarted = altModeChanged;
+        Sw = Sx = Sy = Sxx = Sxy = Syy = 0.0;
+        fitCount = 0;
+        lastSample = -1;
+        ampsSum = 0.0;
+        ampsCount = 0;
+        sampleStarted = millis();
+    }
+
+    if (atTargetVolts != true)
+    {
+        lastSample = -1;
+        ampsSum = 0.0;
+        ampsCount = 0;
+        sampleStarted = millis();
+        return;
+    }
+
+    ampsSum += measuredBatAmps;
+    ampsCount++;
+
+    if ((millis() - sampleStarted) < TPR_SAMPLE_PERIOD)
+        return;
+
+    y = ampsSum / ampsCount;
+    ampsSum = 0.0;
+    ampsCount = 0;
+    sampleStarted = millis();
+
+    if (lastSample >= 0.0)
+    {
+        Sw = (Sw * TPR_FORGET) + 1.0;
+        Sx = (Sx * TPR_FORGET) + lastSample;
+        Sy = (Sy * TPR_FORGET) + y;
+        Sxx = (Sxx * TPR_FORGET) + (lastSample * lastSample);
+        Sxy = (Sxy * TPR_FORGET) + (lastSample * y);
+        Syy = (Syy * TPR_FORGET) + (y * y);
+        if (fitCount < 255)
+            fitCount++;
+
+        TPR_solve();
+    }
+
+    lastSample = max(y, 0.0);
+} //update_TPR
+
+//-------       'helper' function used by TPR_exit_reached();
+//              Has the fit seen enough of the taper, is it actually decaying (and not so slowly as to be meaningless),
+//              and do the samples follow the curve well enough to believe it?
+static bool TPR_fit_good(void)
+{
+    return ((fitCount >= TPR_MIN_SAMPLES) &&
+            (tprB > 0.0) && (tprB < TPR_B_MAX) &&
+            (tprSigma <= (TPR_NOISE_MAX * systemAmpMult)) &&
+            (lastSample >= 0.0));
+}
+
+//------------------------------------------------------------------------------------------------------
+// Taper Exit Reached
+//      Returns TRUE if the fitted taper says Acceptance is done:  Either the battery Amps have fallen to the
+//      passed exitAmps (pass 0 if there is no Amps threshold), or the current has flattened out onto the
+//      fitted floor and is not going to fall any further.
+//
+//------------------------------------------------------------------------------------------------------
+
+bool TPR_exit_reached(float exitAmps)
+{
+    float Iinf;
+
+    if (TPR_fit_good() != true)
+        return (false);
+
+    if ((exitAmps > 0.0) && (lastSample <= exitAmps))
+        return (true);
+
+    Iinf = tprA / (1.0 - tprB);
+    return ((Iinf <= (TPR_FLOOR_MAX * systemAmpMult)) &&                                     // A believable floor - not just the early part of the taper  -- AND --
+            ((lastSample - Iinf) <= ((TPR_FLOOR_BAND * systemAmpMult) + (2.0 * tprSigma)))); //  are we sitting on it, within the noise?
+} //TPR_exit_reached
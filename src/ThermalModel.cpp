@@ -0,0 +1,189 @@
+//      ThermalModel.cpp
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//*****************************************************************************************
+//
+//    First order thermal model of the alternator, used to set an Amps ceiling that keeps the
+//    alternator temperature a few minutes from now below ALT_TEMP_SETPOINT - rather than waiting
+//    for it to get there and then cutting the field.
+//
+//          dT/dt  =  K * u   -   c * g(RPMs) * (T - Ta)
+//
+//      u     = Heat put in:  (Alt Amps / THM_AMPS_REF)^2  +  THM_FIELD_WEIGHT * (Field PWM / FIELD_PWM_MAX)^2
+//      g()   = How much more the fan cools as it spins faster:  1 + RPMs / THM_RPM_REF
+//      Ta    = Ambient (engine room) temperature
+//
+//    Written as   dT/dt = K * u  -  (100c) * (g * T / 100)  +  (c * Ta) * g   this is linear in the
+//    three parameters K, 100c, and c*Ta,  which are fitted online with Recursive Least Squares from
+//    the NTC history.   (The scaling of the 2nd term keeps the three regressors of similar size, which
+//    keeps the single precision math well behaved)
+//
+//*****************************************************************************************
+
+#include "Config.h"
+#include "System.h"
+#include "Alternator.h"
+#include "Sensors.h"
+#include "ThermalModel.h"
+#include <math.h>
+
+float thermalAmpsCap = -1; // Amps ceiling from the thermal model, -1 if the model is not (yet) usable.
+
+static float theta[3] = {THM_K_INITIAL, THM_C_INITIAL * 100.0, THM_C_INITIAL * THM_TA_INITIAL}; // Fitted parameters: K, 100c, c*Ta    (Units of minutes)
+static float P[3][3];     // RLS covariance matrix
+static uint8_t fitCount;  // Number of samples the fit has seen  (Caps at 255)
+
+//-------       'helper' function used by manage_THM();
+//              One step of Recursive Least Squares with forgetting, fitting y = phi . theta
+static void THM_fit(float *phi, float y)
+{
+    float Pphi[3];
+    float denom = THM_FORGET;
+    float err = y;
+    uint8_t i, j;
+
+    for (i = 0; i < 3; i++)
+    {
+        Pphi[i] = 0.0;
+        for (j = 0; j < 3; j++)
+            Pphi[i] += P[i][j] * phi[j];
+        denom += phi[i] * Pphi[i];
+        err -= phi[i] * theta[i];
+    }
+
+    for (i = 0; i < 3; i++)
+        theta[i] += Pphi[i] * err / denom;
+
+    for (i = 0; i < 3; i++) // P = (P - Pphi * Pphi' / denom) / lambda     (P is symmetric, so phi'P = Pphi')
+        for (j = 0; j < 3; j++)
+            P[i][j] = (P[i][j] - (Pphi[i] * Pphi[j] / denom)) / THM_FORGET;
+}
+
+//------------------------------------------------------------------------------------------------------
+// THM Valid
+//      Returns TRUE if the model has seen enough of the alternator to be trusted, and what it has learned
+//      makes physical sense (heats up when loaded, cools towards a believable ambient temperature).
+//
+//------------------------------------------------------------------------------------------------------
+
+bool THM_valid(void)
+{
+    float ambient;
+
+    if ((fitCount < THM_MIN_SAMPLES) || (theta[0] <= 0.0) || (theta[1] <= 0.0))
+        return (false);
+
+    ambient = 100.0 * theta[2] / theta[1];
+    return ((ambient >= THM_TA_MIN) && (ambient <= THM_TA_MAX));
+} //THM_valid
+
+//------------------------------------------------------------------------------------------------------
+// Manage Thermal Model
+//      Called from manage_ALT() each PWM_CHANGE_RATE.  Averages the heat input and RPMs over THM_SAMPLE_PERIOD,
+//      then fits the model to how the (smoothed) alternator temperature changed over that period.  Finally, works
+//      out how much heat input would bring the predicted temperature THM_HORIZON minutes out to just under the
+//      set point, and converts that into the Amps ceiling thermalAmpsCap - used by calculate_ALT_targets().
+//
+//------------------------------------------------------------------------------------------------------
+
+void manage_THM(void)
+{
+    uint32_t static lastSample = 0;
+    float static uSum = 0.0;        // Heat input and RPMs summed over the present sample period
+    float static gSum = 0.0;
+    uint16_t static sumCount = 0;
+    float static smoothedTemp = -99; // NTCs only resolve whole degrees C, so we fit to a smoothed version
+    float static priorTemp = -99;    //   and the one from the start of this sample period.
+
+    float phi[3];
+    float u;
+    float uField;
+    float g;
+    float cg;
+    float ambient;
+    float e;
+    float limit;
+
+    if ((measuredAltTemp <= -99) || (shuntAltAmpsMeasured == false) || (measuredRPMs == 0))
+    { // Need to see the temp, the heat input, and the cooling to do anything.  (Keep what we have learned, but do not use it for now)
+        thermalAmpsCap = -1;
+        smoothedTemp = -99;
+        sumCount = 0;
+        lastSample = millis();
+        return;
+    }
+
+    if (fitCount == 0)
+    { // 1st time in, prime the covariance.  A not very confident start, so the initial guesses get moved quickly.
+        for (uint8_t i = 0; i < 3; i++)
+            for (uint8_t j = 0; j < 3; j++)
+                P[i][j] = (i == j) ? THM_P_INITIAL : 0.0;
+    }
+
+    if (smoothedTemp == -99)
+        smoothedTemp = priorTemp = measuredAltTemp;
+    else
+        smoothedTemp += (measuredAltTemp - smoothedTemp) / THM_TEMP_SMOOTHING;
+
+    uField = (float)fieldPWMvalue / FIELD_PWM_MAX;
+    uField = THM_FIELD_WEIGHT * uField * uField;
+    u = max(measuredAltAmps, 0.0) / THM_AMPS_REF;
+    u = (u * u) + uField;
+    g = 1.0 + ((float)measuredRPMs / THM_RPM_REF);
+
+    uSum += u;
+    gSum += g;
+    sumCount++;
+
+    if ((millis() - lastSample) >= THM_SAMPLE_PERIOD)
+    {
+        if (sumCount > 0)
+        {
+            phi[0] = uSum / sumCount;
+            phi[1] = -(gSum / sumCount) * ((smoothedTemp + priorTemp) / 2.0) / 100.0;
+            phi[2] = gSum / sumCount;
+
+            THM_fit(phi, (smoothedTemp - priorTemp) * 60000.0 / (millis() - lastSample)); // Degrees C per minute
+            if (fitCount < 255)
+                fitCount++;
+        }
+
+        priorTemp = smoothedTemp;
+        uSum = 0.0;
+        gSum = 0.0;
+        sumCount = 0;
+        lastSample = millis();
+    }
+
+    if (THM_valid() != true)
+    {
+        thermalAmpsCap = -1;
+        return;
+    }
+
+    //--- With the heat input held at u, temperature heads to  Tss = Ta + K * u / (c * g)  with a time constant of  1 / (c * g).
+    //     So THM_HORIZON minutes from now  T = Tss + (T0 - Tss) * e,  where e = exp(-c * g * THM_HORIZON).   Solve that for the u which gives T = set point.
+    cg = g * theta[1] / 100.0;
+    ambient = theta[2] / (theta[1] / 100.0);
+    e = exp(-cg * THM_HORIZON);
+    limit = systemConfig.ALT_TEMP_SETPOINT - THM_MARGIN;
+
+    u = (cg / theta[0]) * (((limit - (smoothedTemp * e)) / (1.0 - e)) - ambient); // Total heat input allowed..
+    u -= uField;                                                                  //   less what the field itself puts in,
+    thermalAmpsCap = (u > 0.0) ? (THM_AMPS_REF * sqrt(u)) : 0.0;                  //   and the rest can be stator Amps.
+} //manage_THM
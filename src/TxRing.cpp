@@ -0,0 +1,226 @@
+//      TxRing.cpp
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//*****************************************************************************************
+//
+//    Non-blocking transmit for the ASCII (status / debug) and Serial Display ports.
+//
+//    At 9600 baud the Arduino core's 64 byte transmit buffer holds only ~65mS worth of
+//    characters, and once it is full HardwareSerial::write() sits and waits for room - so
+//    a 200 byte status string would hold up the Mainloop for ~150mS.   Instead, messages are
+//    queued here in a much larger ring, and TX_service() tops up the core's buffer each pass
+//    of the Mainloop with only as many bytes as it has room for.  The core's UDRE interrupt
+//    then clocks them out.  Nothing here ever waits on the UART, other then TX_flush().
+//
+//    A message goes into the ring whole, or not at all.  If there is not room:
+//      - Low priority messages (periodic status, DBG) are dropped, and also are not allowed
+//        to use the last TX_HP_RESERVE bytes of the ring, keeping that for ..
+//      - High priority messages (command responses, AOK, RST, FLT, display updates) which
+//        are only dropped if the ring is truly full.
+//    send_outbound() also looks at TX_free() before building a status string, and holds off
+//    until there is room - so a status string is not so much dropped as sent later with
+//    fresh values.
+//
+//*****************************************************************************************
+
+#include "Config.h"
+#include "TxRing.h"
+
+static uint8_t asciiBuf[TX_ASCII_SIZE];
+tTXRing asciiTX = {&Serial, asciiBuf, TX_ASCII_SIZE, 0, 0, 0, 0, 0};
+
+#ifdef USE_SERIAL_DISPLAY
+static uint8_t displayBuf[TX_DISPLAY_SIZE];
+tTXRing displayTX = {&SERIAL_DISPLAY_PORT, displayBuf, TX_DISPLAY_SIZE, 0, 0, 0, 0, 0};
+#endif
+
+//-------       'helper' functions
+static uint16_t TX_used(tTXRing *ring)
+{
+    if (ring->head >= ring->tail)
+        return (ring->head - ring->tail);
+    return (ring->size - ring->tail + ring->head);
+}
+
+static void TX_service_ring(tTXRing *ring)
+{ // Move as much as the core's transmit buffer has room for, it will not block.
+    int room;
+    uint16_t n;
+
+    room = ring->port->availableForWrite();
+
+    while ((room > 0) && (ring->tail != ring->head))
+    {
+        n = (ring->head > ring->tail) ? (ring->head - ring->tail) : (ring->size - ring->tail); // Contiguous bytes up to the head, or the end of the buffer
+        n = min(n, (uint16_t)room);
+
+        ring->port->write(&ring->buf[ring->tail], n);
+        room -= n;
+        ring->tail += n;
+        if (ring->tail >= ring->size)
+            ring->tail = 0;
+    }
+}
+
+static void TX_dropped(tTXRing *ring, uint16_t n)
+{
+    ring->dropped = ((0xFFFF - ring->dropped) > n) ? (ring->dropped + n) : 0xFFFF;
+}
+
+static void TX_queued(tTXRing *ring, uint16_t n)
+{ // The head has just moved up over n more bytes - tally them up, and get them started on their way.
+    uint16_t used;
+
+    ring->queued += n;
+
+    used = TX_used(ring);
+    if (used > ring->peak)
+        ring->peak = used;
+
+    TX_service_ring(ring);
+}
+
+static bool TX_put(tTXRing *ring, const uint8_t *data, uint16_t len, bool highPriority)
+{
+    uint16_t n;
+
+    if (len == 0)
+        return (true);
+
+    if ((len + (highPriority ? 0 : TX_HP_RESERVE)) > TX_free(ring))
+    {
+        TX_dropped(ring, len);
+        return (false);
+    }
+
+    for (n = 0; n < len; n++)
+    {
+        ring->buf[ring->head] = *data++;
+        if (++ring->head >= ring->size)
+            ring->head = 0;
+    }
+
+    TX_queued(ring, len);
+    return (true);
+}
+
+//------------------------------------------------------------------------------------------------------
+// TX Write
+//      Queues the passed string to be sent out the ring's serial port.  Returns FALSE if it was dropped
+//      for lack of room.   See the top of this file for how highPriority is used.
+//
+//      Normally called via the ASCII_write() and ASCII_write_LP() macros in Portability.h
+//
+//------------------------------------------------------------------------------------------------------
+
+bool TX_write(tTXRing *ring, const char *str, bool highPriority)
+{
+    return (TX_put(ring, (const uint8_t *)str, strlen(str), highPriority));
+} //TX_write
+
+//------------------------------------------------------------------------------------------------------
+// TX Write Bytes
+//      As TX_write(), but for binary data that may hold NULLs.  (Used by BT_send())
+//
+//------------------------------------------------------------------------------------------------------
+
+bool TX_write_bytes(tTXRing *ring, const uint8_t *data, uint16_t len, bool highPriority)
+{
+    return (TX_put(ring, data, len, highPriority));
+} //TX_write_bytes
+
+//------------------------------------------------------------------------------------------------------
+// TX Commit
+//      Used by the streaming writer (see TxWriter.cpp), which builds a message of len bytes in place in the
+//      ring's free space.  If it all fit, moves the ring's head up to newHead to send it, else counts it as dropped.
+//
+//------------------------------------------------------------------------------------------------------
+
+bool TX_commit(tTXRing *ring, uint16_t newHead, uint16_t len, bool fit)
+{
+    if (!fit)
+    {
+        TX_dropped(ring, len);
+        return (false);
+    }
+
+    ring->head = newHead;
+    TX_queued(ring, len);
+    return (true);
+} //TX_commit
+
+//------------------------------------------------------------------------------------------------------
+// TX Free
+//      Returns how many more bytes the ring can take.
+//
+//------------------------------------------------------------------------------------------------------
+
+uint16_t TX_free(tTXRing *ring)
+{
+    return (ring->size - 1 - TX_used(ring)); // (One byte is always left empty, so a full ring can be told from an empty one)
+} //TX_free
+
+//------------------------------------------------------------------------------------------------------
+// TX Ring
+//      Returns the ring for the passed TX_PORT_xxx.  If there is no separate Serial Display port, everything
+//      goes to the ASCII one.
+//
+//------------------------------------------------------------------------------------------------------
+
+tTXRing *TX_ring(uint8_t port)
+{
+#ifdef USE_SERIAL_DISPLAY
+    if ((port == TX_PORT_DISPLAY) && (displayTX.port != asciiTX.port))
+        return (&displayTX);
+#endif
+
+    return (&asciiTX);
+} //TX_ring
+
+//------------------------------------------------------------------------------------------------------
+// TX Service
+//      Called from the Mainloop (and every time something is queued) to keep the serial ports fed.
+//
+//------------------------------------------------------------------------------------------------------
+
+void TX_service(void)
+{
+    TX_service_ring(&asciiTX);
+
+#ifdef USE_SERIAL_DISPLAY
+    if (displayTX.port != asciiTX.port)
+        TX_service_ring(&displayTX);
+#endif
+} //TX_service
+
+//------------------------------------------------------------------------------------------------------
+// TX Flush
+//      Waits until everything queued has been handed to the serial ports.  This DOES block, and is for
+//      use only when the Mainloop will not be around to do it:  Startup, rebooting, and faulting.
+//
+//------------------------------------------------------------------------------------------------------
+
+void TX_flush(void)
+{
+    do
+        TX_service();
+    while ((asciiTX.tail != asciiTX.head)
+#ifdef USE_SERIAL_DISPLAY
+           || ((displayTX.port != asciiTX.port) && (displayTX.tail != displayTX.head))
+#endif
+    );
+} //TX_flush
@@ -0,0 +1,52 @@
+//      TxRing.h
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//      (Included from Portability.h, ahead of Config.h being fully processed - so nothing in here may depend on the Config.h #defines)
+
+#ifndef _TXRING_H_
+#define _TXRING_H_
+
+#include <Arduino.h>
+
+typedef struct
+{ // Outbound ring buffer for one serial port.  Filled by TX_write(), emptied into the port by TX_service().
+    HardwareSerial *port;
+    uint8_t *buf;
+    uint16_t size;
+    uint16_t head;    // Next byte to be filled
+    uint16_t tail;    // Next byte to be sent
+    uint16_t dropped; // Bytes thrown away as there was no room for them.  (Sticks at 0xFFFF)
+    uint16_t peak;    // Most bytes that have been waiting to go out at one time.
+    uint16_t queued;  // Running count of bytes accepted into the ring  (Wraps, take the difference of two readings)
+} tTXRing;
+
+#define TX_PORT_ASCII 0   // Port numbers used by TX_ring()   (Serial)
+#define TX_PORT_DISPLAY 1 //   (SERIAL_DISPLAY_PORT)
+
+extern tTXRing asciiTX;
+extern tTXRing displayTX;
+
+bool TX_write(tTXRing *ring, const char *str, bool highPriority);
+bool TX_write_bytes(tTXRing *ring, const uint8_t *data, uint16_t len, bool highPriority);
+bool TX_commit(tTXRing *ring, uint16_t newHead, uint16_t len, bool fit);
+uint16_t TX_free(tTXRing *ring);
+tTXRing *TX_ring(uint8_t port);
+void TX_service(void);
+void TX_flush(void);
+
+#endif // _TXRING_H_
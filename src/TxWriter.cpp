@@ -0,0 +1,268 @@
+//      TxWriter.cpp
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//*****************************************************************************************
+//
+//    Streaming writer for the status strings.  Rather then snprintf_P() a whole message into
+//    a 200 byte stack buffer (with each float first sprintf()'d into one of float2string()'s
+//    static buffers) and then copying it into the TX ring, the message is rendered one field
+//    at a time straight into the ring's free space:
+//
+//          tTXWriter w;
+//          TXW_begin(&w, &asciiTX, 0, false);
+//          TXW_str_P(&w, PSTR("AST;,"));
+//          TXW_fixed(&w, measuredBatVolts, 2);
+//              . . .
+//          TXW_end(&w);
+//
+//    Nothing is sent until TXW_end(), which moves the ring's head up over the message - or,
+//    if it did not all fit, drops it whole as TX_write() would have.  A writer that is simply
+//    abandoned (ala, delta mode finding the message has not changed) sends nothing.
+//
+//    In binary mode (TXW_FRAMED) the message is COBS encoded as a BT_TEXT frame as it goes,
+//    the code bytes being filled in behind it - so it is the same frame BT_send() would make.
+//
+//    The numbers come out exactly as the snprintf_P() formats and float2string() they replace:
+//      TXW_int()    %d              TXW_uint()   %u            TXW_ulong()  %lu
+//      TXW_pad()    %0nd            TXW_fixed()  float2string(v, n) -  The whole part with its sign
+//                                                (so -0.5 shows as "0.50"), the fraction truncated to n digits.
+//    Except that float2string() kept the fraction in an unsigned int, and so printed the wrong digits once
+//    |v| * 10^n passed 65535  (65.536 to 3 places came out "65.000") - TXW_fixed() gets those right.
+//    (test/host/txw_fixed checks all this against a copy of float2string())
+//
+//*****************************************************************************************
+
+#include "Config.h"
+#include "TxWriter.h"
+#include "BinTelemetry.h"
+
+//-------       'helper' functions
+static void TXW_raw(tTXWriter *w, uint8_t c)
+{ // Put one byte into the ring, if there is still room.
+    w->bytes++;
+
+    if (w->room == 0)
+    {
+        w->fit = false;
+        return;
+    }
+
+    w->ring->buf[w->head] = c;
+    if (++w->head >= w->ring->size)
+        w->head = 0;
+    w->room--;
+}
+
+static void TXW_cobs(tTXWriter *w, uint8_t c)
+{ // COBS encode one byte of the frame.  (Same as COBS_put() in BinTelemetry.cpp, but the code byte is found by its place in the ring)
+    if (c != 0)
+    {
+        TXW_raw(w, c);
+        w->run++;
+    }
+
+    if ((c == 0) || (w->run == 0xFE))
+    { // Close this block out, and start the next one.
+        if (w->fit)
+            w->ring->buf[w->codeIdx] = w->run + 1;
+        w->codeIdx = w->head;
+        w->run = 0;
+        TXW_raw(w, 0); //   (Place holder for its code byte)
+    }
+}
+
+static void TXW_digits(tTXWriter *w, uint32_t v, uint8_t minDigits)
+{
+    char digits[10]; // Enough for a uint32_t, least significant 1st
+    uint8_t n = 0;
+    uint16_t s;
+
+    if (v <= 0xFFFFU)
+    { // Most are, and 16-bit divides are much faster on the AVR.
+        s = (uint16_t)v;
+        do
+        {
+            digits[n++] = '0' + (s % 10);
+            s /= 10;
+        } while (s != 0);
+    }
+    else
+    {
+        do
+        {
+            digits[n++] = '0' + (v % 10);
+            v /= 10;
+        } while (v != 0);
+    }
+
+    minDigits = min(minDigits, (uint8_t)sizeof(digits));
+    while (n < minDigits)
+        digits[n++] = '0';
+
+    while (n > 0)
+        TXW_char(w, digits[--n]);
+}
+
+//------------------------------------------------------------------------------------------------------
+// TXW Begin / Begin Type
+//      Starts a new message in the passed ring.  mode is TXW_xxx, highPriority is as for TX_write().
+//      TXW_begin_type() is for framed messages that are not BT_TEXT, type being their BT_xxx.
+//
+//------------------------------------------------------------------------------------------------------
+
+void TXW_begin(tTXWriter *w, tTXRing *ring, uint8_t mode, bool highPriority)
+{
+    TXW_begin_type(w, ring, mode, BT_TEXT, highPriority);
+} //TXW_begin
+
+void TXW_begin_type(tTXWriter *w, tTXRing *ring, uint8_t mode, uint8_t type, bool highPriority)
+{
+    w->ring = ring;
+    w->head = ring->head;
+    w->room = TX_free(ring);
+    if (!highPriority)
+        w->room = (w->room > TX_HP_RESERVE) ? (w->room - TX_HP_RESERVE) : 0;
+    w->bytes = 0;
+    w->len = 0;
+    w->crc = 0xFFFF;
+    w->mode = mode;
+    w->fit = true;
+
+    if (mode & TXW_FRAMED)
+    {
+        w->mode |= TXW_CRC;
+        w->codeIdx = w->head;
+        w->run = 0;
+        TXW_raw(w, 0); // Place holder for the 1st code byte
+        w->crc = CRC16_update(w->crc, type);
+        TXW_cobs(w, type);
+    }
+} //TXW_begin_type
+
+//------------------------------------------------------------------------------------------------------
+// TXW End
+//      Finishes off the message and sends it on its way.  Returns how many bytes were queued, 0 if it
+//      had to be dropped.
+//
+//------------------------------------------------------------------------------------------------------
+
+uint16_t TXW_end(tTXWriter *w)
+{
+    uint16_t crc = w->crc;
+
+    if (w->mode & TXW_FRAMED)
+    {
+        TXW_cobs(w, (uint8_t)crc);
+        TXW_cobs(w, (uint8_t)(crc >> 8));
+        if (w->fit)
+            w->ring->buf[w->codeIdx] = w->run + 1; // Close out the last block
+        TXW_raw(w, 0x00);                           //   and mark the end of the frame.
+    }
+
+    if (!TX_commit(w->ring, w->head, w->bytes, w->fit))
+        return (0);
+
+    return (w->bytes);
+} //TXW_end
+
+//------------------------------------------------------------------------------------------------------
+// TXW Char / Str / Str_P
+//      Add the passed character, string, or string in PROGMEM to the message.
+//
+//------------------------------------------------------------------------------------------------------
+
+void TXW_char(tTXWriter *w, char c)
+{
+    if (w->len >= (BT_MAX_PAYLOAD - 1))
+        return; // Truncated, as snprintf() into an OUTBOUND_BUFF_SIZE buffer would have.
+    w->len++;
+
+    if (w->mode & TXW_CRC)
+        w->crc = CRC16_update(w->crc, (uint8_t)c);
+
+    if (w->mode & TXW_FRAMED)
+        TXW_cobs(w, (uint8_t)c);
+    else
+        TXW_raw(w, (uint8_t)c);
+} //TXW_char
+
+void TXW_str(tTXWriter *w, const char *str)
+{
+    while (*str)
+        TXW_char(w, *str++);
+} //TXW_str
+
+void TXW_str_P(tTXWriter *w, const char *str)
+{
+    char c;
+
+    while ((c = (char)pgm_read_byte(str++)) != '\0')
+        TXW_char(w, c);
+} //TXW_str_P
+
+//------------------------------------------------------------------------------------------------------
+// TXW Int / Uint / Ulong / Pad
+//      Add the passed number, as %d, %u, %lu - or for TXW_pad() %0nd - would have.
+//
+//------------------------------------------------------------------------------------------------------
+
+void TXW_int(tTXWriter *w, int v)
+{
+    if (v < 0)
+    {
+        TXW_char(w, '-');
+        TXW_digits(w, (uint32_t)(-(int32_t)v), 1);
+    }
+    else
+        TXW_digits(w, (uint32_t)v, 1);
+} //TXW_int
+
+void TXW_uint(tTXWriter *w, unsigned int v)
+{
+    TXW_digits(w, v, 1);
+} //TXW_uint
+
+void TXW_ulong(tTXWriter *w, uint32_t v)
+{
+    TXW_digits(w, v, 1);
+} //TXW_ulong
+
+void TXW_pad(tTXWriter *w, unsigned int v, uint8_t digits)
+{
+    TXW_digits(w, v, digits);
+} //TXW_pad
+
+//------------------------------------------------------------------------------------------------------
+// TXW Fixed
+//      Add the passed float with 'decimals' digits after the decimal point.  (Replaces float2string())
+//
+//------------------------------------------------------------------------------------------------------
+
+void TXW_fixed(tTXWriter *w, float v, uint8_t decimals)
+{
+    uint32_t mult = 1; // Multiplier for the fractional portion of the number
+    float absV;
+
+    for (uint8_t i = 0; i < decimals; i++)
+        mult *= 10;
+
+    absV = (v < 0) ? -v : v;
+
+    TXW_int(w, (int)v); // Whole number, with its sign
+    TXW_char(w, '.');
+    TXW_digits(w, (uint32_t)(absV * mult) % mult, decimals); // Fraction, w/o a sign.
+} //TXW_fixed
@@ -0,0 +1,54 @@
+//      TxWriter.h
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+
+#ifndef _TXWRITER_H_
+#define _TXWRITER_H_
+
+#include "TxRing.h"
+
+#define TXW_FRAMED 0x01 // TXW_begin() modes:  Wrap the message in a BT_TEXT frame  (Binary mode, see BinTelemetry.h)
+#define TXW_CRC 0x02    //   Keep a CRC-16 of the message  (Used by delta mode to see if it has changed, always kept when framed)
+
+typedef struct
+{ // Streaming writer - assembles one outbound message in place in a TX ring, see TxWriter.cpp
+    tTXRing *ring;
+    uint16_t head;    // Where the next byte goes.  (The ring's own head is only moved up to here by TXW_end())
+    uint16_t room;    // Ring bytes this message may still use
+    uint16_t bytes;   // Ring bytes it needs so far  (Includes the framing)
+    uint16_t codeIdx; // Framed:  where the current COBS code byte is in the ring
+    uint8_t run;      //   and how many bytes follow it so far
+    uint8_t len;      // Message bytes written so far.  (Capped at BT_MAX_PAYLOAD - 1)
+    uint16_t crc;
+    uint8_t mode;     // TXW_xxx
+    bool fit;         // FALSE once there was not room for it all
+} tTXWriter;
+
+void TXW_begin(tTXWriter *w, tTXRing *ring, uint8_t mode, bool highPriority);
+void TXW_begin_type(tTXWriter *w, tTXRing *ring, uint8_t mode, uint8_t type, bool highPriority);
+uint16_t TXW_end(tTXWriter *w);
+void TXW_char(tTXWriter *w, char c);
+void TXW_str(tTXWriter *w, const char *str);
+void TXW_str_P(tTXWriter *w, const char *str);
+void TXW_int(tTXWriter *w, int v);
+void TXW_uint(tTXWriter *w, unsigned int v);
+void TXW_ulong(tTXWriter *w, uint32_t v);
+void TXW_pad(tTXWriter *w, unsigned int v, uint8_t digits);
+void TXW_fixed(tTXWriter *w, float v, uint8_t decimals);
+
+#endif // _TXWRITER_H_
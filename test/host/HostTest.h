@@ -0,0 +1,71 @@
+//
+//      HostTest.h
+//
+//      The few checks the host tests use.  A failed CHECK prints where and what, and the test exits non-zero at the end.
+//
+
+#ifndef _HOST_TEST_H_
+#define _HOST_TEST_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static int htFailures = 0;
+static int htChecks = 0;
+
+#define CHECK(c)                                                             \
+    do                                                                       \
+    {                                                                        \
+        htChecks++;                                                          \
+        if (!(c))                                                            \
+        {                                                                    \
+            htFailures++;                                                    \
+            printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #c);    \
+        }                                                                    \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                          \
+    do                                                                                          \
+    {                                                                                           \
+        long long _a = (long long)(a), _b = (long long)(b);                                     \
+        htChecks++;                                                                             \
+        if (_a != _b)                                                                           \
+        {                                                                                       \
+            htFailures++;                                                                       \
+            printf("%s:%d: CHECK_EQ failed: %s == %lld, %s == %lld\n", __FILE__, __LINE__, #a, _a, #b, _b); \
+        }                                                                                       \
+    } while (0)
+
+#define CHECK_STR(a, b)                                                                             \
+    do                                                                                              \
+    {                                                                                               \
+        const char *_a = (a), *_b = (b);                                                            \
+        htChecks++;                                                                                 \
+        if (strcmp(_a, _b) != 0)                                                                    \
+        {                                                                                           \
+            htFailures++;                                                                           \
+            printf("%s:%d: CHECK_STR failed: %s == \"%s\", %s == \"%s\"\n", __FILE__, __LINE__, #a, _a, #b, _b); \
+        }                                                                                           \
+    } while (0)
+
+//----  Wall-clock nS per call of 'expr', for the benchmarks.  (Host numbers - only the ratios carry over to the AVR)
+#define BENCH_NS(loops, expr)                                               \
+    ([&]() -> double {                                                      \
+        struct timespec _t0, _t1;                                           \
+        clock_gettime(CLOCK_MONOTONIC, &_t0);                               \
+        for (long _i = 0; _i < (loops); _i++)                               \
+        {                                                                   \
+            expr;                                                           \
+        }                                                                   \
+        clock_gettime(CLOCK_MONOTONIC, &_t1);                               \
+        return (((_t1.tv_sec - _t0.tv_sec) * 1e9 + (_t1.tv_nsec - _t0.tv_nsec)) / (loops)); \
+    }())
+
+static int test_summary(const char *name)
+{
+    printf("%s: %d checks, %d failed\n", name, htChecks, htFailures);
+    return (htFailures == 0 ? 0 : 1);
+}
+
+#endif // _HOST_TEST_H_
@@ -0,0 +1,322 @@
+//
+//      bin_telemetry.cpp
+//
+//      Round trip of the binary telemetry framing:  frames built by BT_send() / BT_send_AST() on the regulator side are
+//      taken back apart by both BT_decode() (the regulator's own, used for $BKL:) and the host side BTDecoder in
+//      tools/BinTelemetry, and must come out as they went in.  Every BT_* type is sent, payloads are run from empty up
+//      to BT_MAX_PAYLOAD in a few patterns heavy in 0x00s, and the COBS blocks are checked up to the 254 byte edge where
+//      a block is full without a 0x00 to end it.  Damaged, truncated and over-long frames must be thrown away.
+//
+
+#include "../../tools/BinTelemetry/BTDecoder.h" // (Ahead of Arduino.h and its min() / max() macros, for <string>)
+
+#include "Config.h"
+#include "TxRing.h"
+#include "BinTelemetry.cpp" // For COBS_put()
+
+#include "HostTest.h"
+
+static uint8_t sent[2048];
+
+//----  Everything BT_send() has queued up, as it went out the port.
+static size_t drain(void)
+{
+    TX_flush();
+    return (Serial.host_sent(sent, sizeof(sent)));
+}
+
+static void fill(uint8_t *p, int len, int pattern, uint32_t seed)
+{
+    for (int i = 0; i < len; i++)
+    {
+        seed = seed * 1103515245UL + 12345UL;
+        switch (pattern)
+        {
+        case 0:
+            p[i] = 0x00; // All NULLs - a COBS block per byte
+            break;
+        case 1:
+            p[i] = 0xFF; // None at all
+            break;
+        case 2:
+            p[i] = (i & 1) ? 0x00 : (uint8_t)(i + 1); // Every other one
+            break;
+        default:
+            p[i] = ((seed >> 16) % 5 == 0) ? 0x00 : (uint8_t)(seed >> 8); // Random, ~1 in 5 NULL
+            break;
+        }
+    }
+}
+
+//----  Sends the payload, and checks both decoders hand it back - and that BTDecoder::encode() would have framed it the same.
+static void round_trip(uint8_t type, const void *payload, int len, const char *what)
+{
+    BTDecoder dec;
+    uint8_t copy[sizeof(sent)];
+    uint8_t hostFrame[BT_MAX_FRAME];
+    int n, good = 0, i;
+
+    CHECK(BT_send(type, payload, len, true));
+    n = drain();
+
+    CHECK(n >= 4);
+    CHECK(n <= BT_MAX_FRAME);
+    CHECK_EQ(sent[n - 1], 0x00);
+    CHECK(memchr(sent, 0x00, n - 1) == NULL); // The only NULL is the one ending the frame
+
+    for (i = 0; i < n; i++)
+        if (dec.feed(sent[i]))
+            good++;
+    CHECK_EQ(good, 1);
+    CHECK_EQ(dec.type(), type);
+    CHECK_EQ(dec.length(), len);
+    CHECK(memcmp(dec.payload(), payload, len) == 0);
+
+    memcpy(copy, sent, n);
+    CHECK_EQ(BT_decode(copy, n - 1), len);
+    CHECK_EQ(copy[0], type);
+    CHECK(memcmp(&copy[1], payload, len) == 0);
+
+    CHECK_EQ(BTDecoder::encode(type, payload, len, hostFrame), n);
+    CHECK(memcmp(hostFrame, sent, n) == 0);
+
+    if (htFailures != 0)
+        printf("    ... sending %s, %d bytes\n", what, len);
+}
+
+//----  Plain COBS, no CRC:  the encoder's half of BT_send().  (Its indexes are uint8_t, so good for 255 bytes out)
+static int cobs_encode(const uint8_t *in, int len, uint8_t *out)
+{
+    uint8_t pos = 1, codeIdx = 0;
+
+    for (int i = 0; i < len; i++)
+        COBS_put(out, &pos, &codeIdx, in[i]);
+    out[codeIdx] = pos - codeIdx;
+    return (pos);
+}
+
+static void test_types(void)
+{
+    tBTAST ast;
+    tBTCPE cpe;
+    tBTSST sst;
+    tBTSCV scv;
+    tBTBackup bk;
+    tBTHistory his;
+    uint8_t disp[40];
+    const char *text = "AST;1234,14.20,55.3,50.1,785,14.40,120,1500,21,25,85,3200,14.35,40,4,55\r\n";
+
+    fill((uint8_t *)&ast, sizeof(ast), 3, 1);
+    fill((uint8_t *)&cpe, sizeof(cpe), 3, 2);
+    fill((uint8_t *)&sst, sizeof(sst), 3, 3);
+    fill((uint8_t *)&scv, sizeof(scv), 3, 4);
+    fill((uint8_t *)&bk, sizeof(bk), 3, 5);
+    fill((uint8_t *)&his, sizeof(his), 3, 6);
+    fill(disp, sizeof(disp), 2, 7);
+
+    round_trip(BT_AST, &ast, sizeof(ast), "BT_AST");
+    round_trip(BT_CPE, &cpe, sizeof(cpe), "BT_CPE");
+    round_trip(BT_SST, &sst, sizeof(sst), "BT_SST");
+    round_trip(BT_SCV, &scv, sizeof(scv), "BT_SCV");
+    round_trip(BT_BACKUP, &bk, sizeof(bk), "BT_BACKUP");
+    round_trip(BT_BACKUP, &bk, offsetof(tBTBackup, data) + 10, "BT_BACKUP (last, short)");
+    round_trip(BT_HISTORY, &his, sizeof(his), "BT_HISTORY");
+    round_trip(BT_HISTORY, &his, offsetof(tBTHistory, rec) + (3 * sizeof(tBTHistRec)), "BT_HISTORY (3 records)");
+    round_trip(BT_DISPLAY, disp, sizeof(disp), "BT_DISPLAY");
+    round_trip(BT_TEXT, text, strlen(text), "BT_TEXT");
+
+    binaryMode = true; // Text via BT_write_text() is framed once in binary mode ..
+    BTDecoder dec;
+    CHECK(BT_write_text(text, true));
+    size_t n = drain();
+    for (size_t i = 0; i < n; i++)
+        dec.feed(sent[i]);
+    CHECK(dec.text() == text);
+
+    binaryMode = false; //   .. and sent as-is when not.
+    CHECK(BT_write_text(text, true));
+    CHECK_EQ(drain(), strlen(text));
+    CHECK(memcmp(sent, text, strlen(text)) == 0);
+}
+
+static void test_payloads(void)
+{
+    uint8_t p[BT_MAX_PAYLOAD + 50];
+    char what[40];
+
+    for (int pattern = 0; pattern < 4; pattern++)
+        for (int len = 0; len <= BT_MAX_PAYLOAD; len++)
+        {
+            fill(p, len, pattern, len);
+            snprintf(what, sizeof(what), "pattern %d", pattern);
+            round_trip(0x40 + pattern, p, len, what);
+        }
+
+    //---  Over-long payloads are cut back to BT_MAX_PAYLOAD, not sent overflowing the frame.
+    BTDecoder dec;
+    fill(p, sizeof(p), 1, 0);
+    CHECK(BT_send(BT_TEXT, p, sizeof(p), true));
+    size_t n = drain();
+    CHECK(n <= BT_MAX_FRAME);
+    for (size_t i = 0; i < n; i++)
+        dec.feed(sent[i]);
+    CHECK_EQ(dec.length(), BT_MAX_PAYLOAD);
+    CHECK_EQ(BTDecoder::encode(BT_TEXT, p, sizeof(p), p), 0);
+}
+
+static void test_delta(void)
+{
+    BTDecoder dec;
+    tBTAST ast, got, expect;
+    size_t n, i;
+
+    memset(&ast, 0, sizeof(ast));
+    ast.runTime = 1000;
+    ast.batmV = 12800;
+    ast.batdA = 250;
+    ast.state = bulk_charge;
+    ast.RPMs = 2000;
+
+    BT_reset_delta();
+    CHECK(BT_send_AST(&ast, false, true)); // First one after a reset is a keyframe
+    n = drain();
+    for (i = 0; i < n; i++)
+        dec.feed(sent[i]);
+    CHECK_EQ(dec.type(), BT_AST);
+    CHECK(dec.ast(got));
+    CHECK(memcmp(&got, &ast, sizeof(ast)) == 0);
+
+    expect = ast;
+    ast.batmV += btDeadband[1] + 1; // Out of its deadband - sent ..
+    ast.batdA += btDeadband[3];     //   inside it - not ..
+    ast.state = acceptance_charge;  //   deadband 0 - sent
+    ast.RPMs = 0x0100;              //   and one with a NULL in it
+    expect.batmV = ast.batmV;
+    expect.state = ast.state;
+    expect.RPMs = ast.RPMs;
+
+    CHECK(BT_send_AST(&ast, false, true));
+    n = drain();
+    for (i = 0; i < n; i++)
+        dec.feed(sent[i]);
+    CHECK_EQ(dec.type(), BT_AST_DELTA);
+    CHECK_EQ(dec.length(), 3 + 2 + 1 + 2); // 3 TAGs, and their values
+    CHECK(dec.ast(got));
+    CHECK(memcmp(&got, &expect, sizeof(ast)) == 0);
+
+    CHECK(BT_send_AST(&ast, false, true)); // Nothing has moved, nothing is sent.
+    CHECK_EQ(drain(), 0);
+
+    CHECK(BT_send_AST(&ast, true, true)); // Keyframe brings the held back field up to date
+    n = drain();
+    for (i = 0; i < n; i++)
+        dec.feed(sent[i]);
+    CHECK_EQ(dec.type(), BT_AST);
+    CHECK(dec.ast(got));
+    CHECK(memcmp(&got, &ast, sizeof(ast)) == 0);
+}
+
+static void test_damage(void)
+{
+    uint8_t p[100], copy[sizeof(sent)];
+    BTDecoder dec;
+    int n, i, b, rejected = 0, tries = 0;
+
+    fill(p, sizeof(p), 3, 99);
+    BT_send(BT_SST, p, sizeof(p), true);
+    n = drain();
+
+    for (i = 0; i < (n - 1); i++) // Every single bit error, anywhere in the frame
+        for (b = 0; b < 8; b++)
+        {
+            memcpy(copy, sent, n);
+            copy[i] ^= (1 << b);
+            tries++;
+            if (BT_decode(copy, n - 1) == -1)
+                rejected++;
+        }
+    CHECK_EQ(rejected, tries);
+
+    for (i = 0; i < (n - 1); i++)
+    { // Cut short
+        memcpy(copy, sent, n);
+        CHECK_EQ(BT_decode(copy, i), -1);
+    }
+
+    for (i = 0; i < (n - 5); i++) // A frame cut short by a lost byte (or a late start) is thrown away by BTDecoder ..
+        dec.feed(sent[i + 5]);
+    CHECK_EQ(dec.frames, 0);
+    CHECK_EQ(dec.crcErrors, 1);
+    for (i = 0; i < n; i++) //   .. which is back in step for the next one.
+        dec.feed(sent[i]);
+    CHECK_EQ(dec.frames, 1);
+    CHECK(memcmp(dec.payload(), p, sizeof(p)) == 0);
+
+    for (i = 0; i < (BT_MAX_FRAME + 10); i++) // And a run of bytes longer then any frame is an overrun, not a crash ..
+        dec.feed(0x55);
+    CHECK(!dec.feed(0x00));
+    CHECK_EQ(dec.overruns, 1);
+    for (i = 0; i < n; i++) //   .. again followed by a good one.
+        dec.feed(sent[i]);
+    CHECK_EQ(dec.frames, 2);
+}
+
+static void test_cobs_edges(void)
+{
+    uint8_t in[260], enc[260];
+    int n, len, content, withNull;
+    uint16_t crc;
+
+    //---  Up to a run of 253 non-NULLs is one block, its code 1 more then its length.  (Then a NULL, or not)
+    for (len = 250; len <= 253; len++)
+        for (withNull = 0; withNull < 2; withNull++)
+        {
+            memset(in, 0x5A, sizeof(in));
+            in[len] = 0x00;
+            n = cobs_encode(in, len + withNull, enc);
+            CHECK_EQ(n, len + 1 + withNull);
+            CHECK(memchr(enc, 0x00, n) == NULL);
+            CHECK_EQ(enc[0], len + 1);
+            if (withNull)
+                CHECK_EQ(enc[len + 1], 1);
+        }
+
+    //---  A frame never gets near 254 (BT_MAX_FRAME), so BT_send() never has to split a run with a full (code 0xFF) block.
+    //      BT_decode() takes up to 255 bytes though - so check it right to the edge:  253 bytes (TYPE, PAYLOAD and CRC)
+    //      as one block of code 0xFE, and 254 as a full block of 0xFF, which has no NULL after it.
+    for (content = 253; content <= 254; content++)
+    {
+        in[0] = BT_TEXT;
+        memset(&in[1], 0x5A, content - 3);
+        for (uint8_t tweak = 1; tweak != 0; tweak++)
+        { // (The CRC has to come out without a NULL in it, else the block is split)
+            in[content - 3] = tweak;
+            crc = 0xFFFF;
+            for (int i = 0; i < (content - 2); i++)
+                crc = CRC16_update(crc, in[i]);
+            if (((crc & 0xFF) != 0) && ((crc >> 8) != 0))
+                break;
+        }
+        in[content - 2] = crc & 0xFF;
+        in[content - 1] = crc >> 8;
+
+        enc[0] = content + 1;
+        memcpy(&enc[1], in, content);
+        CHECK_EQ(BT_decode(enc, content + 1), content - 3);
+        CHECK(memcmp(in, enc, content) == 0);
+
+        enc[0] = content + 2; // Claims 1 byte more then is there
+        memcpy(&enc[1], in, content);
+        CHECK_EQ(BT_decode(enc, content + 1), -1);
+    }
+}
+
+int main(void)
+{
+    test_types();
+    test_payloads();
+    test_delta();
+    test_damage();
+    test_cobs_edges();
+    return (test_summary("bin_telemetry"));
+}
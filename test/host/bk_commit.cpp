@@ -0,0 +1,223 @@
+//
+//      bk_commit.cpp
+//
+//      Loading a Config Backup image ($BKL:) - write_BK_image(), commit_BK_image() and update_BK_image() in Flash.cpp.
+//
+//      -- The power is cut after every update_BK_image() pass:  after resume_BK_image() (as at the next Startup) the saved
+//         configuration must be all the old one or all the new one - and always the new one once the STG flag has been set.
+//      -- No pass writes more than BK_EEPROM_STEP bytes of EEPROM.
+//      -- A damaged or incomplete image is refused, changing nothing.
+//      -- Configuration changes made while an image is being put in place are dropped, not half done.
+//
+
+#include "Config.h"
+#include "System.h"
+#include "CPE.h"
+#include "Flash.h"
+
+#include "HostTest.h"
+
+#define OLD 1
+#define NEW 2
+
+static uint8_t image[sizeof(tBKImage)];
+static uint8_t saved[E2END + 1];
+
+//----  The configuration the image will hold:  SCS saved, CPS 7 saved, CPS 6 back to its defaults.
+static void set_new(void)
+{
+    tSCS scs = systemConfig;
+    tCPS cps;
+
+    scs.ALT_IDLE_RPM = 1200;
+    write_SCS_EEPROM(&scs);
+    transfer_default_CPS(7, &cps);
+    cps.ACPT_BAT_V_SETPOINT = 14.6;
+    write_CPS_EEPROM(7, &cps);
+    write_CPS_EEPROM(6, NULL);
+}
+
+//----  And the one on the regulator before it is loaded:  SCS saved, CPS 6 saved, CPS 7 not.
+static void set_old(void)
+{
+    tSCS scs = systemConfig;
+    tCPS cps;
+
+    scs.ALT_IDLE_RPM = 900;
+    write_SCS_EEPROM(&scs);
+    transfer_default_CPS(6, &cps);
+    cps.ACPT_BAT_V_SETPOINT = 14.0;
+    write_CPS_EEPROM(6, &cps);
+    write_CPS_EEPROM(7, NULL);
+}
+
+//----  Which of the two is saved now?  0 = neither, a mix.
+static int which(void)
+{
+    tSCS scs;
+    tCPS cps6, cps7;
+    bool have6, have7;
+
+    if (!read_SCS_EEPROM(&scs))
+        return (0);
+    have6 = read_CPS_EEPROM(6, &cps6);
+    have7 = read_CPS_EEPROM(7, &cps7);
+
+    if ((scs.ALT_IDLE_RPM == 900) && have6 && (cps6.ACPT_BAT_V_SETPOINT == 14.0f) && !have7)
+        return (OLD);
+    if ((scs.ALT_IDLE_RPM == 1200) && !have6 && have7 && (cps7.ACPT_BAT_V_SETPOINT == 14.6f))
+        return (NEW);
+    return (0);
+}
+
+//----  Power cut now:  what would the next Startup find?  (hostEEPROM is put back after)
+static int after_power_cut(void)
+{
+    int w;
+
+    memcpy(saved, hostEEPROM, sizeof(saved));
+    resume_BK_image();
+    w = which();
+    memcpy(hostEEPROM, saved, sizeof(saved));
+    return (w);
+}
+
+static bool flag_set(void)
+{
+    return ((hostEEPROM[STG_FLAG_LOCATION] & ~BK_COMMIT_CAL) == BK_COMMIT_K);
+}
+
+//----  Stage the image a BT_BACKUP_CHUNK at a time, as BK_load() does.  Returns FALSE if write_BK_image() refused any.
+static bool stage(const uint8_t *img, unsigned size, uint32_t *passes, uint32_t *maxWrites)
+{
+    for (unsigned at = 0; at < size; at += BT_BACKUP_CHUNK)
+    {
+        uint8_t len = ((size - at) < BT_BACKUP_CHUNK) ? (size - at) : BT_BACKUP_CHUNK;
+
+        if (!write_BK_image(at, &img[at], len))
+            return (false);
+        CHECK(!write_BK_image(at + len, &img[at], 1)); // Not until this one is in
+
+        for (;;)
+        {
+            uint32_t w = hostEEPROMWrites;
+            bool done = update_BK_image();
+            if ((hostEEPROMWrites - w) > *maxWrites)
+                *maxWrites = hostEEPROMWrites - w;
+            (*passes)++;
+            CHECK_EQ(after_power_cut(), OLD); // Nothing in place yet
+            if (done)
+                break;
+        }
+    }
+    return (true);
+}
+
+static void test_load(void)
+{
+    uint32_t passes = 0, maxWrites = 0, commitPasses = 0;
+    bool flagSeen = false;
+    int w;
+
+    //---  Read the new configuration out as an image, then put the old one back.
+    memset(hostEEPROM, 0xFF, sizeof(hostEEPROM));
+    set_new();
+    for (unsigned at = 0; at < sizeof(image);)
+        at += read_BK_image(at, &image[at], BT_BACKUP_CHUNK);
+    set_old();
+    CHECK_EQ(which(), OLD);
+
+    CHECK(stage(image, sizeof(image), &passes, &maxWrites));
+    CHECK(commit_BK_image());
+    CHECK(!commit_BK_image()); // Only once
+
+    for (;;)
+    {
+        uint32_t w0 = hostEEPROMWrites;
+        bool done = update_BK_image();
+        if ((hostEEPROMWrites - w0) > maxWrites)
+            maxWrites = hostEEPROMWrites - w0;
+        commitPasses++;
+
+        w = after_power_cut();
+        if (flag_set())
+            flagSeen = true;
+        if (flagSeen)
+            CHECK_EQ(w, NEW);
+        else
+            CHECK_EQ(w, OLD);
+        if (done)
+            break;
+    }
+
+    CHECK(flagSeen);
+    CHECK(!flag_set());
+    CHECK_EQ(which(), NEW);
+    CHECK_EQ(maxWrites, BK_EEPROM_STEP);
+    printf("Staged in %u passes, put in place in %u, at most %u EEPROM bytes written in any one\n", passes, commitPasses, maxWrites);
+}
+
+static void test_refused(void)
+{
+    uint32_t passes = 0, maxWrites = 0;
+    uint32_t writes;
+
+    //---  Damaged on the way:  refused, and nothing is changed.
+    set_old();
+    image[100] ^= 0x01;
+    CHECK(stage(image, sizeof(image), &passes, &maxWrites));
+    writes = hostEEPROMWrites;
+    CHECK(!commit_BK_image());
+    CHECK(update_BK_image());
+    CHECK_EQ(hostEEPROMWrites, writes);
+    CHECK_EQ(which(), OLD);
+    image[100] ^= 0x01;
+
+    //---  Only part of it.
+    CHECK(stage(image, sizeof(image) - 10, &passes, &maxWrites));
+    CHECK(!commit_BK_image());
+    CHECK_EQ(which(), OLD);
+
+    //---  Not the next chunk.
+    CHECK(stage(image, BT_BACKUP_CHUNK, &passes, &maxWrites));
+    CHECK(!write_BK_image(2 * BT_BACKUP_CHUNK, image, BT_BACKUP_CHUNK));
+}
+
+static void test_changes_during(void)
+{
+    uint32_t passes = 0, maxWrites = 0;
+    tSCS scs = systemConfig;
+    tCPS cps;
+
+    set_old();
+    CHECK(stage(image, sizeof(image), &passes, &maxWrites));
+    CHECK(commit_BK_image());
+    while (!flag_set() && !update_BK_image())
+        ;
+    update_BK_image(); // (Part way through putting it in place)
+    CHECK(flag_set());
+
+    scs.ALT_IDLE_RPM = 700; // ($SCO, or Modbus, from another port)
+    write_SCS_EEPROM(&scs);
+    transfer_default_CPS(7, &cps);
+    write_CPS_EEPROM(7, &cps);
+
+    while (!update_BK_image())
+        ;
+    CHECK_EQ(which(), NEW);
+
+    write_SCS_EEPROM(&scs); // Once done, changes are saved again.
+    CHECK(read_SCS_EEPROM(&scs));
+    CHECK_EQ(scs.ALT_IDLE_RPM, 700);
+}
+
+int main(void)
+{
+    systemConfig.CONFIG_LOCKOUT = 0;
+
+    test_load();
+    test_refused();
+    test_changes_during();
+
+    return (test_summary("bk_commit"));
+}
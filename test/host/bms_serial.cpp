@@ -0,0 +1,324 @@
+//
+//      bms_serial.cpp
+//
+//      What the BMS sends in on BMS_SERIAL_PORT  (BMS_SERIAL.cpp), and what the regulator does with it:
+//
+//      -- LIMITS, PACK, CELLS and DISCONNECT frames land in bmsData.  A bad CRC, a length that does not fit the frame type,
+//         or a type we do not know is counted and thrown away - and the parser finds the next START after it.
+//      -- No more than BMS_MAX_BYTES_PER_PASS are taken each pass of the Mainloop.
+//      -- The Charge Voltage / Current Limits cap the targets (set_VAWL()), NO_CHARGE takes the Amps to 0, and all of that
+//         goes away BMS_LIMITS_TIMEOUT after the last LIMITS frame.
+//      -- A disconnect warning drops into LIFEPO_FORCED_SHUTDOWN with the field off, and clearing it goes back to ramping.
+//         The alarm Feature-out follows the warning - but stays on if Force-to-Float is holding it on too.
+//      -- The highest cell tapers the Amps down to BALANCE_AMPS at CELL_MAX_MV and holds them there, cuts them only once
+//         CELL_OVER_MV past it, and gives them back only once it is down to CELL_MAX_MV again.
+//
+
+#include "Config.h"
+#include "System.h"
+#include "Alternator.h"
+#include "Sensors.h"
+#include "ThermalModel.h"
+#include "BinTelemetry.h"
+#include "BMS_SERIAL.h"
+
+#include "HostTest.h"
+
+#define ALARM_PIN FEATURE_OUT_LIFEPO_SHUTDOWN_ALARM_PORT
+
+static uint8_t frame[BMS_MAX_PAYLOAD + 6];
+
+//----  Build a BMS frame in frame[], returns its length.  crcError is XOR'd into the CRC to spoil it.
+static size_t build(uint8_t type, const uint8_t *payload, uint8_t len, uint16_t crcError = 0)
+{
+    uint16_t crc = 0xFFFF;
+    size_t n = 0;
+
+    frame[n++] = BMS_FRAME_START;
+    frame[n++] = type;
+    frame[n++] = len;
+    memcpy(frame + n, payload, len);
+    n += len;
+    crc = CRC16_update(crc, type);
+    crc = CRC16_update(crc, len);
+    for (uint8_t i = 0; i < len; i++)
+        crc = CRC16_update(crc, payload[i]);
+    crc ^= crcError;
+    frame[n++] = crc & 0xFF;
+    frame[n++] = crc >> 8;
+    return (n);
+}
+
+//----  Received from the BMS, and the Mainloop passes over it until it has all been taken.
+static void receive(const uint8_t *data, size_t len)
+{
+    BMS_SERIAL_PORT.host_receive(data, len);
+    while (BMS_SERIAL_PORT.available() > 0)
+        manage_BMS();
+}
+
+static void send(uint8_t type, const uint8_t *payload, uint8_t len, uint16_t crcError = 0)
+{
+    receive(frame, build(type, payload, len, crcError));
+}
+
+static void limits(uint16_t CVL_mV, uint16_t CCL_dA, uint8_t flags)
+{
+    uint8_t p[5] = {(uint8_t)CVL_mV, (uint8_t)(CVL_mV >> 8), (uint8_t)CCL_dA, (uint8_t)(CCL_dA >> 8), flags};
+    send(BMS_MSG_LIMITS, p, sizeof(p));
+}
+
+static void cells(uint16_t maxmV)
+{
+    uint16_t mV[4] = {3300, maxmV, 3310, 3290};
+    uint8_t p[1 + 2 * 4];
+
+    p[0] = 4;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        p[1 + 2 * i] = (uint8_t)mV[i];
+        p[2 + 2 * i] = (uint8_t)(mV[i] >> 8);
+    }
+    send(BMS_MSG_CELLS, p, sizeof(p));
+}
+
+static void reset_world(void)
+{
+    BMS_SERIAL_PORT.host_clear();
+    memset(&bmsData, 0, sizeof(bmsData));
+    manage_BMS(); //   (Lets the alarm pin catch up with there being no warning)
+    hostMillis = 1000;
+    bmsFrameErrors = 0;
+
+    memcpy_P(&chargingParms, &defaultCPS[0], sizeof(tCPS));
+    chargingParms.ACPT_BAT_V_SETPOINT = 14.4;
+    chargingParms.CELL_TAPER_MV = 3450;
+    chargingParms.CELL_MAX_MV = 3550;
+    chargingParms.BALANCE_AMPS = 10;
+    systemVoltMult = 1.0;
+    systemAmpMult = 1.0;
+    compile_CPS();
+
+    systemConfig.ALT_AMPS_LIMIT = 100;
+    systemConfig.ALT_AMP_DERATE_NORMAL = 1.0;
+    systemConfig.ALT_WATTS_LIMIT = -1;
+    systemConfig.ALT_PULLBACK_FACTOR = 0;
+    altCapAmps = 100;
+    measuredRPMs = 0;
+    thresholdPWMvalue = 0;
+    measuredAltTemp = 50;
+    measuredBatTemp = -99;
+    requiredSensorsFlag = 0;
+    smallAltMode = false;
+    thermalAmpsCap = -1;
+    faultCode = 0;
+    chargingState = bulk_charge;
+}
+
+static void test_frames(void)
+{
+    static const uint8_t pack[4] = {0x2C, 0x33, 0x9C, 0xFF}; // 13100mV, -10.0A
+    static const uint8_t junk[5] = {0x00, 0x55, 0x7D, 0xAA, 0x01};
+
+    reset_world();
+
+    limits(14200, 800, 0);
+    CHECK_EQ(bmsFrameErrors, 0);
+    CHECK_EQ(bmsData.CVL_mV, 14200);
+    CHECK_EQ(bmsData.CCL_dA, 800);
+    CHECK_EQ(bmsData.flags, 0);
+    CHECK_EQ(bmsData.lastLimits, 1000);
+    CHECK(BMS_limits_valid());
+
+    send(BMS_MSG_PACK, pack, sizeof(pack));
+    CHECK_EQ(bmsData.packmV, 13100);
+    CHECK_EQ(bmsData.packdA, -100);
+
+    cells(3400);
+    CHECK_EQ(bmsData.cellCount, 4);
+    CHECK_EQ(bmsData.cellmV[1], 3400);
+    CHECK(BMS_cells_valid());
+    CHECK_EQ(BMS_cell_max(), 3400);
+    CHECK_EQ(BMS_cell_spread(), 110);
+
+    //---  Bad ones:  thrown away, counted, and bmsData left as it was.
+    uint8_t p[BMS_MAX_PAYLOAD + 1] = {0x10, 0x27, 0x64, 0x00, 0x00}; // (10000mV, 10.0A)
+
+    send(BMS_MSG_LIMITS, p, 5, 0x0100); //                        Bad CRC
+    CHECK_EQ(bmsFrameErrors, 1);
+    CHECK_EQ(bmsData.CVL_mV, 14200);
+    send(BMS_MSG_LIMITS, p, 4); //                                 Too short for a LIMITS frame
+    CHECK_EQ(bmsFrameErrors, 2);
+    CHECK_EQ(bmsData.CVL_mV, 14200);
+    send(BMS_MSG_LIMITS, p, 6); //                                 Too long
+    CHECK_EQ(bmsFrameErrors, 3);
+    p[0] = 5; //                                                     5 cells, but only 4 sent
+    send(BMS_MSG_CELLS, p, 9);
+    CHECK_EQ(bmsFrameErrors, 4);
+    CHECK_EQ(bmsData.cellCount, 4);
+    p[0] = BMS_MAX_CELLS + 1;
+    send(BMS_MSG_CELLS, p, 1);
+    CHECK_EQ(bmsFrameErrors, 5);
+    send(0x55, p, 2); //                                            Type we do not know
+    CHECK_EQ(bmsFrameErrors, 6);
+    send(BMS_MSG_DISCONNECT, p, BMS_MAX_PAYLOAD + 1); //            Longer than any frame can be
+    CHECK_EQ(bmsFrameErrors, 7);
+    CHECK_EQ(bmsData.flags, 0);
+
+    //---  Resync:  Line noise, then a frame cut off part way and a good one right behind it.
+    receive(junk, sizeof(junk));
+    CHECK_EQ(bmsFrameErrors, 7); //   (No START, nothing to count)
+    build(BMS_MSG_LIMITS, p, 5);
+    receive(frame, 3); //              START, TYPE, LEN - and then the BMS restarts ..
+    limits(14000, 600, 0);
+    CHECK_EQ(bmsFrameErrors, 8); //    .. so the cut off one fails its CRC, taking bytes of the next with it.
+    CHECK_EQ(bmsData.CVL_mV, 14200);
+    limits(14000, 600, 0); //          The parser is back in step for the one after.
+    CHECK_EQ(bmsFrameErrors, 8);
+    CHECK_EQ(bmsData.CVL_mV, 14000);
+    CHECK_EQ(bmsData.CCL_dA, 600);
+    receive(junk, sizeof(junk));
+    limits(10000, 100, 0); //          Junk straight into a good frame
+    CHECK_EQ(bmsData.CVL_mV, 10000);
+    CHECK_EQ(bmsData.CCL_dA, 100);
+    CHECK_EQ(bmsFrameErrors, 8);
+}
+
+static void test_bytes_per_pass(void)
+{
+    uint8_t burst[BMS_MAX_BYTES_PER_PASS + 8];
+    size_t n;
+
+    reset_world();
+    n = build(BMS_MSG_DISCONNECT, NULL, 0);
+    memset(burst, 0, sizeof(burst));
+    memcpy(burst + BMS_MAX_BYTES_PER_PASS + 1, frame, n); //   A DISCONNECT that lands just past what one pass takes
+
+    BMS_SERIAL_PORT.host_receive(burst, BMS_MAX_BYTES_PER_PASS + 1 + n);
+    manage_BMS();
+    CHECK_EQ(BMS_SERIAL_PORT.available(), 1 + n);
+    CHECK_EQ(chargingState, bulk_charge);
+    manage_BMS();
+    CHECK_EQ(BMS_SERIAL_PORT.available(), 0);
+    CHECK_EQ(chargingState, LIFEPO_FORCED_SHUTDOWN);
+}
+
+static void test_limits(void)
+{
+    reset_world();
+    calculate_ALT_targets();
+    CHECK(fabs(targetBatVolts - 14.4) < 0.001); //  The Charge Profile alone
+    CHECK(fabs(targetAltAmps - 100) < 0.001);
+
+    limits(14100, 455, 0);
+    calculate_ALT_targets();
+    CHECK(fabs(targetBatVolts - 14.1) < 0.001); //  Capped by the BMS
+    CHECK(fabs(targetAltAmps - 45.5) < 0.001);
+
+    limits(14600, 1500, 0); //                      Higher than the Charge Profile, which then wins
+    calculate_ALT_targets();
+    CHECK(fabs(targetBatVolts - 14.4) < 0.001);
+    CHECK(fabs(targetAltAmps - 100) < 0.001);
+
+    limits(14100, 455, BMS_FLAG_NO_CHARGE);
+    calculate_ALT_targets();
+    CHECK_EQ(targetAltAmps, 0);
+    CHECK_EQ(chargingState, bulk_charge); //        (Asking for no charge is not a disconnect)
+
+    host_advance(BMS_LIMITS_TIMEOUT - 1); //        BMS gone quiet ..
+    calculate_ALT_targets();
+    CHECK_EQ(targetAltAmps, 0);
+    host_advance(1); //                             .. for long enough:  back to the Charge Profile
+    CHECK(!BMS_limits_valid());
+    calculate_ALT_targets();
+    CHECK(fabs(targetBatVolts - 14.4) < 0.001);
+    CHECK(fabs(targetAltAmps - 100) < 0.001);
+}
+
+static void test_shutdown(void)
+{
+    uint8_t reason = 1;
+
+    reset_world();
+    CHECK_EQ(hostPinOut[ALARM_PIN], LOW);
+
+    limits(14200, 800, BMS_FLAG_DISCONNECT); //   Warning via the LIMITS flags
+    CHECK_EQ(chargingState, LIFEPO_FORCED_SHUTDOWN);
+    CHECK_EQ(fieldPWMvalue, 0);
+    CHECK_EQ(hostPinOut[ALARM_PIN], HIGH);
+    manage_BMS();
+    CHECK_EQ(chargingState, LIFEPO_FORCED_SHUTDOWN);
+
+    limits(14200, 800, 0); //                     Cleared
+    CHECK_EQ(chargingState, ramping);
+    CHECK_EQ(hostPinOut[ALARM_PIN], LOW);
+
+    send(BMS_MSG_DISCONNECT, &reason, 1); //      Warning via a DISCONNECT frame, held until a LIMITS frame clears it
+    CHECK_EQ(chargingState, LIFEPO_FORCED_SHUTDOWN);
+    CHECK_EQ(hostPinOut[ALARM_PIN], HIGH);
+    cells(3400);
+    CHECK_EQ(chargingState, LIFEPO_FORCED_SHUTDOWN);
+    limits(14200, 800, 0);
+    CHECK_EQ(chargingState, ramping);
+
+    chargingState = FAULTED; //                    A FAULT is left as it is
+    limits(14200, 800, BMS_FLAG_DISCONNECT);
+    CHECK_EQ(chargingState, FAULTED);
+    limits(14200, 800, 0);
+    CHECK_EQ(chargingState, FAULTED);
+
+    //---  The alarm pin is shared with Force-to-Float:  clearing the BMS warning leaves it on while that is.
+    chargingState = forced_float_charge;
+    digitalWrite(ALARM_PIN, HIGH); //              (As handle_feature_in() does)
+    for (int i = 0; i < 5; i++)
+        manage_BMS();
+    CHECK_EQ(hostPinOut[ALARM_PIN], HIGH); //      Not turned off every pass
+    limits(14200, 800, BMS_FLAG_DISCONNECT);
+    CHECK_EQ(hostPinOut[ALARM_PIN], HIGH);
+    chargingState = forced_float_charge;
+    limits(14200, 800, 0);
+    CHECK_EQ(hostPinOut[ALARM_PIN], HIGH);
+    chargingState = bulk_charge; //                Force-to-Float ends, the BMS does not touch the pin until its warning changes
+    manage_BMS();
+    CHECK_EQ(hostPinOut[ALARM_PIN], HIGH);
+}
+
+//----  Target Amps with the highest cell at mV.
+static float cell_amps(uint16_t mV)
+{
+    cells(mV);
+    limits(15000, 2000, 0); //  (Keeps the BMS limits valid, but out of the way)
+    calculate_ALT_targets();
+    return (targetAltAmps);
+}
+
+static void test_cells(void)
+{
+    reset_world();
+
+    CHECK(fabs(cell_amps(3400) - 100) < 0.01); //  Below CELL_TAPER_MV
+    CHECK(fabs(cell_amps(3450) - 100) < 0.01);
+    CHECK(fabs(cell_amps(3500) - 55) < 0.01); //   Half-way to CELL_MAX_MV:  half-way down to BALANCE_AMPS
+    CHECK(fabs(cell_amps(3550) - 10) < 0.01); //   At CELL_MAX_MV, held at BALANCE_AMPS ..
+    CHECK(fabs(cell_amps(3550 + CELL_OVER_MV) - 10) < 0.01);
+    CHECK(fabs(cell_amps(3551 + CELL_OVER_MV) - 0) < 0.01); // .. and cut only past CELL_OVER_MV beyond it,
+    CHECK(fabs(cell_amps(3560) - 0) < 0.01); //               .. until back down to CELL_MAX_MV.
+    CHECK(fabs(cell_amps(3551) - 0) < 0.01);
+    CHECK(fabs(cell_amps(3550) - 10) < 0.01);
+    CHECK(fabs(cell_amps(3560) - 10) < 0.01); //   (And back up again is still BALANCE_AMPS)
+
+    //---  Chatter:  a cell wandering just over CELL_MAX_MV (as it does while the BMS balances) never cuts the Amps.
+    for (int i = 0; i < 50; i++)
+        CHECK(fabs(cell_amps(3550 + ((i & 1) ? CELL_OVER_MV : 1)) - 10) < 0.01);
+}
+
+int main(void)
+{
+    test_frames();
+    test_bytes_per_pass();
+    test_limits();
+    test_shutdown();
+    test_cells();
+
+    return (test_summary("bms_serial"));
+}
@@ -0,0 +1,654 @@
+//
+//      charging_sm.cpp
+//
+//      Runs the Charging State Machine tables (SMStates[] / SMTrans[], run by run_charging_SM()) side by side with a copy of
+//      the switch (chargingState) manage_ALT() used before them, feeding both the same inputs and outside events, and checks
+//      they go through the same states, state names, Field PWM and LED patterns.
+//
+//      The exits added after the tables (State of Charge, fitted taper, BMS cell balancing) are compiled out of Alternator.cpp
+//      here, as the old switch never had them - what is being checked is that moving to the tables changed nothing.
+//
+
+#include "Config.h"
+#include "System.h"
+#include "LED.h"
+#include "Alternator.h"
+#include "OSEnergy_Serial.h"
+#include "Sensors.h"
+#include "FeedForward.h"
+#include "GainSchedule.h"
+#include "ThermalModel.h"
+#include "SOC.h"
+#include "Taper.h"
+#include "BMS_SERIAL.h"
+#include "Flash.h"
+
+#undef USE_SOC_ESTIMATOR // (Headers above are already in, so only the code in Alternator.cpp loses these)
+#undef USE_TAPER_EXIT
+#undef USE_BMS_SERIAL_IN
+#include "Alternator.cpp" // For run_charging_SM(), and the statics it works on
+
+#include "HostTest.h"
+
+extern unsigned LEDPattern;
+extern unsigned LEDBitMask;
+extern unsigned LEDTiming;
+extern bool LEDFOMirror;
+
+//----  The switch from manage_ALT() before the tables, as it was.  Returns TRUE where it did a 'return' out of manage_ALT(),
+//      and puts the state name in refName[] where it used to point chargingStateString.
+//
+//      The one change:  Volts and Amps are compared on the 1mV / 0.1A grid compile_CPS() has since put the thresholds on,
+//      which (by design) moves an exit by up to 0.5mV / 0.05A.  Without it the two would differ there, and not because of the tables.
+#define ON_GRID_V(v) TO_mV(v)
+#define ON_GRID_A(a) TO_dA(a)
+
+static char refName[12];
+
+static bool ref_charging_SM(void)
+{
+    switch (chargingState)
+    {
+    case warm_up:
+        strcpy(refName, "WARMUP     ");
+
+        if ((tachMode) && (systemConfig.FIELD_TACH_PWM > 0))
+            fieldPWMvalue = systemConfig.FIELD_TACH_PWM;
+        else
+            fieldPWMvalue = FIELD_PWM_MIN;
+
+        PWMError = 0;
+
+        inChargingStateCount = (uint32_t)systemConfig.ENGINE_WARMUP_DURATION - int((enteredMills - altModeChanged) / 1000UL);
+
+        if (((enteredMills - altModeChanged) > ((uint32_t)systemConfig.ENGINE_WARMUP_DURATION * 1000UL)) &&
+            !((tachMode) && (systemConfig.FIELD_TACH_PWM > 0) && (measuredRPMs == 0)))
+            set_charging_mode(ramping);
+
+        break;
+
+    case ramping:
+        strcpy(refName, "RAMPING    ");
+
+        persistentBatAmps = measuredBatAmps;
+        persistentBatVolts = measuredBatVolts;
+        reset_run_summary();
+
+        inChargingStateCount = int(((PWM_RAMP_RATE * FIELD_PWM_MAX / PWM_CHANGE_CAP) - (enteredMills - altModeChanged)) / 1000UL);
+
+        if (systemConfig.ALT_AMPS_LIMIT != -1)
+        {
+            altCapAmps = systemConfig.ALT_AMPS_LIMIT;
+            altCapRPMs = 0;
+        }
+
+        if ((fieldPWMvalue >= fieldPWMLimit) ||
+            (atTargVoltage) ||
+            (errorA >= 0) ||
+            (errorW >= 0) ||
+            ((enteredMills - altModeChanged) >= PWM_RAMP_RATE * FIELD_PWM_MAX / PWM_CHANGE_CAP)
+#ifdef ENABLE_FEATURE_IN_SCUBA
+            ||
+            ((scubaMode) && (fieldPWMvalue >= FIELD_PWM_SCUBA))
+#endif
+        )
+        {
+            if ((systemConfig.ALT_AMPS_LIMIT == -1) && (ALT_cap_sample_needed()))
+                set_charging_mode(determine_ALT_cap);
+            else
+                set_charging_mode(bulk_charge);
+        }
+        else
+        {
+            if ((enteredMills - lastPWMChanged) <= PWM_RAMP_RATE)
+                return (true);
+        }
+
+        break;
+
+    case determine_ALT_cap:
+        strcpy(refName, "DET ALT CAP");
+
+        if ((systemConfig.ALT_AMPS_LIMIT != -1) ||
+            (fieldPWMvalue == FIELD_PWM_MAX) ||
+            (atTargVoltage) ||
+            (measuredRPMs == 0) ||
+            (shuntAltAmpsMeasured == false) ||
+            ((enteredMills - altModeChanged) >= SAMPLE_ALT_CAP_DURATION))
+        {
+            set_charging_mode(bulk_charge);
+
+            if (altCapCurveChanged == true)
+            {
+                write_ACC_EEPROM(&altCapCurve);
+                altCapCurveChanged = false;
+            }
+        }
+
+        break;
+
+    case bulk_charge:
+        strcpy(refName, "BULK       ");
+        inChargingStateTime = (enteredMills - altModeChanged);
+
+        if (atTargVoltage)
+        {
+            adptExitAcceptDuration = (enteredMills - altModeChanged) * ADPT_ACPT_TIME_FACTOR;
+            set_charging_mode(acceptance_charge);
+        }
+
+        persistentBatAmps = measuredBatAmps;
+
+        if (((enteredMills - rampModeEntered) <= PWM_RAMP_RATE * FIELD_PWM_MAX / PWM_CHANGE_CAP) &&
+            ((enteredMills - lastPWMChanged) <= PWM_RAMP_RATE))
+            return (true);
+
+        if (systemConfig.ALT_AMPS_LIMIT != -1)
+            break;
+
+        if ((enteredMills - altModeChanged) <= SAMPLE_ALT_CAP_REST)
+            break;
+
+        if (ALT_cap_sample_needed())
+            set_charging_mode(determine_ALT_cap);
+
+        break;
+
+    case acceptance_charge:
+        strcpy(refName, "ACCEPTANCE ");
+        inChargingStateTime = uint32_t(enteredMills - altModeChanged);
+
+        if (((chargingParms.EXIT_ACPT_DURATION > 0) &&
+             ((enteredMills - altModeChanged) >= chargingParms.EXIT_ACPT_DURATION)) ||
+
+            ((chargingParms.EXIT_ACPT_AMPS == -1) &&
+             ((enteredMills - altModeChanged) >= adptExitAcceptDuration)) ||
+
+            ((chargingParms.EXIT_ACPT_AMPS > 0) &&
+             ((shuntAltAmpsMeasured == true)) &&
+             (atTargVoltage) &&
+             (ON_GRID_A(persistentBatAmps) <= ON_GRID_A(chargingParms.EXIT_ACPT_AMPS * systemAmpMult))) ||
+
+            ((chargingParms.EXIT_ACPT_DURATION == 0) && (chargingParms.EXIT_ACPT_AMPS == 0)))
+        {
+            if (chargingParms.LIMIT_OC_AMPS == 0)
+                set_charging_mode(float_charge);
+            else
+                set_charging_mode(overcharge_charge);
+        }
+        break;
+
+    case overcharge_charge:
+        strcpy(refName, "OVER CHARGE");
+
+        if (((enteredMills - altModeChanged) >= chargingParms.EXIT_OC_DURATION) ||
+            (chargingParms.LIMIT_OC_AMPS == 0) ||
+            (chargingParms.EXIT_OC_VOLTS == 0) ||
+            (atTargVoltage))
+        {
+            set_charging_mode(float_charge);
+        }
+
+        break;
+
+    case float_charge:
+        strcpy(refName, "FLOAT      ");
+
+        if ((((int32_t)chargingParms.EXIT_FLOAT_DURATION) != 0) &&
+            ((enteredMills - altModeChanged) >= chargingParms.EXIT_FLOAT_DURATION))
+        {
+            set_charging_mode(post_float);
+            fieldPWMvalue = FIELD_PWM_MIN;
+            PWMError = 0;
+        }
+
+        if (((chargingParms.FLOAT_TO_BULK_VOLTS != 0) && (ON_GRID_V(persistentBatVolts) <= ON_GRID_V(chargingParms.FLOAT_TO_BULK_VOLTS * systemVoltMult))) ||
+
+            (((shuntAltAmpsMeasured == true)) &&
+             (((chargingParms.FLOAT_TO_BULK_AMPS != 0) && (ON_GRID_A(persistentBatAmps) <= ON_GRID_A(chargingParms.FLOAT_TO_BULK_AMPS * systemAmpMult))) ||
+
+              ((chargingParms.FLOAT_TO_BULK_AHS != 0) &&
+               ((int)(((accumulatedASecs - modeChangeASecs) / 3600UL) * (ACCUMULATE_SAMPLING_RATE / 1000UL)) <= (chargingParms.FLOAT_TO_BULK_AHS * systemAmpMult))))))
+        {
+            set_charging_mode(ramping);
+        }
+        break;
+
+    case forced_float_charge:
+        strcpy(refName, "FORCE FLOAT");
+        break;
+
+    case LIFEPO_FORCED_SHUTDOWN:
+        strcpy(refName, "LIFEPO STDN");
+        fieldPWMvalue = 0;
+        break;
+
+    case post_float:
+        strcpy(refName, "POST FLOAT ");
+
+        if ((((int32_t)chargingParms.EXIT_PF_DURATION) != 0) &&
+            ((enteredMills - altModeChanged) >= chargingParms.EXIT_PF_DURATION))
+        {
+            set_charging_mode(float_charge);
+            break;
+        }
+
+        if (((chargingParms.PF_TO_BULK_VOLTS != 0.0) && (ON_GRID_V(persistentBatVolts) < ON_GRID_V(chargingParms.PF_TO_BULK_VOLTS * systemVoltMult))) ||
+            ((chargingParms.PF_TO_BULK_AHS != 0) && ((shuntAltAmpsMeasured == true)) &&
+             ((int)(((accumulatedASecs - modeChangeASecs) / 3600UL) * (ACCUMULATE_SAMPLING_RATE / 1000UL)) <= (chargingParms.PF_TO_BULK_AHS * systemAmpMult))))
+        {
+            set_charging_mode(ramping);
+            break;
+        }
+
+        fieldPWMvalue = FIELD_PWM_MIN;
+        PWMError = 0;
+
+        break;
+
+    case equalize:
+        strcpy(refName, "EQUALIZE   ");
+
+        if (((enteredMills - altModeChanged) >= chargingParms.EXIT_EQUAL_DURATION) ||
+            ((chargingParms.EXIT_EQUAL_AMPS != 0) &&
+             ((shuntAltAmpsMeasured == true)) &&
+             (atTargVoltage) &&
+             (ON_GRID_A(measuredBatAmps) <= ON_GRID_A(chargingParms.EXIT_EQUAL_AMPS * systemAmpMult))))
+        {
+            set_charging_mode(float_charge);
+        }
+
+        break;
+
+    case disabled:
+        if (chargingState == disabled)
+            strcpy(refName, "DISABLED   ");
+    case unknown:
+        if (chargingState == unknown)
+            strcpy(refName, "UNKNOWN    ");
+        PWMError = 0;
+        LEDRepeat = 0;
+        fieldPWMvalue = 0;
+        break;
+
+    case FAULTED:
+        strcpy(refName, "FAULTED    ");
+        return (true);
+
+    default:
+        strcpy(refName, "FAULTED    ");
+        chargingState = FAULTED;
+        faultCode = FC_LOG_ALT_STATE1;
+        return (true);
+    }
+
+    return (false);
+}
+
+//----  And the switch update_LED() used before the tables.
+static void ref_update_LED(void)
+{
+    switch (chargingState)
+    {
+    case ramping:
+    case determine_ALT_cap:
+    case bulk_charge:
+        blink_LED(LED_BULK, LED_RATE_NORMAL, -1, false);
+        break;
+
+    case acceptance_charge:
+        blink_LED(LED_ACCEPT, LED_RATE_NORMAL, -1, false);
+        break;
+
+    case overcharge_charge:
+        blink_LED(LED_OC, LED_RATE_SLOW, -1, false);
+        break;
+
+    case float_charge:
+    case forced_float_charge:
+    case post_float:
+        blink_LED(LED_FLOAT, LED_RATE_NORMAL, -1, false);
+        break;
+
+    case equalize:
+        blink_LED(LED_EQUALIZE, LED_RATE_FAST, -1, OUT_LAMP_MIRROR_EQUALIZE);
+        break;
+
+    default:
+        blink_LED(LED_IDLE, LED_RATE_NORMAL, -1, false);
+        break;
+    }
+}
+
+//----  Scenarios.  Each step moves the clock, optionally makes an outside change (as $FRM:, a Feature-in, the BMS, or a
+//      fault check would), sets the measurements, and runs one or more passes of the state machine.
+enum tEvent
+{
+    EV_NONE,
+    EV_MODE,        // set_charging_mode(mode)  ($FRM:, Feature-in force float / equalize)
+    EV_FAULT,       // chargingState = FAULTED  (as check_for_faults() does)
+    EV_BMS_STOP,    // BMS asking for a shutdown, as loop() handles it
+    EV_BMS_CLEAR,   //   and clearing it again
+    EV_BAD_STATE,   // chargingState holding something the state machine does not know
+    EV_SAG,         // VBat has been down at 'volts' long enough for the smoothed persistentBatVolts to get there too
+};
+
+typedef struct
+{
+    uint32_t dt; // mS since the last step
+    tEvent event;
+    tModes mode;
+    float volts; // measuredBatVolts
+    float amps;  // measuredBatAmps (and Alt Amps)
+    bool atTarget;
+    float errA; // errorA / errorW
+    int pwm;    // fieldPWMvalue going in
+    int rpms;
+    uint32_t pwmAge; // mS since the PWM was last changed
+    uint16_t passes; // Run this many passes, PASS_MS apart  (0 = 1)
+} tStep;
+
+typedef struct
+{
+    tModes state;
+    bool held;
+    int pwm;
+    int pwmError;
+    char name[12];
+    unsigned ledPattern;
+    unsigned ledRate;
+    bool ledMirror;
+} tTrace;
+
+#define MAX_PASSES 8192
+#define PASS_MS PWM_CHANGE_RATE // (As often as manage_ALT() gets a new VBat sample)
+
+static int scenarioOCAmps = 0; // LIMIT_OC_AMPS for the scenarios
+
+static void reset_world(int altAmpsLimit)
+{
+    memcpy_P(&chargingParms, &defaultCPS[0], sizeof(tCPS));
+    chargingParms.EXIT_ACPT_AMPS = 10;
+    chargingParms.EXIT_ACPT_DURATION = 2 * 3600000UL;
+    chargingParms.LIMIT_OC_AMPS = scenarioOCAmps;
+    chargingParms.EXIT_FLOAT_DURATION = 3600000UL;
+    chargingParms.FLOAT_TO_BULK_AMPS = 0;
+    chargingParms.FLOAT_TO_BULK_AHS = 0;
+    chargingParms.FLOAT_TO_BULK_VOLTS = 12.20;
+    chargingParms.EXIT_PF_DURATION = 1800000UL;
+    chargingParms.PF_TO_BULK_VOLTS = 12.50;
+    chargingParms.PF_TO_BULK_AHS = 0;
+    chargingParms.EXIT_EQUAL_DURATION = 3600000UL;
+    chargingParms.EXIT_EQUAL_AMPS = 5;
+    chargingParms.EXIT_OC_VOLTS = 15.0;
+    chargingParms.EXIT_OC_DURATION = 1800000UL;
+
+    systemVoltMult = 1.0;
+    systemAmpMult = 1.0;
+    compile_CPS();
+
+    systemConfig.ENGINE_WARMUP_DURATION = 30;
+    systemConfig.FIELD_TACH_PWM = -1;
+    systemConfig.ALT_AMPS_LIMIT = altAmpsLimit;
+    tachMode = false;
+    scubaMode = false;
+    fieldPWMLimit = FIELD_PWM_MAX;
+    memset(&altCapCurve, 0, sizeof(altCapCurve));
+    altCapCurveChanged = false;
+    adptExitAcceptDuration = 4 * 3600000UL;
+
+    hostMillis = 1000;
+    chargingState = unknown;
+    faultCode = 0;
+    measuredAltAmps = 0;
+    accumulatedASecs = 0;
+    modeChangeASecs = 0;
+    persistentBatAmps = 0;
+    persistentBatVolts = 0;
+    set_charging_mode(warm_up);
+}
+
+static int run_scenario(const tStep *steps, int n, int altAmpsLimit, bool tables, tTrace *trace, int *lastPass)
+{
+    int p = 0;
+
+    reset_world(altAmpsLimit);
+
+    for (int i = 0; i < n; i++)
+    {
+        const tStep *s = &steps[i];
+        host_advance(s->dt);
+
+        switch (s->event)
+        {
+        case EV_MODE:
+            set_charging_mode(s->mode);
+            break;
+        case EV_FAULT:
+            chargingState = FAULTED;
+            break;
+        case EV_BMS_STOP:
+            if ((chargingState != LIFEPO_FORCED_SHUTDOWN) && (chargingState != FAULTED))
+            {
+                set_charging_mode(LIFEPO_FORCED_SHUTDOWN);
+                fieldPWMvalue = 0;
+            }
+            break;
+        case EV_BMS_CLEAR:
+            if (chargingState == LIFEPO_FORCED_SHUTDOWN)
+                set_charging_mode(ramping);
+            break;
+        case EV_BAD_STATE:
+            chargingState = FAULTED_REDUCED_LOAD;
+            break;
+        case EV_SAG:
+            persistentBatVolts = s->volts;
+            break;
+        default:
+            break;
+        }
+
+        for (int k = 0; k < max((int)s->passes, 1); k++, p++)
+        {
+            if (k != 0)
+                host_advance(PASS_MS);
+
+            measuredBatVolts = s->volts; // What manage_ALT() has worked out before it gets to the state machine
+            measuredBatAmps = s->amps;
+            measuredAltAmps = s->amps;
+            shuntAltAmpsMeasured = true;
+            atTargVoltage = s->atTarget;
+            errorA = s->errA;
+            errorW = s->errA;
+            fieldPWMvalue = (s->pwm >= 0) ? s->pwm : fieldPWMvalue;
+            measuredRPMs = s->rpms;
+            lastPWMChanged = millis() - s->pwmAge;
+            PWMError = 3;
+            enteredMills = millis();
+
+            if (measuredBatAmps >= persistentBatAmps)
+                persistentBatAmps = measuredBatAmps;
+            else if (measuredBatAmps > 0.0)
+                persistentBatAmps = (((persistentBatAmps * (float)(AMPS_PERSISTENCE_FACTOR - 1L)) + measuredBatAmps) / AMPS_PERSISTENCE_FACTOR);
+
+            if (measuredBatVolts >= persistentBatVolts)
+                persistentBatVolts = measuredBatVolts;
+            else
+                persistentBatVolts = (((persistentBatVolts * (float)(VOLTS_PERSISTENCE_FACTOR - 1)) + measuredBatVolts) / VOLTS_PERSISTENCE_FACTOR);
+
+            persistentBatmV = TO_mV(persistentBatVolts);
+            persistentBatdA = TO_dA(persistentBatAmps);
+            measuredBatdA = TO_dA(measuredBatAmps);
+
+            trace[p].held = tables ? run_charging_SM() : ref_charging_SM();
+            trace[p].state = chargingState;
+            trace[p].pwm = fieldPWMvalue;
+            trace[p].pwmError = PWMError;
+            strcpy(trace[p].name, tables ? chargingStateName : refName);
+
+            LEDRepeat = 0; // Let the current pattern finish, and see what is picked next
+            LEDBitMask = 0;
+            if (tables)
+                update_LED();
+            else
+                ref_update_LED();
+            trace[p].ledPattern = LEDPattern;
+            trace[p].ledRate = LEDTiming;
+            trace[p].ledMirror = LEDFOMirror;
+        }
+        lastPass[i] = p - 1;
+    }
+    return (p);
+}
+
+static void check_scenario(const char *name, const tStep *steps, int n, int altAmpsLimit, const tModes *expect)
+{
+    static tTrace oldT[MAX_PASSES], newT[MAX_PASSES];
+    int lastPass[64];
+    int passes;
+
+    passes = run_scenario(steps, n, altAmpsLimit, false, oldT, lastPass);
+    CHECK_EQ(run_scenario(steps, n, altAmpsLimit, true, newT, lastPass), passes);
+
+    for (int i = 0; i < passes; i++)
+    {
+        int before = htFailures;
+
+        CHECK_EQ(newT[i].state, oldT[i].state);
+        CHECK_EQ(newT[i].held, oldT[i].held);
+        CHECK_EQ(newT[i].pwm, oldT[i].pwm);
+        CHECK_EQ(newT[i].pwmError, oldT[i].pwmError);
+        CHECK_STR(newT[i].name, oldT[i].name);
+        CHECK_EQ(newT[i].ledPattern, oldT[i].ledPattern);
+        CHECK_EQ(newT[i].ledRate, oldT[i].ledRate);
+        CHECK_EQ(newT[i].ledMirror, oldT[i].ledMirror);
+
+        if (htFailures != before)
+            printf("    ... in scenario '%s', pass %d\n", name, i);
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        int before = htFailures;
+
+        CHECK_EQ(newT[lastPass[i]].state, expect[i]); // (And make sure the scenario really goes where it is meant to)
+        if (htFailures != before)
+            printf("    ... in scenario '%s', step %d\n", name, i);
+    }
+}
+
+#define N(a) ((int)(sizeof(a) / sizeof(a[0])))
+#define MIN_ 60000UL
+#define HR_ 3600000UL
+
+int main()
+{
+    //---  Warm-up, ramp, bulk, acceptance (by Amps), float, post-float (by time), back to float, and a load pulling it back to ramping.
+    static const tStep normal[] = {
+        {1000, EV_NONE, unknown, 12.4, 0, false, -50, 0, 1500, 60000},          // Warming up
+        {30000, EV_NONE, unknown, 12.4, 0, false, -50, 0, 1500, 60000},         //   done
+        {200, EV_NONE, unknown, 12.5, 20, false, -50, 40, 1500, 100},           // Ramping, PWM just changed - hold
+        {200, EV_NONE, unknown, 12.6, 40, false, -50, 60, 1500, 60000},         //   still ramping
+        {200, EV_NONE, unknown, 12.7, 60, false, 5, 80, 1500, 60000},           //   reached terminal Amps - on to bulk
+        {10 * MIN_, EV_NONE, unknown, 13.5, 80, false, -5, 120, 1500, 60000},   // Bulk
+        {20 * MIN_, EV_NONE, unknown, 14.4, 60, true, -5, 120, 1500, 60000},    //   volts reached - acceptance
+        {10 * MIN_, EV_NONE, unknown, 14.4, 30, true, -5, 100, 1500, 60000},    // Acceptance
+        {10 * MIN_, EV_NONE, unknown, 14.4, 12, false, -5, 90, 1500, 60000},    //   low amps, but not at voltage
+        {1 * MIN_, EV_NONE, unknown, 14.4, 2, true, -5, 90, 1500, 60000},       //   low amps at voltage (persistent Amps still high)
+        {1 * MIN_, EV_NONE, unknown, 14.4, 2, true, -5, 90, 1500, 60000, 600},  //   persistent Amps down too - float
+        {1 * MIN_, EV_NONE, unknown, 13.4, 2, true, -5, 60, 1500, 60000},       // Float
+        {HR_, EV_NONE, unknown, 13.4, 1, true, -5, 60, 1500, 60000},            //   long enough - post float
+        {10 * MIN_, EV_NONE, unknown, 13.0, 0, false, -5, 60, 1500, 60000},     // Post float, field off
+        {25 * MIN_, EV_NONE, unknown, 12.9, 0, false, -5, 0, 1500, 60000},      //   long enough - float
+        {1 * MIN_, EV_NONE, unknown, 13.3, 3, true, -5, 50, 1500, 60000},       // Float
+        {1 * MIN_, EV_NONE, unknown, 11.8, 3, false, -5, 50, 1500, 60000, 800}, //   big load, volts down - ramp
+        {1 * MIN_, EV_NONE, unknown, 12.4, 60, false, -5, 60, 1500, 60000},     // Ramping
+        {1 * MIN_, EV_NONE, unknown, 12.4, 60, false, -5, -1, 1500, 60000}};    //   and on to bulk
+    static const tModes normalExp[] = {warm_up, ramping, ramping, ramping, bulk_charge, bulk_charge, acceptance_charge,
+                                       acceptance_charge, acceptance_charge, acceptance_charge, float_charge,
+                                       float_charge, post_float, post_float, float_charge, float_charge, ramping, bulk_charge, bulk_charge};
+
+    //---  Acceptance cut short by time, float pulled back by volts just as its time runs out, and post-float pulled back by volts.
+    static const tStep restart[] = {
+        {31000, EV_NONE, unknown, 12.4, 0, false, -50, 0, 1500, 60000},
+        {1000, EV_NONE, unknown, 12.7, 60, false, 5, 80, 1500, 60000},          // Ramp --> Bulk
+        {1000, EV_NONE, unknown, 14.4, 60, true, -5, 120, 1500, 60000},         // Bulk --> Accept
+        {2 * HR_, EV_NONE, unknown, 14.4, 40, true, -5, 120, 1500, 60000},      // Accept, by time --> Float
+        {HR_, EV_SAG, unknown, 11.0, 0, false, -5, 70, 1500, 60000},            // Float, out of time AND low volts --> ramp
+        {1 * MIN_, EV_NONE, unknown, 12.4, 20, false, -50, 70, 1500, 60000},    //   ramp done --> Bulk
+        {1000, EV_NONE, unknown, 14.4, 20, true, -50, 70, 1500, 60000},
+        {1000, EV_NONE, unknown, 14.4, 20, true, -50, 70, 1500, 60000},
+        {3 * HR_, EV_NONE, unknown, 13.4, 0, true, -5, 60, 1500, 60000},
+        {HR_, EV_NONE, unknown, 13.4, 0, true, -5, 60, 1500, 60000},            // --> Post float
+        {1000, EV_NONE, unknown, 12.0, 0, false, -5, 0, 1500, 60000},           // Post float, volts falling
+        {1000, EV_NONE, unknown, 12.0, 0, false, -5, 0, 1500, 60000, 600}};     //   far enough --> ramp
+    static const tModes restartExp[] = {ramping, bulk_charge, acceptance_charge, float_charge, ramping, bulk_charge,
+                                        acceptance_charge, acceptance_charge, float_charge, post_float, post_float, ramping};
+
+    //---  Forced float, and equalize (by Amps and by time), from the outside
+    static const tStep forced[] = {
+        {31000, EV_NONE, unknown, 12.4, 0, false, -50, 0, 1500, 60000},
+        {1000, EV_NONE, unknown, 12.7, 60, false, 5, 80, 1500, 60000},                      // Bulk
+        {1000, EV_MODE, forced_float_charge, 12.8, 60, false, -5, 80, 1500, 60000},         // Feature-in: force to float
+        {HR_, EV_NONE, unknown, 11.0, 0, false, -5, 80, 1500, 60000},                       //   stays there whatever
+        {1000, EV_MODE, float_charge, 13.4, 5, true, -5, 60, 1500, 60000},                  //   released
+        {1000, EV_MODE, equalize, 15.0, 20, false, -5, 100, 1500, 60000},                   // $FRM: equalize
+        {10 * MIN_, EV_NONE, unknown, 15.5, 8, true, -5, 100, 1500, 60000},
+        {10 * MIN_, EV_NONE, unknown, 15.5, 4, true, -5, 100, 1500, 60000},                 //   amps low at voltage --> float
+        {1000, EV_MODE, equalize, 15.0, 20, false, -5, 100, 1500, 60000},
+        {HR_, EV_NONE, unknown, 15.3, 20, false, -5, 100, 1500, 60000},                     //   out of time --> float
+        {1000, EV_MODE, disabled, 13.0, 0, false, -5, 100, 1500, 60000},                    // $FRM: disable
+        {1000, EV_NONE, unknown, 13.0, 0, false, -5, 100, 1500, 60000},
+        {1000, EV_MODE, unknown, 13.0, 0, false, -5, 100, 1500, 60000}};
+    static const tModes forcedExp[] = {ramping, bulk_charge, forced_float_charge, forced_float_charge, float_charge,
+                                       equalize, equalize, float_charge, equalize, float_charge, disabled, disabled, unknown};
+
+    //---  BMS disconnect / shutdown and back, then faults (and a state the state machine does not know)
+    static const tStep bms[] = {
+        {31000, EV_NONE, unknown, 12.4, 0, false, -50, 0, 1500, 60000},
+        {1000, EV_NONE, unknown, 12.7, 60, false, 5, 80, 1500, 60000},                      // Bulk
+        {1000, EV_BMS_STOP, unknown, 13.0, 0, false, -5, 80, 1500, 60000},                  // BMS shutdown
+        {1000, EV_BMS_STOP, unknown, 13.0, 0, false, -5, 80, 1500, 60000},                  //   field stays off
+        {1000, EV_BMS_CLEAR, unknown, 13.0, 0, false, -50, 10, 1500, 100},                  //   cleared - softly via ramp
+        {1000, EV_NONE, unknown, 13.0, 40, false, 5, 40, 1500, 60000},
+        {1000, EV_FAULT, unknown, 13.0, 40, false, 5, 40, 1500, 60000},                     // Faulted - nothing moves
+        {1000, EV_BMS_STOP, unknown, 13.0, 40, false, 5, 40, 1500, 60000},                  //   not even the BMS
+        {HR_, EV_NONE, unknown, 13.0, 40, true, 5, 40, 1500, 60000},
+        {1000, EV_MODE, ramping, 13.0, 40, false, 5, 40, 1500, 60000},
+        {1000, EV_BAD_STATE, unknown, 13.0, 40, false, 5, 40, 1500, 60000}};                // --> FAULTED
+    static const tModes bmsExp[] = {ramping, bulk_charge, LIFEPO_FORCED_SHUTDOWN, LIFEPO_FORCED_SHUTDOWN, ramping,
+                                    bulk_charge, FAULTED, FAULTED, FAULTED, bulk_charge, FAULTED};
+
+    //---  Auto-sizing the alternator:  ramp into a Capacity Sample cycle, and back to bulk once it is done
+    static const tStep autoCap[] = {
+        {31000, EV_NONE, unknown, 12.4, 0, false, -50, 0, 1500, 60000},
+        {1000, EV_NONE, unknown, 12.7, 60, false, 5, 80, 1500, 60000},                      // Ramp done, RPMs not sampled --> sample
+        {1000, EV_NONE, unknown, 12.8, 90, false, -5, 150, 1500, 60000},
+        {SAMPLE_ALT_CAP_DURATION, EV_NONE, unknown, 12.9, 95, false, -5, 160, 1500, 60000}, //   long enough --> bulk
+        {1000, EV_NONE, unknown, 12.9, 95, false, -5, 160, 0, 60000},                       // No RPMs - no sample
+        {SAMPLE_ALT_CAP_REST + 1000, EV_NONE, unknown, 13.0, 95, false, -5, 160, 3000, 60000}, // Faster, rested --> sample again
+        {1000, EV_NONE, unknown, 14.4, 95, true, -5, 160, 3000, 60000}};                    //   at voltage --> bulk
+    static const tModes autoCapExp[] = {ramping, determine_ALT_cap, determine_ALT_cap, bulk_charge, bulk_charge,
+                                        determine_ALT_cap, bulk_charge};
+
+    //---  Overcharge:  acceptance on into OC, and out of it at voltage
+    static const tStep oc[] = {
+        {31000, EV_NONE, unknown, 12.4, 0, false, -50, 0, 1500, 60000},
+        {1000, EV_NONE, unknown, 12.7, 60, false, 5, 80, 1500, 60000},
+        {1000, EV_NONE, unknown, 14.4, 60, true, -5, 120, 1500, 60000},
+        {2 * HR_, EV_NONE, unknown, 14.4, 40, true, -5, 120, 1500, 60000},                  // Accept by time --> OC
+        {10 * MIN_, EV_NONE, unknown, 14.8, 3, false, -5, 120, 1500, 60000},
+        {10 * MIN_, EV_NONE, unknown, 15.0, 3, true, -5, 120, 1500, 60000}};                //   at voltage --> float
+    static const tModes ocExp[] = {ramping, bulk_charge, acceptance_charge, overcharge_charge, overcharge_charge, float_charge};
+
+    check_scenario("bulk-accept-float", normal, N(normal), 100, normalExp);
+    check_scenario("restarts", restart, N(restart), 100, restartExp);
+    check_scenario("forced float / equalize", forced, N(forced), 100, forcedExp);
+    check_scenario("BMS shutdown / faults", bms, N(bms), 100, bmsExp);
+    check_scenario("alternator auto-sizing", autoCap, N(autoCap), -1, autoCapExp);
+
+    scenarioOCAmps = 5; // (Overcharge needs turning on in the profile)
+    check_scenario("overcharge", oc, N(oc), 100, ocExp);
+
+    return (test_summary("charging_sm"));
+}
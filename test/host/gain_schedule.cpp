@@ -0,0 +1,203 @@
+//
+//      gain_schedule.cpp
+//
+//      The PID Gain Schedule  (GainSchedule.cpp, and its $GSS: / $GSR: / $RGS: commands):
+//
+//      -- gain_schedule_mult() interpolates between the 4 grid points around the RPMs and Alternator Temperature, and
+//         lands right on a grid point's multiplier there.
+//      -- Past the table's edges (either way, either axis) the edge of the table is used.
+//      -- No RPMs or no temperature sensor gives 1.0, ala the PID gains as they are.
+//      -- $GSS: changes one grid point - takes effect at once and is saved in EEPROM;  $RGS: sends back what was set;
+//         $GSR: goes back to the default.  Out of range fields are held to their range (as the other commands do), and a
+//         command missing a field, or any change when locked-out, is refused.
+//
+
+#include "Config.h"
+#include "System.h"
+#include "TxRing.h"
+#include "Flash.h"
+#include "OSEnergy_Serial.h"
+#include "GainSchedule.h"
+
+#include "HostTest.h"
+
+static char out[256];
+
+//----  A command on the USB port, and what it sent back.
+static const char *command(const char *s)
+{
+    size_t n;
+
+    Serial.host_receive(s);
+    for (int i = 0; i < 100; i++)
+        check_inbound();
+    TX_flush();
+    n = Serial.host_sent((uint8_t *)out, sizeof(out) - 1);
+    out[n] = '\0';
+    return (out);
+}
+
+//----  The grid point [r][t], as a multiplier.
+static float grid(uint8_t r, uint8_t t)
+{
+    return ((float)gainSchedule.MULT[r][t] / GS_MULT_ONE);
+}
+
+static bool near(float a, float b)
+{
+    return (fabs(a - b) < 0.0005);
+}
+
+static void test_grid_points(void)
+{
+    transfer_default_GST(&gainSchedule);
+
+    for (uint8_t r = 1; r < GS_RPM_BINS; r++) // (Row 0 is at 0 RPMs - which is the 'no RPMs' case, see below)
+        for (uint8_t t = 0; t < GS_TEMP_BINS; t++)
+            CHECK(near(gain_schedule_mult(r * GS_RPM_STEP, GS_TEMP_MIN + t * GS_TEMP_STEP), grid(r, t)));
+}
+
+static void test_interpolation(void)
+{
+    float lo, hi;
+
+    transfer_default_GST(&gainSchedule);
+
+    // Half-way both ways:  the average of the 4 grid points around it.
+    CHECK(near(gain_schedule_mult(GS_RPM_STEP / 2, GS_TEMP_MIN + GS_TEMP_STEP / 2),
+               (grid(0, 0) + grid(0, 1) + grid(1, 0) + grid(1, 1)) / 4));
+
+    // Along one axis only
+    CHECK(near(gain_schedule_mult(GS_RPM_STEP * 3 / 2, GS_TEMP_MIN), (grid(1, 0) + grid(2, 0)) / 2));
+    CHECK(near(gain_schedule_mult(GS_RPM_STEP * 2, GS_TEMP_MIN + GS_TEMP_STEP / 4), grid(2, 0) + (grid(2, 1) - grid(2, 0)) / 4));
+
+    // Anywhere else, against bilinear interpolation worked out here.
+    for (int rpm = 50; rpm < (GS_RPM_BINS - 1) * GS_RPM_STEP; rpm += 130)
+        for (int temp = GS_TEMP_MIN; temp < GS_TEMP_MIN + (GS_TEMP_BINS - 1) * GS_TEMP_STEP; temp += 7)
+        {
+            uint8_t r = rpm / GS_RPM_STEP;
+            uint8_t t = (temp - GS_TEMP_MIN) / GS_TEMP_STEP;
+            float fr = (float)(rpm - r * GS_RPM_STEP) / GS_RPM_STEP;
+            float ft = (float)(temp - GS_TEMP_MIN - t * GS_TEMP_STEP) / GS_TEMP_STEP;
+
+            lo = grid(r, t) * (1 - ft) + grid(r, t + 1) * ft;
+            hi = grid(r + 1, t) * (1 - ft) + grid(r + 1, t + 1) * ft;
+            CHECK(near(gain_schedule_mult(rpm, temp), lo * (1 - fr) + hi * fr));
+        }
+}
+
+static void test_edges(void)
+{
+    const int topRPM = (GS_RPM_BINS - 1) * GS_RPM_STEP;
+    const int topTemp = GS_TEMP_MIN + (GS_TEMP_BINS - 1) * GS_TEMP_STEP;
+
+    transfer_default_GST(&gainSchedule);
+
+    CHECK(near(gain_schedule_mult(topRPM, topTemp), grid(GS_RPM_BINS - 1, GS_TEMP_BINS - 1))); // The far corner
+    CHECK(near(gain_schedule_mult(topRPM + 5000, topTemp + 50), grid(GS_RPM_BINS - 1, GS_TEMP_BINS - 1)));
+    CHECK(near(gain_schedule_mult(topRPM * 2, GS_TEMP_MIN), grid(GS_RPM_BINS - 1, 0)));
+    CHECK(near(gain_schedule_mult(GS_RPM_STEP, -20), grid(1, 0))); // Colder than the table
+    CHECK(near(gain_schedule_mult(GS_RPM_STEP, GS_TEMP_MIN - 1), grid(1, 0)));
+    CHECK(near(gain_schedule_mult(GS_RPM_STEP, topTemp + 1), grid(1, GS_TEMP_BINS - 1)));
+    CHECK(near(gain_schedule_mult(-500, GS_TEMP_MIN), grid(0, 0))); //   Slower than 0 RPMs, ala row 0
+    CHECK(near(gain_schedule_mult(32767, 32767), grid(GS_RPM_BINS - 1, GS_TEMP_BINS - 1)));
+}
+
+static void test_fallbacks(void)
+{
+    transfer_default_GST(&gainSchedule);
+    CHECK(grid(0, 0) != 1.0); //   (So the checks below mean something)
+
+    CHECK_EQ(gain_schedule_mult(0, GS_TEMP_MIN), 1.0);    // No stator signal
+    CHECK_EQ(gain_schedule_mult(0, 200), 1.0);
+    CHECK_EQ(gain_schedule_mult(1600, -99), 1.0);         // No temperature sensor
+    CHECK_EQ(gain_schedule_mult(1600, -100), 1.0);
+    CHECK_EQ(gain_schedule_mult(0, -99), 1.0);
+    CHECK(gain_schedule_mult(800, -98) != 1.0);  //           A (very) cold one, is still a reading
+}
+
+//----  What $RGS: should send back for the schedule as it now is  (then its AOK).
+static const char *expected_PGS(void)
+{
+    static char s[256];
+    int n;
+
+    n = snprintf(s, sizeof(s), "PGS;,%d,%d,%d", GS_RPM_STEP, GS_TEMP_MIN, GS_TEMP_STEP);
+    for (uint8_t r = 0; r < GS_RPM_BINS; r++)
+    {
+        n += snprintf(s + n, sizeof(s) - n, ", ");
+        for (uint8_t t = 0; t < GS_TEMP_BINS; t++)
+        {
+            unsigned hundredths = (unsigned)((uint32_t)gainSchedule.MULT[r][t] * 100 / GS_MULT_ONE); // (Truncated, as TXW_fixed() does)
+            n += snprintf(s + n, sizeof(s) - n, ",%u.%02u", hundredths / 100, hundredths % 100);
+        }
+    }
+    snprintf(s + n, sizeof(s) - n, "\r\nAOK;\r\n");
+    return (s);
+}
+
+static void test_commands(void)
+{
+    tGST saved;
+
+    memset(hostEEPROM, 0xFF, sizeof(hostEEPROM));
+    systemConfig.CONFIG_LOCKOUT = 0;
+    initialize_GST();
+    CHECK(memcmp(&gainSchedule, &defaultGST, sizeof(tGST)) == 0); // Nothing saved, so the default
+    CHECK(!read_GST_EEPROM(&saved));
+
+    CHECK_STR(command("$RGS:\r\n"), expected_PGS());
+    CHECK_STR(out, "PGS;,800,20,40, ,1.25,1.37,1.50, ,1.25,1.31,1.37, ,1.00,1.06,1.12, ,0.75,0.81,0.87, ,0.62,0.68,0.75\r\nAOK;\r\n");
+
+    CHECK_STR(command("$GSS:2,1,1.5\r\n"), "AOK;\r\n");
+    CHECK_EQ(gainSchedule.MULT[2][1], 96);
+    CHECK(near(gain_schedule_mult(2 * GS_RPM_STEP, GS_TEMP_MIN + GS_TEMP_STEP), 1.5)); // Right away
+    CHECK_STR(command("$RGS:\r\n"), expected_PGS());
+    CHECK(strstr(out, ", ,1.00,1.50,1.12, ,") != NULL);
+
+    CHECK_STR(command("$GSS:4,2,0.1\r\n"), "AOK;\r\n"); // The ends of the range
+    CHECK_EQ(gainSchedule.MULT[4][2], 6);
+    CHECK_STR(command("$GSS:0,0,3.0\r\n"), "AOK;\r\n");
+    CHECK_EQ(gainSchedule.MULT[0][0], 192);
+    CHECK_STR(command("$RGS:\r\n"), expected_PGS());
+
+    memcpy(&saved, &gainSchedule, sizeof(tGST)); //  Saved, and back at the next Startup
+    transfer_default_GST(&gainSchedule);
+    initialize_GST();
+    CHECK(memcmp(&gainSchedule, &saved, sizeof(tGST)) == 0);
+
+    CHECK(strncmp(command("$GSS:1,1\r\n"), "AOK", 3) != 0); //     Missing one
+    CHECK(memcmp(&gainSchedule, &saved, sizeof(tGST)) == 0);
+
+    CHECK_STR(command("$GSS:9,0,1.0\r\n"), "AOK;\r\n"); //    Past the table:  held to its last row / column
+    CHECK_EQ(gainSchedule.MULT[GS_RPM_BINS - 1][0], GS_MULT_ONE);
+    CHECK_STR(command("$GSS:1,7,2.0\r\n"), "AOK;\r\n");
+    CHECK_EQ(gainSchedule.MULT[1][GS_TEMP_BINS - 1], 2 * GS_MULT_ONE);
+    CHECK_STR(command("$GSS:1,1,3.5\r\n"), "AOK;\r\n"); //    Multiplier held to 0.1 .. 3.0
+    CHECK_EQ(gainSchedule.MULT[1][1], 192);
+    CHECK_STR(command("$GSS:1,0,0.05\r\n"), "AOK;\r\n");
+    CHECK_EQ(gainSchedule.MULT[1][0], 6);
+    memcpy(&saved, &gainSchedule, sizeof(tGST));
+
+    systemConfig.CONFIG_LOCKOUT = 1;
+    CHECK(strncmp(command("$GSS:1,1,2.0\r\n"), "AOK", 3) != 0);
+    CHECK(strncmp(command("$GSR:\r\n"), "AOK", 3) != 0);
+    CHECK(memcmp(&gainSchedule, &saved, sizeof(tGST)) == 0);
+    systemConfig.CONFIG_LOCKOUT = 0;
+
+    CHECK_STR(command("$GSR:\r\n"), "AOK;\r\n"); //  Back to the default, and nothing left saved
+    CHECK(memcmp(&gainSchedule, &defaultGST, sizeof(tGST)) == 0);
+    CHECK(!read_GST_EEPROM(&saved));
+    CHECK_STR(command("$RGS:\r\n"), expected_PGS());
+}
+
+int main(void)
+{
+    test_grid_points();
+    test_interpolation();
+    test_edges();
+    test_fallbacks();
+    test_commands();
+
+    return (test_summary("gain_schedule"));
+}
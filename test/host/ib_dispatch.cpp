@@ -0,0 +1,308 @@
+//
+//      ib_dispatch.cpp
+//
+//      Inbound commands:  the IB_HASH() dispatch table, and the field parsing done as each character arrives.
+//
+//      -- Every 3 character command that could be sent (any printable characters) must find the same IBHandlers[] entry
+//         straight from its hash slot as a scan of the whole table would - so no command can be shadowed by, or mistaken
+//         for, another - and every documented command must be found.
+//      -- Commands that are too short, too long, have too many fields, time out or are cut off by a new '$' must be dropped
+//         whole, leaving nothing behind for the next one.
+//      -- The getXXX() helpers must hand back what the strtok() / atoi() / atof() versions they replaced did.  Other then:
+//         numbers past what an int holds now saturate rather then wrap, only 4 decimal places are kept, and there is no
+//         exponent ("1e3" is 1).
+//      -- And a timing of the two, for a 15 field $SCA:  (Host nS - only the ratio says anything about the AVR)
+//
+
+#include "Config.h"
+#include "System.h"
+#include "OSEnergy_Serial.cpp" // For IBHandlers[], IB_parse(), ibPorts[]
+
+#include "HostTest.h"
+
+//----  Linear scan of the table, as check_inbound() did before the hash.   Returns the slot, or -1.
+static int scan(uint8_t c0, uint8_t c1, uint8_t c2)
+{
+    for (int i = 0; i < IB_HASH_SIZE; i++)
+        if ((IBHandlers[i].command[0] != 0) && (IBHandlers[i].command[0] == (char)c0) && (IBHandlers[i].command[1] == (char)c1) &&
+            ((IBHandlers[i].command[2] == '*') || (IBHandlers[i].command[2] == (char)c2)))
+            return (i);
+    return (-1);
+}
+
+//----  The hashed lookup, as check_inbound() does it.
+static int lookup(uint8_t c0, uint8_t c1, uint8_t c2)
+{
+    tIBHandlers entry;
+    uint8_t slot = IB_HASH(c0, c1);
+
+    memcpy_P(&entry, &IBHandlers[slot], sizeof(tIBHandlers));
+    if ((entry.command[0] == (char)c0) && (entry.command[1] == (char)c1) && ((entry.command[2] == '*') || (entry.command[2] == (char)c2)))
+        return (slot);
+    return (-1);
+}
+
+static void test_hash(void)
+{
+    static const char *commands[] = {"BIN", "BKL", "BKS", "CPA", "CPB", "CPC", "CPE", "CPF", "CPO", "CPP", "CPR", "CPS",
+                                     "DLT", "EDB", "FRM", "MSR", "RAS", "RBT", "RCP", "SCA", "SCN", "SCO", "SCR", "SCT", "SUB",
+#ifdef USE_SERIAL_DISPLAY
+                                     "DRS",
+#endif
+#ifdef USE_GAIN_SCHEDULING
+                                     "GSR", "GSS", "RGS",
+#endif
+#ifdef USE_HISTORY
+                                     "HIS",
+#endif
+    };
+    int mismatches = 0, found = 0;
+
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+    {
+        int slot = lookup(commands[i][0], commands[i][1], commands[i][2]);
+        CHECK(slot >= 0);
+        if (slot < 0)
+            printf("    ... $%s: not found\n", commands[i]);
+    }
+
+    for (int i = 0; i < IB_HASH_SIZE; i++) // No two entries share their 1st two letters (else the hash could only find one of them)
+        for (int j = i + 1; j < IB_HASH_SIZE; j++)
+            if (IBHandlers[i].command[0] != 0)
+                CHECK(!((IBHandlers[i].command[0] == IBHandlers[j].command[0]) && (IBHandlers[i].command[1] == IBHandlers[j].command[1])));
+
+    for (int c0 = 0x20; c0 < 0x7F; c0++) // Everything printable, and a few that are not
+        for (int c1 = 0x20; c1 < 0x7F; c1++)
+            for (int c2 = 0x20; c2 < 0x7F; c2++)
+            {
+                int s = scan(c0, c1, c2);
+                if (s != lookup(c0, c1, c2))
+                    mismatches++;
+                if (s >= 0)
+                    found++;
+            }
+    for (int c = 0x80; c < 0x100; c++)
+        if ((scan(c, 'A', 'A') != -1) || (lookup(c, 'A', 'A') != -1) || (lookup('S', c, 'A') != -1))
+            mismatches++;
+
+    CHECK_EQ(mismatches, 0);
+    CHECK(found > 0);
+}
+
+//----  Feeds the string to the ASCII port's command buffer, returns TRUE if a command came out of it.
+static bool feed(const char *s)
+{
+    bool got = false;
+
+    Serial.host_receive(s);
+    while (Serial.available())
+        if (fill_ib_buffer(&ibPorts[0]))
+            got = true;
+    ibPort = &ibPorts[0];
+    ibBuf = ibPort->buf;
+    return (got);
+}
+
+static void test_malformed(void)
+{
+    char s[200];
+    int v;
+
+    IB_reset(&ibPorts[0], false);
+
+    CHECK(feed("$SUB:1,2\n"));
+    CHECK_STR(ibBuf, "SUB:1,2");
+
+    CHECK(!feed("$AB\n"));             // Too short to be a command
+    CHECK(!feed("no dollar\n"));        // Not a command at all
+    CHECK(!feed("$SUB:1,2,3"));        // Not finished yet ..
+    CHECK(feed("$RAS:\n"));            //   .. and a new '$' starts over, leaving nothing of it
+    CHECK_STR(ibBuf, "RAS:");
+    CHECK_EQ(ibPort->fieldCount, 0);
+
+    memset(s, 0, sizeof(s)); // Too long:  dropped whole, and the next one is fine
+    strcpy(s, "$CPA:");
+    for (int i = 5; i < (INBOUND_BUFF_SIZE + 5); i++)
+        s[i] = '1';
+    strcat(s, "\n");
+    CHECK(!feed(s));
+    CHECK(feed("$SUB:7\n"));
+    CHECK(getInt(ibBuf + 4, &v, -100, 100));
+    CHECK_EQ(v, 7);
+
+    strcpy(s, "$SCA:"); // Too many fields
+    for (int i = 0; i <= IB_MAX_FIELDS; i++)
+        strcat(s, "1,");
+    strcat(s, "\n");
+    CHECK(!feed(s));
+
+    strcpy(s, "$SCA:"); // As many as are allowed
+    for (int i = 0; i < IB_MAX_FIELDS; i++)
+        strcat(s, (i < (IB_MAX_FIELDS - 1)) ? "3," : "3");
+    strcat(s, "\n");
+    CHECK(feed(s));
+    CHECK_EQ(ibPort->fieldCount, IB_MAX_FIELDS);
+
+    CHECK(!feed("$SUB:1,2,")); // Timed out
+    host_advance(IB_BUFF_FILL_TIMEOUT + 1);
+    CHECK(!feed("3\n"));
+    CHECK(!ibPorts[0].filling);
+    CHECK(feed("$SUB:\n"));
+    CHECK_EQ(ibPort->fieldCount, 0);
+    CHECK(!getInt(ibBuf + 4, &v, -100, 100)); // Nothing left behind to find
+
+    CHECK(feed("$SUB:5@"));    // '@' ends a command as well
+    CHECK_STR(ibBuf, "SUB:5");
+}
+
+//----  The helpers they replaced (less the AVR's 16-bit int - numbers are kept within that below)
+static bool old_getInt(char *buffer, int *dest, int LLim, int HLim)
+{
+    char *cp = strtok(buffer, ",");
+    if (cp == NULL)
+        return (false);
+    *dest = constrain(atoi(cp), LLim, HLim);
+    return (true);
+}
+
+static bool old_getFloat(char *buffer, float *dest, float LLim, float HLim)
+{
+    char *cp = strtok(buffer, ",");
+    if (cp == NULL)
+        return (false);
+    *dest = constrain(atof(cp), LLim, HLim);
+    return (true);
+}
+
+//----  Reads every field both ways, starting from ibBuf + at  (As the handlers do:  +4 right after the ':', or +5 past a one
+//      character selector and its ',' - ala $CPA:7,...)
+static void compare_fields(const char *fields, int at)
+{
+    char line[80], copy[80];
+    int a, b, failures = htFailures;
+    float f, g;
+    bool okA, okB;
+
+    snprintf(line, sizeof(line), (at == 4) ? "$CPA:%s\n" : "$CPA:7,%s\n", fields);
+    CHECK(feed(line));
+
+    strcpy(copy, ibBuf);
+    okA = getInt(ibBuf + at, &a, -32767, 32767);
+    okB = old_getInt(copy + at, &b, -32767, 32767);
+    while (okA && okB)
+    {
+        CHECK_EQ(a, b);
+        okA = getInt(NULL, &a, -32767, 32767);
+        okB = old_getInt(NULL, &b, -32767, 32767);
+    }
+    CHECK_EQ(okA, okB);
+
+    strcpy(copy, ibBuf);
+    okA = getFloat(ibBuf + at, &f, -10000, 10000);
+    okB = old_getFloat(copy + at, &g, -10000, 10000);
+    while (okA && okB)
+    {
+        CHECK(fabs(f - g) <= 0.00005 * max(1.0f, fabs(g)));
+        okA = getFloat(NULL, &f, -10000, 10000);
+        okB = old_getFloat(NULL, &g, -10000, 10000);
+    }
+    CHECK_EQ(okA, okB);
+
+    if (htFailures != failures)
+        printf("    ... in \"%s\"\n", line);
+}
+
+static void test_fields(void)
+{
+    static const char *cases[] = {"7,14.4,60,15", "  7, -3.25,+4,-0.5", ",,,5,,6,", "12abc,3.5x,-,.", ".5,-.25,0.0001,9999.9999",
+                                  "32767,-32767,0,1", "1.50,2.000,-0,00012", "", " ", "--5,+-5,5-,1.2.3", "\t8,9 ,1 0"};
+    uint32_t seed = 7;
+    char r[60];
+    int a;
+    float f;
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        compare_fields(cases[i], 4);
+        compare_fields(cases[i], 5);
+    }
+
+    for (int n = 0; n < 20000; n++)
+    { // Random runs of the characters that matter, up to 14 fields
+        static const char alphabet[] = "0123456789012345678901234567890123456789..,,,,--+  x";
+        int len = 0, fields = 0;
+        seed = seed * 1103515245UL + 12345UL;
+        int want = 1 + (seed >> 16) % 40;
+        while ((len < want) && (len < (int)sizeof(r) - 1))
+        {
+            seed = seed * 1103515245UL + 12345UL;
+            char c = alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+            if ((c == ',') && (++fields >= (IB_MAX_FIELDS - 2)))
+                c = '1';
+            r[len++] = c;
+        }
+        r[len] = 0;
+        bool longNum = false; // (Keep the numbers within what an int / 4 places hold, the parts where they differ are checked below)
+        for (const char *p = r; *p; p++)
+            if (strspn(p, "0123456789") > 4)
+                longNum = true;
+        if (!longNum && (strstr(r, "0x") == NULL)) // (glibc's atof() takes hex, avr-libc's does not)
+            compare_fields(r, 4);
+    }
+
+    //---  Where they part ways, on purpose.
+    CHECK(feed("$CPA:99999999,1.23456,1e3\n"));
+    CHECK(getInt(ibBuf + 4, &a, -32767, 32767));
+    CHECK_EQ(a, 32767); // Saturates  (atoi() wrapped)
+    CHECK(getFloat(NULL, &f, -10000, 10000));
+    CHECK(fabs(f - 1.2345f) < 0.00001); // 4 places
+    CHECK(getFloat(NULL, &f, -10000, 10000));
+    CHECK_EQ(f, 1.0f); // No exponent
+}
+
+static void test_timing(void)
+{
+    const char *sca = "SCA:1,75,80,60,40,3,0,-1,12,2.50,500,500,0,-1,30";
+    char buf[INBOUND_BUFF_SIZE + 1];
+    volatile float sink = 0;
+    float f;
+
+    double tNew = BENCH_NS(100000, {
+        tIBPort *p = &ibPorts[0];
+        IB_reset(p, true);
+        for (const char *c = sca; *c; c++)
+        {
+            IB_parse(p, *c);
+            p->buf[p->index++] = *c;
+        }
+        p->buf[p->index] = 0;
+        ibPort = p;
+        ibBuf = p->buf;
+        getFloat(ibBuf + 5, &f, -1000, 1000);
+        sink += f;
+        while (getFloat(NULL, &f, -1000, 1000))
+            sink += f;
+    });
+
+    double tOld = BENCH_NS(100000, {
+        uint8_t n = 0;
+        for (const char *c = sca; *c; c++)
+            buf[n++] = *c;
+        buf[n] = 0;
+        old_getFloat(buf + 5, &f, -1000, 1000);
+        sink += f;
+        while (old_getFloat(NULL, &f, -1000, 1000))
+            sink += f;
+    });
+
+    printf("15 field $SCA:  strtok / atof: %.0f nS,  parsed as it arrives: %.0f nS\n", tOld, tNew);
+}
+
+int main(void)
+{
+    test_hash();
+    test_malformed();
+    test_fields();
+    test_timing();
+    return (test_summary("ib_dispatch"));
+}
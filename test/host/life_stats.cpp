@@ -0,0 +1,122 @@
+//
+//      life_stats.cpp
+//
+//      The Lifetime statistics (tLIFE) are kept in EEPROM:
+//
+//      -- They are loaded at Startup (initialize_sensors()), counting the restart, and start over only if none were saved
+//         or what was saved does not check out.
+//      -- checkpoint_LIFE() saves them every LIFE_CHECKPOINT_PERIOD, and not in between.
+//      -- A FAULT is saved at once - but the same FAULT again within LIFE_CHECKPOINT_PERIOD (a FAULT restart loop) is not.
+//      -- They lie past the Config Backup staging area, and saving them leaves it alone.
+//
+
+#include "Config.h"
+#include "System.h"
+#include "Sensors.h"
+#include "Flash.h"
+
+#include "HostTest.h"
+
+//----  Power cut and back on:  RAM is lost, the EEPROM is not.
+static void power_cycle(void)
+{
+    memset(&lifeStats, 0xA5, sizeof(lifeStats));
+    initialize_sensors();
+}
+
+static void test_startup(void)
+{
+    memset(hostEEPROM, 0xFF, sizeof(hostEEPROM));
+    power_cycle();
+    CHECK_EQ(lifeStats.restarts, 0); // Nothing saved, started over
+    CHECK_EQ(lifeStats.upSecs, 0);
+    CHECK_EQ(lifeStats.faults, 0);
+
+    lifeStats.upSecs = 5000;
+    lifeStats.AHs = 1234;
+    write_LIFE_EEPROM(&lifeStats);
+    power_cycle();
+    CHECK_EQ(lifeStats.restarts, 1);
+    CHECK_EQ(lifeStats.upSecs, 5000);
+    CHECK_EQ(lifeStats.AHs, 1234);
+
+    hostEEPROM[LIFE_FLASH_LOCATION + sizeof(tLKEY) + 3] ^= 0x10; // Damaged
+    power_cycle();
+    CHECK_EQ(lifeStats.restarts, 0);
+    CHECK_EQ(lifeStats.AHs, 0);
+}
+
+static void test_checkpoint(void)
+{
+    uint32_t writes;
+
+    checkpoint_LIFE(); // (Start its period from now)
+    host_advance(LIFE_CHECKPOINT_PERIOD);
+    checkpoint_LIFE();
+
+    lifeStats.upSecs += 60;
+    writes = hostEEPROMWrites;
+    host_advance(LIFE_CHECKPOINT_PERIOD - 1);
+    checkpoint_LIFE();
+    CHECK_EQ(hostEEPROMWrites, writes); // Not yet
+    host_advance(1);
+    checkpoint_LIFE();
+    CHECK(hostEEPROMWrites > writes);
+
+    power_cycle();
+    CHECK_EQ(lifeStats.upSecs, 60);
+}
+
+static void test_faults(void)
+{
+    uint32_t writes;
+
+    lifeStats.upSecs = 10000;
+    writes = hostEEPROMWrites;
+    log_fault(FC_SYS_FET_TEMP);
+    CHECK(hostEEPROMWrites > writes);
+    power_cycle();
+    CHECK_EQ(lifeStats.faults, 1);
+    CHECK_EQ(lifeStats.faultCode[0], FC_SYS_FET_TEMP);
+    CHECK_EQ(lifeStats.faultSecs[0], 10000);
+
+    //---  The same one, restarting the regulator every few seconds:  saved the once.
+    lifeStats.upSecs += 5;
+    writes = hostEEPROMWrites;
+    log_fault(FC_SYS_FET_TEMP);
+    CHECK_EQ(hostEEPROMWrites, writes);
+    CHECK_EQ(lifeStats.faults, 2); // (Still counted)
+
+    //---  A different one is saved, as is the same one after LIFE_CHECKPOINT_PERIOD.
+    log_fault(FC_SYS_REQIRED_SENSOR);
+    CHECK(hostEEPROMWrites > writes);
+    lifeStats.upSecs += LIFE_CHECKPOINT_PERIOD / 1000UL;
+    writes = hostEEPROMWrites;
+    log_fault(FC_SYS_REQIRED_SENSOR);
+    CHECK(hostEEPROMWrites > writes);
+    power_cycle();
+    CHECK_EQ(lifeStats.faults, 4);
+    CHECK_EQ(lifeStats.faultCode[1], FC_SYS_REQIRED_SENSOR);
+    CHECK_EQ(lifeStats.faultCode[2], FC_SYS_FET_TEMP);
+}
+
+static void test_layout(void)
+{
+    uint8_t staging[STG_FLAG_LOCATION + 1];
+
+    memcpy(staging, hostEEPROM, sizeof(staging));
+    lifeStats.AHs++;
+    write_LIFE_EEPROM(&lifeStats);
+    CHECK(memcmp(staging, hostEEPROM, sizeof(staging)) == 0);
+    CHECK(LIFE_FLASH_LOCATION > STG_FLAG_LOCATION);
+}
+
+int main(void)
+{
+    test_startup();
+    test_checkpoint();
+    test_faults();
+    test_layout();
+
+    return (test_summary("life_stats"));
+}
@@ -0,0 +1,388 @@
+//
+//      modbus.cpp
+//
+//      The Modbus RTU slave's request handling, MB_process(), driven with frames as a Modbus master would send them.
+//
+//      -- CRC-16/MODBUS:  the table version must match the bit-at-a-time one, and the published check values.
+//      -- Input and Holding register reads, at and just past the ends of each range (exception 02), and bad counts (03).
+//      -- Writes:  within limits they are saved to EEPROM and read back the same, a value out of limit anywhere in a block is
+//         exception 03 with nothing saved, only the custom Charge Profiles take writes, and CONFIG_LOCKOUT gives exception 04.
+//      -- Broadcasts (address 0) are done but never answered;  damaged, short, wrongly sized and other slaves' frames are ignored.
+//
+//      The USART / Timer 5 framing (Modbus.cpp, under USE_MODBUS) is interrupt driven straight off the AVR's registers, and is not
+//      built here.
+//
+
+#include "Config.h"
+#include "System.h"
+#include "Sensors.h"
+#include "Alternator.h"
+#include "CPE.h"
+#include "Flash.h"
+#include "Modbus.h"
+
+#include "HostTest.h"
+
+#define EX_FUNCTION 0x01
+#define EX_ADDRESS 0x02
+#define EX_VALUE 0x03
+#define EX_FAILURE 0x04
+
+static uint8_t frame[MB_MAX_FRAME];
+static uint16_t rsp; // Length of the last response
+
+//----  CRC-16/MODBUS worked out a bit at a time, to check the table against.
+static uint16_t crc_bits(const uint8_t *d, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+
+    while (len--)
+    {
+        crc ^= *d++;
+        for (uint8_t b = 0; b < 8; b++)
+            crc = (crc & 1) ? ((crc >> 1) ^ 0xA001) : (crc >> 1);
+    }
+    return (crc);
+}
+
+//----  Send a request:  the passed bytes, with the CRC added.  Returns the response length, and checks its CRC.
+static uint16_t request(const uint8_t *req, uint16_t len)
+{
+    uint16_t crc;
+
+    memcpy(frame, req, len);
+    crc = MB_CRC16(frame, len);
+    frame[len++] = crc & 0xFF;
+    frame[len++] = crc >> 8;
+
+    rsp = MB_process(frame, len);
+    if (rsp != 0)
+        CHECK_EQ(MB_CRC16(frame, rsp), 0);
+    return (rsp);
+}
+
+static uint16_t read_regs(uint8_t address, uint8_t function, uint16_t start, uint16_t count)
+{
+    uint8_t req[] = {address, function, (uint8_t)(start >> 8), (uint8_t)start, (uint8_t)(count >> 8), (uint8_t)count};
+    return (request(req, sizeof(req)));
+}
+
+static uint16_t write_single(uint8_t address, uint16_t reg, uint16_t v)
+{
+    uint8_t req[] = {address, 0x06, (uint8_t)(reg >> 8), (uint8_t)reg, (uint8_t)(v >> 8), (uint8_t)v};
+    return (request(req, sizeof(req)));
+}
+
+static uint16_t write_multiple(uint8_t address, uint16_t start, const uint16_t *v, uint16_t count)
+{
+    uint8_t req[MB_MAX_FRAME];
+    uint16_t n = 0;
+
+    req[n++] = address;
+    req[n++] = 0x10;
+    req[n++] = start >> 8;
+    req[n++] = start & 0xFF;
+    req[n++] = count >> 8;
+    req[n++] = count & 0xFF;
+    req[n++] = count * 2;
+    for (uint16_t i = 0; i < count; i++)
+    {
+        req[n++] = v[i] >> 8;
+        req[n++] = v[i] & 0xFF;
+    }
+    return (request(req, n));
+}
+
+//----  Register i of the last read response.
+static uint16_t reg(uint16_t i)
+{
+    return (((uint16_t)frame[3 + (2 * i)] << 8) | frame[4 + (2 * i)]);
+}
+
+//----  Was the last response exception 'ex' to function 'function'?
+static bool exception(uint8_t function, uint8_t ex)
+{
+    return ((rsp == 5) && (frame[1] == (function | 0x80)) && (frame[2] == ex));
+}
+
+//----  Read one holding register back.
+static uint16_t holding(uint16_t r)
+{
+    read_regs(MODBUS_SLAVE_ID, 0x03, r, 1);
+    return (reg(0));
+}
+
+static void test_crc(void)
+{
+    static const uint8_t check[] = "123456789";
+    static const uint8_t req[] = {0x01, 0x03, 0x00, 0x00, 0x00, 0x0A};
+    uint8_t d[300];
+    uint32_t seed = 7;
+
+    CHECK_EQ(MB_CRC16(check, 9), 0x4B37); // The CRC-16/MODBUS check value
+    CHECK_EQ(MB_CRC16(req, sizeof(req)), 0xCDC5); //   and the usual 'read 10 registers' example, sent as C5 CD
+
+    for (int n = 0; n < 300; n++)
+    {
+        seed = seed * 1103515245UL + 12345UL;
+        d[n] = seed >> 16;
+        CHECK_EQ(MB_CRC16(d, n + 1), crc_bits(d, n + 1));
+    }
+}
+
+static void test_inputs(void)
+{
+    measuredBatVolts = 13.456;
+    measuredBatAmps = -12.3;
+    measuredAltVolts = 14.1;
+    measuredAltAmps = 85.4;
+    measuredAltWatts = 1204;
+    measuredBatTemp = -5;
+    measuredRPMs = 2100;
+    chargingState = bulk_charge;
+    accumulatedASecs = -5 * 3600L;
+    generatorLrRunTime = 70000UL * 1000UL;
+    cpIndex = 3;
+
+    CHECK_EQ(read_regs(MODBUS_SLAVE_ID, 0x04, 0, MB_INPUT_REGS), 5 + (2 * MB_INPUT_REGS)); // (Address, function, byte count, the registers, CRC)
+    CHECK_EQ(frame[0], MODBUS_SLAVE_ID);
+    CHECK_EQ(frame[1], 0x04);
+    CHECK_EQ(frame[2], 2 * MB_INPUT_REGS);
+    CHECK_EQ(reg(MB_IR_BAT_MV), 13456);
+    CHECK_EQ((int16_t)reg(MB_IR_BAT_DA), -123);
+    CHECK_EQ(reg(MB_IR_ALT_MV), 14100);
+    CHECK_EQ(reg(MB_IR_ALT_DA), 854);
+    CHECK_EQ(reg(MB_IR_ALT_WATTS), 1204);
+    CHECK_EQ((int16_t)reg(MB_IR_BAT_TEMP), -5);
+    CHECK_EQ(reg(MB_IR_RPMS), 2100);
+    CHECK_EQ(reg(MB_IR_STATE), bulk_charge);
+    CHECK_EQ(reg(MB_IR_AHS_HI), 0xFFFF); // -5 Ahs, as a signed 32 bit value
+    CHECK_EQ(reg(MB_IR_AHS_LO), 0xFFFB);
+    CHECK_EQ(reg(MB_IR_RUNTIME_HI), 70000UL >> 16);
+    CHECK_EQ(reg(MB_IR_RUNTIME_LO), 70000UL & 0xFFFF);
+    CHECK_EQ(reg(MB_IR_CP_INDEX), 4);
+
+    read_regs(MODBUS_SLAVE_ID, 0x04, MB_INPUT_REGS - 1, 1); // The last one
+    CHECK_EQ(reg(0), 4);
+    read_regs(MODBUS_SLAVE_ID, 0x04, MB_INPUT_REGS - 1, 2); //   and one past it
+    CHECK(exception(0x04, EX_ADDRESS));
+    read_regs(MODBUS_SLAVE_ID, 0x04, MB_INPUT_REGS, 1);
+    CHECK(exception(0x04, EX_ADDRESS));
+    read_regs(MODBUS_SLAVE_ID, 0x04, 0xFFFF, 1); // (start + count must not wrap)
+    CHECK(exception(0x04, EX_ADDRESS));
+    read_regs(MODBUS_SLAVE_ID, 0x04, 0, 0);
+    CHECK(exception(0x04, EX_VALUE));
+    read_regs(MODBUS_SLAVE_ID, 0x04, 0, MB_MAX_READ + 1);
+    CHECK(exception(0x04, EX_VALUE));
+}
+
+static void test_holding_reads(void)
+{
+    tCPS cps;
+    uint16_t scsRegs, cpsRegs;
+
+    //---  How many registers each range has - the first one past the end is exception 02.
+    for (scsRegs = 1; read_regs(MODBUS_SLAVE_ID, 0x03, 0, scsRegs) != 5; scsRegs++)
+        ;
+    CHECK(exception(0x03, EX_ADDRESS));
+    CHECK_EQ(scsRegs - 1, 22);
+    for (cpsRegs = 1; read_regs(MODBUS_SLAVE_ID, 0x03, MB_CPS_BASE, cpsRegs) != 5; cpsRegs++)
+        ;
+    CHECK_EQ(cpsRegs - 1, 29);
+
+    //---  The System Configuration - nothing saved yet, so what is in use.
+    systemConfig.ALT_IDLE_RPM = 950;
+    systemConfig.ALT_AMPS_LIMIT = -1;
+    systemConfig.ENGINE_ALT_DRIVE_RATIO = 2.7;
+    CHECK_EQ(read_regs(MODBUS_SLAVE_ID, 0x03, 0, 22), 5 + 44);
+    CHECK_EQ(reg(7), 950);
+    CHECK_EQ((int16_t)reg(8), -1);
+    CHECK_EQ(reg(11), 2700);
+
+    //---  Each Charge Profile, from its defaults.  Reads may not run from one range into the next.
+    for (uint8_t n = 0; n < MAX_CPES; n++)
+    {
+        transfer_default_CPS(n, &cps);
+        CHECK_EQ(read_regs(MODBUS_SLAVE_ID, 0x03, MB_CPS_BASE + (MB_CPS_STRIDE * n), 29), 5 + 58);
+        CHECK_EQ(reg(0), lround(cps.ACPT_BAT_V_SETPOINT * 1000));
+        CHECK_EQ(reg(1), cps.EXIT_ACPT_DURATION / 60000UL);
+        CHECK_EQ((int16_t)reg(9), cps.FLOAT_TO_BULK_AMPS);
+        CHECK_EQ(reg(25), cps.CELL_TAPER_MV);
+
+        read_regs(MODBUS_SLAVE_ID, 0x03, MB_CPS_BASE + (MB_CPS_STRIDE * n) + 28, 1);
+        CHECK_EQ(rsp, 7);
+        read_regs(MODBUS_SLAVE_ID, 0x03, MB_CPS_BASE + (MB_CPS_STRIDE * n) + 28, 2);
+        CHECK(exception(0x03, EX_ADDRESS));
+        read_regs(MODBUS_SLAVE_ID, 0x03, MB_CPS_BASE + (MB_CPS_STRIDE * n) + 29, 1); // (The gap up to the next profile)
+        CHECK(exception(0x03, EX_ADDRESS));
+    }
+
+    read_regs(MODBUS_SLAVE_ID, 0x03, 21, 2); // Off the end of the System Configuration
+    CHECK(exception(0x03, EX_ADDRESS));
+    read_regs(MODBUS_SLAVE_ID, 0x03, 22, 1);
+    CHECK(exception(0x03, EX_ADDRESS));
+    read_regs(MODBUS_SLAVE_ID, 0x03, MB_CPS_BASE - 1, 1);
+    CHECK(exception(0x03, EX_ADDRESS));
+    read_regs(MODBUS_SLAVE_ID, 0x03, MB_CPS_BASE + (MB_CPS_STRIDE * MAX_CPES), 1); // No such profile
+    CHECK(exception(0x03, EX_ADDRESS));
+    read_regs(MODBUS_SLAVE_ID, 0x03, 0, 0);
+    CHECK(exception(0x03, EX_VALUE));
+    read_regs(MODBUS_SLAVE_ID, 0x03, 0, MB_MAX_READ + 1);
+    CHECK(exception(0x03, EX_VALUE));
+}
+
+static void test_writes(void)
+{
+    const uint16_t custom = MB_CPS_BASE + (MB_CPS_STRIDE * (MAX_CPES - CUSTOM_CPES));
+    tSCS scs;
+    tCPS cps;
+    uint16_t v[4];
+    uint32_t writes;
+
+    //---  Write Single - echoed back, saved, and read back the same.
+    CHECK_EQ(write_single(MODBUS_SLAVE_ID, 7, 1100), 8);
+    CHECK_EQ(frame[1], 0x06);
+    CHECK_EQ((frame[2] << 8) | frame[3], 7); // (Echo:  address, function, register, value)
+    CHECK_EQ((frame[4] << 8) | frame[5], 1100);
+    CHECK(read_SCS_EEPROM(&scs));
+    CHECK_EQ(scs.ALT_IDLE_RPM, 1100);
+    CHECK_EQ(holding(7), 1100);
+    CHECK_EQ(systemConfig.ALT_IDLE_RPM, 950); // Only used after a reboot
+
+    write_single(MODBUS_SLAVE_ID, 8, (uint16_t)-1); // Signed, at its low limit
+    CHECK_EQ(rsp, 8);
+    CHECK_EQ((int16_t)holding(8), -1);
+
+    //---  Limits:  the edges go in, one past them does not - and nothing is saved.
+    write_single(MODBUS_SLAVE_ID, 7, 1500);
+    CHECK_EQ(holding(7), 1500);
+    writes = hostEEPROMWrites;
+    write_single(MODBUS_SLAVE_ID, 7, 1501);
+    CHECK(exception(0x06, EX_VALUE));
+    write_single(MODBUS_SLAVE_ID, 8, (uint16_t)-2);
+    CHECK(exception(0x06, EX_VALUE));
+    write_single(MODBUS_SLAVE_ID, 2, 14); // ALT_TEMP_SETPOINT  15..120
+    CHECK(exception(0x06, EX_VALUE));
+    CHECK_EQ(hostEEPROMWrites, writes);
+    CHECK_EQ(holding(7), 1500);
+
+    write_single(MODBUS_SLAVE_ID, 22, 0); // Past the System Configuration
+    CHECK(exception(0x06, EX_ADDRESS));
+
+    //---  Write Multiple, to a custom Charge Profile.
+    v[0] = 14400; // ACPT_BAT_V_SETPOINT, mV
+    v[1] = 90;    // EXIT_ACPT_DURATION, Minutes
+    v[2] = 5;     // EXIT_ACPT_AMPS
+    CHECK_EQ(write_multiple(MODBUS_SLAVE_ID, custom, v, 3), 8);
+    CHECK_EQ(frame[1], 0x10);
+    CHECK_EQ((frame[2] << 8) | frame[3], custom); // (Response:  address, function, start, count)
+    CHECK_EQ((frame[4] << 8) | frame[5], 3);
+    CHECK(read_CPS_EEPROM(MAX_CPES - CUSTOM_CPES, &cps));
+    CHECK(fabs(cps.ACPT_BAT_V_SETPOINT - 14.4) < 0.0001);
+    CHECK_EQ(cps.EXIT_ACPT_DURATION, 90 * 60000UL);
+    CHECK_EQ(cps.EXIT_ACPT_AMPS, 5);
+    CHECK_EQ(holding(custom), 14400);
+
+    //---  One bad value in a block, and none of it goes in.
+    writes = hostEEPROMWrites;
+    v[0] = 14000;
+    v[1] = 601; // Over 600
+    CHECK_EQ(write_multiple(MODBUS_SLAVE_ID, custom, v, 3), 5);
+    CHECK(exception(0x10, EX_VALUE));
+    CHECK_EQ(hostEEPROMWrites, writes);
+    CHECK_EQ(holding(custom), 14400);
+
+    //---  Only the custom profiles may be changed, and a block may not cross out of one.
+    v[1] = 60;
+    write_multiple(MODBUS_SLAVE_ID, custom - MB_CPS_STRIDE, v, 3);
+    CHECK(exception(0x10, EX_ADDRESS));
+    write_single(MODBUS_SLAVE_ID, MB_CPS_BASE, 14000);
+    CHECK(exception(0x06, EX_ADDRESS));
+    write_multiple(MODBUS_SLAVE_ID, custom + 27, v, 3);
+    CHECK(exception(0x10, EX_ADDRESS));
+
+    //---  The byte count must agree with the register count.
+    {
+        uint8_t req[] = {MODBUS_SLAVE_ID, 0x10, (uint8_t)(custom >> 8), (uint8_t)custom, 0, 2, 2, 0x38, 0x40};
+        request(req, sizeof(req));
+        CHECK(exception(0x10, EX_VALUE));
+    }
+    write_multiple(MODBUS_SLAVE_ID, custom, v, 0);
+    CHECK(exception(0x10, EX_VALUE));
+
+    //---  Locked out.
+    systemConfig.CONFIG_LOCKOUT = 1;
+    writes = hostEEPROMWrites;
+    write_single(MODBUS_SLAVE_ID, 7, 1000);
+    CHECK(exception(0x06, EX_FAILURE));
+    write_multiple(MODBUS_SLAVE_ID, custom, v, 3);
+    CHECK(exception(0x10, EX_FAILURE));
+    CHECK_EQ(hostEEPROMWrites, writes);
+    CHECK_EQ(holding(7), 1500); // Reads still work
+    systemConfig.CONFIG_LOCKOUT = 0;
+}
+
+static void test_framing(void)
+{
+    static const uint8_t good[] = {MODBUS_SLAVE_ID, 0x03, 0, 7, 0, 1};
+
+    //---  Broadcasts are done, but not answered.
+    CHECK_EQ(write_single(0, 7, 1234), 0);
+    CHECK_EQ(holding(7), 1234);
+    {
+        uint16_t v[1] = {800};
+        CHECK_EQ(write_multiple(0, 7, v, 1), 0);
+        CHECK_EQ(holding(7), 800);
+    }
+    CHECK_EQ(read_regs(0, 0x03, 0, 1), 0);
+    CHECK_EQ(read_regs(0, 0x2B, 0, 1), 0); //   Not even with an exception
+
+    //---  Not for us.
+    CHECK_EQ(read_regs(MODBUS_SLAVE_ID + 1, 0x03, 0, 1), 0);
+    CHECK_EQ(write_single(MODBUS_SLAVE_ID + 1, 7, 1000), 0);
+    CHECK_EQ(holding(7), 800);
+
+    //---  Damaged:  any one bit flipped anywhere (CRC included) and it is ignored.
+    for (uint16_t bit = 0; bit < 8 * 8; bit++)
+    {
+        uint16_t crc;
+
+        memcpy(frame, good, sizeof(good));
+        crc = MB_CRC16(frame, sizeof(good));
+        frame[6] = crc & 0xFF;
+        frame[7] = crc >> 8;
+        frame[bit / 8] ^= 1 << (bit % 8);
+        CHECK_EQ(MB_process(frame, 8), 0);
+    }
+
+    //---  Too short, or the wrong size for its function.
+    CHECK_EQ(request(good, 2), 0);
+    CHECK_EQ(request(good, 5), 0);
+    {
+        uint8_t longer[] = {MODBUS_SLAVE_ID, 0x03, 0, 7, 0, 1, 0};
+        CHECK_EQ(request(longer, sizeof(longer)), 0);
+        longer[1] = 0x06;
+        CHECK_EQ(request(longer, sizeof(longer)), 0);
+    }
+    CHECK_EQ(holding(7), 800);
+
+    //---  Functions not supported.
+    read_regs(MODBUS_SLAVE_ID, 0x01, 0, 1);
+    CHECK(exception(0x01, EX_FUNCTION));
+    read_regs(MODBUS_SLAVE_ID, 0x2B, 0, 1);
+    CHECK(exception(0x2B, EX_FUNCTION));
+}
+
+int main(void)
+{
+    memset(hostEEPROM, 0xFF, sizeof(hostEEPROM)); // As erased
+    systemConfig.CONFIG_LOCKOUT = 0;
+
+    test_crc();
+    test_inputs();
+    test_holding_reads();
+    test_writes();
+    test_framing();
+
+    return (test_summary("modbus"));
+}
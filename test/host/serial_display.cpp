@@ -0,0 +1,118 @@
+//
+//      serial_display.cpp
+//
+//      What the remote Serial Display is sent  (SerialDisplay.cpp):
+//
+//      -- Until it sends $DRS: it gets the "$D:<field>,<text>" lines it always has, one per field.
+//      -- $DRS: switches it to $DF: frames - which carry a <seq> that counts up, and a CRC of the frame - and asks for all the
+//         fields.  No AOK is sent back.  $DRS:1 switches to binary frames, and a bad $DRS: changes nothing.
+//
+
+#include "Config.h"
+#include "System.h"
+#include "TxRing.h"
+#include "BinTelemetry.h"
+#include "OSEnergy_Serial.h"
+#include "SerialDisplay.h"
+
+#include "HostTest.h"
+
+static char out[512];
+static size_t outLen;
+
+//----  What has gone out the display port.
+static const char *sent(void)
+{
+    TX_flush();
+    outLen = SERIAL_DISPLAY_PORT.host_sent((uint8_t *)out, sizeof(out) - 1);
+    out[outLen] = '\0';
+    return (out);
+}
+
+//----  A command from the display.
+static void command(const char *s)
+{
+    SERIAL_DISPLAY_PORT.host_receive(s);
+    for (int i = 0; i < 100; i++)
+        check_inbound();
+}
+
+//----  The $DF: frame expected for the passed content  (from the '$' up to the '*')
+static const char *frame(const char *content)
+{
+    static char f[256];
+    uint16_t crc = 0xFFFF;
+
+    for (const char *p = content; *p; p++)
+        crc = CRC16_update(crc, (uint8_t)*p);
+    snprintf(f, sizeof(f), "%s*%04X\r\n", content, crc);
+    return (f);
+}
+
+//----  Two fields, the way LCD_send_frame() sends them.
+static void two_fields(void)
+{
+    tTXWriter w;
+
+    SD_begin(&w);
+    SD_field(&w, 1);
+    TXW_str(&w, "14.20V");
+    SD_field(&w, 7);
+    TXW_str(&w, "42%");
+    CHECK(SD_end(&w));
+}
+
+static void test_lines(void)
+{
+    tTXWriter w;
+
+    CHECK(!sdFrames);
+    SD_send_text(11, REV_FORK);
+    CHECK_STR(sent(), "$D:11," REV_FORK "\r\n");
+
+    two_fields();
+    CHECK_STR(sent(), "$D:1,14.20V\r\n$D:7,42%\r\n");
+
+    SD_begin(&w); // Nothing changed, nothing sent
+    CHECK(SD_end(&w));
+    CHECK_STR(sent(), "");
+}
+
+static void test_frames(void)
+{
+    command("$DRS:2\r\n"); // Not a mode there is
+    CHECK(!sdFrames);
+    CHECK_STR(sent(), "");
+
+    sdResync = false;
+    command("$DRS:\r\n");
+    CHECK(sdFrames);
+    CHECK(!sdBinary);
+    CHECK(sdResync);
+    CHECK_STR(sent(), ""); // (No AOK)
+
+    SD_send_text(11, REV_FORK);
+    CHECK_STR(sent(), frame("$DF:0;11," REV_FORK));
+    two_fields();
+    CHECK_STR(sent(), frame("$DF:1;1,14.20V;7,42%"));
+
+    command("$DRS:1\r\n");
+    CHECK(sdBinary);
+    two_fields();
+    sent();
+    CHECK((outLen > 2) && (out[0] != '$') && (out[outLen - 1] == 0x00)); // (A COBS frame, ending in its 0x00)
+
+    command("$DRS:0\r\n");
+    CHECK(sdFrames);
+    CHECK(!sdBinary);
+    two_fields();
+    CHECK_STR(sent(), frame("$DF:3;1,14.20V;7,42%"));
+}
+
+int main(void)
+{
+    test_lines();
+    test_frames();
+
+    return (test_summary("serial_display"));
+}
@@ -0,0 +1,220 @@
+//
+//      Arduino.h  (host build)
+//
+//      Just enough of the Arduino core for the regulator sources to compile and run on a Linux host, so parts of the
+//      firmware can be driven from the host tests in test/host.  See HostArduino.cpp for the simulated hardware.
+//
+//      Note that int is 32 bits here, vs 16 bits on the ATmega2560.
+//
+
+#ifndef _HOST_ARDUINO_H_
+#define _HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define DEC 10
+#define HEX 16
+
+#define A0 54
+#define A1 55
+#define A2 56
+#define A3 57
+#define A4 58
+#define A5 59
+#define A6 60
+#define A7 61
+#define A8 62
+#define A9 63
+#define A10 64
+#define A11 65
+#define A12 66
+#define A13 67
+#define A14 68
+#define A15 69
+
+#define F(s) (s)
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#ifndef min
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#endif
+#define noInterrupts()
+#define interrupts()
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define lowByte(w) ((uint8_t)((w)&0xff))
+#define word(h, l) ((uint16_t)(((h) << 8) | (l)))
+#define digitalPinToInterrupt(p) (p)
+
+#define SERIAL_8N1 0x06
+#define SERIAL_8E1 0x26
+
+//----  Simulated time.  Only moves when a test moves it, see host_advance().
+extern uint32_t hostMillis;
+void host_advance(uint32_t ms);
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+void attachInterrupt(uint8_t irq, void (*fn)(void), int mode);
+void detachInterrupt(uint8_t irq);
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+extern uint8_t hostPinOut[70]; // Last value written to each pin, and what digitalRead() returns for each pin
+extern uint8_t hostPinIn[70];
+extern int hostAnalogOut[70];
+
+char *dtostrf(double val, signed char width, unsigned char prec, char *buf);
+char *itoa(int val, char *buf, int radix);
+char *ltoa(long val, char *buf, int radix);
+char *utoa(unsigned val, char *buf, int radix);
+char *ultoa(unsigned long val, char *buf, int radix);
+
+class String
+{
+public:
+    String(const char * = "") {}
+    const char *c_str() const { return (""); }
+    unsigned length() const { return (0); }
+    operator bool() const { return (true); }
+};
+
+class Print
+{
+public:
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *b, size_t n)
+    {
+        size_t r = 0;
+        while (n--)
+            r += write(*b++);
+        return (r);
+    }
+    size_t write(const char *s) { return (write((const uint8_t *)s, strlen(s))); }
+    size_t write(const char *s, size_t n) { return (write((const uint8_t *)s, n)); }
+    size_t print(const char *s) { return (write(s)); }
+    size_t print(char c) { return (write((uint8_t)c)); }
+    size_t print(long v, int radix = DEC)
+    {
+        char b[34];
+        return (write(ltoa(v, b, radix)));
+    }
+    size_t print(int v, int radix = DEC) { return (print((long)v, radix)); }
+    size_t print(unsigned v, int radix = DEC) { return (print((unsigned long)v, radix)); }
+    size_t print(unsigned long v, int radix = DEC)
+    {
+        char b[34];
+        return (write(ultoa(v, b, radix)));
+    }
+    size_t print(double v, int prec = 2)
+    {
+        char b[40];
+        return (write(dtostrf(v, 1, prec, b)));
+    }
+    size_t print(const String &) { return (0); }
+    size_t println(void) { return (write("\r\n")); }
+    template <typename T>
+    size_t println(T v) { return (print(v) + println()); }
+    template <typename T>
+    size_t println(T v, int f) { return (print(v, f) + println()); }
+    virtual int availableForWrite() { return (0); }
+    virtual void flush() {}
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+//----  Serial ports capture what is sent, and hand back whatever a test has queued up to be received.
+class HardwareSerial : public Stream
+{
+public:
+    void begin(unsigned long) {}
+    void begin(unsigned long, uint8_t) {}
+    void end() {}
+    int available();
+    int read();
+    int peek();
+    size_t write(uint8_t c);
+    using Print::write;
+    int availableForWrite() { return (63); }
+    void flush() {}
+    operator bool() { return (true); }
+
+    void host_receive(const void *data, size_t len); // Queue bytes for read()
+    void host_receive(const char *s) { host_receive(s, strlen(s)); }
+    size_t host_sent(uint8_t *buf, size_t size);     // Take (and clear) what has been written
+    size_t host_sent_len(void) { return (txLen); }
+    void host_clear(void) { txLen = rxHead = rxTail = 0; }
+
+private:
+    uint8_t rx[4096];
+    size_t rxHead = 0, rxTail = 0;
+    uint8_t tx[16384];
+    size_t txLen = 0;
+};
+
+extern HardwareSerial Serial, Serial1, Serial2, Serial3;
+
+//----  The few AVR registers the sources touch directly  (UART, Timer 5 - see Modbus.cpp)
+extern volatile uint8_t SREG, UDR0, UDR1, UDR2, UDR3;
+extern volatile uint8_t UCSR0A, UCSR1A, UCSR2A, UCSR3A, UCSR0B, UCSR1B, UCSR2B, UCSR3B, UCSR0C, UCSR1C, UCSR2C, UCSR3C;
+extern volatile uint16_t UBRR0, UBRR1, UBRR2, UBRR3;
+extern volatile uint8_t TCCR1B, TCCR2B, TCCR3B, TCCR4B, TCCR5A, TCCR5B, TIMSK5, TIFR5;
+extern volatile uint16_t TCNT5, OCR5A;
+extern volatile uint8_t PORTC, DDRC, PINC;
+
+#define RXEN0 4
+#define TXEN0 3
+#define RXCIE0 7
+#define TXCIE0 6
+#define UDRIE0 5
+#define UDRE0 5
+#define U2X0 1
+#define FE0 4
+#define DOR0 3
+#define UPE0 2
+#define TXC0 6
+#define CS50 0
+#define CS51 1
+#define OCIE5A 1
+#define OCF5A 1
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#endif // _HOST_ARDUINO_H_
@@ -0,0 +1,207 @@
+//
+//      HostArduino.cpp  (host build)
+//
+//      The simulated hardware behind the host stubs:  a clock that only moves when a test moves it, pins that remember
+//      what was last written to them, an EEPROM held in RAM, and serial ports that capture what is sent.
+//
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <SoftI2CMaster.h>
+#include <I2Cx.h>
+#include <MemoryFree.h>
+#include <avr/wdt.h>
+#include <util/crc16.h>
+
+uint32_t hostMillis = 0;
+
+uint8_t hostPinOut[70];
+uint8_t hostPinIn[70];
+int hostAnalogOut[70];
+
+uint8_t hostEEPROM[E2END + 1];
+uint32_t hostEEPROMWrites = 0;
+
+HardwareSerial Serial, Serial1, Serial2, Serial3;
+TwoWire Wire;
+I2C I2c;
+
+volatile uint8_t SREG, UDR0, UDR1, UDR2, UDR3;
+volatile uint8_t UCSR0A, UCSR1A, UCSR2A, UCSR3A, UCSR0B, UCSR1B, UCSR2B, UCSR3B, UCSR0C, UCSR1C, UCSR2C, UCSR3C;
+volatile uint16_t UBRR0, UBRR1, UBRR2, UBRR3;
+volatile uint8_t TCCR1B, TCCR2B, TCCR3B, TCCR4B, TCCR5A, TCCR5B, TIMSK5, TIFR5;
+volatile uint16_t TCNT5, OCR5A;
+volatile uint8_t PORTC, DDRC, PINC;
+
+//----  Time
+void host_advance(uint32_t ms) { hostMillis += ms; }
+unsigned long millis(void) { return (hostMillis); }
+unsigned long micros(void) { return (hostMillis * 1000UL); }
+void delay(unsigned long ms) { hostMillis += ms; }
+void delayMicroseconds(unsigned) {}
+
+//----  Pins
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t pin, uint8_t val) { hostPinOut[pin % 70] = val; }
+int digitalRead(uint8_t pin) { return (hostPinIn[pin % 70]); }
+int analogRead(uint8_t) { return (0); }
+void analogWrite(uint8_t pin, int val) { hostAnalogOut[pin % 70] = val; }
+void attachInterrupt(uint8_t, void (*)(void), int) {}
+void detachInterrupt(uint8_t) {}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+    return ((x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin);
+}
+
+//----  avr-libc string conversions not in glibc
+char *dtostrf(double val, signed char width, unsigned char prec, char *buf)
+{
+    sprintf(buf, "%*.*f", width, prec, val);
+    return (buf);
+}
+
+char *ultoa(unsigned long val, char *buf, int radix)
+{
+    char tmp[34];
+    int i = 0;
+    do
+    {
+        int d = val % radix;
+        tmp[i++] = (d < 10) ? ('0' + d) : ('a' + d - 10);
+        val /= radix;
+    } while (val != 0);
+    for (int j = 0; j < i; j++)
+        buf[j] = tmp[i - 1 - j];
+    buf[i] = '\0';
+    return (buf);
+}
+
+char *ltoa(long val, char *buf, int radix)
+{
+    if ((val < 0) && (radix == 10))
+    {
+        buf[0] = '-';
+        ultoa(-(unsigned long)val, buf + 1, radix);
+        return (buf);
+    }
+    return (ultoa((unsigned long)val, buf, radix));
+}
+
+char *itoa(int val, char *buf, int radix) { return (ltoa(val, buf, radix)); }
+char *utoa(unsigned val, char *buf, int radix) { return (ultoa(val, buf, radix)); }
+
+//----  Serial ports
+int HardwareSerial::available() { return ((int)(rxHead - rxTail)); }
+int HardwareSerial::read() { return ((rxTail < rxHead) ? rx[rxTail++] : -1); }
+int HardwareSerial::peek() { return ((rxTail < rxHead) ? rx[rxTail] : -1); }
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    if (txLen < sizeof(tx))
+        tx[txLen++] = c;
+    return (1);
+}
+
+void HardwareSerial::host_receive(const void *data, size_t len)
+{
+    if (rxTail == rxHead)
+        rxHead = rxTail = 0;
+    if (len > sizeof(rx) - rxHead)
+        len = sizeof(rx) - rxHead;
+    memcpy(&rx[rxHead], data, len);
+    rxHead += len;
+}
+
+size_t HardwareSerial::host_sent(uint8_t *buf, size_t size)
+{
+    size_t n = min(size, txLen);
+    memcpy(buf, tx, n);
+    txLen = 0;
+    return (n);
+}
+
+//----  EEPROM
+void eeprom_read_block(void *dst, const void *src, size_t n) { memcpy(dst, &hostEEPROM[(uintptr_t)src], n); }
+
+void eeprom_update_block(const void *src, void *dst, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        eeprom_update_byte((uint8_t *)dst + i, ((const uint8_t *)src)[i]);
+}
+
+void eeprom_write_block(const void *src, void *dst, size_t n) { eeprom_update_block(src, dst, n); }
+uint8_t eeprom_read_byte(const uint8_t *p) { return (hostEEPROM[(uintptr_t)p]); }
+void eeprom_write_byte(uint8_t *p, uint8_t v) { eeprom_update_byte(p, v); }
+
+void eeprom_update_byte(uint8_t *p, uint8_t v)
+{
+    if (hostEEPROM[(uintptr_t)p] != v)
+        hostEEPROMWrites++;
+    hostEEPROM[(uintptr_t)p] = v;
+}
+
+uint16_t eeprom_read_word(const uint16_t *p)
+{
+    uint16_t v;
+    eeprom_read_block(&v, p, sizeof(v));
+    return (v);
+}
+
+void eeprom_write_word(uint16_t *p, uint16_t v) { eeprom_update_block(&v, p, sizeof(v)); }
+void eeprom_update_word(uint16_t *p, uint16_t v) { eeprom_update_block(&v, p, sizeof(v)); }
+
+uint32_t eeprom_read_dword(const uint32_t *p)
+{
+    uint32_t v;
+    eeprom_read_block(&v, p, sizeof(v));
+    return (v);
+}
+
+void eeprom_write_dword(uint32_t *p, uint32_t v) { eeprom_update_block(&v, p, sizeof(v)); }
+void eeprom_update_dword(uint32_t *p, uint32_t v) { eeprom_update_block(&v, p, sizeof(v)); }
+
+//----  Watchdog, I2C, RAM
+void wdt_enable(int) {}
+void wdt_reset(void) {}
+void wdt_disable(void) {}
+
+bool i2c_init(void) { return (true); }
+bool i2c_start(uint8_t) { return (true); }
+bool i2c_rep_start(uint8_t) { return (true); }
+void i2c_stop(void) {}
+bool i2c_write(uint8_t) { return (true); }
+uint8_t i2c_read(bool) { return (0); }
+
+int freeMemory(void) { return (8192); }
+
+//----  The top of the AVR heap, as checkStampStack() looks for it:  2K of free RAM, all still stamped.
+//      (stampFreeStack() would stamp from here up to the host's stack - no test may call it, or setup())
+static uint8_t hostFreeRAM[8 + 2048 + 1];
+static bool hostFreeRAMStamped = (memset(hostFreeRAM + 8, 0xA5, 2048), true);
+unsigned int __heap_start;
+void *__brkval = hostFreeRAM;
+
+//----  CRCs, as documented for <util/crc16.h>
+uint16_t _crc16_update(uint16_t crc, uint8_t a)
+{
+    crc ^= a;
+    for (int i = 0; i < 8; ++i)
+        crc = (crc & 1) ? ((crc >> 1) ^ 0xA001) : (crc >> 1);
+    return (crc);
+}
+
+uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data)
+{
+    data ^= (uint8_t)(crc & 0xff);
+    data ^= data << 4;
+    return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+}
+
+uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data)
+{
+    crc = crc ^ ((uint16_t)data << 8);
+    for (int i = 0; i < 8; i++)
+        crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+    return (crc);
+}
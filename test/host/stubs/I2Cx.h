@@ -0,0 +1,27 @@
+//
+//      I2Cx.h  (host build)
+//
+//      Stands in for lib/I2Cx.  No INA226s on the host:  every read 'succeeds' and returns zeros.
+//
+
+#ifndef _HOST_I2CX_H_
+#define _HOST_I2CX_H_
+
+#include <Arduino.h>
+
+class I2C
+{
+public:
+    void begin() {}
+    void end() {}
+    void timeOut(uint16_t) {}
+    void pullup(uint8_t) {}
+    uint8_t available() { return (0); }
+    uint8_t receive() { return (0); }
+    uint8_t write(uint8_t, uint8_t, uint8_t *, uint8_t) { return (0); }
+    uint8_t read(uint8_t, uint8_t, uint8_t) { return (0); }
+};
+
+extern I2C I2c;
+
+#endif // _HOST_I2CX_H_
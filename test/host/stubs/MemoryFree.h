@@ -0,0 +1,3 @@
+// MemoryFree.h  (host build) - stands in for lib/MemoryFree;  the host heap is not the AVR one.
+#pragma once
+int freeMemory(void);
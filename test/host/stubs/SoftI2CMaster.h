@@ -0,0 +1,11 @@
+// SoftI2CMaster.h  (host build) - nothing answers on the bit-banged bus either.
+#pragma once
+#include <stdint.h>
+#define I2C_WRITE 0
+#define I2C_READ 1
+bool i2c_init(void);
+bool i2c_start(uint8_t addr);
+bool i2c_rep_start(uint8_t addr);
+void i2c_stop(void);
+bool i2c_write(uint8_t value);
+uint8_t i2c_read(bool last);
@@ -0,0 +1,18 @@
+// Wire.h  (host build) - nothing answers on the I2C bus.
+#pragma once
+#include <Arduino.h>
+class TwoWire : public Stream
+{
+public:
+    void begin() {}
+    void setClock(uint32_t) {}
+    void beginTransmission(uint8_t) {}
+    uint8_t endTransmission(bool = true) { return (2); }
+    uint8_t requestFrom(uint8_t, uint8_t) { return (0); }
+    size_t write(uint8_t) { return (1); }
+    using Print::write;
+    int available() { return (0); }
+    int read() { return (-1); }
+    int peek() { return (-1); }
+};
+extern TwoWire Wire;
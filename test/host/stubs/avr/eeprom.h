@@ -0,0 +1,31 @@
+//
+//      avr/eeprom.h  (host build)
+//
+//      The EEPROM is a RAM array, see HostArduino.cpp.  Tests can look at (or tear) it directly via hostEEPROM[].
+//
+
+#ifndef _HOST_EEPROM_H_
+#define _HOST_EEPROM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define E2END 0x0FFF
+
+extern uint8_t hostEEPROM[E2END + 1];
+extern uint32_t hostEEPROMWrites; // Count of bytes actually written (ala, changed) - each ~3.4mS on the AVR
+
+void eeprom_read_block(void *dst, const void *src, size_t n);
+void eeprom_write_block(const void *src, void *dst, size_t n);
+void eeprom_update_block(const void *src, void *dst, size_t n);
+uint8_t eeprom_read_byte(const uint8_t *p);
+void eeprom_write_byte(uint8_t *p, uint8_t v);
+void eeprom_update_byte(uint8_t *p, uint8_t v);
+uint16_t eeprom_read_word(const uint16_t *p);
+void eeprom_write_word(uint16_t *p, uint16_t v);
+void eeprom_update_word(uint16_t *p, uint16_t v);
+uint32_t eeprom_read_dword(const uint32_t *p);
+void eeprom_write_dword(uint32_t *p, uint32_t v);
+void eeprom_update_dword(uint32_t *p, uint32_t v);
+
+#endif // _HOST_EEPROM_H_
@@ -0,0 +1,5 @@
+// avr/interrupt.h  (host build) - ISRs become plain functions a test can call.
+#pragma once
+#define ISR(v) extern "C" void v(void)
+#define cli()
+#define sei()
@@ -0,0 +1,3 @@
+// avr/io.h  (host build) - the registers used are declared in Arduino.h
+#pragma once
+#define _BV(bit) (1 << (bit))
@@ -0,0 +1,42 @@
+//
+//      avr/pgmspace.h  (host build)
+//
+//      There is only one address space on the host, so PROGMEM is plain const data and the _P functions are the normal ones.
+//
+
+#ifndef _HOST_PGMSPACE_H_
+#define _HOST_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+
+#define pgm_read_byte(a) (*(const uint8_t *)(a))
+#define pgm_read_byte_near(a) (*(const uint8_t *)(a))
+#define pgm_read_word(a) (*(const uint16_t *)(a))
+#define pgm_read_word_near(a) (*(const uint16_t *)(a))
+#define pgm_read_dword(a) (*(const uint32_t *)(a))
+#define pgm_read_dword_near(a) (*(const uint32_t *)(a))
+#define pgm_read_float(a) (*(const float *)(a))
+#define pgm_read_float_near(a) (*(const float *)(a))
+#define pgm_read_ptr(a) (*(void *const *)(a))
+
+#define memcpy_P memcpy
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strcasecmp_P strcasecmp
+#define strncasecmp_P strncasecmp
+#define strstr_P strstr
+#define strchr_P strchr
+#define snprintf_P snprintf
+#define sprintf_P sprintf
+
+#endif // _HOST_PGMSPACE_H_
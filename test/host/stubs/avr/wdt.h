@@ -0,0 +1,7 @@
+// avr/wdt.h  (host build)
+#pragma once
+#define WDTO_15MS 0
+#define WDTO_8S 9
+void wdt_enable(int timeout);
+void wdt_reset(void);
+void wdt_disable(void);
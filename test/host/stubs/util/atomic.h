@@ -0,0 +1,4 @@
+// util/atomic.h  (host build) - nothing can interrupt on the host.
+#pragma once
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_BLOCK(x)
@@ -0,0 +1,6 @@
+// util/crc16.h  (host build) - same algorithms as the avr-libc versions.
+#pragma once
+#include <stdint.h>
+uint16_t _crc16_update(uint16_t crc, uint8_t a);
+uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data);
+uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data);
@@ -0,0 +1,183 @@
+//
+//      taper.cpp
+//
+//      The Acceptance current taper fit  (Taper.cpp):  update_TPR() is run once a second against a battery whose Amps decay
+//      exponentially onto a floor, with noise on top, while held at the Acceptance voltage.
+//
+//      -- The fit must find the time constant and the floor.
+//      -- With an EXIT_ACPT_AMPS above the floor, TPR_exit_reached() says so once the Amps come down through it - not before,
+//         and within a sample period or so after.
+//      -- With no Amps threshold, it says so once the Amps have flattened out onto a floor under TPR_FLOOR_MAX, but never for
+//         a floor above it.
+//      -- Nothing is said until TPR_MIN_SAMPLES have been fitted, nor from samples too noisy to follow the curve.  Losing the
+//         Acceptance voltage breaks the chain of samples, and a new Acceptance phase starts the fit over.
+//
+
+#include "Config.h"
+#include "System.h"
+#include "Sensors.h"
+#include "Alternator.h"
+#include "Taper.cpp" // For tprA, tprB
+
+#include "HostTest.h"
+
+#define SAMPLE_MIN (TPR_SAMPLE_PERIOD / 60000.0) // Minutes per sample of the fit
+
+static uint32_t seed = 3;
+
+//----  Roughly normal noise, of the passed standard deviation.
+static double noise(double sigma)
+{
+    double s = 0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        seed = seed * 1103515245UL + 12345UL;
+        s += ((seed >> 8) & 0xFFFF) / 65535.0 - 0.5;
+    }
+    return (s * sigma * sqrt(3.0)); //  (Sum of 4 uniforms over +/-0.5 has a std dev of 1/sqrt(3))
+}
+
+//----  The true taper, and the time (minutes into Acceptance) it comes down to 'amps'.
+static double taper(double I0, double Iinf, double tau, double t)
+{
+    return (Iinf + (I0 - Iinf) * exp(-t / tau));
+}
+
+static double time_to(double I0, double Iinf, double tau, double amps)
+{
+    return (tau * log((I0 - Iinf) / (amps - Iinf)));
+}
+
+//----  New Acceptance phase.
+static void start(void)
+{
+    host_advance(1000);
+    altModeChanged = millis();
+    update_TPR(true);
+}
+
+//----  Hold at voltage for up to 'minutes' of the taper, calling update_TPR() every second.  Returns the minute TPR_exit_reached()
+//      first said so, or -1 if it never did.  A sigma over TPR_NOISE_MAX is expected to give no exit at all.
+static double run(double I0, double Iinf, double tau, double sigma, float exitAmps, double minutes)
+{
+    measuredBatAmps = I0;
+    start();
+    for (double t = 0; t < minutes; t += 1.0 / 60)
+    {
+        measuredBatAmps = taper(I0, Iinf, tau, t) + noise(sigma);
+        host_advance(1000);
+        update_TPR(true);
+        if (TPR_exit_reached(exitAmps))
+        {
+            CHECK(fitCount >= TPR_MIN_SAMPLES);
+            return (t);
+        }
+    }
+    return (-1);
+}
+
+static void test_fit(void)
+{
+    double t;
+
+    systemAmpMult = 1.0;
+    t = run(100, 8, 20, 0.3, 0, 30); //  (Not long enough to reach the floor)
+    CHECK_EQ(t, -1);
+    CHECK(fabs(tprB - exp(-SAMPLE_MIN / 20)) < 0.0005); //                 b = e^(-period / tau)
+    CHECK(fabs(tprA / (1.0 - tprB) - 8) < 0.5);          //                 Iinf
+}
+
+static void test_amps_exit(void)
+{
+    double t, tCross;
+
+    //---  Big battery, slow taper;  EXIT_ACPT_AMPS above the floor.
+    tCross = time_to(100, 5, 20, 20);
+    t = run(100, 5, 20, 0.3, 20, 120);
+    CHECK(t >= tCross);
+    CHECK(t <= tCross + 1.5 * SAMPLE_MIN + 0.5); // (The 30 second average, and where in a sample period it crossed)
+    printf("Exit at %.1f minutes, Amps down to EXIT_ACPT_AMPS at %.1f\n", t, tCross);
+
+    //---  Faster taper, more noise - still within a minute or two of the crossing.
+    tCross = time_to(60, 2, 8, 10);
+    t = run(60, 2, 8, 0.8, 10, 120);
+    CHECK(t >= tCross - 0.5);
+    CHECK(t <= tCross + 2.0);
+
+    //---  Crossed before the fit could be believed:  said as soon as it is.
+    t = run(30, 2, 2, 0.3, 25, 60);
+    CHECK(t >= TPR_MIN_SAMPLES * SAMPLE_MIN);
+    CHECK(t <= (TPR_MIN_SAMPLES + 2) * SAMPLE_MIN);
+}
+
+static void test_floor_exit(void)
+{
+    double t;
+    double band = TPR_FLOOR_BAND + 2 * 0.3;
+
+    //---  No Amps threshold:  out once sitting on a floor under TPR_FLOOR_MAX ..
+    t = run(100, 8, 15, 0.3, 0, 240);
+    CHECK(t > 0);
+    CHECK(t >= time_to(100, 8, 15, 8 + 4 * band)); //   Not while still coming down ..
+    CHECK(t <= time_to(100, 8, 15, 8 + band / 4)); //   .. and soon once there.
+    printf("Floor exit at %.1f minutes, Amps within the band at %.1f\n", t, time_to(100, 8, 15, 8 + band));
+
+    //---  .. or a floor above EXIT_ACPT_AMPS, that never gets down to it.
+    t = run(100, 12, 15, 0.3, 5, 240);
+    CHECK(t > 0);
+    CHECK(t <= time_to(100, 12, 15, 12 + band / 4));
+
+    //---  A floor above TPR_FLOOR_MAX is just the early part of a slow taper, never an exit.
+    CHECK_EQ(run(100, TPR_FLOOR_MAX + 5, 15, 0.3, 0, 240), -1);
+    CHECK_EQ(run(100, TPR_FLOOR_MAX + 5, 15, 0.3, 10, 240), -1);
+
+    //---  Too noisy to follow the curve:  the fit is not used at all.  (3x TPR_NOISE_MAX, once averaged over a sample)
+    double sigma = 3 * TPR_NOISE_MAX * sqrt(TPR_SAMPLE_PERIOD / 1000.0);
+    CHECK_EQ(run(100, 8, 15, sigma, 0, 240), -1);
+    CHECK_EQ(run(100, 8, 15, sigma, 20, 240), -1);
+
+    //---  Amps scaled with the battery bank (systemAmpMult), so is the floor allowed.
+    systemAmpMult = 2.0;
+    t = run(200, 2 * (TPR_FLOOR_MAX - 3), 15, 0.3, 0, 240);
+    CHECK(t > 0);
+    systemAmpMult = 1.0;
+}
+
+static void test_breaks(void)
+{
+    double t;
+
+    //---  Fitted, then a new Acceptance phase:  starts over, so nothing is said until TPR_MIN_SAMPLES again.
+    t = run(100, 8, 15, 0.3, 0, 240);
+    CHECK(t > 0);
+    start();
+    CHECK(!TPR_exit_reached(0));
+    CHECK_EQ(fitCount, 0);
+
+    //---  Lost the Acceptance voltage (engine to idle) at the floor:  the chain of samples is broken, and the Amps seen while off
+    //     voltage are not used.
+    t = run(100, 8, 15, 0.3, 0, 240);
+    CHECK(t > 0);
+    for (int i = 0; i < 600; i++)
+    {
+        measuredBatAmps = 0.5; //   (Would look like it had gone under EXIT_ACPT_AMPS)
+        host_advance(1000);
+        update_TPR(false);
+    }
+    CHECK(!TPR_exit_reached(20));
+    measuredBatAmps = 8;
+    host_advance(1000);
+    update_TPR(true); //           Back at voltage, on the floor
+    CHECK(!TPR_exit_reached(20));
+}
+
+int main(void)
+{
+    test_fit();
+    test_amps_exit();
+    test_floor_exit();
+    test_breaks();
+
+    return (test_summary("taper"));
+}
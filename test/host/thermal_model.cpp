@@ -0,0 +1,141 @@
+//
+//      thermal_model.cpp
+//
+//      The alternator Thermal Model  (ThermalModel.cpp):  manage_THM() is run every PWM_CHANGE_RATE against a simulated
+//      alternator that follows the model's own first order equation with known K, c and Ta - its temperature read back in
+//      whole degrees, as the NTC gives it - through a few hours of changing load and engine speed.
+//
+//      -- The RLS fit must find K, c and Ta.
+//      -- thermalAmpsCap must be what those true values give, and holding the Amps there for THM_HORIZON minutes must bring
+//         the alternator to just under ALT_TEMP_SETPOINT - THM_MARGIN, not over it.
+//      -- Not used until THM_MIN_SAMPLES have been fitted, nor with no RPMs or Alt Amps to go on.
+//
+
+#include "Config.h"
+#include "System.h"
+#include "Sensors.h"
+#include "Alternator.h"
+#include "ThermalModel.cpp" // For theta[]
+
+#include "HostTest.h"
+
+#define TRUE_K 6.0   // Degrees C / minute at u = 1
+#define TRUE_C 0.05  // 1 / minutes  (20 minute time constant standing still)
+#define TRUE_TA 38.0 // Engine room
+
+static double altTemp = TRUE_TA;
+static uint32_t seed = 7;
+
+static double heat(double amps, int pwm)
+{
+    double f = (double)pwm / FIELD_PWM_MAX;
+    return ((amps / THM_AMPS_REF) * (amps / THM_AMPS_REF) + THM_FIELD_WEIGHT * f * f);
+}
+
+//----  Run the alternator at the given Amps, PWM and RPMs for the given minutes, calling manage_THM() as manage_ALT() does.
+static void run(double amps, int pwm, int rpms, double minutes)
+{
+    const double dt = PWM_CHANGE_RATE / 60000.0;
+
+    for (double t = 0; t < minutes; t += dt)
+    {
+        double g = 1.0 + rpms / THM_RPM_REF;
+
+        altTemp += (TRUE_K * heat(amps, pwm) - TRUE_C * g * (altTemp - TRUE_TA)) * dt;
+        measuredAltTemp = (int)lround(altTemp);
+        measuredAltAmps = amps;
+        fieldPWMvalue = pwm;
+        measuredRPMs = rpms;
+        host_advance(PWM_CHANGE_RATE);
+        manage_THM();
+    }
+}
+
+static uint32_t rnd(uint32_t n)
+{
+    seed = seed * 1103515245UL + 12345UL;
+    return ((seed >> 8) % n);
+}
+
+//----  The Amps that bring the true alternator to 'limit' in THM_HORIZON minutes from 'temp'.
+static double true_cap(double temp, int pwm, int rpms, double limit)
+{
+    double cg = TRUE_C * (1.0 + rpms / THM_RPM_REF);
+    double e = exp(-cg * THM_HORIZON);
+    double u = (cg / TRUE_K) * (((limit - temp * e) / (1.0 - e)) - TRUE_TA) - heat(0, pwm);
+
+    return ((u > 0) ? THM_AMPS_REF * sqrt(u) : 0.0);
+}
+
+static void test_fit(void)
+{
+    double K, c, Ta, limit, want;
+    int pwm, rpms;
+
+    systemConfig.ALT_TEMP_SETPOINT = 105;
+    shuntAltAmpsMeasured = true;
+
+    run(40, 100, 1500, 1);
+    CHECK(!THM_valid()); // Too soon
+    CHECK(thermalAmpsCap == -1);
+
+    //---  Heat up and cool down a few times, with the load and engine speed moving around.
+    for (int i = 0; i < 24; i++)
+    {
+        double amps = (i & 1) ? 10 + rnd(30) : 80 + rnd(60);
+        run(amps, 60 + rnd(190), 1000 + rnd(2000), 6 + rnd(8));
+    }
+
+    K = theta[0];
+    c = theta[1] / 100.0;
+    Ta = theta[2] / c;
+    printf("K %.3f (%.3f)  c %.4f (%.4f)  Ta %.1f (%.1f) after %u fits\n", K, TRUE_K, c, TRUE_C, Ta, TRUE_TA, fitCount);
+    CHECK(THM_valid());
+    CHECK(fabs(K - TRUE_K) < 0.15 * TRUE_K);
+    CHECK(fabs(c - TRUE_C) < 0.15 * TRUE_C);
+    CHECK(fabs(Ta - TRUE_TA) < 5.0);
+
+    //---  The Amps cap, from where it is now.
+    pwm = 180;
+    rpms = 2000;
+    run(60, pwm, rpms, 2);
+    limit = systemConfig.ALT_TEMP_SETPOINT - THM_MARGIN;
+    want = true_cap(altTemp, pwm, rpms, limit);
+    printf("At %.1f C, thermalAmpsCap %.1f A  (true model %.1f A)\n", altTemp, thermalAmpsCap, want);
+    CHECK(fabs(thermalAmpsCap - want) < 0.1 * want);
+
+    //---  Hold the Amps there:  THM_HORIZON minutes later the alternator should be just at the limit.
+    want = thermalAmpsCap;
+    run(want, pwm, rpms, THM_HORIZON);
+    printf("After %.0f minutes at the cap:  %.1f C  (limit %.0f C)\n", THM_HORIZON, altTemp, limit);
+    CHECK(altTemp <= limit + 1.0);
+    CHECK(altTemp >= limit - 3.0);
+
+    //---  And from there on (the cap worked out afresh as it goes) it does not go over.
+    for (int m = 0; m < 60; m++)
+    {
+        run(thermalAmpsCap, pwm, rpms, 0.5);
+        CHECK(altTemp <= limit + 1.0);
+    }
+}
+
+static void test_not_used(void)
+{
+    measuredRPMs = 0; // Engine stopped, nothing to go on
+    manage_THM();
+    CHECK(thermalAmpsCap == -1);
+
+    measuredRPMs = 1500;
+    shuntAltAmpsMeasured = false;
+    manage_THM();
+    CHECK(thermalAmpsCap == -1);
+    shuntAltAmpsMeasured = true;
+}
+
+int main(void)
+{
+    test_fit();
+    test_not_used();
+
+    return (test_summary("thermal_model"));
+}
@@ -0,0 +1,461 @@
+//
+//      txw_fixed.cpp
+//
+//      Checks TXW_fixed() (and TXW_int()) render numbers the way float2string() - which they replaced - did on the
+//      ATmega2560, and times the two.
+//
+//      float2string() is copied here as it was, but with its int / unsigned int made 16 bits wide as they are on the AVR
+//      (avr-gcc converts an out of range float via a 32-bit int, then keeps the low 16 bits - as done here).  That
+//      matters for the fraction:  once (|v| * 10^decimals) passes 65535 float2string() wrapped and printed the wrong
+//      digits (65.536V at 3 places came out as "65.000"), where TXW_fixed() keeps 32 bits and gets it right.  Those are
+//      checked against the same digits worked out with 32 bits instead.  Everything else must match byte for byte - including
+//      the fraction being truncated, not rounded, and a value between -1 and 0 losing its sign ("-0.5" --> "0.50").
+//
+//      The whole part is kept within +/-32767, as on the AVR TXW_int() wraps past that just as float2string() did.
+//
+//      Then the whole AST, CPE, SCV and SST messages are checked byte for byte against the snprintf_P() prep_*() they replaced
+//      (copied here as they were), over sets of random values kept within what float2string() could print.  SST has since had
+//      the OLED load and sensor latency added on the end, those are appended to the old one the same way.
+//
+
+#include "Config.h"
+#include "System.h"
+#include "Alternator.h"
+#include "Sensors.h"
+#include "CPE.h"
+#include "TxRing.h"
+#include "TxWriter.h"
+#include "OSEnergy_Serial.h"
+
+#include "HostTest.h"
+
+static uint8_t callCount; // (Was static in float2string(), out here so the whole message checks can start it over)
+
+//----  float2string() as it was in OSEnergy_Serial.cpp, with AVR int sizes.
+static char *float2string(float v, uint8_t decimals)
+{
+    const int OUTPUT_BUFS = 7;
+    const int MAX_OUTPUT = 13;
+    float absV;
+    static char outputBuffers[OUTPUT_BUFS][MAX_OUTPUT + 1];
+    char formatter[] = "%d.%0_d";
+
+    char *pos = outputBuffers[++callCount % OUTPUT_BUFS];
+
+    formatter[5] = decimals + '0';
+
+    uint16_t mult = 1;
+    uint8_t multleft = decimals;
+    while (multleft--)
+    {
+        mult *= 10;
+    }
+
+    absV = v;
+    if (absV < 0)
+        absV *= -1;
+
+    snprintf(pos, MAX_OUTPUT, formatter,
+             (int)(int16_t)(int32_t)v,
+             (int)(uint16_t)((uint16_t)(uint32_t)(absV * mult) % mult));
+
+    return pos;
+}
+
+static char out[64];
+
+//----  The old way of sending one:  float2string(), then the string copied into the ring.
+static const char *old_path(float v, uint8_t decimals)
+{
+    size_t n;
+
+    TX_write(&asciiTX, float2string(v, decimals), true);
+    TX_flush();
+    n = Serial.host_sent((uint8_t *)out, sizeof(out) - 1);
+    out[n] = '\0';
+    return (out);
+}
+
+//----  What TXW_fixed() sends, as a string.
+static const char *fixed(float v, uint8_t decimals)
+{
+    tTXWriter w;
+    size_t n;
+
+    TXW_begin(&w, &asciiTX, 0, true);
+    TXW_fixed(&w, v, decimals);
+    TXW_end(&w);
+    TX_flush();
+    n = Serial.host_sent((uint8_t *)out, sizeof(out) - 1);
+    out[n] = '\0';
+    return (out);
+}
+
+//----  Would float2string() have wrapped?  If not, they must match - if so, TXW_fixed() must have the right digits.
+static void check(float v, uint8_t decimals)
+{
+    uint32_t mult = 1;
+    char expect[40];
+    float absV = (v < 0) ? -v : v;
+
+    for (uint8_t i = 0; i < decimals; i++)
+        mult *= 10;
+
+    if ((absV * mult) < 65536.0f)
+        strcpy(expect, float2string(v, decimals));
+    else
+        snprintf(expect, sizeof(expect), "%d.%0*u", (int)v, decimals, (unsigned)((uint32_t)(absV * mult) % mult));
+
+    if (strcmp(fixed(v, decimals), expect) != 0)
+    {
+        htChecks++;
+        htFailures++;
+        printf("TXW_fixed(%.9g, %u) == \"%s\", expected \"%s\"\n", v, decimals, out, expect);
+    }
+    else
+        htChecks++;
+}
+
+void prep_AST(tTXWriter *w); // (Not in OSEnergy_Serial.h)
+void prep_CPE(tTXWriter *w, tCPS *cpsPtr, int index);
+void prep_SCV(tTXWriter *w);
+void prep_SST(tTXWriter *w);
+
+//----  The prep_*() functions as they were before TXW, in OSEnergy_Serial.cpp.
+static void old_prep_AST(char *buffer)
+{ // AST: Alternator Status ASCII string.
+    snprintf_P(buffer, OUTBOUND_BUFF_SIZE, PSTR("AST;,%d.%02d, ,%s,%s,%s,%d, ,%s,%d,%d,%d, ,%d,%d, ,%d, ,%s,%d,%d,%d\r\n"),
+               (int)(generatorLrRunTime / (3600UL * 1000UL)),       // Runtime Hours
+               (int)((generatorLrRunTime / (3600UL * 10UL)) % 100), // Runtime 1/100th
+
+               float2string(measuredBatVolts, 2),
+               float2string(measuredAltAmps, 1),
+               float2string(measuredBatAmps, 1),
+               measuredAltWatts,
+
+               float2string(targetBatVolts, 2),
+               (int)targetAltAmps,
+               targetAltWatts,
+               chargingState,
+
+               measuredBatTemp, // In deg C
+               measuredAltTemp, //was ... max(measuredAltTemp, measuredAlt2Temp),
+
+               measuredRPMs,
+
+               float2string(measuredAltVolts, 3),
+               measuredFETTemp,
+               measuredFieldAmps,
+               ((100 * fieldPWMvalue) / FIELD_PWM_MAX));
+} //prep_AST
+
+static void old_prep_CPE(char *buffer, tCPS *cpsPtr, int index)
+{
+    snprintf_P(buffer, OUTBOUND_BUFF_SIZE, PSTR("CPE;,%d,%s,%d,%d,%d, ,%d,%d,%s,%d, ,%s,%d,%d,%d,%d,%s, ,%d,%s,%d, ,%s,%d,%d,%d, ,%s,%d,%d,%d, ,%d,%d, ,%u,%u,%d,%d\r\n"),
+               (index + 1), // Convert from "0-origin" of array indexes for display
+               float2string(cpsPtr->ACPT_BAT_V_SETPOINT, 2),
+               (unsigned int)(cpsPtr->EXIT_ACPT_DURATION / 60000UL), // Show time running in Minutes, as opposed to mS
+               cpsPtr->EXIT_ACPT_AMPS,
+               (int)0, // Place holder for future dV/dT exit parameter, hard coded = 0 for now.
+
+               cpsPtr->LIMIT_OC_AMPS,
+               (unsigned int)(cpsPtr->EXIT_OC_DURATION / 60000UL),
+               float2string(cpsPtr->EXIT_OC_VOLTS, 2),
+               (int)0, // Place holder for future dV/dT exit parameter, hard coded = 0 for now.
+
+               float2string(cpsPtr->FLOAT_BAT_V_SETPOINT, 2),
+               cpsPtr->LIMIT_FLOAT_AMPS,
+               (unsigned int)(cpsPtr->EXIT_FLOAT_DURATION / 60000UL),
+               cpsPtr->FLOAT_TO_BULK_AMPS,
+               cpsPtr->FLOAT_TO_BULK_AHS,
+               float2string(cpsPtr->FLOAT_TO_BULK_VOLTS, 2),
+
+               (unsigned int)(cpsPtr->EXIT_PF_DURATION / 60000UL), //  Show in Minutes, as opposed to mS,
+               float2string(cpsPtr->PF_TO_BULK_VOLTS, 2),
+               cpsPtr->PF_TO_BULK_AHS,
+
+               float2string(cpsPtr->EQUAL_BAT_V_SETPOINT, 2),
+               cpsPtr->LIMIT_EQUAL_AMPS,
+               (unsigned int)(cpsPtr->EXIT_EQUAL_DURATION / 60000UL), //  Show in Minutes, as opposed to mS,
+               cpsPtr->EXIT_EQUAL_AMPS,
+
+               float2string(cpsPtr->BAT_TEMP_1C_COMP, 3),
+               cpsPtr->MIN_TEMP_COMP_LIMIT,
+               cpsPtr->BAT_MIN_CHARGE_TEMP,
+               cpsPtr->BAT_MAX_CHARGE_TEMP,
+
+               cpsPtr->EXIT_ACPT_SOC,
+               cpsPtr->FLOAT_TO_BULK_SOC,
+
+               cpsPtr->CELL_TAPER_MV,
+               cpsPtr->CELL_MAX_MV,
+               cpsPtr->BALANCE_AMPS,
+               cpsPtr->BALANCE_SPREAD_MV);
+} //prep_CPE
+
+static void old_prep_SCV(char *buffer)
+{ // Prep the System Control Variables.
+    snprintf_P(buffer, OUTBOUND_BUFF_SIZE, PSTR("SCV;,%1u,%1u,%1u,%s,%s,%1u, ,%d,%s,%s,%s,%d, ,%d,%d, ,%d,%s,%d,%d, ,%d,%d,%d,%u\r\n"),
+               systemConfig.CONFIG_LOCKOUT,
+               systemConfig.REVERSED_BAT_SHUNT,
+               systemConfig.REVERSED_ALT_SHUNT,
+               float2string(systemConfig.SV_OVERRIDE, 2),
+               float2string(systemConfig.BC_MULT_OVERRIDE, 2),
+               systemConfig.CP_INDEX_OVERRIDE,
+
+               systemConfig.ALT_TEMP_SETPOINT,
+               float2string(systemConfig.ALT_AMP_DERATE_NORMAL, 2),
+               float2string(systemConfig.ALT_AMP_DERATE_SMALL_MODE, 2),
+               float2string(systemConfig.ALT_AMP_DERATE_HALF_POWER, 2),
+               systemConfig.ALT_PULLBACK_FACTOR,
+
+               systemConfig.ALT_AMPS_LIMIT,
+               systemConfig.ALT_WATTS_LIMIT,
+
+               systemConfig.ALTERNATOR_POLES,
+               float2string(systemConfig.ENGINE_ALT_DRIVE_RATIO, 3),
+               systemConfig.BAT_AMP_SHUNT_RATIO,
+               systemConfig.ALT_AMP_SHUNT_RATIO,
+
+               systemConfig.ALT_IDLE_RPM,
+               ((systemConfig.FIELD_TACH_PWM > 0) ? ((100 * systemConfig.FIELD_TACH_PWM) / FIELD_PWM_MAX) : systemConfig.FIELD_TACH_PWM),
+               systemConfig.ENGINE_WARMUP_DURATION,
+               systemConfig.REQURED_SENSORS);
+} //prep_SCV
+
+static void old_prep_SST(char *buffer)
+{
+    snprintf_P(buffer, OUTBOUND_BUFF_SIZE - 3, PSTR("SST;,%s, ,%1u,%1u, ,%d,%s,%s, ,%d,%d, ,%d,%d, ,%1u, ,%u,%u\r\n"), //  System Status
+               firmwareVersion,
+
+               smallAltMode,
+               tachMode,
+
+               (int)(cpIndex + 1),
+               float2string(systemAmpMult, 2),
+               float2string(systemVoltMult, 2),
+
+               altCapAmps,
+               altCapRPMs,
+
+               (int)((accumulatedASecs / 3600UL) * (ACCUMULATE_SAMPLING_RATE / 1000UL)), // Convert into actual AHs
+               (int)((accumulatedWSecs / 3600UL) * (ACCUMULATE_SAMPLING_RATE / 1000UL)), // Convert into actual WHs
+
+               systemConfig.FORCED_TM,
+
+               asciiTX.dropped, // Bytes of serial output that had to be dropped
+               asciiTX.peak);   //   and the most that have been waiting to go out.
+
+    // Added since:  the OLED load and slice, and the sensor latencies.
+    size_t n = strlen(buffer) - 2; // (Over the "\r\n")
+    snprintf(buffer + n, OUTBOUND_BUFF_SIZE - n, ", ,%s,%u, ,%lu,%lu\r\n",
+             float2string(oledLoad / 10.0, 1), oledSliceMax, (unsigned long)sensorLatency, (unsigned long)sensorLatencyMax);
+} //prep_SST
+
+//----  A whole message from the new prep_*(), as a string.
+static const char *message(void (*prep)(tTXWriter *w))
+{
+    static char msg[OUTBOUND_BUFF_SIZE + 1];
+    tTXWriter w;
+    size_t n;
+
+    TXW_begin(&w, &asciiTX, 0, true);
+    prep(&w);
+    TXW_end(&w);
+    TX_flush();
+    n = Serial.host_sent((uint8_t *)msg, sizeof(msg) - 1);
+    msg[n] = '\0';
+    return (msg);
+}
+
+static tCPS *testCPS;
+static void prep_test_CPE(tTXWriter *w)
+{
+    prep_CPE(w, testCPS, 6);
+}
+
+static uint32_t seed = 1;
+
+//----  Random whole number in lo..hi, and a random float in lo..hi.
+static long rnd(long lo, long hi)
+{
+    seed = seed * 1103515245UL + 12345UL;
+    return (lo + (long)((seed >> 8) % (uint32_t)(hi - lo + 1)));
+}
+
+static float rndf(float lo, float hi)
+{
+    return (lo + (hi - lo) * (float)rnd(0, 1000000) / 1000000.0f);
+}
+
+//----  Fill everything the 4 messages send with random values, within what float2string() could print  (|v| * 10^places < 65536)
+//      and what the AVR's 16-bit int holds.  Some floats are kept between -1 and 0, where both lose the sign.
+static void randomize(tCPS *cps)
+{
+    generatorLrRunTime = (uint32_t)rnd(0, 2000000000L);
+    measuredBatVolts = rndf(0, 65);
+    measuredAltAmps = rndf(-300, 300);
+    measuredBatAmps = (rnd(0, 3) == 0) ? rndf(-1, 0) : rndf(-500, 500);
+    measuredAltWatts = rnd(-32767, 32767);
+    targetBatVolts = rndf(0, 65);
+    targetAltAmps = rndf(0, 1000);
+    targetAltWatts = rnd(0, 15000);
+    chargingState = (tModes)rnd(0, 38);
+    measuredBatTemp = rnd(-100, 150);
+    measuredAltTemp = rnd(-100, 150);
+    measuredRPMs = rnd(0, 32767);
+    measuredAltVolts = rndf(0, 65);
+    measuredFETTemp = rnd(-100, 150);
+    measuredFieldAmps = rnd(-1000, 1000);
+    fieldPWMvalue = rnd(0, FIELD_PWM_MAX);
+
+    cps->ACPT_BAT_V_SETPOINT = rndf(0, 65);
+    cps->EXIT_ACPT_DURATION = rnd(0, 65535) * 60000UL + rnd(0, 59999);
+    cps->EXIT_ACPT_AMPS = rnd(-1, 500);
+    cps->LIMIT_OC_AMPS = rnd(0, 500);
+    cps->EXIT_OC_DURATION = rnd(0, 65535) * 60000UL;
+    cps->EXIT_OC_VOLTS = rndf(0, 65);
+    cps->FLOAT_BAT_V_SETPOINT = rndf(0, 65);
+    cps->LIMIT_FLOAT_AMPS = rnd(-1, 500);
+    cps->EXIT_FLOAT_DURATION = rnd(0, 65535) * 60000UL;
+    cps->FLOAT_TO_BULK_AMPS = rnd(-500, 500);
+    cps->FLOAT_TO_BULK_AHS = rnd(0, 32767);
+    cps->FLOAT_TO_BULK_VOLTS = rndf(0, 65);
+    cps->EXIT_PF_DURATION = rnd(0, 65535) * 60000UL;
+    cps->PF_TO_BULK_VOLTS = rndf(0, 65);
+    cps->PF_TO_BULK_AHS = rnd(0, 32767);
+    cps->EQUAL_BAT_V_SETPOINT = rndf(0, 65);
+    cps->LIMIT_EQUAL_AMPS = rnd(0, 500);
+    cps->EXIT_EQUAL_DURATION = rnd(0, 65535) * 60000UL;
+    cps->EXIT_EQUAL_AMPS = rnd(0, 500);
+    cps->BAT_TEMP_1C_COMP = rndf(-0.999, 0.05);
+    cps->MIN_TEMP_COMP_LIMIT = rnd(-100, 100);
+    cps->BAT_MIN_CHARGE_TEMP = rnd(-100, 100);
+    cps->BAT_MAX_CHARGE_TEMP = rnd(-100, 100);
+    cps->EXIT_ACPT_SOC = rnd(0, 100);
+    cps->FLOAT_TO_BULK_SOC = rnd(0, 100);
+    cps->CELL_TAPER_MV = rnd(0, 5000);
+    cps->CELL_MAX_MV = rnd(0, 5000);
+    cps->BALANCE_AMPS = rnd(0, 100);
+    cps->BALANCE_SPREAD_MV = rnd(0, 255);
+
+    systemConfig.CONFIG_LOCKOUT = rnd(0, 2);
+    systemConfig.REVERSED_BAT_SHUNT = rnd(0, 1);
+    systemConfig.REVERSED_ALT_SHUNT = rnd(0, 1);
+    systemConfig.SV_OVERRIDE = rndf(0, 4);
+    systemConfig.BC_MULT_OVERRIDE = rndf(0, 10);
+    systemConfig.CP_INDEX_OVERRIDE = rnd(0, 255);
+    systemConfig.ALT_TEMP_SETPOINT = rnd(0, 255);
+    systemConfig.ALT_AMP_DERATE_NORMAL = rndf(0, 1);
+    systemConfig.ALT_AMP_DERATE_SMALL_MODE = rndf(0, 1);
+    systemConfig.ALT_AMP_DERATE_HALF_POWER = rndf(0, 1);
+    systemConfig.ALT_PULLBACK_FACTOR = rnd(-1, 10);
+    systemConfig.ALT_AMPS_LIMIT = rnd(-1, 1000);
+    systemConfig.ALT_WATTS_LIMIT = rnd(-1, 32767);
+    systemConfig.ALTERNATOR_POLES = rnd(0, 255);
+    systemConfig.ENGINE_ALT_DRIVE_RATIO = rndf(0, 20);
+    systemConfig.BAT_AMP_SHUNT_RATIO = rnd(-32767, 32767);
+    systemConfig.ALT_AMP_SHUNT_RATIO = rnd(-32767, 32767);
+    systemConfig.ALT_IDLE_RPM = rnd(0, 5000);
+    systemConfig.FIELD_TACH_PWM = rnd(-1, FIELD_PWM_MAX);
+    systemConfig.ENGINE_WARMUP_DURATION = rnd(0, 32767);
+    systemConfig.REQURED_SENSORS = rnd(0, 255);
+    systemConfig.FORCED_TM = rnd(0, 1);
+
+    smallAltMode = rnd(0, 1);
+    tachMode = rnd(0, 1);
+    cpIndex = rnd(0, 7);
+    systemAmpMult = rndf(0, 4);
+    systemVoltMult = rndf(0, 4);
+    altCapAmps = rnd(-1, 1000);
+    altCapRPMs = rnd(0, 32767);
+    accumulatedASecs = rnd(0, 32767L * 3600L);
+    accumulatedWSecs = rnd(0, 32767L * 3600L);
+    asciiTX.dropped = rnd(0, 65535);
+    asciiTX.peak = rnd(0, 65535);
+    oledLoad = rnd(0, 1000);
+    oledSliceMax = rnd(0, 65535);
+    sensorLatency = (uint32_t)rnd(0, 2000000000L);
+    sensorLatencyMax = (uint32_t)rnd(0, 2000000000L);
+}
+
+//----  Each of the 4 messages, old and new, for the values as they are now.
+//
+//      float2string() handed out its 7 buffers by callCount % 7, and as the uint8_t callCount wrapped 255 --> 0 that went from
+//      buffer 3 back to 0 - so now and then one message got the same buffer for two of its numbers, and sent one of them twice.  (Its
+//      own bug, gone with it.)  callCount is started over for each old message here, to compare what it meant to send.
+static void check_messages(tCPS *cps)
+{
+    char expect[OUTBOUND_BUFF_SIZE];
+
+    callCount = 0;
+    old_prep_AST(expect);
+    CHECK_STR(message(prep_AST), expect);
+    callCount = 0;
+    old_prep_CPE(expect, cps, 6);
+    testCPS = cps;
+    CHECK_STR(message(prep_test_CPE), expect);
+    callCount = 0;
+    old_prep_SCV(expect);
+    CHECK_STR(message(prep_SCV), expect);
+    callCount = 0;
+    old_prep_SST(expect);
+    CHECK_STR(message(prep_SST), expect);
+}
+
+int main(void)
+{
+    tCPS cps;
+    uint8_t d;
+    long k;
+
+    //---  Every value on a 0.001 grid out past any Volts / Amps / Watts the regulator sends, at each number of places used.
+    for (d = 1; d <= 3; d++)
+        for (k = -80000; k <= 80000; k++)
+            check(k / 1000.0f, d);
+
+    //---  And random floats, whole part up to the +/-32767 limit.
+    for (k = 0; k < 300000; k++)
+    {
+        seed = seed * 1103515245UL + 12345UL;
+        float v = (float)(int32_t)seed / 65536.0f; // +/- 32768
+        if ((v > -32767.0f) && (v < 32767.0f))
+            check(v, 1 + (k % 3));
+    }
+
+    //---  The edges, spelled out.
+    CHECK_STR(fixed(14.2f, 2), "14.20");       // 14.1999998 * 100 rounds up to 1420 as a float
+    CHECK_STR(fixed(14.199f, 2), "14.19");     //   but the fraction is otherwise truncated, not rounded
+    CHECK_STR(fixed(-1.25f, 2), "-1.25");
+    CHECK_STR(fixed(-12.999f, 1), "-12.9");
+    CHECK_STR(fixed(-0.5f, 2), "0.50");        // Sign lost between -1 and 0, as float2string() did
+    CHECK_STR(float2string(-0.5f, 2), "0.50");
+    CHECK_STR(fixed(0.0f, 3), "0.000");
+    CHECK_STR(fixed(0.05f, 1), "0.0");
+    CHECK_STR(fixed(65.535f, 3), "65.535");
+    CHECK_STR(fixed(65.536f, 3), "65.536");    // float2string() wrapped here ..
+    CHECK_STR(float2string(65.536f, 3), "65.000");
+    CHECK_STR(fixed(655.36f, 2), "655.36");    //   and here
+    CHECK_STR(fixed(32767.0f, 1), "32767.0");
+    CHECK_STR(fixed(-32767.9f, 1), "-32767.9");
+
+    //---  Timing.  (Host nS - the AVR has no FPU and 16-bit divides, so only the ratio says anything)
+    volatile float v = 13.875f;
+    double tOld = BENCH_NS(200000, old_path(v, 2));
+    double tNew = BENCH_NS(200000, fixed(v, 2));
+    char was[sizeof(out)];
+    strcpy(was, old_path(v, 2));
+    CHECK_STR(was, fixed(v, 2));
+    printf("float2string + TX_write: %.0f nS, TXW_fixed: %.0f nS  (each into the ring and out the port)\n", tOld, tNew);
+
+    //---  Whole messages:  the Charge Profile the regulator starts with, then random values.
+    memcpy_P(&cps, &defaultCPS[0], sizeof(tCPS));
+    check_messages(&cps);
+    for (k = 0; k < 20000; k++)
+    {
+        randomize(&cps);
+        check_messages(&cps);
+    }
+
+    return (test_summary("txw_fixed"));
+}
@@ -0,0 +1,183 @@
+//      BTDecoder.cpp
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//      Host side decoder for the regulator's binary telemetry, see BTDecoder.h
+//
+
+#include "BTDecoder.h"
+
+static const tBTField astFields[BT_AST_NFIELDS] = {BT_AST_FIELDS};
+
+BTDecoder::BTDecoder()
+{
+    frames = 0;
+    crcErrors = 0;
+    overruns = 0;
+    m_astValid = false;
+    reset();
+}
+
+void BTDecoder::reset(void)
+{
+    m_rawLen = 0;
+    m_overrun = false;
+    m_type = 0;
+    m_length = 0;
+}
+
+bool BTDecoder::feed(uint8_t c)
+{
+    if (c != 0x00)
+    { // Still collecting the frame
+        if (m_rawLen < (int)sizeof(m_raw))
+            m_raw[m_rawLen++] = c;
+        else
+            m_overrun = true;
+        return false;
+    }
+
+    bool good = false; // 0x00 = end of frame
+
+    if (m_overrun)
+        overruns++;
+    else if (m_rawLen > 0)
+    {
+        good = decode();
+        if (good)
+            frames++;
+        else
+            crcErrors++;
+    }
+
+    m_rawLen = 0;
+    m_overrun = false;
+    return good;
+}
+
+bool BTDecoder::decode(void)
+{ // Undo the COBS encoding into m_frame[], then check the CRC
+    int in = 0;
+    int out = 0;
+
+    while (in < m_rawLen)
+    {
+        uint8_t code = m_raw[in++];
+
+        if ((in + code - 1) > m_rawLen)
+            return false; // Block runs off the end of the frame
+
+        for (int i = 1; i < code; i++)
+            m_frame[out++] = m_raw[in++];
+
+        if ((code != 0xFF) && (in < m_rawLen))
+            m_frame[out++] = 0x00;
+    }
+
+    if (out < 3)
+        return false; // Must at least have a TYPE and the CRC
+
+    uint16_t crc = 0xFFFF;
+    for (int i = 0; i < out - 2; i++)
+        crc = CRC16_update(crc, m_frame[i]);
+
+    if (crc != (m_frame[out - 2] | ((uint16_t)m_frame[out - 1] << 8)))
+        return false;
+
+    m_type = m_frame[0];
+    m_length = out - 3;
+
+    if ((m_type == BT_AST) && (m_length == (int)sizeof(tBTAST)))
+    {
+        memcpy(&m_ast, payload(), sizeof(tBTAST));
+        m_astValid = true;
+    }
+    else if (m_type == BT_AST_DELTA)
+        return applyDelta();
+
+    return true;
+}
+
+bool BTDecoder::applyDelta(void)
+{ // Walk the TAG / VALUE pairs, updating the AST from the last keyframe
+    const uint8_t *p = payload();
+    int i = 0;
+
+    while (i < m_length)
+    {
+        uint8_t tag = p[i++];
+        if ((tag >= BT_AST_NFIELDS) || ((i + astFields[tag].size) > m_length))
+        {
+            m_astValid = false; // Can not trust the image any more, wait for the next keyframe.
+            return false;
+        }
+
+        memcpy((uint8_t *)&m_ast + astFields[tag].offset, p + i, astFields[tag].size);
+        i += astFields[tag].size;
+    }
+
+    return true;
+}
+
+bool BTDecoder::ast(tBTAST &dest) const
+{
+    if (!m_astValid || ((m_type != BT_AST) && (m_type != BT_AST_DELTA)))
+        return false;
+    dest = m_ast;
+    return true;
+}
+
+std::string BTDecoder::text(void) const
+{
+    if (m_type != BT_TEXT)
+        return std::string();
+    return std::string((const char *)payload(), m_length);
+}
+
+int BTDecoder::encode(uint8_t type, const void *payload, int len, uint8_t *out)
+{ // Same framing as BT_send() on the regulator:  COBS( TYPE PAYLOAD CRC ) 0x00
+    uint8_t frame[BT_MAX_FRAME];
+    int n = 0;
+    uint16_t crc = 0xFFFF;
+
+    if ((len < 0) || (len > BT_MAX_PAYLOAD))
+        return 0; // Would not fit in a frame  (the regulator would have cut it short)
+
+    frame[n++] = type;
+    memcpy(frame + n, payload, len);
+    n += len;
+    for (int i = 0; i < n; i++)
+        crc = CRC16_update(crc, frame[i]);
+    frame[n++] = crc & 0xFF;
+    frame[n++] = crc >> 8;
+
+    int pos = 1;
+    int codeIdx = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (frame[i] != 0)
+            out[pos++] = frame[i];
+        if ((frame[i] == 0) || ((pos - codeIdx) == 0xFF))
+        {
+            out[codeIdx] = pos - codeIdx;
+            codeIdx = pos++;
+        }
+    }
+    out[codeIdx] = pos - codeIdx;
+    out[pos++] = 0x00;
+    return pos;
+}
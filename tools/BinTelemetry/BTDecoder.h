@@ -0,0 +1,90 @@
+//      BTDecoder.h
+//
+//      Copyright (c) 2021 by Pete Dubler
+//
+//              This program is free software: you can redistribute it and/or modify
+//              it under the terms of the GNU General Public License as published by
+//              the Free Software Foundation, either version 3 of the License, or
+//              (at your option) any later version.
+//
+//              This program is distributed in the hope that it will be useful,
+//              but WITHOUT ANY WARRANTY; without even the implied warranty of
+//              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//              GNU General Public License for more details.
+//
+//              You should have received a copy of the GNU General Public License
+//              along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//      Host side decoder for the regulator's binary telemetry  ($BIN:1, see src/BinTelemetry.h for the frame format)
+//
+//      Feed it every byte received from the regulator, each time feed() returns true a complete good frame is
+//      waiting.  For example:
+//
+//          BTDecoder dec;
+//          tBTAST ast;
+//
+//          while (read(fd, &c, 1) == 1)
+//              if (dec.feed(c) && dec.get(BT_AST, ast))
+//                  printf("%.2fV %.1fA\n", ast.batmV / 1000.0, ast.batdA / 10.0);
+//
+//      In delta mode ($BIN:2) use ast() instead of get(), it keeps the AST up to date from the keyframes and deltas.
+//
+//      encode() builds a frame to send to the regulator - only used for the BT_BACKUP frames following $BKL:
+//
+//      The payload structures are the ones the regulator uses, so this expects a little-endian host.
+//
+
+#ifndef _BTDECODER_H_
+#define _BTDECODER_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include "../../src/BinTelemetry.h"
+
+class BTDecoder
+{
+public:
+    BTDecoder();
+
+    bool feed(uint8_t c); // Returns true once a complete, good, frame has been received.
+    void reset(void);
+
+    uint8_t type(void) const { return m_type; }
+    const uint8_t *payload(void) const { return m_frame + 1; }
+    int length(void) const { return m_length; } // Of the payload
+
+    template <typename T>
+    bool get(uint8_t type, T &dest) const
+    { // Copy out the payload of the last frame, if it is of the expected type and size.
+        if ((m_type != type) || (m_length != (int)sizeof(T)))
+            return false;
+        memcpy(&dest, payload(), sizeof(T));
+        return true;
+    }
+
+    std::string text(void) const; // Payload of the last BT_TEXT frame (empty if it was not one)
+
+    static int encode(uint8_t type, const void *payload, int len, uint8_t *out); // Returns the frame's length (0x00 included), out must hold BT_MAX_FRAME.  0 if len > BT_MAX_PAYLOAD
+    bool ast(tBTAST &dest) const; // Latest AST, if the last frame was a BT_AST or BT_AST_DELTA (and a keyframe has been seen)
+
+    uint32_t frames;    // Good frames received
+    uint32_t crcErrors; // Frames thrown away
+    uint32_t overruns;
+
+private:
+    bool decode(void);
+    bool applyDelta(void);
+
+    uint8_t m_raw[BT_MAX_FRAME]; // COBS encoded, as received
+    uint8_t m_frame[BT_MAX_FRAME];
+    int m_rawLen;
+    bool m_overrun;
+    uint8_t m_type;
+    int m_length;
+    tBTAST m_ast;
+    bool m_astValid;
+};
+
+#endif // _BTDECODER_H_